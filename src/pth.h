@@ -60,6 +60,8 @@
     /* extra structure definitions */
 struct timeval;
 struct timespec;
+struct msghdr;
+struct mmsghdr;
 
     /* essential values */
 #ifndef FALSE
@@ -125,6 +127,18 @@ BEGIN_DECLARATION
                                        PTH_CTRL_GETTHREADS_DEAD)
 #define PTH_CTRL_DUMPSTATE            _BIT(10)
 #define PTH_CTRL_FAVOURNEW            _BIT(11)
+#define PTH_CTRL_GETTIMERWAKEUPS      _BIT(12)
+#define PTH_CTRL_GETTIMERCOALESCED    _BIT(13)
+#define PTH_CTRL_IOURING              _BIT(14)
+#define PTH_CTRL_GETOFFLOADQUEUE      _BIT(15)
+#define PTH_CTRL_GETOFFLOADJOBS       _BIT(16)
+#define PTH_CTRL_GETOFFLOADLATENCY    _BIT(17)
+#define PTH_CTRL_GETFSYNCS            _BIT(18)
+#define PTH_CTRL_GETFSYNCREQUESTS     _BIT(19)
+#define PTH_CTRL_GETFSYNCLATENCY      _BIT(20)
+#define PTH_CTRL_GETMUTEXCONTENDED    _BIT(21)
+#define PTH_CTRL_GETMUTEXHANDOFFS     _BIT(22)
+#define PTH_CTRL_GETMUTEXWAITTIME     _BIT(23)
 
     /* the time value structure */
 typedef struct timeval pth_time_t;
@@ -167,7 +181,9 @@ enum {
     PTH_ATTR_START_ARG,      /* RO [void *]            thread start argument             */
     PTH_ATTR_STATE,          /* RO [pth_state_t]       scheduling state                  */
     PTH_ATTR_EVENTS,         /* RO [pth_event_t]       events the thread is waiting for  */
-    PTH_ATTR_BOUND           /* RO [int]               whether object is bound to thread */
+    PTH_ATTR_BOUND,          /* RO [int]               whether object is bound to thread */
+    PTH_ATTR_TIMER_SLACK,    /* RW [long]              timer slack in nanoseconds        */
+    PTH_ATTR_DEADLINE        /* RW [pth_time_t]        time budget of thread             */
 };
 
     /* default thread attribute */
@@ -187,6 +203,12 @@ struct pth_event_st;
 #define PTH_EVENT_COND               _BIT(7)
 #define PTH_EVENT_TID                _BIT(8)
 #define PTH_EVENT_FUNC               _BIT(9)
+#define PTH_EVENT_NOTIFY             _BIT(10)
+#define PTH_EVENT_PID                _BIT(23)
+#define PTH_EVENT_POLL               _BIT(24)
+#define PTH_EVENT_PIPE               _BIT(25)
+#define PTH_EVENT_SEM                _BIT(26)
+#define PTH_EVENT_WAITGROUP          _BIT(19)
 
     /* event occurange restrictions */
 #define PTH_UNTIL_OCCURRED           _BIT(11)
@@ -249,20 +271,23 @@ struct pth_ring_st {
    /* mutex values */
 #define PTH_MUTEX_INITIALIZED        _BIT(0)
 #define PTH_MUTEX_LOCKED             _BIT(1)
-#define PTH_MUTEX_INIT               { {NULL, NULL}, PTH_MUTEX_INITIALIZED, NULL, 0 }
+#define PTH_MUTEX_FAIR               _BIT(2)
+#define PTH_MUTEX_INHERIT            _BIT(3)
+#define PTH_MUTEX_INIT               { {NULL, NULL}, PTH_MUTEX_INITIALIZED, NULL, 0, 0, NULL, NULL }
 
    /* read-write lock values */
 enum { PTH_RWLOCK_RD, PTH_RWLOCK_RW };
 #define PTH_RWLOCK_INITIALIZED       _BIT(0)
 #define PTH_RWLOCK_INIT              { PTH_RWLOCK_INITIALIZED, PTH_RWLOCK_RD, 0, \
-                                       PTH_MUTEX_INIT, PTH_MUTEX_INIT }
+                                       NULL, 0, NULL, NULL, NULL, NULL }
 
    /* condition variable values */
 #define PTH_COND_INITIALIZED         _BIT(0)
 #define PTH_COND_SIGNALED            _BIT(1)
 #define PTH_COND_BROADCAST           _BIT(2)
 #define PTH_COND_HANDLED             _BIT(3)
-#define PTH_COND_INIT                { PTH_COND_INITIALIZED, 0 }
+#define PTH_COND_YIELD               _BIT(4)
+#define PTH_COND_INIT                { PTH_COND_INITIALIZED, 0, NULL, NULL }
 
    /* barrier variable values */
 #define PTH_BARRIER_INITIALIZED      _BIT(0)
@@ -272,6 +297,17 @@ enum { PTH_RWLOCK_RD, PTH_RWLOCK_RW };
 #define PTH_BARRIER_HEADLIGHT        (-1)
 #define PTH_BARRIER_TAILLIGHT        (-2)
 
+   /* semaphore values */
+#define PTH_SEM_INITIALIZED          _BIT(0)
+#define PTH_SEM_INIT(value)          { PTH_SEM_INITIALIZED, (value), NULL, NULL }
+
+   /* wait group and latch values */
+#define PTH_WAITGROUP_INITIALIZED    _BIT(0)
+#define PTH_WAITGROUP_LATCH          _BIT(1)
+#define PTH_WAITGROUP_INIT           { PTH_WAITGROUP_INITIALIZED, 0, NULL }
+#define PTH_LATCH_INIT(count)        { PTH_WAITGROUP_INITIALIZED|PTH_WAITGROUP_LATCH, \
+                                       (count), NULL }
+
     /* the message port structure */
 typedef struct pth_msgport_st *pth_msgport_t;
 struct pth_msgport_st;
@@ -285,6 +321,20 @@ struct pth_message_st { /* not hidden to allow inclusion */
     void          *m_data;
 };
 
+    /* the notification object structure */
+typedef struct pth_notify_st *pth_notify_t;
+struct pth_notify_st;
+
+    /* the buffered stream structure */
+typedef struct pth_stream_st *pth_stream_t;
+struct pth_stream_st;
+#define PTH_STREAM_BUFSIZE 8192
+
+    /* the in-process pipe structure */
+typedef struct pth_pipe_st *pth_pipe_t;
+struct pth_pipe_st;
+#define PTH_PIPE_BUFSIZE 65536
+
     /* the mutex structure */
 typedef struct pth_mutex_st pth_mutex_t;
 struct pth_mutex_st { /* not hidden to avoid destructor */
@@ -292,6 +342,9 @@ struct pth_mutex_st { /* not hidden to avoid destructor */
     int            mx_state;
     pth_t          mx_owner;
     unsigned long  mx_count;
+    int            mx_spins;
+    struct pth_mutex_waiter_st *mx_whead;
+    struct pth_mutex_waiter_st *mx_wtail;
 };
 
     /* the read-write lock structure */
@@ -300,8 +353,12 @@ struct pth_rwlock_st { /* not hidden to avoid destructor */
     int            rw_state;
     unsigned int   rw_mode;
     unsigned long  rw_readers;
-    pth_mutex_t    rw_mutex_rd;
-    pth_mutex_t    rw_mutex_rw;
+    pth_t          rw_writer;
+    unsigned long  rw_count;
+    struct pth_rwlock_waiter_st *rw_rwait;
+    struct pth_rwlock_waiter_st *rw_wwait;
+    struct pth_rwlock_waiter_st *rw_wlast;
+    struct pth_rwlock_waiter_st *rw_upgrader;
 };
 
     /* the condition variable structure */
@@ -309,6 +366,8 @@ typedef struct pth_cond_st pth_cond_t;
 struct pth_cond_st { /* not hidden to avoid destructor */
     unsigned long cn_state;
     unsigned int  cn_waiters;
+    struct pth_cond_waiter_st *cn_whead;
+    struct pth_cond_waiter_st *cn_wtail;
 };
 
     /* the barrier variable structure */
@@ -322,6 +381,24 @@ struct pth_barrier_st { /* not hidden to avoid destructor */
     pth_mutex_t   br_mutex;
 };
 
+    /* the semaphore structure */
+typedef struct pth_sem_st pth_sem_t;
+struct pth_sem_st { /* not hidden to avoid destructor */
+    int            sm_state;
+    unsigned int   sm_value;
+    struct pth_sem_waiter_st *sm_whead;
+    struct pth_sem_waiter_st *sm_wtail;
+};
+
+    /* the wait group structure (also used for latches) */
+typedef struct pth_waitgroup_st pth_waitgroup_t;
+typedef struct pth_waitgroup_st pth_latch_t;
+struct pth_waitgroup_st { /* not hidden to avoid destructor */
+    int            wg_state;
+    unsigned int   wg_count;
+    struct pth_waitgroup_waiter_st *wg_waiters;
+};
+
     /* the user-space context structure */
 typedef struct pth_uctx_st *pth_uctx_t;
 struct pth_uctx_st;
@@ -448,6 +525,12 @@ extern void           pth_exit(void *);
 
     /* utility functions */
 extern int            pth_fdmode(int, int);
+extern int            pth_close(int);
+extern int            pth_cork(int, size_t);
+extern int            pth_flush(int);
+extern int            pth_deadline_push(pth_time_t);
+extern int            pth_deadline_pop(void);
+extern int            pth_deadline_remaining(pth_time_t *);
 extern pth_time_t     pth_time(long, long);
 extern pth_time_t     pth_timeout(long, long);
 
@@ -480,6 +563,36 @@ extern int            pth_msgport_put(pth_msgport_t, pth_message_t *);
 extern pth_message_t *pth_msgport_get(pth_msgport_t);
 extern int            pth_msgport_reply(pth_message_t *);
 
+    /* notification object functions */
+extern pth_notify_t   pth_notify_create(void);
+extern int            pth_notify_raise(pth_notify_t);
+extern int            pth_notify_wait(pth_notify_t, pth_event_t);
+extern int            pth_notify_destroy(pth_notify_t);
+
+    /* kernel thread offload functions */
+extern int            pth_offload(void *(*)(void *), void *, void **);
+extern int            pth_mmap_prefetch(const void *, size_t);
+extern int            pth_fsync_group(int);
+
+    /* buffered stream functions */
+extern pth_stream_t   pth_stream_create(int, size_t, size_t);
+extern int            pth_stream_destroy(pth_stream_t);
+extern int            pth_stream_fd(pth_stream_t);
+extern ssize_t        pth_stream_read(pth_stream_t, void *, size_t, pth_event_t);
+extern ssize_t        pth_stream_readuntil(pth_stream_t, int, void *, size_t, pth_event_t);
+extern ssize_t        pth_stream_peek(pth_stream_t, size_t, const void **, pth_event_t);
+extern ssize_t        pth_stream_peekuntil(pth_stream_t, int, const void **, pth_event_t);
+extern int            pth_stream_consume(pth_stream_t, size_t);
+extern ssize_t        pth_stream_write(pth_stream_t, const void *, size_t, pth_event_t);
+extern int            pth_stream_flush(pth_stream_t, pth_event_t);
+
+    /* in-process pipe functions */
+extern pth_pipe_t     pth_pipe_create(size_t);
+extern int            pth_pipe_destroy(pth_pipe_t);
+extern ssize_t        pth_pipe_read(pth_pipe_t, void *, size_t, pth_event_t);
+extern ssize_t        pth_pipe_write(pth_pipe_t, const void *, size_t, pth_event_t);
+extern int            pth_pipe_close(pth_pipe_t);
+
     /* cleanup handler functions */
 extern int            pth_cleanup_push(void (*)(void *), void *);
 extern int            pth_cleanup_pop(int);
@@ -491,16 +604,31 @@ extern pid_t          pth_fork(void);
 
     /* synchronization functions */
 extern int            pth_mutex_init(pth_mutex_t *);
+extern int            pth_mutex_setmode(pth_mutex_t *, int, int);
 extern int            pth_mutex_acquire(pth_mutex_t *, int, pth_event_t);
 extern int            pth_mutex_release(pth_mutex_t *);
 extern int            pth_rwlock_init(pth_rwlock_t *);
 extern int            pth_rwlock_acquire(pth_rwlock_t *, int, int, pth_event_t);
+extern int            pth_rwlock_upgrade(pth_rwlock_t *, int, pth_event_t);
+extern int            pth_rwlock_downgrade(pth_rwlock_t *);
 extern int            pth_rwlock_release(pth_rwlock_t *);
 extern int            pth_cond_init(pth_cond_t *);
 extern int            pth_cond_await(pth_cond_t *, pth_mutex_t *, pth_event_t);
 extern int            pth_cond_notify(pth_cond_t *, int);
 extern int            pth_barrier_init(pth_barrier_t *, int);
 extern int            pth_barrier_reach(pth_barrier_t *);
+extern int            pth_sem_init(pth_sem_t *, unsigned int);
+extern int            pth_sem_acquire(pth_sem_t *, unsigned int);
+extern int            pth_sem_acquire_ev(pth_sem_t *, unsigned int, pth_event_t);
+extern int            pth_sem_tryacquire(pth_sem_t *, unsigned int);
+extern int            pth_sem_release(pth_sem_t *, unsigned int);
+extern int            pth_waitgroup_init(pth_waitgroup_t *);
+extern int            pth_waitgroup_add(pth_waitgroup_t *, int);
+extern int            pth_waitgroup_done(pth_waitgroup_t *);
+extern int            pth_waitgroup_wait(pth_waitgroup_t *, pth_event_t);
+extern int            pth_latch_init(pth_latch_t *, unsigned int);
+extern int            pth_latch_countdown(pth_latch_t *, unsigned int);
+extern int            pth_latch_wait(pth_latch_t *, pth_event_t);
 
     /* user-space context functions */
 extern int            pth_uctx_create(pth_uctx_t *);
@@ -515,6 +643,7 @@ extern Sfdisc_t      *pth_sfiodisc(void);
 extern int            pth_sigwait_ev(const sigset_t *, int *, pth_event_t);
 extern int            pth_connect_ev(int, const struct sockaddr *, socklen_t, pth_event_t);
 extern int            pth_accept_ev(int, struct sockaddr *, socklen_t *, pth_event_t);
+extern int            pth_accept_many(int, int *, int, pth_event_t);
 extern int            pth_select_ev(int, fd_set *, fd_set *, fd_set *, struct timeval *, pth_event_t);
 extern int            pth_poll_ev(struct pollfd *, nfds_t, int, pth_event_t);
 extern ssize_t        pth_read_ev(int, void *, size_t, pth_event_t);
@@ -525,6 +654,13 @@ extern ssize_t        pth_recv_ev(int, void *, size_t, int, pth_event_t);
 extern ssize_t        pth_send_ev(int, const void *, size_t, int, pth_event_t);
 extern ssize_t        pth_recvfrom_ev(int, void *, size_t, int, struct sockaddr *, socklen_t *, pth_event_t);
 extern ssize_t        pth_sendto_ev(int, const void *, size_t, int, const struct sockaddr *, socklen_t, pth_event_t);
+extern ssize_t        pth_sendfile_ev(int, int, off_t *, size_t, pth_event_t);
+extern ssize_t        pth_splice_ev(int, off_t *, int, off_t *, size_t, unsigned int, pth_event_t);
+extern ssize_t        pth_tee_ev(int, int, size_t, unsigned int, pth_event_t);
+extern int            pth_recvmmsg_ev(int, struct mmsghdr *, unsigned int, int, pth_event_t);
+extern int            pth_sendmmsg_ev(int, struct mmsghdr *, unsigned int, int, pth_event_t);
+extern ssize_t        pth_send_zc_ev(int, const void *, size_t, int, pth_event_t *, pth_event_t);
+extern ssize_t        pth_recv_pooled_ev(int, void **, size_t, int, pth_event_t);
 
     /* standard replacement functions */
 extern int            pth_nanosleep(const struct timespec *, struct timespec *);
@@ -549,6 +685,21 @@ extern ssize_t        pth_recvfrom(int, void *, size_t, int, struct sockaddr *,
 extern ssize_t        pth_sendto(int, const void *, size_t, int, const struct sockaddr *, socklen_t);
 extern ssize_t        pth_pread(int, void *, size_t, off_t);
 extern ssize_t        pth_pwrite(int, const void *, size_t, off_t);
+extern ssize_t        pth_preadv(int, const struct iovec *, int, off_t);
+extern ssize_t        pth_pwritev(int, const struct iovec *, int, off_t);
+extern ssize_t        pth_sendfile(int, int, off_t *, size_t);
+extern ssize_t        pth_splice(int, off_t *, int, off_t *, size_t, unsigned int);
+extern ssize_t        pth_tee(int, int, size_t, unsigned int);
+extern int            pth_recvmmsg(int, struct mmsghdr *, unsigned int, int);
+extern int            pth_sendmmsg(int, struct mmsghdr *, unsigned int, int);
+extern ssize_t        pth_send_zc(int, const void *, size_t, int, pth_event_t *);
+extern ssize_t        pth_recv_pooled(int, void **, size_t, int);
+extern void           pth_recv_release(void *);
+
+    /* UDP segmentation offload support */
+extern int            pth_udp_segment(int, int);
+extern int            pth_udp_gro(int, int);
+extern int            pth_udp_gro_size(const struct msghdr *);
 
 END_DECLARATION
 
@@ -577,6 +728,7 @@ END_DECLARATION
 #define sendto        pth_sendto
 #define pread         pth_pread
 #define pwrite        pth_pwrite
+#define close         pth_close
 #endif
 
     /* backward compatibility (Pth < 1.5.0) */
@@ -1,6 +1,9 @@
 /* pth_acdef.h.  Generated by configure.  */
 /* pth_acdef.h.in.  Generated from configure.ac by autoheader.  */
 
+/* Define to 1 if you have the `accept4' function. */
+#define HAVE_ACCEPT4 1
+
 /* Define to 1 if you have the `dlclose' function. */
 #define HAVE_DLCLOSE 1
 
@@ -25,6 +28,9 @@
 /* Define to 1 if you have the <fcntl.h> header file. */
 #define HAVE_FCNTL_H 1
 
+/* Define to 1 if you have the `fdatasync' function. */
+#define HAVE_FDATASYNC 1
+
 /* Define to 1 if you have the `getcontext' function. */
 #define HAVE_GETCONTEXT 1
 
@@ -70,6 +76,12 @@
 /* Define to 1 if you have the <memory.h> header file. */
 #define HAVE_MEMORY_H 1
 
+/* Define to 1 if you have the `mincore' function. */
+#define HAVE_MINCORE 1
+
+/* Define to 1 if you have the <netinet/udp.h> header file. */
+#define HAVE_NETINET_UDP_H 1
+
 /* Define to 1 if you have the <net/errno.h> header file. */
 /* #undef HAVE_NET_ERRNO_H */
 
@@ -91,8 +103,17 @@
 /* define if pre-processor define POLLIN exists in header poll.h */
 #define HAVE_POLLIN 1
 
+/* Define to 1 if you have the `ppoll' function. */
+#define HAVE_PPOLL 1
+
 /* Define to 1 if you have the <pthread.h> header file. */
-/* #undef HAVE_PTHREAD_H */
+#define HAVE_PTHREAD_H 1
+
+/* Define to 1 if you have the `preadv' function. */
+#define HAVE_PREADV 1
+
+/* Define to 1 if you have the `pwritev' function. */
+#define HAVE_PWRITEV 1
 
 /* Define to 1 if you have the `readv' function. */
 #define HAVE_READV 1
@@ -100,9 +121,15 @@
 /* define if pre-processor define RTLD_NEXT exists in header dlfcn.h */
 #define HAVE_RTLD_NEXT 1
 
+/* Define to 1 if you have the `recvmmsg' function. */
+#define HAVE_RECVMMSG 1
+
 /* Define to 1 if you have the `select' function. */
 #define HAVE_SELECT 1
 
+/* Define to 1 if you have the `sendmmsg' function. */
+#define HAVE_SENDMMSG 1
+
 /* Define to 1 if you have the `setcontext' function. */
 #define HAVE_SETCONTEXT 1
 
@@ -139,6 +166,9 @@
 /* Define to 1 if you have the `sigstack' function. */
 #define HAVE_SIGSTACK 1
 
+/* Define to 1 if you have the `splice' function. */
+#define HAVE_SPLICE 1
+
 /* Define to 1 if you have the `sigsuspend' function. */
 #define HAVE_SIGSUSPEND 1
 
@@ -198,9 +228,24 @@
 /* define if pre-processor define SYS_read exists in header sys/syscall.h */
 #define HAVE_SYS_READ 1
 
+/* Define to 1 if you have the <linux/errqueue.h> header file. */
+#define HAVE_LINUX_ERRQUEUE_H 1
+
+/* Define to 1 if you have the <linux/io_uring.h> header file. */
+#define HAVE_LINUX_IO_URING_H 1
+
+/* Define to 1 if you have the <sys/eventfd.h> header file. */
+#define HAVE_SYS_EVENTFD_H 1
+
+/* Define to 1 if you have the <sys/mman.h> header file. */
+#define HAVE_SYS_MMAN_H 1
+
 /* Define to 1 if you have the <sys/resource.h> header file. */
 #define HAVE_SYS_RESOURCE_H 1
 
+/* Define to 1 if you have the <sys/sendfile.h> header file. */
+#define HAVE_SYS_SENDFILE_H 1
+
 /* Define to 1 if you have the <sys/select.h> header file. */
 #define HAVE_SYS_SELECT_H 1
 
@@ -228,6 +273,9 @@
 /* Define to 1 if you have the <sys/wait.h> header file. */
 #define HAVE_SYS_WAIT_H 1
 
+/* Define to 1 if you have the `tee' function. */
+#define HAVE_TEE 1
+
 /* Define to 1 if you have the <unistd.h> header file. */
 #define HAVE_UNISTD_H 1
 
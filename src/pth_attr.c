@@ -43,6 +43,8 @@ struct pth_attr_st {
     unsigned int a_cancelstate;
     unsigned int a_stacksize;
     char        *a_stackaddr;
+    long         a_timerslack;
+    pth_time_t   a_deadline;
 };
 
 #endif /* cpp */
@@ -91,6 +93,8 @@ int pth_attr_init(pth_attr_t a)
     a->a_cancelstate = PTH_CANCEL_DEFAULT;
     a->a_stacksize = 65536;
     a->a_stackaddr = NULL;
+    a->a_timerslack = 0;
+    pth_time_set(&a->a_deadline, PTH_TIME_ZERO);
     return TRUE;
 }
 
@@ -225,6 +229,42 @@ int pth_attr_ctrl(int cmd, pth_attr_t a, int op, va_list ap)
             *dst = *src;
             break;
         }
+        case PTH_ATTR_TIMER_SLACK: {
+            /* timer slack */
+            long val, *src, *dst;
+            if (cmd == PTH_ATTR_SET) {
+                src = &val; val = va_arg(ap, long);
+                if (val < 0)
+                    return pth_error(FALSE, EINVAL);
+                dst = (a->a_tid != NULL ? &a->a_tid->timerslack : &a->a_timerslack);
+            }
+            else {
+                src = (a->a_tid != NULL ? &a->a_tid->timerslack : &a->a_timerslack);
+                dst = va_arg(ap, long *);
+            }
+            *dst = *src;
+            break;
+        }
+        case PTH_ATTR_DEADLINE: {
+            /* time budget (bound: time left until the innermost deadline) */
+            pth_time_t val, *dst;
+            if (cmd == PTH_ATTR_SET) {
+                if (a->a_tid != NULL)
+                    return pth_error(FALSE, EPERM);
+                val = va_arg(ap, pth_time_t);
+                if (val.tv_sec < 0 || val.tv_usec < 0 || val.tv_usec >= 1000000)
+                    return pth_error(FALSE, EINVAL);
+                pth_time_set(&a->a_deadline, &val);
+            }
+            else {
+                dst = va_arg(ap, pth_time_t *);
+                if (a->a_tid == NULL)
+                    pth_time_set(dst, &a->a_deadline);
+                else if (!pth_deadline_left(a->a_tid, dst))
+                    pth_time_set(dst, PTH_TIME_ZERO);
+            }
+            break;
+        }
         case PTH_ATTR_TIME_SPAWN: {
             pth_time_t *dst;
             if (cmd == PTH_ATTR_SET)
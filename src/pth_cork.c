@@ -0,0 +1,467 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  This file is part of GNU Pth, a non-preemptive thread scheduling
+**  library which can be found at http://www.gnu.org/software/pth/.
+**
+**  This library is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU Lesser General Public
+**  License as published by the Free Software Foundation; either
+**  version 2.1 of the License, or (at your option) any later version.
+**
+**  This library is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**  Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public
+**  License along with this library; if not, write to the Free Software
+**  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+**  USA, or contact Ralf S. Engelschall <rse@engelschall.com>.
+**
+**  pth_cork.c: Pth write coalescing
+*/
+                             /* ``Many small drops make
+                                  a single splash.''
+                                                 -- Unknown */
+#include "pth_p.h"
+
+/*
+ * Corked filedescriptors collect small pth_write(3) and pth_writev(3)
+ * calls in a per-filedescriptor buffer. The buffer is written out with
+ * a single system call as soon as the writing thread gives up control
+ * (pth_wait, pth_yield, pth_exit), when it runs full, before any other
+ * kind of output on the filedescriptor and on pth_flush(3). Errors of
+ * such implicit flushes are reported by the next operation on it.
+ */
+
+/* write coalescing buffer of a filedescriptor */
+typedef struct {
+    pth_ringnode_t c_node;   /* node in ring of buffers with pending data  */
+    int            c_fd;     /* the corked filedescriptor                  */
+    char          *c_buf;    /* buffer                                     */
+    size_t         c_size;   /* size of buffer                             */
+    size_t         c_len;    /* amount of pending data                     */
+    pth_t          c_owner;  /* thread which wrote the pending data last   */
+    int            c_busy;   /* number of users writing the buffer out     */
+    int            c_closed; /* filedescriptor was closed meanwhile        */
+    int            c_error;  /* error of an implicit flush (or 0)          */
+    unsigned int   c_epoch;  /* last pth_cork_flushall() run which saw us  */
+} pth_cork_t;
+
+static pth_cork_t   **pth_cork_tab   = NULL;
+static int            pth_cork_size  = 0;
+static pth_ring_t     pth_cork_dirty = PTH_RING_INIT;
+static unsigned int   pth_cork_epoch = 0;
+
+/* number of buffers with pending data (checked before every context switch) */
+int pth_cork_pending = 0;
+
+/* find the buffer of a corked filedescriptor */
+static pth_cork_t *pth_cork_lookup(int fd)
+{
+    if (fd < 0 || fd >= pth_cork_size)
+        return NULL;
+    return pth_cork_tab[fd];
+}
+
+/* remember that a buffer holds data (or no longer does) */
+static void pth_cork_mark(pth_cork_t *c)
+{
+    if (c->c_len > 0 && c->c_node.rn_next == NULL) {
+        pth_ring_append(&pth_cork_dirty, &c->c_node);
+        pth_cork_pending++;
+    }
+    else if (c->c_len == 0 && c->c_node.rn_next != NULL) {
+        pth_ring_delete(&pth_cork_dirty, &c->c_node);
+        c->c_node.rn_next = NULL;
+        c->c_node.rn_prev = NULL;
+        pth_cork_pending--;
+    }
+    return;
+}
+
+/* stop writing out a buffer and free it if its filedescriptor was
+   closed meanwhile by another thread; returns FALSE if it is closed */
+static int pth_cork_unuse(pth_cork_t *c)
+{
+    c->c_busy--;
+    if (!c->c_closed)
+        return TRUE;
+    if (c->c_busy == 0) {
+        free(c->c_buf);
+        free(c);
+    }
+    return FALSE;
+}
+
+/* drop the first nbytes of pending data */
+static void pth_cork_consume(pth_cork_t *c, size_t nbytes)
+{
+    if (nbytes < c->c_len)
+        memmove(c->c_buf, c->c_buf + nbytes, c->c_len - nbytes);
+    c->c_len -= nbytes;
+    pth_cork_mark(c);
+    return;
+}
+
+/* write out the pending data of a buffer */
+static int pth_cork_flushone(pth_cork_t *c, pth_event_t ev_extra)
+{
+    ssize_t n;
+
+    if (c->c_len == 0)
+        return TRUE;
+    c->c_busy++;
+    n = pth_write_ev(c->c_fd, c->c_buf, c->c_len, ev_extra);
+    if (!pth_cork_unuse(c))
+        return pth_error(FALSE, EBADF);
+    if (n < 0)
+        return FALSE;
+
+    /* keep the rest if the write was interrupted by the extra
+       event or the filedescriptor is in non-blocking mode */
+    pth_cork_consume(c, (size_t)n);
+    if (c->c_len > 0)
+        return pth_error(FALSE, ev_extra != NULL ? EINTR : EAGAIN);
+    return TRUE;
+}
+
+/* write out the pending data of a buffer because its thread is about to
+   give up control: this happens inside pth_wait(3), where the thread might
+   already wait on the static event of a Pth I/O function, so these cannot
+   be used here and a private event is waited on instead */
+static int pth_cork_drain(pth_cork_t *c)
+{
+    pth_event_t ev;
+    ssize_t n;
+    int fdmode;
+    int cancelstate;
+    int rc;
+
+    if ((fdmode = pth_fdmode(c->c_fd, PTH_FDMODE_NONBLOCK)) == PTH_FDMODE_ERROR)
+        return pth_error(FALSE, EBADF);
+    pth_cancel_state(PTH_CANCEL_DISABLE, &cancelstate);
+    ev = NULL;
+    rc = TRUE;
+    while (c->c_len > 0) {
+        while ((n = pth_sc(write)(c->c_fd, c->c_buf, c->c_len)) < 0
+               && errno == EINTR) ;
+        if (n > 0) {
+            pth_cork_consume(c, (size_t)n);
+            continue;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            rc = FALSE;
+            break;
+        }
+
+        /* a filedescriptor in non-blocking mode is not waited for */
+        if (fdmode == PTH_FDMODE_NONBLOCK) {
+            rc = pth_error(FALSE, EAGAIN);
+            break;
+        }
+        if (ev == NULL) {
+            if ((ev = pth_event(PTH_EVENT_FD|PTH_UNTIL_FD_WRITEABLE, c->c_fd)) == NULL) {
+                rc = FALSE;
+                break;
+            }
+        }
+        if (pth_wait(ev) < 0) {
+            rc = FALSE;
+            break;
+        }
+        if (c->c_closed || pth_event_status(ev) == PTH_STATUS_FAILED) {
+            rc = pth_error(FALSE, EBADF);
+            break;
+        }
+    }
+    pth_shield {
+        if (ev != NULL)
+            pth_event_free(ev, PTH_FREE_THIS);
+        if (!c->c_closed)
+            pth_fdmode(c->c_fd, fdmode);
+        pth_cancel_state(cancelstate, NULL);
+    }
+    return rc;
+}
+
+/* enable, resize or disable write coalescing on a filedescriptor */
+int pth_cork(int fd, size_t size)
+{
+    pth_cork_t **tab;
+    pth_cork_t *c;
+    char *buf;
+    int tsize;
+
+    pth_implicit_init();
+    if (!pth_util_fd_valid(fd))
+        return pth_error(FALSE, EBADF);
+
+    /* write out what is pending with the old buffer */
+    c = pth_cork_lookup(fd);
+    if (c != NULL && c->c_busy)
+        return pth_error(FALSE, EBUSY);
+    if (c != NULL && !pth_cork_flushone(c, NULL))
+        return FALSE;
+
+    /* disable coalescing */
+    if (size == 0) {
+        if (c != NULL) {
+            pth_cork_tab[fd] = NULL;
+            free(c->c_buf);
+            free(c);
+        }
+        return TRUE;
+    }
+
+    /* enable coalescing or resize the buffer */
+    if (fd >= pth_cork_size) {
+        tsize = (pth_cork_size == 0 ? 64 : pth_cork_size);
+        while (tsize <= fd)
+            tsize *= 2;
+        if ((tab = (pth_cork_t **)realloc(pth_cork_tab, (size_t)tsize * sizeof(pth_cork_t *))) == NULL)
+            return pth_error(FALSE, ENOMEM);
+        memset(tab + pth_cork_size, 0, (size_t)(tsize - pth_cork_size) * sizeof(pth_cork_t *));
+        pth_cork_tab  = tab;
+        pth_cork_size = tsize;
+    }
+    if (c == NULL) {
+        if ((c = (pth_cork_t *)malloc(sizeof(pth_cork_t))) == NULL)
+            return pth_error(FALSE, ENOMEM);
+        memset(c, 0, sizeof(pth_cork_t));
+        c->c_fd = fd;
+        pth_cork_tab[fd] = c;
+    }
+    if (c->c_size != size) {
+        if ((buf = (char *)realloc(c->c_buf, size)) == NULL)
+            return pth_error(FALSE, ENOMEM);
+        c->c_buf  = buf;
+        c->c_size = size;
+    }
+    return TRUE;
+}
+
+/* write out the pending data of a corked filedescriptor */
+int pth_flush(int fd)
+{
+    pth_cork_t *c;
+    int err;
+
+    pth_implicit_init();
+    if ((c = pth_cork_lookup(fd)) == NULL) {
+        if (!pth_util_fd_valid(fd))
+            return pth_error(FALSE, EBADF);
+        return TRUE;
+    }
+    if (c->c_error != 0) {
+        err = c->c_error;
+        c->c_error = 0;
+        return pth_error(FALSE, err);
+    }
+    return pth_cork_flushone(c, NULL);
+}
+
+/* append data to the buffer of a corked filedescriptor, or write it out
+   together with the pending data if it does not fit; returns FALSE if
+   the filedescriptor is not corked and the caller has to do the write */
+int pth_cork_writev(int fd, const struct iovec *iov, int iovcnt, pth_event_t ev_extra, ssize_t *rv)
+{
+    struct iovec tiov_stack[32];
+    struct iovec *tiov;
+    pth_cork_t *c;
+    size_t nbytes, taken, chunk, skip;
+    ssize_t n;
+    int err;
+    int i;
+
+    if ((c = pth_cork_lookup(fd)) == NULL || c->c_busy)
+        return FALSE;
+
+    /* report the error of an earlier implicit flush */
+    if (c->c_error != 0) {
+        err = c->c_error;
+        c->c_error = 0;
+        *rv = pth_error(-1, err);
+        return TRUE;
+    }
+
+    /* just buffer the data if it fits */
+    nbytes = 0;
+    for (i = 0; i < iovcnt; i++)
+        nbytes += iov[i].iov_len;
+    if (c->c_len + nbytes <= c->c_size) {
+        for (i = 0; i < iovcnt; i++) {
+            memcpy(c->c_buf + c->c_len, iov[i].iov_base, iov[i].iov_len);
+            c->c_len += iov[i].iov_len;
+        }
+        c->c_owner = pth_current;
+        pth_cork_mark(c);
+        *rv = (ssize_t)nbytes;
+        return TRUE;
+    }
+
+    /* else write out the pending and the new data with a single call
+       (or one after the other if there is no room for another iovec) */
+    if (iovcnt >= UIO_MAXIOV) {
+        if (pth_cork_flushone(c, ev_extra))
+            return FALSE;
+        *rv = -1;
+        return TRUE;
+    }
+    if ((size_t)iovcnt < sizeof(tiov_stack) / sizeof(struct iovec))
+        tiov = tiov_stack;
+    else if ((tiov = (struct iovec *)malloc((size_t)(iovcnt + 1) * sizeof(struct iovec))) == NULL) {
+        *rv = pth_error(-1, ENOMEM);
+        return TRUE;
+    }
+    tiov[0].iov_base = c->c_buf;
+    tiov[0].iov_len  = c->c_len;
+    memcpy(tiov + 1, iov, (size_t)iovcnt * sizeof(struct iovec));
+    c->c_busy++;
+    n = pth_writev_ev(fd, tiov, iovcnt + 1, ev_extra);
+    if (tiov != tiov_stack)
+        pth_shield { free(tiov); }
+    if (!pth_cork_unuse(c)) {
+        *rv = pth_error(-1, EBADF);
+        return TRUE;
+    }
+    if (n < 0) {
+        *rv = -1;
+        return TRUE;
+    }
+    if ((size_t)n < c->c_len) {
+        pth_cork_consume(c, (size_t)n);
+        taken = 0;
+    }
+    else {
+        taken = (size_t)n - c->c_len;
+        pth_cork_consume(c, c->c_len);
+    }
+
+    /* on an interrupted write keep as much of the rest as fits */
+    if (taken < nbytes) {
+        skip = taken;
+        for (i = 0; i < iovcnt && c->c_len < c->c_size; i++) {
+            if (skip >= iov[i].iov_len) {
+                skip -= iov[i].iov_len;
+                continue;
+            }
+            chunk = iov[i].iov_len - skip;
+            if (chunk > c->c_size - c->c_len)
+                chunk = c->c_size - c->c_len;
+            memcpy(c->c_buf + c->c_len, (const char *)iov[i].iov_base + skip, chunk);
+            c->c_len += chunk;
+            taken += chunk;
+            skip = 0;
+        }
+        c->c_owner = pth_current;
+        pth_cork_mark(c);
+        if (taken == 0) {
+            *rv = pth_error(-1, ev_extra != NULL ? EINTR : EAGAIN);
+            return TRUE;
+        }
+    }
+    *rv = (ssize_t)taken;
+    return TRUE;
+}
+
+/* write out the pending data of a filedescriptor before
+   it is used for output which bypasses the buffer */
+int pth_cork_sync(int fd, pth_event_t ev_extra)
+{
+    pth_cork_t *c;
+    int err;
+
+    if ((c = pth_cork_lookup(fd)) == NULL || c->c_busy)
+        return TRUE;
+    if (c->c_error != 0) {
+        err = c->c_error;
+        c->c_error = 0;
+        return pth_error(FALSE, err);
+    }
+    return pth_cork_flushone(c, ev_extra);
+}
+
+/* write out the pending data of all filedescriptors a thread
+   wrote to (called whenever the thread is about to give up control) */
+void pth_cork_flushall(pth_t t)
+{
+    pth_ringnode_t *rn;
+    pth_cork_t *c;
+    unsigned int epoch;
+
+    /* flushing can block and let other threads change the ring, so
+       restart the scan after each flush, but visit each buffer only once */
+    epoch = ++pth_cork_epoch;
+    for (;;) {
+        c = NULL;
+        for (rn = pth_ring_first(&pth_cork_dirty); rn != NULL;
+             rn = pth_ring_next(&pth_cork_dirty, rn)) {
+            c = (pth_cork_t *)rn;
+            if (c->c_owner == t && !c->c_busy && c->c_epoch != epoch)
+                break;
+            c = NULL;
+        }
+        if (c == NULL)
+            break;
+        c->c_epoch = epoch;
+        c->c_busy++;
+        pth_shield {
+            if (   !pth_cork_drain(c) && !c->c_closed
+                && errno != EAGAIN && errno != EWOULDBLOCK && errno != ETIMEDOUT) {
+                /* the data cannot be delivered, so drop it
+                   and report the error on the next operation */
+                c->c_error = errno;
+                pth_cork_consume(c, c->c_len);
+            }
+            pth_cork_unuse(c);
+        }
+    }
+    return;
+}
+
+/* write out the pending data of a filedescriptor and forget its buffer */
+int pth_cork_release(int fd)
+{
+    pth_cork_t *c;
+    int rc;
+
+    if ((c = pth_cork_lookup(fd)) == NULL)
+        return TRUE;
+    rc = (c->c_busy ? TRUE : pth_cork_sync(fd, NULL));
+    if ((c = pth_cork_lookup(fd)) == NULL)
+        return rc;
+    pth_shield {
+        pth_cork_tab[fd] = NULL;
+        c->c_len = 0;
+        pth_cork_mark(c);
+        if (c->c_busy)
+            /* a thread still writes the buffer out,
+               so it is freed when that thread is done */
+            c->c_closed = TRUE;
+        else {
+            free(c->c_buf);
+            free(c);
+        }
+    }
+    return rc;
+}
+
+/* write out the pending data of all filedescriptors and forget all buffers */
+void pth_cork_kill(void)
+{
+    int fd;
+
+    for (fd = 0; fd < pth_cork_size; fd++)
+        if (pth_cork_tab[fd] != NULL)
+            pth_cork_release(fd);
+    if (pth_cork_tab != NULL)
+        free(pth_cork_tab);
+    pth_cork_tab     = NULL;
+    pth_cork_size    = 0;
+    pth_cork_pending = 0;
+    pth_ring_init(&pth_cork_dirty);
+    return;
+}
@@ -0,0 +1,139 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  This file is part of GNU Pth, a non-preemptive thread scheduling
+**  library which can be found at http://www.gnu.org/software/pth/.
+**
+**  This library is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU Lesser General Public
+**  License as published by the Free Software Foundation; either
+**  version 2.1 of the License, or (at your option) any later version.
+**
+**  This library is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**  Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public
+**  License along with this library; if not, write to the Free Software
+**  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+**  USA, or contact Ralf S. Engelschall <rse@engelschall.com>.
+**
+**  pth_deadline.c: Pth per-thread deadlines
+*/
+                             /* ``Work expands so as to fill
+                                  the time available.''
+                                      -- C. Northcote Parkinson */
+#include "pth_p.h"
+
+/*
+ * A thread can put a time budget on everything it does next. The
+ * deadlines form a stack, where an inner deadline can only shorten the
+ * outer ones. The innermost deadline is kept in a single timer event of
+ * the thread, which pth_wait(3) links into every waiting ring, so each
+ * blocking function fails with ETIMEDOUT once the deadline passed.
+ */
+
+/* set a new innermost absolute deadline for a thread */
+int pth_deadline_set(pth_t t, const struct timespec *until)
+{
+    struct timespec *stack;
+    struct timespec ts;
+    int size;
+
+    /* an inner deadline can only be tighter than the enclosing one */
+    ts = *until;
+    if (t->deadlinecnt > 0 && pth_timens_cmp(&t->deadlines[t->deadlinecnt-1], &ts) < 0)
+        ts = t->deadlines[t->deadlinecnt-1];
+
+    /* remember it on the stack */
+    if (t->deadlinecnt == t->deadlinemax) {
+        size = (t->deadlinemax == 0 ? 4 : t->deadlinemax * 2);
+        if ((stack = (struct timespec *)realloc(t->deadlines, (size_t)size * sizeof(struct timespec))) == NULL)
+            return pth_error(FALSE, ENOMEM);
+        t->deadlines   = stack;
+        t->deadlinemax = size;
+    }
+    if (t->deadline == NULL)
+        if ((t->deadline = pth_event(PTH_EVENT_TIME, pth_time(0, 0))) == NULL)
+            return FALSE;
+    t->deadlines[t->deadlinecnt++] = ts;
+    pth_event_timens(t->deadline, &ts);
+    return TRUE;
+}
+
+/* forget all deadlines of a thread */
+void pth_deadline_clear(pth_t t)
+{
+    if (t->deadline != NULL)
+        pth_event_free(t->deadline, PTH_FREE_THIS);
+    if (t->deadlines != NULL)
+        free(t->deadlines);
+    t->deadline    = NULL;
+    t->deadlines   = NULL;
+    t->deadlinecnt = 0;
+    t->deadlinemax = 0;
+    return;
+}
+
+/* put a time budget on everything the current thread does next */
+int pth_deadline_push(pth_time_t budget)
+{
+    struct timespec until;
+    struct timespec rel;
+
+    pth_implicit_init();
+    if (budget.tv_sec < 0 || budget.tv_usec < 0 || budget.tv_usec >= 1000000)
+        return pth_error(FALSE, EINVAL);
+    pth_timens_from_time(&rel, &budget);
+    pth_timens_now(&until);
+    pth_timens_add(&until, &rel);
+    return pth_deadline_set(pth_current, &until);
+}
+
+/* remove the innermost deadline of the current thread */
+int pth_deadline_pop(void)
+{
+    pth_t t;
+
+    pth_implicit_init();
+    t = pth_current;
+    if (t->deadlinecnt == 0)
+        return pth_error(FALSE, ENOENT);
+    t->deadlinecnt--;
+    if (t->deadlinecnt > 0)
+        pth_event_timens(t->deadline, &t->deadlines[t->deadlinecnt-1]);
+    return TRUE;
+}
+
+/* determine the time left until the innermost deadline of a thread */
+int pth_deadline_left(pth_t t, pth_time_t *left)
+{
+    struct timespec ts;
+    struct timespec now;
+
+    if (t->deadlinecnt == 0)
+        return FALSE;
+    ts = t->deadlines[t->deadlinecnt-1];
+    pth_timens_now(&now);
+    pth_timens_sub(&ts, &now);
+    if (ts.tv_sec < 0) {
+        ts.tv_sec  = 0;
+        ts.tv_nsec = 0;
+    }
+    left->tv_sec  = ts.tv_sec;
+    left->tv_usec = ts.tv_nsec / 1000;
+    return TRUE;
+}
+
+/* determine the budget left for the current thread */
+int pth_deadline_remaining(pth_time_t *left)
+{
+    pth_implicit_init();
+    if (left == NULL)
+        return pth_error(FALSE, EINVAL);
+    if (!pth_deadline_left(pth_current, left))
+        return pth_error(FALSE, ENOENT);
+    return TRUE;
+}
@@ -41,16 +41,27 @@ struct pth_event_st {
     pth_status_t ev_status;
     int ev_type;
     int ev_goal;
+    int ev_pollidx; /* scheduler internal: first entry in its pollfd array */
     union {
         struct { int fd; }                                          FD;
         struct { int *n; int nfd; fd_set *rfds, *wfds, *efds; }     SELECT;
+        struct { int *n; struct pollfd *pfd; nfds_t nfd; }          POLL;
         struct { sigset_t *sigs; int *sig; }                        SIGS;
-        struct { pth_time_t tv; }                                   TIME;
+        struct { pth_time_t tv; struct timespec ts; }               TIME;
         struct { pth_msgport_t mp; }                                MSG;
         struct { pth_mutex_t *mutex; }                              MUTEX;
         struct { pth_cond_t *cond; }                                COND;
         struct { pth_t tid; }                                       TID;
         struct { pth_event_func_t func; void *arg; pth_time_t tv; } FUNC;
+        struct { pth_notify_t nt; }                                 NOTIFY;
+        struct { pid_t pid; int fd; }                               PID;
+        struct { pth_pipe_t p; }                                    PIPE;
+        struct { pth_sem_t *sem; unsigned int n; }                  SEM;
+        struct { pth_waitgroup_t *wg; }                             WAITGROUP;
+        struct { struct pth_offload_job_st *job; }                  OFFLOAD; /* internal */
+        struct { struct pth_uring_op_st *op; }                      URING; /* internal */
+        struct { int fd; unsigned int seq; }                        ZEROCOPY; /* internal */
+        struct { int *granted; }                                    GRANT; /* internal */
     } ev_args;
 };
 
@@ -66,6 +77,16 @@ static void pth_event_destructor(void *vp)
     return;
 }
 
+/* release the resources an event structure owns by itself */
+void pth_event_release(pth_event_t ev)
+{
+    if (ev->ev_type == PTH_EVENT_PID && ev->ev_args.PID.fd != -1) {
+        close(ev->ev_args.PID.fd);
+        ev->ev_args.PID.fd = -1;
+    }
+    return;
+}
+
 /* event structure constructor */
 pth_event_t pth_event(unsigned long spec, ...)
 {
@@ -79,6 +100,8 @@ pth_event_t pth_event(unsigned long spec, ...)
     if (spec & PTH_MODE_REUSE) {
         /* reuse supplied event structure */
         ev = va_arg(ap, pth_event_t);
+        if (ev != NULL)
+            pth_event_release(ev);
     }
     else if (spec & PTH_MODE_STATIC) {
         /* reuse static event structure */
@@ -88,8 +111,12 @@ pth_event_t pth_event(unsigned long spec, ...)
         ev = (pth_event_t)pth_key_getdata(*ev_key);
         if (ev == NULL) {
             ev = (pth_event_t)malloc(sizeof(struct pth_event_st));
+            if (ev != NULL)
+                ev->ev_type = 0;
             pth_key_setdata(*ev_key, ev);
         }
+        if (ev != NULL)
+            pth_event_release(ev);
     }
     else {
         /* allocate new dynamic event structure */
@@ -143,6 +170,19 @@ pth_event_t pth_event(unsigned long spec, ...)
         ev->ev_args.SELECT.wfds = wfds;
         ev->ev_args.SELECT.efds = efds;
     }
+    else if (spec & PTH_EVENT_POLL) {
+        /* filedescriptor array poll event */
+        int *n = va_arg(ap, int *);
+        struct pollfd *pfd = va_arg(ap, struct pollfd *);
+        nfds_t nfd = va_arg(ap, nfds_t);
+        if (pfd == NULL && nfd > 0)
+            return pth_error((pth_event_t)NULL, EFAULT);
+        ev->ev_type = PTH_EVENT_POLL;
+        ev->ev_goal = (int)(spec & (PTH_UNTIL_OCCURRED));
+        ev->ev_args.POLL.n   = n;
+        ev->ev_args.POLL.pfd = pfd;
+        ev->ev_args.POLL.nfd = nfd;
+    }
     else if (spec & PTH_EVENT_SIGS) {
         /* signal set event */
         sigset_t *sigs = va_arg(ap, sigset_t *);
@@ -158,6 +198,7 @@ pth_event_t pth_event(unsigned long spec, ...)
         ev->ev_type = PTH_EVENT_TIME;
         ev->ev_goal = (int)(spec & (PTH_UNTIL_OCCURRED));
         ev->ev_args.TIME.tv = tv;
+        pth_timens_from_time(&ev->ev_args.TIME.ts, &tv);
     }
     else if (spec & PTH_EVENT_MSG) {
         /* message port event */
@@ -206,6 +247,74 @@ pth_event_t pth_event(unsigned long spec, ...)
         ev->ev_args.FUNC.arg   = va_arg(ap, void *);
         ev->ev_args.FUNC.tv    = va_arg(ap, pth_time_t);
     }
+    else if (spec & PTH_EVENT_NOTIFY) {
+        /* notification object event */
+        pth_notify_t nt = va_arg(ap, pth_notify_t);
+        ev->ev_type = PTH_EVENT_NOTIFY;
+        ev->ev_goal = (int)(spec & (PTH_UNTIL_OCCURRED));
+        ev->ev_args.NOTIFY.nt = nt;
+    }
+    else if (spec & PTH_EVENT_PID) {
+        /* child process termination event */
+        pid_t pid = va_arg(ap, pid_t);
+        ev->ev_type = PTH_EVENT_PID;
+        ev->ev_goal = (int)(spec & (PTH_UNTIL_OCCURRED));
+        ev->ev_args.PID.pid = pid;
+        ev->ev_args.PID.fd  = pth_util_pidfd_open(pid);
+    }
+    else if (spec & PTH_EVENT_PIPE) {
+        /* in-process pipe event */
+        pth_pipe_t p = va_arg(ap, pth_pipe_t);
+        ev->ev_type = PTH_EVENT_PIPE;
+        ev->ev_goal = (int)(spec & (PTH_UNTIL_FD_READABLE|PTH_UNTIL_FD_WRITEABLE));
+        ev->ev_args.PIPE.p = p;
+    }
+    else if (spec & PTH_EVENT_SEM) {
+        /* semaphore units event */
+        pth_sem_t *sem = va_arg(ap, pth_sem_t *);
+        unsigned int n = va_arg(ap, unsigned int);
+        ev->ev_type = PTH_EVENT_SEM;
+        ev->ev_goal = (int)(spec & (PTH_UNTIL_OCCURRED));
+        ev->ev_args.SEM.sem = sem;
+        ev->ev_args.SEM.n   = n;
+    }
+    else if (spec & PTH_EVENT_WAITGROUP) {
+        /* wait group (or latch) completion event */
+        pth_waitgroup_t *wg = va_arg(ap, pth_waitgroup_t *);
+        ev->ev_type = PTH_EVENT_WAITGROUP;
+        ev->ev_goal = (int)(spec & (PTH_UNTIL_OCCURRED));
+        ev->ev_args.WAITGROUP.wg = wg;
+    }
+    else if (spec & PTH_EVENT_OFFLOAD) {
+        /* offloaded job completion event (internal only) */
+        pth_offload_job_t *job = va_arg(ap, pth_offload_job_t *);
+        ev->ev_type = PTH_EVENT_OFFLOAD;
+        ev->ev_goal = 0;
+        ev->ev_args.OFFLOAD.job = job;
+    }
+    else if (spec & PTH_EVENT_URING) {
+        /* io_uring operation completion event (internal only) */
+        pth_uring_op_t *op = va_arg(ap, pth_uring_op_t *);
+        ev->ev_type = PTH_EVENT_URING;
+        ev->ev_goal = 0;
+        ev->ev_args.URING.op = op;
+    }
+    else if (spec & PTH_EVENT_ZEROCOPY) {
+        /* zero-copy send completion event (internal only) */
+        int fd = va_arg(ap, int);
+        unsigned int seq = va_arg(ap, unsigned int);
+        ev->ev_type = PTH_EVENT_ZEROCOPY;
+        ev->ev_goal = 0;
+        ev->ev_args.ZEROCOPY.fd  = fd;
+        ev->ev_args.ZEROCOPY.seq = seq;
+    }
+    else if (spec & PTH_EVENT_GRANT) {
+        /* direct grant by another thread (internal only) */
+        int *granted = va_arg(ap, int *);
+        ev->ev_type = PTH_EVENT_GRANT;
+        ev->ev_goal = 0;
+        ev->ev_args.GRANT.granted = granted;
+    }
     else
         return pth_error((pth_event_t)NULL, EINVAL);
 
@@ -215,6 +324,19 @@ pth_event_t pth_event(unsigned long spec, ...)
     return ev;
 }
 
+/* set the deadline of a time event with nanosecond resolution */
+void pth_event_timens(pth_event_t ev, const struct timespec *ts)
+{
+    ev->ev_args.TIME.ts = *ts;
+    ev->ev_args.TIME.tv.tv_sec  = ts->tv_sec;
+    ev->ev_args.TIME.tv.tv_usec = (ts->tv_nsec + 999) / 1000;
+    if (ev->ev_args.TIME.tv.tv_usec >= 1000000) {
+        ev->ev_args.TIME.tv.tv_sec  += 1;
+        ev->ev_args.TIME.tv.tv_usec -= 1000000;
+    }
+    return;
+}
+
 /* determine type of event */
 unsigned long pth_event_typeof(pth_event_t ev)
 {
@@ -238,6 +360,15 @@ int pth_event_extract(pth_event_t ev, ...)
         int *fd = va_arg(ap, int *);
         *fd = ev->ev_args.FD.fd;
     }
+    else if (ev->ev_type & PTH_EVENT_POLL) {
+        /* filedescriptor array poll event */
+        int **n             = va_arg(ap, int **);
+        struct pollfd **pfd = va_arg(ap, struct pollfd **);
+        nfds_t *nfd         = va_arg(ap, nfds_t *);
+        *n   = ev->ev_args.POLL.n;
+        *pfd = ev->ev_args.POLL.pfd;
+        *nfd = ev->ev_args.POLL.nfd;
+    }
     else if (ev->ev_type & PTH_EVENT_SIGS) {
         /* signal set event */
         sigset_t **sigs = va_arg(ap, sigset_t **);
@@ -279,6 +410,33 @@ int pth_event_extract(pth_event_t ev, ...)
         *arg  = ev->ev_args.FUNC.arg;
         *tv   = ev->ev_args.FUNC.tv;
     }
+    else if (ev->ev_type & PTH_EVENT_NOTIFY) {
+        /* notification object event */
+        pth_notify_t *nt = va_arg(ap, pth_notify_t *);
+        *nt = ev->ev_args.NOTIFY.nt;
+    }
+    else if (ev->ev_type & PTH_EVENT_PID) {
+        /* child process termination event */
+        pid_t *pid = va_arg(ap, pid_t *);
+        *pid = ev->ev_args.PID.pid;
+    }
+    else if (ev->ev_type & PTH_EVENT_PIPE) {
+        /* in-process pipe event */
+        pth_pipe_t *p = va_arg(ap, pth_pipe_t *);
+        *p = ev->ev_args.PIPE.p;
+    }
+    else if (ev->ev_type & PTH_EVENT_SEM) {
+        /* semaphore units event */
+        pth_sem_t **sem = va_arg(ap, pth_sem_t **);
+        unsigned int *n = va_arg(ap, unsigned int *);
+        *sem = ev->ev_args.SEM.sem;
+        *n   = ev->ev_args.SEM.n;
+    }
+    else if (ev->ev_type & PTH_EVENT_WAITGROUP) {
+        /* wait group (or latch) completion event */
+        pth_waitgroup_t **wg = va_arg(ap, pth_waitgroup_t **);
+        *wg = ev->ev_args.WAITGROUP.wg;
+    }
     else
         return pth_error(FALSE, EINVAL);
     va_end(ap);
@@ -371,12 +529,14 @@ int pth_event_free(pth_event_t ev, int mode)
     if (mode == PTH_FREE_THIS) {
         ev->ev_prev->ev_next = ev->ev_next;
         ev->ev_next->ev_prev = ev->ev_prev;
+        pth_event_release(ev);
         free(ev);
     }
     else if (mode == PTH_FREE_ALL) {
         evc = ev;
         do {
             evn = evc->ev_next;
+            pth_event_release(evc);
             free(evc);
             evc = evn;
         } while (evc != ev);
@@ -389,16 +549,33 @@ int pth_wait(pth_event_t ev_ring)
 {
     int nonpending;
     pth_event_t ev;
+    pth_event_t dl;
 
     /* at least a waiting ring is required */
     if (ev_ring == NULL)
         return pth_error(-1, EINVAL);
     pth_debug2("pth_wait: enter from thread \"%s\"", pth_current->name);
 
-    /* mark all events in waiting ring as still pending */
+    /* write out data collected on corked filedescriptors
+       (which itself might have to wait) */
+    if (pth_cork_pending > 0)
+        pth_cork_flushall(pth_current);
+
+    /* let the deadline of the thread cut the waiting short */
+    dl = NULL;
+    if (pth_current->deadlinecnt > 0) {
+        dl = pth_current->deadline;
+        pth_event_concat(ev_ring, dl, NULL);
+    }
+
+    /* mark all events in waiting ring as still pending
+       (and count us as a waiter of the condition variables
+       we wait on, so pth_cond_notify signals them for us) */
     ev = ev_ring;
     do {
         ev->ev_status = PTH_STATUS_PENDING;
+        if (ev->ev_type == PTH_EVENT_COND)
+            ev->ev_args.COND.cond->cn_waiters++;
         pth_debug2("pth_wait: waiting on event 0x%lx", (unsigned long)ev);
         ev = ev->ev_next;
     } while (ev != ev_ring);
@@ -411,6 +588,18 @@ int pth_wait(pth_event_t ev_ring)
     pth_current->state = PTH_STATE_WAITING;
     pth_yield(NULL);
 
+    /* we no longer wait on the condition variables */
+    ev = ev_ring;
+    do {
+        if (ev->ev_type == PTH_EVENT_COND)
+            ev->ev_args.COND.cond->cn_waiters--;
+        ev = ev->ev_next;
+    } while (ev != ev_ring);
+
+    /* unlink the deadline again before the thread might vanish */
+    if (dl != NULL)
+        pth_event_isolate(dl);
+
     /* check for cancellation */
     pth_cancel_point();
 
@@ -428,8 +617,27 @@ int pth_wait(pth_event_t ev_ring)
         ev = ev->ev_next;
     } while (ev != ev_ring);
 
+    /* fail if nothing but the deadline occurred */
+    if (nonpending == 0 && dl != NULL && dl->ev_status == PTH_STATUS_OCCURRED) {
+        pth_debug2("pth_wait: deadline passed for thread \"%s\"", pth_current->name);
+        return pth_error(-1, ETIMEDOUT);
+    }
+
     /* leave to current thread with number of occurred events */
     pth_debug2("pth_wait: leave to thread \"%s\"", pth_current->name);
     return nonpending;
 }
 
+/* finish the waiting of a blocking function on its internal event ev,
+   which was concatenated with the extra events ev_extra of the caller:
+   returns 0 if ev occurred, else the errno value the function fails with */
+int pth_wait_result(pth_event_t ev, pth_event_t ev_extra, int rc)
+{
+    if (ev_extra != NULL)
+        pth_event_isolate(ev);
+    if (rc < 0)
+        return ETIMEDOUT;
+    if (ev_extra != NULL && pth_event_status(ev) != PTH_STATUS_OCCURRED)
+        return EINTR;
+    return 0;
+}
@@ -0,0 +1,271 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  This file is part of GNU Pth, a non-preemptive thread scheduling
+**  library which can be found at http://www.gnu.org/software/pth/.
+**
+**  This library is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU Lesser General Public
+**  License as published by the Free Software Foundation; either
+**  version 2.1 of the License, or (at your option) any later version.
+**
+**  This library is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**  Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public
+**  License along with this library; if not, write to the Free Software
+**  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+**  USA, or contact Ralf S. Engelschall <rse@engelschall.com>.
+**
+**  pth_fsync.c: Pth group commit of filedescriptor syncs
+*/
+                             /* ``One for all, all for one.''
+                                          -- Alexandre Dumas */
+#include "pth_p.h"
+
+/*
+ * Threads appending to a shared log usually sync it after every
+ * record. With pth_fsync_group(3) all requests which arrive while a
+ * sync of the same filedescriptor is in flight are collected and then
+ * covered by a single next sync. The thread which starts a sync (the
+ * leader) runs it on a kernel thread of the offload pool and wakes all
+ * threads of its batch afterwards. A request is only covered by a sync
+ * which started after the request arrived, so the data written before
+ * the call is always on stable storage when it returns successfully.
+ */
+
+/* group commit state of a filedescriptor */
+typedef struct pth_fsync_st pth_fsync_t;
+struct pth_fsync_st {
+    pth_fsync_t   *fs_next;
+    int            fs_fd;       /* filedescriptor (-1 if already closed)      */
+    int            fs_users;    /* threads inside pth_fsync_group()           */
+    int            fs_running;  /* a sync is in flight                        */
+    int            fs_batch;    /* requests waiting for the next sync         */
+    unsigned long  fs_started;  /* generation of the last started sync        */
+    unsigned long  fs_done;     /* generation of the last completed sync      */
+    unsigned long  fs_failed;   /* generation of the last failed sync (or 0)  */
+    int            fs_error;    /* errno of the last failed sync              */
+    pth_mutex_t    fs_mutex;
+    pth_cond_t     fs_cond;     /* signals completed syncs                    */
+};
+
+static pth_fsync_t   *pth_fsync_list     = NULL;
+static unsigned long  pth_fsync_syncs    = 0;  /* statistics: completed syncs          */
+static unsigned long  pth_fsync_requests = 0;  /* statistics: requests covered by them */
+static unsigned long  pth_fsync_latency  = 0;  /* statistics: sum of latencies (us)    */
+
+/* find (or create) the group commit state of a filedescriptor */
+static pth_fsync_t *pth_fsync_lookup(int fd)
+{
+    pth_fsync_t *fs;
+
+    for (fs = pth_fsync_list; fs != NULL; fs = fs->fs_next)
+        if (fs->fs_fd == fd)
+            return fs;
+    if ((fs = (pth_fsync_t *)malloc(sizeof(pth_fsync_t))) == NULL)
+        return pth_error((pth_fsync_t *)NULL, ENOMEM);
+    fs->fs_fd      = fd;
+    fs->fs_users   = 0;
+    fs->fs_running = FALSE;
+    fs->fs_batch   = 0;
+    fs->fs_started = 0;
+    fs->fs_done    = 0;
+    fs->fs_failed  = 0;
+    fs->fs_error   = 0;
+    pth_mutex_init(&fs->fs_mutex);
+    pth_cond_init(&fs->fs_cond);
+    fs->fs_next = pth_fsync_list;
+    pth_fsync_list = fs;
+    return fs;
+}
+
+/* free the state of a closed filedescriptor once nobody uses it */
+static void pth_fsync_unlink(pth_fsync_t *fs)
+{
+    pth_fsync_t **pfs;
+
+    if (fs->fs_fd != -1 || fs->fs_users > 0)
+        return;
+    for (pfs = &pth_fsync_list; *pfs != NULL; pfs = &(*pfs)->fs_next) {
+        if (*pfs == fs) {
+            *pfs = fs->fs_next;
+            break;
+        }
+    }
+    free(fs);
+    return;
+}
+
+/* the sync itself (runs on a kernel thread) */
+static void *pth_fsync_job(void *arg)
+{
+    int fd = (int)(intptr_t)arg;
+
+#ifdef HAVE_FDATASYNC
+    if (fdatasync(fd) < 0)
+#else
+    if (fsync(fd) < 0)
+#endif
+        return (void *)(intptr_t)errno;
+    return NULL;
+}
+
+/* run a sync for the group, wait for it and lock the group again:
+   the other threads depend on it, so the leader waits regardless
+   of cancellation requests and its deadline */
+static int pth_fsync_run(pth_fsync_t *fs, int fd, int *err)
+{
+    struct timespec t0, t1;
+    void *value;
+    int cancelstate;
+    int deadlinecnt;
+    int locked;
+
+    pth_cancel_state(PTH_CANCEL_DISABLE, &cancelstate);
+    deadlinecnt = pth_current->deadlinecnt;
+    pth_current->deadlinecnt = 0;
+    pth_mutex_release(&fs->fs_mutex);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    value = NULL;
+    if (!pth_offload(pth_fsync_job, (void *)(intptr_t)fd, &value))
+        /* no kernel thread available, so block the process */
+        value = pth_fsync_job((void *)(intptr_t)fd);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    locked = pth_mutex_acquire(&fs->fs_mutex, FALSE, NULL);
+    pth_shield {
+        pth_current->deadlinecnt = deadlinecnt;
+        pth_cancel_state(cancelstate, NULL);
+    }
+
+    pth_fsync_syncs++;
+    pth_fsync_latency += (unsigned long)((t1.tv_sec  - t0.tv_sec) * 1000000L
+                                       + (t1.tv_nsec - t0.tv_nsec) / 1000L);
+    *err = (int)(intptr_t)value;
+    return locked;
+}
+
+/* a waiting thread was cancelled */
+static void pth_fsync_cleanup(void *arg)
+{
+    pth_fsync_t *fs = (pth_fsync_t *)arg;
+
+    pth_mutex_release(&fs->fs_mutex);
+    fs->fs_users--;
+    pth_fsync_unlink(fs);
+    return;
+}
+
+/* sync a filedescriptor together with all other threads asking for it */
+int pth_fsync_group(int fd)
+{
+    pth_fsync_t *fs;
+    unsigned long target;
+    int locked;
+    int lockerr;
+    int err;
+
+    pth_implicit_init();
+    if (!pth_util_fd_valid(fd))
+        return pth_error(FALSE, EBADF);
+    if ((fs = pth_fsync_lookup(fd)) == NULL)
+        return FALSE;
+
+    /* the request is covered by the next sync which starts */
+    target = fs->fs_started + 1;
+    fs->fs_batch++;
+    fs->fs_users++;
+    if (!pth_mutex_acquire(&fs->fs_mutex, FALSE, NULL)) {
+        /* the deadline of the thread passed while waiting for the lock */
+        pth_shield {
+            if (fs->fs_started < target)
+                fs->fs_batch--;
+            fs->fs_users--;
+            pth_fsync_unlink(fs);
+        }
+        return FALSE;
+    }
+    pth_cleanup_push(pth_fsync_cleanup, fs);
+    err = 0;
+    while (fs->fs_done < target) {
+        if (!fs->fs_running) {
+            /* become the leader of a sync covering all requests so far */
+            fs->fs_running = TRUE;
+            fs->fs_started++;
+            pth_fsync_requests += (unsigned long)fs->fs_batch;
+            fs->fs_batch = 0;
+            locked = pth_fsync_run(fs, fd, &err);
+            lockerr = (locked ? 0 : errno);
+            /* publish the result even without the lock, as the
+               others wait for it (and nothing can yield meanwhile) */
+            fs->fs_running = FALSE;
+            fs->fs_done = fs->fs_started;
+            if (err != 0) {
+                fs->fs_failed = fs->fs_done;
+                fs->fs_error  = err;
+            }
+            pth_cond_notify(&fs->fs_cond, TRUE);
+            if (!locked) {
+                pth_cleanup_pop(FALSE);
+                fs->fs_users--;
+                pth_fsync_unlink(fs);
+                return pth_error(FALSE, lockerr);
+            }
+        }
+        else if (!pth_cond_await(&fs->fs_cond, &fs->fs_mutex, NULL)) {
+            /* the deadline of the thread passed while waiting */
+            err = errno;
+            if (fs->fs_started < target)
+                fs->fs_batch--;
+            break;
+        }
+    }
+    if (err == 0 && fs->fs_failed >= target)
+        err = fs->fs_error;
+    pth_cleanup_pop(TRUE);
+    if (err != 0)
+        return pth_error(FALSE, err);
+    return TRUE;
+}
+
+/* forget the group commit state of a filedescriptor */
+void pth_fsync_release(int fd)
+{
+    pth_fsync_t *fs;
+
+    for (fs = pth_fsync_list; fs != NULL; fs = fs->fs_next) {
+        if (fs->fs_fd == fd) {
+            fs->fs_fd = -1;
+            pth_fsync_unlink(fs);
+            break;
+        }
+    }
+    return;
+}
+
+/* free the group commit states of all filedescriptors */
+void pth_fsync_kill(void)
+{
+    pth_fsync_t *fs;
+
+    while ((fs = pth_fsync_list) != NULL) {
+        pth_fsync_list = fs->fs_next;
+        free(fs);
+    }
+    return;
+}
+
+/* query the group commit statistics */
+long pth_fsync_stat(int which)
+{
+    if (which == PTH_CTRL_GETFSYNCS)
+        return (long)pth_fsync_syncs;
+    else if (which == PTH_CTRL_GETFSYNCREQUESTS)
+        return (long)pth_fsync_requests;
+    else if (which == PTH_CTRL_GETFSYNCLATENCY)
+        return (long)pth_fsync_latency;
+    return 0;
+}
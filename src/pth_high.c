@@ -35,51 +35,65 @@
 
 #include "pth_p.h"
 
+/* create a static time event for a relative timeout with nanosecond resolution */
+static pth_event_t pth_high_timeout(pth_key_t *ev_key, const struct timespec *rel)
+{
+    struct timespec until;
+    pth_event_t ev;
+
+    pth_timens_now(&until);
+    pth_timens_add(&until, rel);
+    if ((ev = pth_event(PTH_EVENT_TIME|PTH_MODE_STATIC, ev_key,
+                        pth_time((long)until.tv_sec, (long)(until.tv_nsec / 1000)))) == NULL)
+        return NULL;
+    pth_event_timens(ev, &until);
+    return ev;
+}
+
 /* Pth variant of nanosleep(2) */
 int pth_nanosleep(const struct timespec *rqtp, struct timespec *rmtp)
 {
-    pth_time_t until;
-    pth_time_t offset;
-    pth_time_t now;
+    struct timespec now;
     pth_event_t ev;
     static pth_key_t ev_key = PTH_KEY_INIT;
+    int rc;
 
     /* consistency checks for POSIX conformance */
     if (rqtp == NULL)
         return pth_error(-1, EFAULT);
-    if (rqtp->tv_nsec < 0 || rqtp->tv_nsec > (1000*1000000))
+    if (rqtp->tv_sec < 0 || rqtp->tv_nsec < 0 || rqtp->tv_nsec >= 1000000000L)
         return pth_error(-1, EINVAL);
 
     /* short-circuit */
     if (rqtp->tv_sec == 0 && rqtp->tv_nsec == 0)
         return 0;
 
-    /* calculate asleep time */
-    offset = pth_time((long)(rqtp->tv_sec), (long)(rqtp->tv_nsec) / 1000);
-    pth_time_set(&until, PTH_TIME_NOW);
-    pth_time_add(&until, &offset);
-
-    /* and let thread sleep until this time is elapsed */
-    if ((ev = pth_event(PTH_EVENT_TIME|PTH_MODE_STATIC, &ev_key, until)) == NULL)
+    /* let thread sleep until this time is elapsed */
+    if ((ev = pth_high_timeout(&ev_key, rqtp)) == NULL)
         return pth_error(-1, errno);
-    pth_wait(ev);
+    rc = pth_wait(ev);
 
-    /* optionally provide amount of slept time */
+    /* optionally provide amount of not slept time */
     if (rmtp != NULL) {
-        pth_time_set(&now, PTH_TIME_NOW);
-        pth_time_sub(&until, &now);
-        rmtp->tv_sec  = until.tv_sec;
-        rmtp->tv_nsec = until.tv_usec * 1000;
+        pth_timens_now(&now);
+        *rmtp = ev->ev_args.TIME.ts;
+        pth_timens_sub(rmtp, &now);
+        if (rmtp->tv_sec < 0) {
+            rmtp->tv_sec  = 0;
+            rmtp->tv_nsec = 0;
+        }
     }
 
+    /* the deadline of the thread cut the sleep short */
+    if (rc < 0)
+        return pth_error(-1, ETIMEDOUT);
     return 0;
 }
 
 /* Pth variant of usleep(3) */
 int pth_usleep(unsigned int usec)
 {
-    pth_time_t until;
-    pth_time_t offset;
+    struct timespec offset;
     pth_event_t ev;
     static pth_key_t ev_key = PTH_KEY_INIT;
 
@@ -87,15 +101,13 @@ int pth_usleep(unsigned int usec)
     if (usec == 0)
         return 0;
 
-    /* calculate asleep time */
-    offset = pth_time((long)(usec / 1000000), (long)(usec % 1000000));
-    pth_time_set(&until, PTH_TIME_NOW);
-    pth_time_add(&until, &offset);
-
-    /* and let thread sleep until this time is elapsed */
-    if ((ev = pth_event(PTH_EVENT_TIME|PTH_MODE_STATIC, &ev_key, until)) == NULL)
+    /* let thread sleep until this time is elapsed */
+    offset.tv_sec  = (time_t)(usec / 1000000);
+    offset.tv_nsec = (long)(usec % 1000000) * 1000;
+    if ((ev = pth_high_timeout(&ev_key, &offset)) == NULL)
         return pth_error(-1, errno);
-    pth_wait(ev);
+    if (pth_wait(ev) < 0)
+        return pth_error(-1, ETIMEDOUT);
 
     return 0;
 }
@@ -103,8 +115,8 @@ int pth_usleep(unsigned int usec)
 /* Pth variant of sleep(3) */
 unsigned int pth_sleep(unsigned int sec)
 {
-    pth_time_t until;
-    pth_time_t offset;
+    struct timespec offset;
+    struct timespec now;
     pth_event_t ev;
     static pth_key_t ev_key = PTH_KEY_INIT;
 
@@ -112,15 +124,20 @@ unsigned int pth_sleep(unsigned int sec)
     if (sec == 0)
         return 0;
 
-    /* calculate asleep time */
-    offset = pth_time(sec, 0);
-    pth_time_set(&until, PTH_TIME_NOW);
-    pth_time_add(&until, &offset);
-
-    /* and let thread sleep until this time is elapsed */
-    if ((ev = pth_event(PTH_EVENT_TIME|PTH_MODE_STATIC, &ev_key, until)) == NULL)
+    /* let thread sleep until this time is elapsed */
+    offset.tv_sec  = (time_t)sec;
+    offset.tv_nsec = 0;
+    if ((ev = pth_high_timeout(&ev_key, &offset)) == NULL)
         return sec;
-    pth_wait(ev);
+    if (pth_wait(ev) < 0) {
+        /* the deadline of the thread cut the sleep short */
+        pth_timens_now(&now);
+        offset = ev->ev_args.TIME.ts;
+        pth_timens_sub(&offset, &now);
+        if (offset.tv_sec < 0)
+            return 0;
+        return (unsigned int)offset.tv_sec + (offset.tv_nsec > 0 ? 1 : 0);
+    }
 
     return 0;
 }
@@ -153,6 +170,7 @@ int pth_sigwait_ev(const sigset_t *set, int *sigp, pth_event_t ev_extra)
     static pth_key_t ev_key = PTH_KEY_INIT;
     sigset_t pending;
     int sig;
+    int err;
 
     if (set == NULL || sigp == NULL)
         return pth_error(EINVAL, EINVAL);
@@ -173,12 +191,8 @@ int pth_sigwait_ev(const sigset_t *set, int *sigp, pth_event_t ev_extra)
         return pth_error(errno, errno);
     if (ev_extra != NULL)
         pth_event_concat(ev, ev_extra, NULL);
-    pth_wait(ev);
-    if (ev_extra != NULL) {
-        pth_event_isolate(ev);
-        if (pth_event_status(ev) != PTH_STATUS_OCCURRED)
-            return pth_error(EINTR, EINTR);
-    }
+    if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0)
+        return pth_error(err, err);
 
     /* nothing to do, scheduler has already set *sigp for us */
     return 0;
@@ -188,8 +202,11 @@ int pth_sigwait_ev(const sigset_t *set, int *sigp, pth_event_t ev_extra)
 pid_t pth_waitpid(pid_t wpid, int *status, int options)
 {
     pth_event_t ev;
+    pth_event_t ev_time;
     static pth_key_t ev_key = PTH_KEY_INIT;
+    static pth_key_t ev_key_time = PTH_KEY_INIT;
     pid_t pid;
+    int rc;
 
     pth_debug2("pth_waitpid: called from thread \"%s\"", pth_current->name);
 
@@ -202,9 +219,25 @@ pid_t pth_waitpid(pid_t wpid, int *status, int options)
         if (pid == -1 || pid > 0 || (pid == 0 && (options & WNOHANG)))
             break;
 
-        /* else wait a little bit */
-        ev = pth_event(PTH_EVENT_TIME|PTH_MODE_STATIC, &ev_key, pth_timeout(0,250000));
-        pth_wait(ev);
+        /* else wait until a matching child exits */
+        if ((ev = pth_event(PTH_EVENT_PID|PTH_MODE_STATIC, &ev_key, wpid)) == NULL)
+            return -1;
+        if (options & (WUNTRACED|WCONTINUED)) {
+            /* stopped or continued children cannot be awaited
+               through the event, so still poll for them */
+            ev_time = pth_event(PTH_EVENT_TIME|PTH_MODE_STATIC, &ev_key_time,
+                                pth_timeout(0,250000));
+            pth_event_concat(ev, ev_time, NULL);
+            rc = pth_wait(ev);
+            pth_event_isolate(ev);
+        }
+        else
+            rc = pth_wait(ev);
+
+        /* do not keep the process descriptor open between calls */
+        pth_event_release(ev);
+        if (rc < 0)
+            return pth_error(-1, ETIMEDOUT);
     }
 
     pth_debug2("pth_waitpid: leave to thread \"%s\"", pth_current->name);
@@ -276,6 +309,9 @@ int pth_system(const char *cmd)
     return (pid == -1 ? -1 : pstat);
 }
 
+/* forward declaration for the nanosecond select(2) variant */
+static int pth_select_ns(int, fd_set *, fd_set *, fd_set *, const struct timespec *, pth_event_t);
+
 /* Pth variant of select(2) */
 int pth_select(int nfds, fd_set *rfds, fd_set *wfds,
                fd_set *efds, struct timeval *timeout)
@@ -286,6 +322,29 @@ int pth_select(int nfds, fd_set *rfds, fd_set *wfds,
 /* Pth variant of select(2) with extra events */
 int pth_select_ev(int nfd, fd_set *rfds, fd_set *wfds,
                   fd_set *efds, struct timeval *timeout, pth_event_t ev_extra)
+{
+    struct timespec ts;
+
+    pth_implicit_init();
+    pth_debug2("pth_select_ev: called from thread \"%s\"", pth_current->name);
+
+    /* POSIX.1-2001/SUSv3 compliance */
+    if (timeout != NULL) {
+        if (   timeout->tv_sec  < 0
+            || timeout->tv_usec < 0
+            || timeout->tv_usec >= 1000000 /* a full second */)
+            return pth_error(-1, EINVAL);
+        if (timeout->tv_sec > 31*24*60*60)
+            timeout->tv_sec = 31*24*60*60;
+        ts.tv_sec  = timeout->tv_sec;
+        ts.tv_nsec = timeout->tv_usec * 1000;
+    }
+    return pth_select_ns(nfd, rfds, wfds, efds, (timeout != NULL ? &ts : NULL), ev_extra);
+}
+
+/* Pth variant of select(2) with extra events and a nanosecond timeout */
+static int pth_select_ns(int nfd, fd_set *rfds, fd_set *wfds,
+                         fd_set *efds, const struct timespec *timeout, pth_event_t ev_extra)
 {
     struct timeval delay;
     pth_event_t ev;
@@ -296,47 +355,24 @@ int pth_select_ev(int nfd, fd_set *rfds, fd_set *wfds,
     fd_set rspare, wspare, espare;
     fd_set *rtmp, *wtmp, *etmp;
     int selected;
+    int waited;
     int rc;
-
-    pth_implicit_init();
-    pth_debug2("pth_select_ev: called from thread \"%s\"", pth_current->name);
+    int err;
 
     /* POSIX.1-2001/SUSv3 compliance */
     if (nfd > FD_SETSIZE)
         return pth_error(-1, EINVAL);
-    if (timeout != NULL) {
-        if (   timeout->tv_sec  < 0
-            || timeout->tv_usec < 0
-            || timeout->tv_usec >= 1000000 /* a full second */)
-            return pth_error(-1, EINVAL);
-        if (timeout->tv_sec > 31*24*60*60)
-            timeout->tv_sec = 31*24*60*60;
-    }
 
-    /* first deal with the special situation of a plain microsecond delay */
+    /* first deal with the special situation of a plain delay,
+       which always has to go through the scheduler (even for very
+       small delays) in order to not block the other threads */
     if (nfd == 0 && rfds == NULL && wfds == NULL && efds == NULL && timeout != NULL) {
-        if (timeout->tv_sec == 0 && timeout->tv_usec <= 10000 /* 1/100 second */) {
-            /* very small delays are acceptable to be performed directly */
-            while (   pth_sc(select)(0, NULL, NULL, NULL, timeout) < 0
-                   && errno == EINTR) ;
-        }
-        else {
-            /* larger delays have to go through the scheduler */
-            ev = pth_event(PTH_EVENT_TIME|PTH_MODE_STATIC, &ev_key_timeout,
-                           pth_timeout(timeout->tv_sec, timeout->tv_usec));
-            if (ev_extra != NULL)
-                pth_event_concat(ev, ev_extra, NULL);
-            pth_wait(ev);
-            if (ev_extra != NULL) {
-                pth_event_isolate(ev);
-                if (pth_event_status(ev) != PTH_STATUS_OCCURRED)
-                    return pth_error(-1, EINTR);
-            }
-        }
-        /* POSIX.1-2001/SUSv3 compliance */
-        if (rfds != NULL) FD_ZERO(rfds);
-        if (wfds != NULL) FD_ZERO(wfds);
-        if (efds != NULL) FD_ZERO(efds);
+        if ((ev = pth_high_timeout(&ev_key_timeout, timeout)) == NULL)
+            return pth_error(-1, errno);
+        if (ev_extra != NULL)
+            pth_event_concat(ev, ev_extra, NULL);
+        if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0)
+            return pth_error(-1, err);
         return 0;
     }
 
@@ -371,7 +407,7 @@ int pth_select_ev(int nfd, fd_set *rfds, fd_set *wfds,
     else if (   rc > 0
              || (   rc == 0
                  && timeout != NULL
-                 && pth_time_cmp(timeout, PTH_TIME_ZERO) == 0)) {
+                 && timeout->tv_sec == 0 && timeout->tv_nsec == 0)) {
         /* pass-through immediate success */
         if (rfds != NULL)
             memcpy(rfds, &rspare, sizeof(fd_set));
@@ -389,13 +425,13 @@ int pth_select_ev(int nfd, fd_set *rfds, fd_set *wfds,
                                &ev_key_select, &rc, nfd, rfds, wfds, efds);
     ev_timeout = NULL;
     if (timeout != NULL) {
-        ev_timeout = pth_event(PTH_EVENT_TIME|PTH_MODE_STATIC, &ev_key_timeout,
-                               pth_timeout(timeout->tv_sec, timeout->tv_usec));
+        if ((ev_timeout = pth_high_timeout(&ev_key_timeout, timeout)) == NULL)
+            return pth_error(-1, errno);
         pth_event_concat(ev, ev_timeout, NULL);
     }
     if (ev_extra != NULL)
         pth_event_concat(ev, ev_extra, NULL);
-    pth_wait(ev);
+    waited = pth_wait(ev);
     if (ev_extra != NULL)
         pth_event_isolate(ev_extra);
     if (timeout != NULL)
@@ -416,6 +452,8 @@ int pth_select_ev(int nfd, fd_set *rfds, fd_set *wfds,
         if (efds != NULL) FD_ZERO(efds);
         rc = 0;
     }
+    if (waited < 0 && !selected)
+        return pth_error(-1, ETIMEDOUT);
     if (ev_extra != NULL && !selected)
         return pth_error(-1, EINTR);
 
@@ -427,25 +465,26 @@ int pth_pselect(int nfds, fd_set *rfds, fd_set *wfds, fd_set *efds,
                 const struct timespec *ts, const sigset_t *mask)
 {
     sigset_t omask;
-    struct timeval tv;
-    struct timeval *tvp;
+    struct timespec tsc;
     int rv;
 
-    /* convert timeout */
+    pth_implicit_init();
+
+    /* check timeout */
     if (ts != NULL) {
-        tv.tv_sec  = ts->tv_sec;
-        tv.tv_usec = ts->tv_nsec / 1000;
-        tvp = &tv;
+        if (ts->tv_sec < 0 || ts->tv_nsec < 0 || ts->tv_nsec >= 1000000000L)
+            return pth_error(-1, EINVAL);
+        tsc = *ts;
+        if (tsc.tv_sec > 31*24*60*60)
+            tsc.tv_sec = 31*24*60*60;
     }
-    else
-        tvp = NULL;
 
     /* optionally set signal mask */
     if (mask != NULL)
         if (pth_sc(sigprocmask)(SIG_SETMASK, mask, &omask) < 0)
             return pth_error(-1, errno);
 
-    rv = pth_select(nfds, rfds, wfds, efds, tvp);
+    rv = pth_select_ns(nfds, rfds, wfds, efds, (ts != NULL ? &tsc : NULL), NULL);
 
     /* optionally set signal mask */
     if (mask != NULL)
@@ -460,131 +499,98 @@ int pth_poll(struct pollfd *pfd, nfds_t nfd, int timeout)
     return pth_poll_ev(pfd, nfd, timeout, NULL);
 }
 
-/* Pth variant of poll(2) with extra events:
-   NOTICE: THIS HAS TO BE BASED ON pth_select(2) BECAUSE
-           INTERNALLY THE SCHEDULER IS ONLY select(2) BASED!! */
+/* Pth variant of poll(2) with extra events */
 int pth_poll_ev(struct pollfd *pfd, nfds_t nfd, int timeout, pth_event_t ev_extra)
 {
-    fd_set rfds, wfds, efds, xfds;
-    struct timeval tv, *ptv;
-    int maxfd, rc, n;
-    unsigned int i;
-    char data[64];
+    struct timespec ts, *pts;
+    struct timespec delay;
+    pth_event_t ev;
+    pth_event_t ev_poll;
+    pth_event_t ev_timeout;
+    static pth_key_t ev_key_poll    = PTH_KEY_INIT;
+    static pth_key_t ev_key_timeout = PTH_KEY_INIT;
+    nfds_t i;
+    int waited;
+    int rc;
 
     pth_implicit_init();
     pth_debug2("pth_poll_ev: called from thread \"%s\"", pth_current->name);
 
     /* argument sanity checks */
-    if (pfd == NULL)
+    if (pfd == NULL && nfd > 0)
         return pth_error(-1, EFAULT);
-    if (nfd > FD_SETSIZE)
-        return pth_error(-1, EINVAL);
 
-    /* convert timeout number into a timeval structure */
-    ptv = &tv;
+    /* convert timeout number into a timespec structure */
+    pts = &ts;
     if (timeout == 0) {
         /* return immediately */
-        ptv->tv_sec  = 0;
-        ptv->tv_usec = 0;
+        ts.tv_sec  = 0;
+        ts.tv_nsec = 0;
     }
     else if (timeout == INFTIM /* (-1) */) {
         /* wait forever */
-        ptv = NULL;
+        pts = NULL;
     }
     else if (timeout > 0) {
         /* return after timeout */
-        ptv->tv_sec  = (timeout / 1000);
-        ptv->tv_usec = (timeout % 1000) * 1000;
+        ts.tv_sec  = (timeout / 1000);
+        ts.tv_nsec = (timeout % 1000) * 1000000L;
     }
     else
         return pth_error(-1, EINVAL);
 
-    /* create fd sets and determine max fd */
-    maxfd = -1;
-    FD_ZERO(&rfds);
-    FD_ZERO(&wfds);
-    FD_ZERO(&efds);
-    FD_ZERO(&xfds);
-    for (i = 0; i < nfd; i++) {
-        /* convert into fd_sets but remember that BSD select(2) says
-           "the only exceptional condition detectable is out-of-band
-           data received on a socket", hence we push POLLWRBAND events
-           onto wfds instead of efds. Additionally, remember invalid
-           filedescriptors in an extra fd_set xfds. */
-        if (!pth_util_fd_valid(pfd[i].fd)) {
-            FD_SET(pfd[i].fd, &xfds);
-            continue;
-        }
-        if (pfd[i].events & (POLLIN|POLLRDNORM))
-            FD_SET(pfd[i].fd, &rfds);
-        if (pfd[i].events & (POLLOUT|POLLWRNORM|POLLWRBAND))
-            FD_SET(pfd[i].fd, &wfds);
-        if (pfd[i].events & (POLLPRI|POLLRDBAND))
-            FD_SET(pfd[i].fd, &efds);
-        if (   pfd[i].fd >= maxfd
-            && (pfd[i].events & (POLLIN|POLLOUT|POLLPRI|
-                                 POLLRDNORM|POLLRDBAND|
-                                 POLLWRNORM|POLLWRBAND)))
-            maxfd = pfd[i].fd;
-    }
+    /* a plain delay always has to go through the scheduler */
+    if (nfd == 0)
+        return pth_select_ns(0, NULL, NULL, NULL, pts, ev_extra);
+
+    /* now directly poll the filedescriptors to avoid unnecessary
+       event handling through the scheduler. As poll(2) itself is used,
+       the kernel reports POLLHUP, POLLERR, POLLRDHUP and POLLNVAL
+       directly and the costs only depend on the number of entries. */
+    delay.tv_sec  = 0;
+    delay.tv_nsec = 0;
+    while ((rc = pth_util_ppoll(pfd, nfd, &delay)) < 0
+           && errno == EINTR)
+        ;
+    if (rc < 0)
+        /* pass-through immediate error */
+        return pth_error(-1, errno);
+    else if (rc > 0 || (pts != NULL && ts.tv_sec == 0 && ts.tv_nsec == 0))
+        /* pass-through immediate success */
+        return rc;
 
-    /* examine fd sets with pth_select(3) */
+    /* suspend current thread until one filedescriptor
+       is ready or the timeout occurred (the scheduler passes
+       the array as a whole to its own poll(2) call) */
     rc = -1;
-    if (maxfd != -1) {
-        rc = pth_select_ev(maxfd+1, &rfds, &wfds, &efds, ptv, ev_extra);
-        if (rc < 0)
+    ev = ev_poll = pth_event(PTH_EVENT_POLL|PTH_MODE_STATIC,
+                             &ev_key_poll, &rc, pfd, nfd);
+    if (ev == NULL)
+        return pth_error(-1, errno);
+    ev_timeout = NULL;
+    if (pts != NULL) {
+        if ((ev_timeout = pth_high_timeout(&ev_key_timeout, pts)) == NULL)
             return pth_error(-1, errno);
-        else if (rc == 0)
-            return 0;
+        pth_event_concat(ev, ev_timeout, NULL);
     }
+    if (ev_extra != NULL)
+        pth_event_concat(ev, ev_extra, NULL);
+    waited = pth_wait(ev);
+    if (ev_extra != NULL)
+        pth_event_isolate(ev_extra);
+    if (pts != NULL)
+        pth_event_isolate(ev_timeout);
 
-    /* POSIX.1-2001/SUSv3 compliant result establishment */
-    n = 0;
-    for (i = 0; i < nfd; i++) {
+    /* poll return code semantics */
+    if (pth_event_status(ev_poll) == PTH_STATUS_FAILED)
+        return pth_error(-1, ENOMEM);
+    if (pth_event_status(ev_poll) == PTH_STATUS_OCCURRED)
+        return rc;
+    for (i = 0; i < nfd; i++)
         pfd[i].revents = 0;
-        if (FD_ISSET(pfd[i].fd, &xfds)) {
-            if (pfd[i].fd >= 0) {
-                pfd[i].revents |= POLLNVAL;
-                n++;
-            }
-            continue;
-        }
-        if (maxfd == -1)
-            continue;
-        if (FD_ISSET(pfd[i].fd, &rfds)) {
-            if (pfd[i].events & POLLIN)
-                pfd[i].revents |= POLLIN;
-            if (pfd[i].events & POLLRDNORM)
-                pfd[i].revents |= POLLRDNORM;
-            n++;
-            /* support for POLLHUP */
-            if (   recv(pfd[i].fd, data, sizeof(data), MSG_PEEK) == -1
-                && (   errno == ESHUTDOWN    || errno == ECONNRESET
-                    || errno == ECONNABORTED || errno == ENETRESET    )) {
-                pfd[i].revents &= ~(POLLIN);
-                pfd[i].revents &= ~(POLLRDNORM);
-                pfd[i].revents |= POLLHUP;
-            }
-        }
-        else if (FD_ISSET(pfd[i].fd, &wfds)) {
-            if (pfd[i].events & POLLOUT)
-                pfd[i].revents |= POLLOUT;
-            if (pfd[i].events & POLLWRNORM)
-                pfd[i].revents |= POLLWRNORM;
-            if (pfd[i].events & POLLWRBAND)
-                pfd[i].revents |= POLLWRBAND;
-            n++;
-        }
-        else if (FD_ISSET(pfd[i].fd, &efds)) {
-            if (pfd[i].events & POLLPRI)
-                pfd[i].revents |= POLLPRI;
-            if (pfd[i].events & POLLRDBAND)
-                pfd[i].revents |= POLLRDBAND;
-            n++;
-        }
-    }
-
-    return n;
+    if (pts != NULL && pth_event_status(ev_timeout) == PTH_STATUS_OCCURRED)
+        return 0;
+    return pth_error(-1, (waited < 0 ? ETIMEDOUT : EINTR));
 }
 
 /* Pth variant of connect(2) */
@@ -627,12 +633,8 @@ int pth_connect_ev(int s, const struct sockaddr *addr, socklen_t addrlen, pth_ev
             return pth_error(-1, errno);
         if (ev_extra != NULL)
             pth_event_concat(ev, ev_extra, NULL);
-        pth_wait(ev);
-        if (ev_extra != NULL) {
-            pth_event_isolate(ev);
-            if (pth_event_status(ev) != PTH_STATUS_OCCURRED)
-                return pth_error(-1, EINTR);
-        }
+        if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0)
+            return pth_error(-1, err);
         errlen = sizeof(err);
         if (getsockopt(s, SOL_SOCKET, SO_ERROR, (void *)&err, &errlen) == -1)
             return -1;
@@ -657,7 +659,9 @@ int pth_accept_ev(int s, struct sockaddr *addr, socklen_t *addrlen, pth_event_t
     pth_event_t ev;
     static pth_key_t ev_key = PTH_KEY_INIT;
     int fdmode;
+    ssize_t rs;
     int rv;
+    int err;
 
     pth_implicit_init();
     pth_debug2("pth_accept_ev: enter from thread \"%s\"", pth_current->name);
@@ -666,6 +670,14 @@ int pth_accept_ev(int s, struct sockaddr *addr, socklen_t *addrlen, pth_event_t
     if (!pth_util_fd_valid(s))
         return pth_error(-1, EBADF);
 
+    /* hand the operation over to the io_uring engine if it is active */
+    if (pth_uring_io(PTH_URING_OP_ACCEPT, s, addr, 0,
+                     (unsigned long long)(uintptr_t)addrlen, 0, ev_extra, &rs)) {
+        if (rs >= 0)
+            pth_fdstate_release((int)rs);
+        return (int)rs;
+    }
+
     /* force filedescriptor into non-blocking mode */
     if ((fdmode = pth_fdmode(s, PTH_FDMODE_NONBLOCK)) == PTH_FDMODE_ERROR)
         return pth_error(-1, EBADF);
@@ -679,32 +691,114 @@ int pth_accept_ev(int s, struct sockaddr *addr, socklen_t *addrlen, pth_event_t
         if (ev == NULL) {
             if ((ev = pth_event(PTH_EVENT_FD|PTH_UNTIL_FD_READABLE|PTH_MODE_STATIC, &ev_key, s)) == NULL)
                 return pth_error(-1, errno);
-            if (ev_extra != NULL)
-                pth_event_concat(ev, ev_extra, NULL);
         }
+        /* (each wait isolates the extra events again) */
+        if (ev_extra != NULL)
+            pth_event_concat(ev, ev_extra, NULL);
         /* wait until accept has a chance */
-        pth_wait(ev);
-        /* check for the extra events */
-        if (ev_extra != NULL) {
-            pth_event_isolate(ev);
-            if (pth_event_status(ev) != PTH_STATUS_OCCURRED) {
-                pth_fdmode(s, fdmode);
-                return pth_error(-1, EINTR);
-            }
+        if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0) {
+            pth_fdmode(s, fdmode);
+            return pth_error(-1, err);
         }
     }
 
-    /* restore filedescriptor mode */
+    /* restore filedescriptor mode (the new connection might reuse
+       the number of an owned one closed with close(2), whose state
+       must not apply to it) */
     pth_shield {
         pth_fdmode(s, fdmode);
-        if (rv != -1)
+        if (rv != -1) {
+            pth_fdstate_release(rv);
             pth_fdmode(rv, fdmode);
+        }
     }
 
     pth_debug2("pth_accept_ev: leave to thread \"%s\"", pth_current->name);
     return rv;
 }
 
+/* accept a pending connection directly in non-blocking mode */
+static int pth_accept_nonblock(int s)
+{
+    int fd;
+
+#if defined(HAVE_ACCEPT4) && defined(SOCK_NONBLOCK) && defined(SOCK_CLOEXEC)
+    while ((fd = accept4(s, NULL, NULL, SOCK_NONBLOCK|SOCK_CLOEXEC)) == -1
+           && errno == EINTR) ;
+#else
+    while ((fd = pth_sc(accept)(s, NULL, NULL)) == -1
+           && errno == EINTR) ;
+    if (fd != -1) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, NULL) | O_NONBLOCKING);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+#endif
+    return fd;
+}
+
+/* accept up to nfds pending connections at once */
+int pth_accept_many(int s, int *fds, int nfds, pth_event_t ev_extra)
+{
+    pth_event_t ev;
+    static pth_key_t ev_key = PTH_KEY_INIT;
+    int fdmode;
+    int fd;
+    int n;
+    int err;
+
+    pth_implicit_init();
+    pth_debug2("pth_accept_many: enter from thread \"%s\"", pth_current->name);
+
+    /* argument sanity checks */
+    if (!pth_util_fd_valid(s))
+        return pth_error(-1, EBADF);
+    if (fds == NULL || nfds <= 0)
+        return pth_error(-1, EINVAL);
+
+    /* force filedescriptor into non-blocking mode */
+    if ((fdmode = pth_fdmode(s, PTH_FDMODE_NONBLOCK)) == PTH_FDMODE_ERROR)
+        return pth_error(-1, EBADF);
+
+    /* drain the backlog, but wait for the first connection only */
+    ev = NULL;
+    n = 0;
+    while (n < nfds) {
+        if ((fd = pth_accept_nonblock(s)) != -1) {
+            /* the new filedescriptor is already non-blocking in the kernel,
+               so let Pth own it in the logical mode of the listening socket
+               instead of switching it back */
+            if (!pth_fdstate_own(fd, fdmode))
+                pth_fdmode(fd, fdmode);
+            fds[n++] = fd;
+            continue;
+        }
+        if (   (errno != EAGAIN && errno != EWOULDBLOCK)
+            || n > 0 || fdmode == PTH_FDMODE_NONBLOCK)
+            break;
+        /* do lazy event allocation */
+        if (ev == NULL) {
+            if ((ev = pth_event(PTH_EVENT_FD|PTH_UNTIL_FD_READABLE|PTH_MODE_STATIC, &ev_key, s)) == NULL) {
+                pth_shield { pth_fdmode(s, fdmode); }
+                return -1;
+            }
+        }
+        /* (each wait isolates the extra events again) */
+        if (ev_extra != NULL)
+            pth_event_concat(ev, ev_extra, NULL);
+        /* wait until accept has a chance */
+        if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0) {
+            pth_fdmode(s, fdmode);
+            return pth_error(-1, err);
+        }
+    }
+
+    /* restore filedescriptor mode */
+    pth_shield { pth_fdmode(s, fdmode); }
+
+    pth_debug2("pth_accept_many: leave to thread \"%s\"", pth_current->name);
+    return (n > 0 ? n : -1);
+}
+
 /* Pth variant of read(2) */
 ssize_t pth_read(int fd, void *buf, size_t nbytes)
 {
@@ -714,12 +808,12 @@ ssize_t pth_read(int fd, void *buf, size_t nbytes)
 /* Pth variant of read(2) with extra event(s) */
 ssize_t pth_read_ev(int fd, void *buf, size_t nbytes, pth_event_t ev_extra)
 {
-    struct timeval delay;
     pth_event_t ev;
     static pth_key_t ev_key = PTH_KEY_INIT;
-    fd_set fds;
     int fdmode;
+    ssize_t rv;
     int n;
+    int err;
 
     pth_implicit_init();
     pth_debug2("pth_read_ev: enter from thread \"%s\"", pth_current->name);
@@ -730,22 +824,44 @@ ssize_t pth_read_ev(int fd, void *buf, size_t nbytes, pth_event_t ev_extra)
     if (!pth_util_fd_valid(fd))
         return pth_error(-1, EBADF);
 
+    /* hand the operation over to the io_uring engine if it is active
+       (this also keeps reads of regular files from blocking the process) */
+    if (pth_uring_io(PTH_URING_OP_READ, fd, buf, nbytes,
+                     (unsigned long long)-1, 0, ev_extra, &rv))
+        return rv;
+
     /* check mode of filedescriptor */
     if ((fdmode = pth_fdmode(fd, PTH_FDMODE_POLL)) == PTH_FDMODE_ERROR)
         return pth_error(-1, EBADF);
 
+    /* sockets owned by Pth are physically non-blocking, so just try to
+       read from them directly and wait whenever nothing is available (which
+       might also happen after a wakeup if another thread was faster) */
+    if (fdmode == PTH_FDMODE_BLOCK && pth_fdstate_owned(fd)) {
+        for (;;) {
+            while ((n = pth_sc(recv)(fd, buf, nbytes, MSG_DONTWAIT)) < 0
+                   && errno == EINTR) ;
+            if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+                break;
+            ev = pth_event(PTH_EVENT_FD|PTH_UNTIL_FD_READABLE|PTH_MODE_STATIC, &ev_key, fd);
+            if (ev_extra != NULL)
+                pth_event_concat(ev, ev_extra, NULL);
+            if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0)
+                return pth_error(-1, err);
+        }
+        if (n >= 0 || !pth_fdstate_stale(fd))
+            return n;
+        if ((fdmode = pth_fdmode(fd, PTH_FDMODE_POLL)) == PTH_FDMODE_ERROR)
+            return pth_error(-1, EBADF);
+    }
+
     /* poll filedescriptor if not already in non-blocking operation */
     if (fdmode == PTH_FDMODE_BLOCK) {
 
-        /* now directly poll filedescriptor for readability
+        /* directly poll filedescriptor for readability
            to avoid unneccessary (and resource consuming because of context
            switches, etc) event handling through the scheduler */
-        FD_ZERO(&fds);
-        FD_SET(fd, &fds);
-        delay.tv_sec  = 0;
-        delay.tv_usec = 0;
-        while ((n = pth_sc(select)(fd+1, &fds, NULL, NULL, &delay)) < 0
-               && errno == EINTR) ;
+        n = pth_util_fd_poll(fd, POLLIN);
         if (n < 0 && (errno == EINVAL || errno == EBADF))
             return pth_error(-1, errno);
 
@@ -755,12 +871,8 @@ ssize_t pth_read_ev(int fd, void *buf, size_t nbytes, pth_event_t ev_extra)
             ev = pth_event(PTH_EVENT_FD|PTH_UNTIL_FD_READABLE|PTH_MODE_STATIC, &ev_key, fd);
             if (ev_extra != NULL)
                 pth_event_concat(ev, ev_extra, NULL);
-            n = pth_wait(ev);
-            if (ev_extra != NULL) {
-                pth_event_isolate(ev);
-                if (pth_event_status(ev) != PTH_STATUS_OCCURRED)
-                    return pth_error(-1, EINTR);
-            }
+            if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0)
+                return pth_error(-1, err);
         }
     }
 
@@ -786,14 +898,14 @@ ssize_t pth_write(int fd, const void *buf, size_t nbytes)
 /* Pth variant of write(2) with extra event(s) */
 ssize_t pth_write_ev(int fd, const void *buf, size_t nbytes, pth_event_t ev_extra)
 {
-    struct timeval delay;
+    struct iovec iov;
     pth_event_t ev;
     static pth_key_t ev_key = PTH_KEY_INIT;
-    fd_set fds;
     int fdmode;
     ssize_t rv;
     ssize_t s;
     int n;
+    int err;
 
     pth_implicit_init();
     pth_debug2("pth_write_ev: enter from thread \"%s\"", pth_current->name);
@@ -804,6 +916,30 @@ ssize_t pth_write_ev(int fd, const void *buf, size_t nbytes, pth_event_t ev_extr
     if (!pth_util_fd_valid(fd))
         return pth_error(-1, EBADF);
 
+    /* collect small writes on corked filedescriptors */
+    iov.iov_base = (void *)buf;
+    iov.iov_len  = nbytes;
+    if (pth_cork_writev(fd, &iov, 1, ev_extra, &rv))
+        return rv;
+
+    /* hand the operation over to the io_uring engine if it is active
+       (and iterate like below to mimic the blocking write(2) behaviour) */
+    if (pth_uring_io(PTH_URING_OP_WRITE, fd, buf, nbytes,
+                     (unsigned long long)-1, 0, ev_extra, &s)) {
+        rv = 0;
+        while (s > 0) {
+            rv += s;
+            nbytes -= s;
+            buf = (void *)((char *)buf + s);
+            if (nbytes == 0 || !pth_uring_io(PTH_URING_OP_WRITE, fd, buf, nbytes,
+                                             (unsigned long long)-1, 0, ev_extra, &s))
+                break;
+        }
+        if (s < 0 && rv == 0)
+            rv = -1;
+        return rv;
+    }
+
     /* force filedescriptor into non-blocking mode */
     if ((fdmode = pth_fdmode(fd, PTH_FDMODE_NONBLOCK)) == PTH_FDMODE_ERROR)
         return pth_error(-1, EBADF);
@@ -813,15 +949,16 @@ ssize_t pth_write_ev(int fd, const void *buf, size_t nbytes, pth_event_t ev_extr
 
         /* now directly poll filedescriptor for writeability
            to avoid unneccessary (and resource consuming because of context
-           switches, etc) event handling through the scheduler */
-        FD_ZERO(&fds);
-        FD_SET(fd, &fds);
-        delay.tv_sec  = 0;
-        delay.tv_usec = 0;
-        while ((n = pth_sc(select)(fd+1, NULL, &fds, NULL, &delay)) < 0
-               && errno == EINTR) ;
-        if (n < 0 && (errno == EINVAL || errno == EBADF))
-            return pth_error(-1, errno);
+           switches, etc) event handling through the scheduler
+           (filedescriptors owned by Pth are just tried directly) */
+        n = 1;
+        if (!pth_fdstate_owned(fd)) {
+            n = pth_util_fd_poll(fd, POLLOUT);
+            if (n < 0 && (errno == EINVAL || errno == EBADF)) {
+                pth_shield { pth_fdmode(fd, fdmode); }
+                return pth_error(-1, errno);
+            }
+        }
 
         rv = 0;
         for (;;) {
@@ -831,13 +968,9 @@ ssize_t pth_write_ev(int fd, const void *buf, size_t nbytes, pth_event_t ev_extr
                 ev = pth_event(PTH_EVENT_FD|PTH_UNTIL_FD_WRITEABLE|PTH_MODE_STATIC, &ev_key, fd);
                 if (ev_extra != NULL)
                     pth_event_concat(ev, ev_extra, NULL);
-                pth_wait(ev);
-                if (ev_extra != NULL) {
-                    pth_event_isolate(ev);
-                    if (pth_event_status(ev) != PTH_STATUS_OCCURRED) {
-                        pth_fdmode(fd, fdmode);
-                        return pth_error(-1, EINTR);
-                    }
+                if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0) {
+                    pth_fdmode(fd, fdmode);
+                    return pth_error(-1, err);
                 }
             }
 
@@ -847,6 +980,12 @@ ssize_t pth_write_ev(int fd, const void *buf, size_t nbytes, pth_event_t ev_extr
             if (s > 0)
                 rv += s;
 
+            /* wait if the direct attempt would have blocked */
+            if (s < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                n = 0;
+                continue;
+            }
+
             /* although we're physically now in non-blocking mode,
                iterate unless all data is written or an error occurs, because
                we've to mimic the usual blocking I/O behaviour of write(2). */
@@ -887,12 +1026,13 @@ ssize_t pth_readv(int fd, const struct iovec *iov, int iovcnt)
 /* Pth variant of readv(2) with extra event(s) */
 ssize_t pth_readv_ev(int fd, const struct iovec *iov, int iovcnt, pth_event_t ev_extra)
 {
-    struct timeval delay;
     pth_event_t ev;
     static pth_key_t ev_key = PTH_KEY_INIT;
-    fd_set fds;
+    struct msghdr msg;
     int fdmode;
+    ssize_t rv;
     int n;
+    int err;
 
     pth_implicit_init();
     pth_debug2("pth_readv_ev: enter from thread \"%s\"", pth_current->name);
@@ -903,22 +1043,45 @@ ssize_t pth_readv_ev(int fd, const struct iovec *iov, int iovcnt, pth_event_t ev
     if (!pth_util_fd_valid(fd))
         return pth_error(-1, EBADF);
 
+    /* hand the operation over to the io_uring engine if it is active */
+    if (pth_uring_io(PTH_URING_OP_READV, fd, iov, (size_t)iovcnt,
+                     (unsigned long long)-1, 0, ev_extra, &rv))
+        return rv;
+
     /* check mode of filedescriptor */
     if ((fdmode = pth_fdmode(fd, PTH_FDMODE_POLL)) == PTH_FDMODE_ERROR)
         return pth_error(-1, EBADF);
 
+    /* sockets owned by Pth are physically non-blocking, so just try to
+       read from them directly and wait whenever nothing is available */
+    if (fdmode == PTH_FDMODE_BLOCK && pth_fdstate_owned(fd)) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov    = (struct iovec *)iov;
+        msg.msg_iovlen = (size_t)iovcnt;
+        for (;;) {
+            while ((n = recvmsg(fd, &msg, MSG_DONTWAIT)) < 0
+                   && errno == EINTR) ;
+            if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+                break;
+            ev = pth_event(PTH_EVENT_FD|PTH_UNTIL_FD_READABLE|PTH_MODE_STATIC, &ev_key, fd);
+            if (ev_extra != NULL)
+                pth_event_concat(ev, ev_extra, NULL);
+            if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0)
+                return pth_error(-1, err);
+        }
+        if (n >= 0 || !pth_fdstate_stale(fd))
+            return n;
+        if ((fdmode = pth_fdmode(fd, PTH_FDMODE_POLL)) == PTH_FDMODE_ERROR)
+            return pth_error(-1, EBADF);
+    }
+
     /* poll filedescriptor if not already in non-blocking operation */
     if (fdmode == PTH_FDMODE_BLOCK) {
 
         /* first directly poll filedescriptor for readability
            to avoid unneccessary (and resource consuming because of context
            switches, etc) event handling through the scheduler */
-        FD_ZERO(&fds);
-        FD_SET(fd, &fds);
-        delay.tv_sec  = 0;
-        delay.tv_usec = 0;
-        while ((n = pth_sc(select)(fd+1, &fds, NULL, NULL, &delay)) < 0
-               && errno == EINTR) ;
+        n = pth_util_fd_poll(fd, POLLIN);
 
         /* if filedescriptor is still not readable,
            let thread sleep until it is or event occurs */
@@ -926,12 +1089,8 @@ ssize_t pth_readv_ev(int fd, const struct iovec *iov, int iovcnt, pth_event_t ev
             ev = pth_event(PTH_EVENT_FD|PTH_UNTIL_FD_READABLE|PTH_MODE_STATIC, &ev_key, fd);
             if (ev_extra != NULL)
                 pth_event_concat(ev, ev_extra, NULL);
-            n = pth_wait(ev);
-            if (ev_extra != NULL) {
-                pth_event_isolate(ev);
-                if (pth_event_status(ev) != PTH_STATUS_OCCURRED)
-                    return pth_error(-1, EINTR);
-            }
+            if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0)
+                return pth_error(-1, err);
         }
     }
 
@@ -1006,10 +1165,8 @@ ssize_t pth_writev(int fd, const struct iovec *iov, int iovcnt)
 /* Pth variant of writev(2) with extra event(s) */
 ssize_t pth_writev_ev(int fd, const struct iovec *iov, int iovcnt, pth_event_t ev_extra)
 {
-    struct timeval delay;
     pth_event_t ev;
     static pth_key_t ev_key = PTH_KEY_INIT;
-    fd_set fds;
     int fdmode;
     struct iovec *liov;
     int liovcnt;
@@ -1020,6 +1177,7 @@ ssize_t pth_writev_ev(int fd, const struct iovec *iov, int iovcnt, pth_event_t e
     struct iovec tiov_stack[32];
     struct iovec *tiov;
     int tiovcnt;
+    int err;
 
     pth_implicit_init();
     pth_debug2("pth_writev_ev: enter from thread \"%s\"", pth_current->name);
@@ -1030,6 +1188,15 @@ ssize_t pth_writev_ev(int fd, const struct iovec *iov, int iovcnt, pth_event_t e
     if (!pth_util_fd_valid(fd))
         return pth_error(-1, EBADF);
 
+    /* collect small writes on corked filedescriptors */
+    if (pth_cork_writev(fd, iov, iovcnt, ev_extra, &rv))
+        return rv;
+
+    /* hand the operation over to the io_uring engine if it is active */
+    if (pth_uring_io(PTH_URING_OP_WRITEV, fd, iov, (size_t)iovcnt,
+                     (unsigned long long)-1, 0, ev_extra, &rv))
+        return rv;
+
     /* force filedescriptor into non-blocking mode */
     if ((fdmode = pth_fdmode(fd, PTH_FDMODE_NONBLOCK)) == PTH_FDMODE_ERROR)
         return pth_error(-1, EBADF);
@@ -1059,12 +1226,7 @@ ssize_t pth_writev_ev(int fd, const struct iovec *iov, int iovcnt, pth_event_t e
         /* first directly poll filedescriptor for writeability
            to avoid unneccessary (and resource consuming because of context
            switches, etc) event handling through the scheduler */
-        FD_ZERO(&fds);
-        FD_SET(fd, &fds);
-        delay.tv_sec  = 0;
-        delay.tv_usec = 0;
-        while ((n = pth_sc(select)(fd+1, NULL, &fds, NULL, &delay)) < 0
-               && errno == EINTR) ;
+        n = pth_util_fd_poll(fd, POLLOUT);
 
         for (;;) {
             /* if filedescriptor is still not writeable,
@@ -1073,15 +1235,11 @@ ssize_t pth_writev_ev(int fd, const struct iovec *iov, int iovcnt, pth_event_t e
                 ev = pth_event(PTH_EVENT_FD|PTH_UNTIL_FD_WRITEABLE|PTH_MODE_STATIC, &ev_key, fd);
                 if (ev_extra != NULL)
                     pth_event_concat(ev, ev_extra, NULL);
-                pth_wait(ev);
-                if (ev_extra != NULL) {
-                    pth_event_isolate(ev);
-                    if (pth_event_status(ev) != PTH_STATUS_OCCURRED) {
-                        pth_fdmode(fd, fdmode);
-                        if ((size_t)iovcnt > sizeof(tiov_stack))
-                            free(tiov);
-                        return pth_error(-1, EINTR);
-                    }
+                if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0) {
+                    pth_fdmode(fd, fdmode);
+                    if ((size_t)iovcnt > sizeof(tiov_stack))
+                        free(tiov);
+                    return pth_error(-1, err);
                 }
             }
 
@@ -1231,71 +1389,297 @@ ssize_t pth_writev_faked(int fd, const struct iovec *iov, int iovcnt)
     return(rv);
 }
 
+/* let the current thread sleep until a filedescriptor in
+   blocking mode is ready for positional I/O */
+static int pth_high_pwait(int fd, int goal)
+{
+    static pth_key_t ev_key = PTH_KEY_INIT;
+    pth_event_t ev;
+    int n;
+
+    /* first directly poll filedescriptor (for regular files
+       this is always successful, so no event handling is needed) */
+    n = pth_util_fd_poll(fd, (goal == PTH_UNTIL_FD_READABLE ? POLLIN : POLLOUT));
+    if (n < 0)
+        return FALSE;
+    if (n == 0) {
+        if ((ev = pth_event(PTH_EVENT_FD|goal|PTH_MODE_STATIC, &ev_key, fd)) == NULL)
+            return FALSE;
+        if (pth_wait(ev) < 0)
+            return pth_error(FALSE, ETIMEDOUT);
+    }
+    return TRUE;
+}
+
 /* Pth variant of POSIX pread(3) */
 ssize_t pth_pread(int fd, void *buf, size_t nbytes, off_t offset)
 {
-    static pth_mutex_t mutex = PTH_MUTEX_INIT;
-    off_t old_offset;
-    ssize_t rc;
-
-    /* protect us: pth_read can yield! */
-    if (!pth_mutex_acquire(&mutex, FALSE, NULL))
-        return (-1);
-
-    /* remember current offset */
-    if ((old_offset = lseek(fd, 0, SEEK_CUR)) == (off_t)(-1)) {
-        pth_mutex_release(&mutex);
-        return (-1);
-    }
-    /* seek to requested offset */
-    if (lseek(fd, offset, SEEK_SET) == (off_t)(-1)) {
-        pth_mutex_release(&mutex);
-        return (-1);
-    }
+    int fdmode;
+    ssize_t rv;
 
-    /* perform the read operation */
-    rc = pth_read(fd, buf, nbytes);
+    pth_implicit_init();
+    pth_debug2("pth_pread: enter from thread \"%s\"", pth_current->name);
+
+    /* POSIX compliance */
+    if (nbytes == 0)
+        return 0;
+    if (!pth_util_fd_valid(fd))
+        return pth_error(-1, EBADF);
 
-    /* restore the old offset situation */
-    pth_shield { lseek(fd, old_offset, SEEK_SET); }
+    /* hand the operation over to the io_uring engine if it is active */
+    if (pth_uring_io(PTH_URING_OP_READ, fd, buf, nbytes,
+                     (unsigned long long)offset, 0, NULL, &rv))
+        return rv;
 
-    /* unprotect and return result of read */
-    pth_mutex_release(&mutex);
-    return rc;
+    /* wait for readability if not in non-blocking operation */
+    if ((fdmode = pth_fdmode(fd, PTH_FDMODE_POLL)) == PTH_FDMODE_ERROR)
+        return pth_error(-1, EBADF);
+    if (fdmode == PTH_FDMODE_BLOCK && !pth_high_pwait(fd, PTH_UNTIL_FD_READABLE))
+        return -1;
+
+    /* perform the positional read, which leaves the file offset alone
+       and hence needs no serialization with other threads */
+    while ((rv = pth_sc(pread)(fd, buf, nbytes, offset)) < 0
+           && errno == EINTR)
+        ;
+
+    pth_debug2("pth_pread: leave to thread \"%s\"", pth_current->name);
+    return rv;
 }
 
 /* Pth variant of POSIX pwrite(3) */
 ssize_t pth_pwrite(int fd, const void *buf, size_t nbytes, off_t offset)
 {
-    static pth_mutex_t mutex = PTH_MUTEX_INIT;
-    off_t old_offset;
-    ssize_t rc;
-
-    /* protect us: pth_write can yield! */
-    if (!pth_mutex_acquire(&mutex, FALSE, NULL))
-        return (-1);
-
-    /* remember current offset */
-    if ((old_offset = lseek(fd, 0, SEEK_CUR)) == (off_t)(-1)) {
-        pth_mutex_release(&mutex);
-        return (-1);
-    }
-    /* seek to requested offset */
-    if (lseek(fd, offset, SEEK_SET) == (off_t)(-1)) {
-        pth_mutex_release(&mutex);
-        return (-1);
-    }
-
-    /* perform the write operation */
-    rc = pth_write(fd, buf, nbytes);
+    int fdmode;
+    ssize_t rv;
+    ssize_t s;
 
-    /* restore the old offset situation */
-    pth_shield { lseek(fd, old_offset, SEEK_SET); }
+    pth_implicit_init();
+    pth_debug2("pth_pwrite: enter from thread \"%s\"", pth_current->name);
 
-    /* unprotect and return result of write */
-    pth_mutex_release(&mutex);
-    return rc;
-}
+    /* POSIX compliance */
+    if (nbytes == 0)
+        return 0;
+    if (!pth_util_fd_valid(fd))
+        return pth_error(-1, EBADF);
+
+    /* hand the operation over to the io_uring engine if it is active
+       (and iterate like below to mimic the blocking pwrite(2) behaviour) */
+    if (pth_uring_io(PTH_URING_OP_WRITE, fd, buf, nbytes,
+                     (unsigned long long)offset, 0, NULL, &s)) {
+        rv = 0;
+        while (s > 0) {
+            rv += s;
+            nbytes -= s;
+            buf = (void *)((char *)buf + s);
+            offset += s;
+            if (nbytes == 0 || !pth_uring_io(PTH_URING_OP_WRITE, fd, buf, nbytes,
+                                             (unsigned long long)offset, 0, NULL, &s))
+                break;
+        }
+        if (s < 0 && rv == 0)
+            rv = -1;
+        return rv;
+    }
+
+    /* wait for writeability if not in non-blocking operation */
+    if ((fdmode = pth_fdmode(fd, PTH_FDMODE_POLL)) == PTH_FDMODE_ERROR)
+        return pth_error(-1, EBADF);
+    if (fdmode == PTH_FDMODE_BLOCK && !pth_high_pwait(fd, PTH_UNTIL_FD_WRITEABLE))
+        return -1;
+
+    rv = 0;
+    for (;;) {
+        /* perform the positional write */
+        while ((s = pth_sc(pwrite)(fd, buf, nbytes, offset)) < 0
+               && errno == EINTR)
+            ;
+        if (s > 0)
+            rv += s;
+
+        /* in blocking mode iterate unless all data is written or an error
+           occurs, because we've to mimic the usual blocking I/O behaviour */
+        if (fdmode == PTH_FDMODE_BLOCK && s > 0 && s < (ssize_t)nbytes) {
+            nbytes -= s;
+            buf = (void *)((char *)buf + s);
+            offset += s;
+            if (pth_high_pwait(fd, PTH_UNTIL_FD_WRITEABLE))
+                continue;
+        }
+
+        /* pass error to caller, but not for partial writes (rv > 0) */
+        if (s < 0 && rv == 0)
+            rv = -1;
+        break;
+    }
+
+    pth_debug2("pth_pwrite: leave to thread \"%s\"", pth_current->name);
+    return rv;
+}
+
+/* Pth variant of preadv(2) */
+ssize_t pth_preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    int fdmode;
+    ssize_t rv;
+
+    pth_implicit_init();
+    pth_debug2("pth_preadv: enter from thread \"%s\"", pth_current->name);
+
+    /* POSIX compliance */
+    if (iovcnt <= 0 || iovcnt > UIO_MAXIOV)
+        return pth_error(-1, EINVAL);
+    if (!pth_util_fd_valid(fd))
+        return pth_error(-1, EBADF);
+
+    /* hand the operation over to the io_uring engine if it is active */
+    if (pth_uring_io(PTH_URING_OP_READV, fd, iov, (size_t)iovcnt,
+                     (unsigned long long)offset, 0, NULL, &rv))
+        return rv;
+
+    /* wait for readability if not in non-blocking operation */
+    if ((fdmode = pth_fdmode(fd, PTH_FDMODE_POLL)) == PTH_FDMODE_ERROR)
+        return pth_error(-1, EBADF);
+    if (fdmode == PTH_FDMODE_BLOCK && !pth_high_pwait(fd, PTH_UNTIL_FD_READABLE))
+        return -1;
+
+    /* perform the positional scatter read */
+#ifdef HAVE_PREADV
+    while ((rv = preadv(fd, iov, iovcnt, offset)) < 0
+           && errno == EINTR)
+        ;
+#else
+    rv = pth_preadv_faked(fd, iov, iovcnt, offset);
+#endif
+
+    pth_debug2("pth_preadv: leave to thread \"%s\"", pth_current->name);
+    return rv;
+}
+
+/* Pth variant of pwritev(2) */
+ssize_t pth_pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    int fdmode;
+    struct iovec *liov;
+    int liovcnt;
+    size_t nbytes;
+    ssize_t rv;
+    ssize_t s;
+    struct iovec tiov_stack[32];
+    struct iovec *tiov;
+
+    pth_implicit_init();
+    pth_debug2("pth_pwritev: enter from thread \"%s\"", pth_current->name);
+
+    /* POSIX compliance */
+    if (iovcnt <= 0 || iovcnt > UIO_MAXIOV)
+        return pth_error(-1, EINVAL);
+    if (!pth_util_fd_valid(fd))
+        return pth_error(-1, EBADF);
+
+    /* hand the operation over to the io_uring engine if it is active */
+    if (pth_uring_io(PTH_URING_OP_WRITEV, fd, iov, (size_t)iovcnt,
+                     (unsigned long long)offset, 0, NULL, &rv))
+        return rv;
+
+    /* wait for writeability if not in non-blocking operation */
+    if ((fdmode = pth_fdmode(fd, PTH_FDMODE_POLL)) == PTH_FDMODE_ERROR)
+        return pth_error(-1, EBADF);
+    if (fdmode == PTH_FDMODE_BLOCK && !pth_high_pwait(fd, PTH_UNTIL_FD_WRITEABLE))
+        return -1;
+
+    /* provide temporary iovec structure for advancing after partial writes */
+    if ((size_t)iovcnt > sizeof(tiov_stack) / sizeof(tiov_stack[0])) {
+        if ((tiov = (struct iovec *)malloc(sizeof(struct iovec) * iovcnt)) == NULL)
+            return pth_error(-1, errno);
+    }
+    else
+        tiov = tiov_stack;
+    nbytes  = pth_writev_iov_bytes(iov, iovcnt);
+    liov    = NULL;
+    liovcnt = 0;
+    pth_writev_iov_advance(iov, iovcnt, 0, &liov, &liovcnt, tiov, iovcnt);
+
+    rv = 0;
+    for (;;) {
+        /* perform the positional gather write */
+#ifdef HAVE_PWRITEV
+        while ((s = pwritev(fd, liov, liovcnt, offset)) < 0
+               && errno == EINTR)
+            ;
+#else
+        s = pth_pwritev_faked(fd, liov, liovcnt, offset);
+#endif
+        if (s > 0)
+            rv += s;
+
+        /* in blocking mode iterate unless all data is written or an error
+           occurs, because we've to mimic the usual blocking I/O behaviour */
+        if (fdmode == PTH_FDMODE_BLOCK && s > 0 && s < (ssize_t)nbytes) {
+            nbytes -= s;
+            offset += s;
+            pth_writev_iov_advance(iov, iovcnt, s, &liov, &liovcnt, tiov, iovcnt);
+            if (pth_high_pwait(fd, PTH_UNTIL_FD_WRITEABLE))
+                continue;
+        }
+
+        /* pass error to caller, but not for partial writes (rv > 0) */
+        if (s < 0 && rv == 0)
+            rv = -1;
+        break;
+    }
+
+    /* cleanup */
+    if (tiov != tiov_stack)
+        pth_shield { free(tiov); }
+
+    pth_debug2("pth_pwritev: leave to thread \"%s\"", pth_current->name);
+    return rv;
+}
+
+#ifndef HAVE_PREADV
+/* A faked version of preadv(2) (one pread(2) per vector element) */
+ssize_t pth_preadv_faked(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    ssize_t rv, n;
+    int i;
+
+    rv = 0;
+    for (i = 0; i < iovcnt; i++) {
+        while ((n = pth_sc(pread)(fd, iov[i].iov_base, iov[i].iov_len, offset)) < 0
+               && errno == EINTR) ;
+        if (n < 0)
+            return (rv > 0 ? rv : -1);
+        rv += n;
+        offset += n;
+        if ((size_t)n < iov[i].iov_len)
+            break;
+    }
+    return rv;
+}
+#endif
+
+#ifndef HAVE_PWRITEV
+/* A faked version of pwritev(2) (one pwrite(2) per vector element) */
+ssize_t pth_pwritev_faked(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    ssize_t rv, n;
+    int i;
+
+    rv = 0;
+    for (i = 0; i < iovcnt; i++) {
+        while ((n = pth_sc(pwrite)(fd, iov[i].iov_base, iov[i].iov_len, offset)) < 0
+               && errno == EINTR) ;
+        if (n < 0)
+            return (rv > 0 ? rv : -1);
+        rv += n;
+        offset += n;
+        if ((size_t)n < iov[i].iov_len)
+            break;
+    }
+    return rv;
+}
+#endif
 
 /* Pth variant of SUSv2 recv(2) */
 ssize_t pth_recv(int s, void *buf, size_t len, int flags)
@@ -1318,12 +1702,12 @@ ssize_t pth_recvfrom(int s, void *buf, size_t len, int flags, struct sockaddr *f
 /* Pth variant of SUSv2 recvfrom(2) with extra event(s) */
 ssize_t pth_recvfrom_ev(int fd, void *buf, size_t nbytes, int flags, struct sockaddr *from, socklen_t *fromlen, pth_event_t ev_extra)
 {
-    struct timeval delay;
     pth_event_t ev;
     static pth_key_t ev_key = PTH_KEY_INIT;
-    fd_set fds;
     int fdmode;
+    ssize_t rv;
     int n;
+    int err;
 
     pth_implicit_init();
     pth_debug2("pth_recvfrom_ev: enter from thread \"%s\"", pth_current->name);
@@ -1334,24 +1718,42 @@ ssize_t pth_recvfrom_ev(int fd, void *buf, size_t nbytes, int flags, struct sock
     if (!pth_util_fd_valid(fd))
         return pth_error(-1, EBADF);
 
+    /* hand plain receives over to the io_uring engine if it is active */
+    if (from == NULL
+        && pth_uring_io(PTH_URING_OP_RECV, fd, buf, nbytes, 0, flags, ev_extra, &rv))
+        return rv;
+
     /* check mode of filedescriptor */
     if ((fdmode = pth_fdmode(fd, PTH_FDMODE_POLL)) == PTH_FDMODE_ERROR)
         return pth_error(-1, EBADF);
 
+    /* sockets owned by Pth are physically non-blocking, so just try to
+       receive from them directly and wait whenever nothing is available */
+    if (fdmode == PTH_FDMODE_BLOCK && pth_fdstate_owned(fd)) {
+        for (;;) {
+            while ((n = pth_sc(recvfrom)(fd, buf, nbytes, flags|MSG_DONTWAIT, from, fromlen)) < 0
+                   && errno == EINTR) ;
+            if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+                break;
+            ev = pth_event(PTH_EVENT_FD|PTH_UNTIL_FD_READABLE|PTH_MODE_STATIC, &ev_key, fd);
+            if (ev_extra != NULL)
+                pth_event_concat(ev, ev_extra, NULL);
+            if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0)
+                return pth_error(-1, err);
+        }
+        if (n >= 0 || !pth_fdstate_stale(fd))
+            return n;
+        if ((fdmode = pth_fdmode(fd, PTH_FDMODE_POLL)) == PTH_FDMODE_ERROR)
+            return pth_error(-1, EBADF);
+    }
+
     /* poll filedescriptor if not already in non-blocking operation */
     if (fdmode == PTH_FDMODE_BLOCK) {
 
-        /* now directly poll filedescriptor for readability
+        /* directly poll filedescriptor for readability
            to avoid unneccessary (and resource consuming because of context
            switches, etc) event handling through the scheduler */
-        if (!pth_util_fd_valid(fd))
-            return pth_error(-1, EBADF);
-        FD_ZERO(&fds);
-        FD_SET(fd, &fds);
-        delay.tv_sec  = 0;
-        delay.tv_usec = 0;
-        while ((n = pth_sc(select)(fd+1, &fds, NULL, NULL, &delay)) < 0
-               && errno == EINTR) ;
+        n = pth_util_fd_poll(fd, POLLIN);
         if (n < 0 && (errno == EINVAL || errno == EBADF))
             return pth_error(-1, errno);
 
@@ -1361,12 +1763,8 @@ ssize_t pth_recvfrom_ev(int fd, void *buf, size_t nbytes, int flags, struct sock
             ev = pth_event(PTH_EVENT_FD|PTH_UNTIL_FD_READABLE|PTH_MODE_STATIC, &ev_key, fd);
             if (ev_extra != NULL)
                 pth_event_concat(ev, ev_extra, NULL);
-            n = pth_wait(ev);
-            if (ev_extra != NULL) {
-                pth_event_isolate(ev);
-                if (pth_event_status(ev) != PTH_STATUS_OCCURRED)
-                    return pth_error(-1, EINTR);
-            }
+            if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0)
+                return pth_error(-1, err);
         }
     }
 
@@ -1404,14 +1802,13 @@ ssize_t pth_sendto(int s, const void *buf, size_t len, int flags, const struct s
 /* Pth variant of SUSv2 sendto(2) with extra event(s) */
 ssize_t pth_sendto_ev(int fd, const void *buf, size_t nbytes, int flags, const struct sockaddr *to, socklen_t tolen, pth_event_t ev_extra)
 {
-    struct timeval delay;
     pth_event_t ev;
     static pth_key_t ev_key = PTH_KEY_INIT;
-    fd_set fds;
     int fdmode;
     ssize_t rv;
     ssize_t s;
     int n;
+    int err;
 
     pth_implicit_init();
     pth_debug2("pth_sendto_ev: enter from thread \"%s\"", pth_current->name);
@@ -1422,6 +1819,28 @@ ssize_t pth_sendto_ev(int fd, const void *buf, size_t nbytes, int flags, const s
     if (!pth_util_fd_valid(fd))
         return pth_error(-1, EBADF);
 
+    /* keep the order with data collected on a corked filedescriptor */
+    if (pth_cork_pending > 0 && !pth_cork_sync(fd, ev_extra))
+        return -1;
+
+    /* hand plain sends over to the io_uring engine if it is active
+       (and iterate like below to mimic the blocking send(2) behaviour) */
+    if (to == NULL
+        && pth_uring_io(PTH_URING_OP_SEND, fd, buf, nbytes, 0, flags, ev_extra, &s)) {
+        rv = 0;
+        while (s > 0) {
+            rv += s;
+            nbytes -= s;
+            buf = (void *)((char *)buf + s);
+            if (nbytes == 0 || !pth_uring_io(PTH_URING_OP_SEND, fd, buf, nbytes,
+                                             0, flags, ev_extra, &s))
+                break;
+        }
+        if (s < 0 && rv == 0)
+            rv = -1;
+        return rv;
+    }
+
     /* force filedescriptor into non-blocking mode */
     if ((fdmode = pth_fdmode(fd, PTH_FDMODE_NONBLOCK)) == PTH_FDMODE_ERROR)
         return pth_error(-1, EBADF);
@@ -1431,19 +1850,16 @@ ssize_t pth_sendto_ev(int fd, const void *buf, size_t nbytes, int flags, const s
 
         /* now directly poll filedescriptor for writeability
            to avoid unneccessary (and resource consuming because of context
-           switches, etc) event handling through the scheduler */
-        if (!pth_util_fd_valid(fd)) {
-            pth_fdmode(fd, fdmode);
-            return pth_error(-1, EBADF);
+           switches, etc) event handling through the scheduler
+           (filedescriptors owned by Pth are just tried directly) */
+        n = 1;
+        if (!pth_fdstate_owned(fd)) {
+            n = pth_util_fd_poll(fd, POLLOUT);
+            if (n < 0 && (errno == EINVAL || errno == EBADF)) {
+                pth_shield { pth_fdmode(fd, fdmode); }
+                return pth_error(-1, errno);
+            }
         }
-        FD_ZERO(&fds);
-        FD_SET(fd, &fds);
-        delay.tv_sec  = 0;
-        delay.tv_usec = 0;
-        while ((n = pth_sc(select)(fd+1, NULL, &fds, NULL, &delay)) < 0
-               && errno == EINTR) ;
-        if (n < 0 && (errno == EINVAL || errno == EBADF))
-            return pth_error(-1, errno);
 
         rv = 0;
         for (;;) {
@@ -1453,13 +1869,9 @@ ssize_t pth_sendto_ev(int fd, const void *buf, size_t nbytes, int flags, const s
                 ev = pth_event(PTH_EVENT_FD|PTH_UNTIL_FD_WRITEABLE|PTH_MODE_STATIC, &ev_key, fd);
                 if (ev_extra != NULL)
                     pth_event_concat(ev, ev_extra, NULL);
-                pth_wait(ev);
-                if (ev_extra != NULL) {
-                    pth_event_isolate(ev);
-                    if (pth_event_status(ev) != PTH_STATUS_OCCURRED) {
-                        pth_fdmode(fd, fdmode);
-                        return pth_error(-1, EINTR);
-                    }
+                if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0) {
+                    pth_fdmode(fd, fdmode);
+                    return pth_error(-1, err);
                 }
             }
 
@@ -1469,6 +1881,12 @@ ssize_t pth_sendto_ev(int fd, const void *buf, size_t nbytes, int flags, const s
             if (s > 0)
                 rv += s;
 
+            /* wait if the direct attempt would have blocked */
+            if (s < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                n = 0;
+                continue;
+            }
+
             /* although we're physically now in non-blocking mode,
                iterate unless all data is written or an error occurs, because
                we've to mimic the usual blocking I/O behaviour of write(2). */
@@ -1500,3 +1918,384 @@ ssize_t pth_sendto_ev(int fd, const void *buf, size_t nbytes, int flags, const s
     return rv;
 }
 
+
+/* the kinds of zero-copy transfers handled by pth_high_xfer() */
+#define PTH_HIGH_XFER_SENDFILE 1
+#define PTH_HIGH_XFER_SPLICE   2
+#define PTH_HIGH_XFER_TEE      3
+
+/* common driver for the zero-copy transfer functions: both
+   filedescriptors are forced into non-blocking mode and the thread is
+   parked on EAGAIN. As long as nothing was transferred it waits for
+   whichever side is not ready; afterwards it only waits for the output
+   (mimicking the blocking write(2) behaviour) and stops as soon as the
+   input runs dry (mimicking the blocking read(2) behaviour). */
+static ssize_t pth_high_xfer(int op, int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+                             size_t len, unsigned int flags, pth_event_t ev_extra)
+{
+    pth_event_t ev;
+    static pth_key_t ev_key = PTH_KEY_INIT;
+    int fdmode_in, fdmode_out;
+    off_t sf_off;
+#if defined(HAVE_SPLICE)
+    loff_t sp_in, sp_out;
+#endif
+    ssize_t rv;
+    ssize_t s;
+    int goal;
+    int fd;
+    int n;
+    int err;
+
+    /* POSIX compliance */
+    if (len == 0)
+        return 0;
+    if (!pth_util_fd_valid(fd_in) || !pth_util_fd_valid(fd_out))
+        return pth_error(-1, EBADF);
+
+    /* keep the order with data collected on a corked filedescriptor */
+    if (pth_cork_pending > 0 && !pth_cork_sync(fd_out, ev_extra))
+        return -1;
+
+    /* force filedescriptors into non-blocking mode */
+    if ((fdmode_out = pth_fdmode(fd_out, PTH_FDMODE_NONBLOCK)) == PTH_FDMODE_ERROR)
+        return pth_error(-1, EBADF);
+    if ((fdmode_in = pth_fdmode(fd_in, PTH_FDMODE_NONBLOCK)) == PTH_FDMODE_ERROR) {
+        pth_shield { pth_fdmode(fd_out, fdmode_out); }
+        return pth_error(-1, EBADF);
+    }
+
+    sf_off = (off_in != NULL ? *off_in : 0);
+#if defined(HAVE_SPLICE)
+    sp_in  = (off_in  != NULL ? (loff_t)*off_in  : 0);
+    sp_out = (off_out != NULL ? (loff_t)*off_out : 0);
+#endif
+    rv = 0;
+    for (;;) {
+        /* perform the actual transfer operation */
+        switch (op) {
+#if defined(HAVE_SYS_SENDFILE_H)
+            case PTH_HIGH_XFER_SENDFILE:
+                s = sendfile(fd_out, fd_in, off_in != NULL ? &sf_off : NULL, len);
+                break;
+#endif
+#if defined(HAVE_SPLICE)
+            case PTH_HIGH_XFER_SPLICE:
+                s = splice(fd_in, off_in != NULL ? &sp_in : NULL,
+                           fd_out, off_out != NULL ? &sp_out : NULL,
+                           len, flags|SPLICE_F_NONBLOCK);
+                break;
+#endif
+#if defined(HAVE_TEE)
+            case PTH_HIGH_XFER_TEE:
+                s = tee(fd_in, fd_out, len, flags|SPLICE_F_NONBLOCK);
+                break;
+#endif
+            default:
+                s = -1;
+                errno = ENOSYS;
+                break;
+        }
+        if (s < 0 && errno == EINTR)
+            continue;
+
+        /* iterate on partial transfers, except for tee(2) which does not
+           consume its input and hence would duplicate the same data again */
+        if (s > 0) {
+            rv += s;
+            len -= (size_t)s;
+            if (len == 0 || op == PTH_HIGH_XFER_TEE || fdmode_out == PTH_FDMODE_NONBLOCK)
+                break;
+            continue;
+        }
+
+        /* end of input reached */
+        if (s == 0)
+            break;
+
+        /* pass error to caller, but not for partial transfers (rv > 0) */
+        if (errno != EAGAIN || fdmode_out == PTH_FDMODE_NONBLOCK) {
+            if (rv == 0)
+                rv = -1;
+            break;
+        }
+
+        /* determine the side which is not ready by directly
+           polling the input filedescriptor for readability */
+        n = pth_util_fd_poll(fd_in, POLLIN);
+        if (n == 0) {
+            if (rv > 0)
+                break;
+            fd   = fd_in;
+            goal = PTH_UNTIL_FD_READABLE;
+        }
+        else {
+            fd   = fd_out;
+            goal = PTH_UNTIL_FD_WRITEABLE;
+        }
+
+        /* let thread sleep until the side is ready or the extra event occurs */
+        ev = pth_event(PTH_EVENT_FD|goal|PTH_MODE_STATIC, &ev_key, fd);
+        if (ev_extra != NULL)
+            pth_event_concat(ev, ev_extra, NULL);
+        if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0) {
+            if (rv == 0)
+                rv = pth_error(-1, err);
+            break;
+        }
+    }
+
+    /* restore filedescriptor modes and pass back the updated offsets */
+    pth_shield {
+        pth_fdmode(fd_in, fdmode_in);
+        pth_fdmode(fd_out, fdmode_out);
+        if (op == PTH_HIGH_XFER_SENDFILE && off_in != NULL)
+            *off_in = sf_off;
+#if defined(HAVE_SPLICE)
+        if (op == PTH_HIGH_XFER_SPLICE && off_in != NULL)
+            *off_in = (off_t)sp_in;
+        if (op == PTH_HIGH_XFER_SPLICE && off_out != NULL)
+            *off_out = (off_t)sp_out;
+#endif
+    }
+    return rv;
+}
+
+/* Pth variant of sendfile(2) */
+ssize_t pth_sendfile(int out_fd, int in_fd, off_t *offset, size_t count)
+{
+    return pth_sendfile_ev(out_fd, in_fd, offset, count, NULL);
+}
+
+/* Pth variant of sendfile(2) with extra event(s) */
+ssize_t pth_sendfile_ev(int out_fd, int in_fd, off_t *offset, size_t count, pth_event_t ev_extra)
+{
+    ssize_t rv;
+
+    pth_implicit_init();
+    pth_debug2("pth_sendfile_ev: enter from thread \"%s\"", pth_current->name);
+    rv = pth_high_xfer(PTH_HIGH_XFER_SENDFILE, in_fd, offset, out_fd, NULL,
+                       count, 0, ev_extra);
+    pth_debug2("pth_sendfile_ev: leave to thread \"%s\"", pth_current->name);
+    return rv;
+}
+
+/* Pth variant of splice(2) */
+ssize_t pth_splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len, unsigned int flags)
+{
+    return pth_splice_ev(fd_in, off_in, fd_out, off_out, len, flags, NULL);
+}
+
+/* Pth variant of splice(2) with extra event(s) */
+ssize_t pth_splice_ev(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len,
+                      unsigned int flags, pth_event_t ev_extra)
+{
+    ssize_t rv;
+
+    pth_implicit_init();
+    pth_debug2("pth_splice_ev: enter from thread \"%s\"", pth_current->name);
+    rv = pth_high_xfer(PTH_HIGH_XFER_SPLICE, fd_in, off_in, fd_out, off_out,
+                       len, flags, ev_extra);
+    pth_debug2("pth_splice_ev: leave to thread \"%s\"", pth_current->name);
+    return rv;
+}
+
+/* Pth variant of tee(2) */
+ssize_t pth_tee(int fd_in, int fd_out, size_t len, unsigned int flags)
+{
+    return pth_tee_ev(fd_in, fd_out, len, flags, NULL);
+}
+
+/* Pth variant of tee(2) with extra event(s) */
+ssize_t pth_tee_ev(int fd_in, int fd_out, size_t len, unsigned int flags, pth_event_t ev_extra)
+{
+    ssize_t rv;
+
+    pth_implicit_init();
+    pth_debug2("pth_tee_ev: enter from thread \"%s\"", pth_current->name);
+    rv = pth_high_xfer(PTH_HIGH_XFER_TEE, fd_in, NULL, fd_out, NULL,
+                       len, flags, ev_extra);
+    pth_debug2("pth_tee_ev: leave to thread \"%s\"", pth_current->name);
+    return rv;
+}
+
+/* Pth variant of recvmmsg(2) */
+int pth_recvmmsg(int fd, struct mmsghdr *vec, unsigned int vlen, int flags)
+{
+    return pth_recvmmsg_ev(fd, vec, vlen, flags, NULL);
+}
+
+/* Pth variant of recvmmsg(2) with extra event(s) */
+int pth_recvmmsg_ev(int fd, struct mmsghdr *vec, unsigned int vlen, int flags, pth_event_t ev_extra)
+{
+#if defined(HAVE_RECVMMSG)
+    pth_event_t ev;
+    static pth_key_t ev_key = PTH_KEY_INIT;
+    int fdmode;
+    int n;
+    int err;
+
+    pth_implicit_init();
+    pth_debug2("pth_recvmmsg_ev: enter from thread \"%s\"", pth_current->name);
+
+    /* POSIX compliance */
+    if (vlen == 0)
+        return 0;
+    if (!pth_util_fd_valid(fd))
+        return pth_error(-1, EBADF);
+
+    /* check mode of filedescriptor */
+    if ((fdmode = pth_fdmode(fd, PTH_FDMODE_POLL)) == PTH_FDMODE_ERROR)
+        return pth_error(-1, EBADF);
+
+    /* under load datagrams are usually already queued, so instead of
+       polling for readability first, directly try to receive a whole
+       batch and only let the thread sleep if nothing is available */
+    for (;;) {
+        while ((n = recvmmsg(fd, vec, vlen, flags|MSG_DONTWAIT, NULL)) < 0
+               && errno == EINTR) ;
+        if (n >= 0 || errno != EAGAIN || fdmode != PTH_FDMODE_BLOCK)
+            break;
+        ev = pth_event(PTH_EVENT_FD|PTH_UNTIL_FD_READABLE|PTH_MODE_STATIC, &ev_key, fd);
+        if (ev_extra != NULL)
+            pth_event_concat(ev, ev_extra, NULL);
+        if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0)
+            return pth_error(-1, err);
+    }
+
+    pth_debug2("pth_recvmmsg_ev: leave to thread \"%s\"", pth_current->name);
+    return n;
+#else
+    (void)fd; (void)vec; (void)vlen; (void)flags; (void)ev_extra;
+    return pth_error(-1, ENOSYS);
+#endif
+}
+
+/* Pth variant of sendmmsg(2) */
+int pth_sendmmsg(int fd, struct mmsghdr *vec, unsigned int vlen, int flags)
+{
+    return pth_sendmmsg_ev(fd, vec, vlen, flags, NULL);
+}
+
+/* Pth variant of sendmmsg(2) with extra event(s) */
+int pth_sendmmsg_ev(int fd, struct mmsghdr *vec, unsigned int vlen, int flags, pth_event_t ev_extra)
+{
+#if defined(HAVE_SENDMMSG)
+    pth_event_t ev;
+    static pth_key_t ev_key = PTH_KEY_INIT;
+    int fdmode;
+    int rv;
+    int n;
+    int err;
+
+    pth_implicit_init();
+    pth_debug2("pth_sendmmsg_ev: enter from thread \"%s\"", pth_current->name);
+
+    /* POSIX compliance */
+    if (vlen == 0)
+        return 0;
+    if (!pth_util_fd_valid(fd))
+        return pth_error(-1, EBADF);
+
+    /* keep the order with data collected on a corked filedescriptor */
+    if (pth_cork_pending > 0 && !pth_cork_sync(fd, ev_extra))
+        return -1;
+
+    /* check mode of filedescriptor */
+    if ((fdmode = pth_fdmode(fd, PTH_FDMODE_POLL)) == PTH_FDMODE_ERROR)
+        return pth_error(-1, EBADF);
+
+    rv = 0;
+    for (;;) {
+        /* directly try to send the remaining batch */
+        while ((n = sendmmsg(fd, vec, vlen, flags|MSG_DONTWAIT)) < 0
+               && errno == EINTR) ;
+        if (n > 0)
+            rv += n;
+
+        /* iterate unless all messages are sent or an error occurs,
+           because we've to mimic the usual blocking I/O behaviour */
+        if (n > 0 && (unsigned int)n < vlen && fdmode == PTH_FDMODE_BLOCK) {
+            vec  += n;
+            vlen -= (unsigned int)n;
+            continue;
+        }
+        if (n >= 0 || errno != EAGAIN || fdmode != PTH_FDMODE_BLOCK)
+            break;
+
+        /* let thread sleep until the socket is writeable or the extra event occurs */
+        ev = pth_event(PTH_EVENT_FD|PTH_UNTIL_FD_WRITEABLE|PTH_MODE_STATIC, &ev_key, fd);
+        if (ev_extra != NULL)
+            pth_event_concat(ev, ev_extra, NULL);
+        if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0) {
+            if (rv == 0)
+                rv = pth_error(-1, err);
+            return rv;
+        }
+    }
+
+    /* pass error to caller, but not for partial batches (rv > 0) */
+    if (n < 0 && rv == 0)
+        rv = -1;
+
+    pth_debug2("pth_sendmmsg_ev: leave to thread \"%s\"", pth_current->name);
+    return rv;
+#else
+    (void)fd; (void)vec; (void)vlen; (void)flags; (void)ev_extra;
+    return pth_error(-1, ENOSYS);
+#endif
+}
+
+/* enable UDP generic segmentation offload: every datagram sent on the
+   socket is split by the kernel into segments of the given size */
+int pth_udp_segment(int fd, int size)
+{
+#if defined(UDP_SEGMENT)
+    if (size < 0 || size > 65535)
+        return pth_error(FALSE, EINVAL);
+    if (setsockopt(fd, SOL_UDP, UDP_SEGMENT, &size, sizeof(size)) < 0)
+        return FALSE;
+    return TRUE;
+#else
+    (void)fd; (void)size;
+    return pth_error(FALSE, ENOPROTOOPT);
+#endif
+}
+
+/* enable UDP generic receive offload: consecutive datagrams of a
+   flow may be delivered to the socket as one coalesced buffer */
+int pth_udp_gro(int fd, int enable)
+{
+#if defined(UDP_GRO)
+    enable = (enable ? 1 : 0);
+    if (setsockopt(fd, SOL_UDP, UDP_GRO, &enable, sizeof(enable)) < 0)
+        return FALSE;
+    return TRUE;
+#else
+    (void)fd; (void)enable;
+    return pth_error(FALSE, ENOPROTOOPT);
+#endif
+}
+
+/* determine the segment size of a received coalesced buffer
+   (or 0 if the message carries a single datagram only) */
+int pth_udp_gro_size(const struct msghdr *msg)
+{
+#if defined(UDP_GRO)
+    struct cmsghdr *cmsg;
+    int size;
+
+    if (msg == NULL || msg->msg_controllen == 0)
+        return 0;
+    for (cmsg = CMSG_FIRSTHDR((struct msghdr *)msg); cmsg != NULL;
+         cmsg = CMSG_NXTHDR((struct msghdr *)msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+            memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+            return size;
+        }
+    }
+#else
+    (void)msg;
+#endif
+    return 0;
+}
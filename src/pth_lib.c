@@ -146,7 +146,12 @@ int pth_kill(void)
     }
     pth_debug1("pth_kill: enter");
     pth_thread_cleanup(pth_main);
+    pth_cork_kill();
     pth_scheduler_kill();
+    pth_fdstate_kill();
+    pth_zerocopy_kill();
+    pth_pool_kill();
+    pth_fsync_kill();
     pth_initialized = FALSE;
     pth_tcb_free(pth_sched);
     pth_tcb_free(pth_main);
@@ -201,6 +206,35 @@ long pth_ctrl(unsigned long query, ...)
         int favournew = va_arg(ap, int);
         pth_favournew = (favournew ? 1 : 0);
     }
+    else if (query & PTH_CTRL_GETTIMERWAKEUPS) {
+        rc = (long)pth_timer_wakeups;
+    }
+    else if (query & PTH_CTRL_GETTIMERCOALESCED) {
+        rc = (long)pth_timer_coalesced;
+    }
+    else if (query & (PTH_CTRL_GETOFFLOADQUEUE|PTH_CTRL_GETOFFLOADJOBS|PTH_CTRL_GETOFFLOADLATENCY)) {
+        rc = pth_offload_stat((int)(query & (PTH_CTRL_GETOFFLOADQUEUE|
+                                             PTH_CTRL_GETOFFLOADJOBS|
+                                             PTH_CTRL_GETOFFLOADLATENCY)));
+    }
+    else if (query & (PTH_CTRL_GETFSYNCS|PTH_CTRL_GETFSYNCREQUESTS|PTH_CTRL_GETFSYNCLATENCY)) {
+        rc = pth_fsync_stat((int)(query & (PTH_CTRL_GETFSYNCS|
+                                           PTH_CTRL_GETFSYNCREQUESTS|
+                                           PTH_CTRL_GETFSYNCLATENCY)));
+    }
+    else if (query & (PTH_CTRL_GETMUTEXCONTENDED|PTH_CTRL_GETMUTEXHANDOFFS|PTH_CTRL_GETMUTEXWAITTIME)) {
+        rc = pth_mutex_stat((int)(query & (PTH_CTRL_GETMUTEXCONTENDED|
+                                           PTH_CTRL_GETMUTEXHANDOFFS|
+                                           PTH_CTRL_GETMUTEXWAITTIME)));
+    }
+    else if (query & PTH_CTRL_IOURING) {
+        int enable = va_arg(ap, int);
+        if (enable)
+            pth_uring_init();
+        else
+            pth_uring_kill();
+        rc = (pth_uring_active() ? 1 : 0);
+    }
     else
         rc = -1;
     va_end(ap);
@@ -253,6 +287,7 @@ pth_t pth_spawn(pth_attr_t attr, void *(*func)(void *), void *arg)
         t->joinable    = attr->a_joinable;
         t->cancelstate = attr->a_cancelstate;
         t->dispatches  = attr->a_dispatches;
+        t->timerslack  = attr->a_timerslack;
         pth_util_cpystrn(t->name, attr->a_name, PTH_TCB_NAMELEN);
     }
     else if (pth_current != NULL) {
@@ -261,6 +296,7 @@ pth_t pth_spawn(pth_attr_t attr, void *(*func)(void *), void *arg)
         t->joinable    = pth_current->joinable;
         t->cancelstate = pth_current->cancelstate;
         t->dispatches  = 0;
+        t->timerslack  = pth_current->timerslack;
         pth_snprintf(t->name, PTH_TCB_NAMELEN, "%s.child@%d=0x%lx",
                      pth_current->name, (unsigned int)time(NULL),
                      (unsigned long)pth_current);
@@ -271,6 +307,7 @@ pth_t pth_spawn(pth_attr_t attr, void *(*func)(void *), void *arg)
         t->joinable    = TRUE;
         t->cancelstate = PTH_CANCEL_DEFAULT;
         t->dispatches  = 0;
+        t->timerslack  = 0;
         pth_snprintf(t->name, PTH_TCB_NAMELEN,
                      "user/%x", (unsigned int)time(NULL));
     }
@@ -284,6 +321,12 @@ pth_t pth_spawn(pth_attr_t attr, void *(*func)(void *), void *arg)
     /* initialize events */
     t->events = NULL;
 
+    /* initialize deadlines */
+    t->deadline    = NULL;
+    t->deadlines   = NULL;
+    t->deadlinecnt = 0;
+    t->deadlinemax = 0;
+
     /* clear raised signals */
     sigemptyset(&t->sigpending);
     t->sigpendcnt = 0;
@@ -305,6 +348,21 @@ pth_t pth_spawn(pth_attr_t attr, void *(*func)(void *), void *arg)
 
     /* initialize mutex stuff */
     pth_ring_init(&t->mutexring);
+    t->prioinherit = PTH_PRIO_MIN;
+    t->mutexwait   = NULL;
+
+    /* a time budget given as attribute starts now */
+    if (attr != PTH_ATTR_DEFAULT
+        && (attr->a_deadline.tv_sec > 0 || attr->a_deadline.tv_usec > 0)) {
+        struct timespec until, rel;
+        pth_timens_from_time(&rel, &attr->a_deadline);
+        pth_timens_now(&until);
+        pth_timens_add(&until, &rel);
+        if (!pth_deadline_set(t, &until)) {
+            pth_shield { pth_tcb_free(t); }
+            return pth_error((pth_t)NULL, errno);
+        }
+    }
 
 #ifdef PTH_EX
     /* initialize exception handling context */
@@ -428,6 +486,9 @@ void pth_exit(void *value)
 
     pth_debug2("pth_exit: marking thread \"%s\" as dead", pth_current->name);
 
+    /* the deadlines end with the thread */
+    pth_deadline_clear(pth_current);
+
     /* the main thread is special, because its termination
        would terminate the whole process, so we have to delay 
        its termination until it is really the last thread */
@@ -442,6 +503,10 @@ void pth_exit(void *value)
     /* execute cleanups */
     pth_thread_cleanup(pth_current);
 
+    /* write out data collected on corked filedescriptors */
+    if (pth_cork_pending > 0)
+        pth_cork_flushall(pth_current);
+
     if (pth_current != pth_main) {
         /*
          * Now mark the current thread as dead, explicitly switch into the
@@ -484,7 +549,8 @@ int pth_join(pth_t tid, void **value)
         tid = pth_pqueue_head(&pth_DQ);
     if (tid == NULL || (tid != NULL && tid->state != PTH_STATE_DEAD)) {
         ev = pth_event(PTH_EVENT_TID|PTH_UNTIL_TID_DEAD|PTH_MODE_STATIC, &ev_key, tid);
-        pth_wait(ev);
+        if (pth_wait(ev) < 0)
+            return pth_error(FALSE, ETIMEDOUT);
     }
     if (tid == NULL)
         tid = pth_pqueue_head(&pth_DQ);
@@ -519,6 +585,11 @@ int pth_yield(pth_t to)
     if (to != NULL && q != NULL)
         pth_pqueue_favorite(q, to);
 
+    /* write out data collected on corked filedescriptors
+       (pth_wait did this already before the thread started waiting) */
+    if (pth_cork_pending > 0 && pth_current->state != PTH_STATE_WAITING)
+        pth_cork_flushall(pth_current);
+
     /* switch to scheduler */
     if (to != NULL) {
         pth_debug2("pth_yield: give up control to scheduler "
@@ -582,12 +653,118 @@ int pth_resume(pth_t t)
     return TRUE;
 }
 
+/* state of filedescriptors created by Pth itself (see pth_accept_many):
+   they stay in non-blocking mode in the kernel all the time, so their
+   (logical) I/O mode is only tracked here and never has to be probed */
+static unsigned char *pth_fdstate      = NULL;
+static int            pth_fdstate_size = 0;
+
+#define PTH_FDSTATE_OWNED    (1<<0) /* non-blocking mode owned by Pth */
+#define PTH_FDSTATE_NONBLOCK (1<<1) /* logical non-blocking mode      */
+
+/* take over a filedescriptor which is in non-blocking mode in the kernel */
+int pth_fdstate_own(int fd, int fdmode)
+{
+    unsigned char *state;
+    int size;
+
+    if (fd < 0)
+        return pth_error(FALSE, EBADF);
+    if (fd >= pth_fdstate_size) {
+        size = (pth_fdstate_size == 0 ? 64 : pth_fdstate_size);
+        while (size <= fd)
+            size *= 2;
+        if ((state = (unsigned char *)realloc(pth_fdstate, (size_t)size)) == NULL)
+            return pth_error(FALSE, ENOMEM);
+        memset(state + pth_fdstate_size, 0, (size_t)(size - pth_fdstate_size));
+        pth_fdstate      = state;
+        pth_fdstate_size = size;
+    }
+    pth_fdstate[fd] = PTH_FDSTATE_OWNED;
+    if (fdmode == PTH_FDMODE_NONBLOCK)
+        pth_fdstate[fd] |= PTH_FDSTATE_NONBLOCK;
+    return TRUE;
+}
+
+/* check whether a filedescriptor is owned by Pth */
+int pth_fdstate_owned(int fd)
+{
+    return (fd >= 0 && fd < pth_fdstate_size && (pth_fdstate[fd] & PTH_FDSTATE_OWNED));
+}
+
+/* check whether a failed direct attempt on an owned filedescriptor revealed
+   that its number was reused behind our back for something which is not even
+   a socket (closed with close(2) instead of pth_close()), and forget it then */
+int pth_fdstate_stale(int fd)
+{
+    if (errno != ENOTSOCK)
+        return FALSE;
+    pth_fdstate_release(fd);
+    return TRUE;
+}
+
+/* forget about an owned filedescriptor */
+void pth_fdstate_release(int fd)
+{
+    if (fd >= 0 && fd < pth_fdstate_size)
+        pth_fdstate[fd] = 0;
+    return;
+}
+
+/* hand all owned filedescriptors back in their logical mode */
+void pth_fdstate_kill(void)
+{
+    int fd;
+
+    for (fd = 0; fd < pth_fdstate_size; fd++) {
+        if (   (pth_fdstate[fd] & PTH_FDSTATE_OWNED)
+            && !(pth_fdstate[fd] & PTH_FDSTATE_NONBLOCK)) {
+            pth_fdstate[fd] = 0;
+            pth_fdmode(fd, PTH_FDMODE_BLOCK);
+        }
+    }
+    if (pth_fdstate != NULL)
+        free(pth_fdstate);
+    pth_fdstate      = NULL;
+    pth_fdstate_size = 0;
+    return;
+}
+
+/* close a filedescriptor and forget its state */
+int pth_close(int fd)
+{
+    int rc;
+
+    /* pending data is written out first, but the
+       filedescriptor is closed even if this fails */
+    rc = pth_cork_release(fd);
+    pth_fdstate_release(fd);
+    pth_zerocopy_release(fd);
+    pth_fsync_release(fd);
+    if (!rc) {
+        pth_shield { pth_sc(close)(fd); }
+        return -1;
+    }
+    return pth_sc(close)(fd);
+}
+
 /* switch a filedescriptor's I/O mode */
 int pth_fdmode(int fd, int newmode)
 {
     int fdmode;
     int oldmode;
 
+    /* owned filedescriptors only switch their logical mode */
+    if (pth_fdstate_owned(fd)) {
+        oldmode = (pth_fdstate[fd] & PTH_FDSTATE_NONBLOCK ?
+                   PTH_FDMODE_NONBLOCK : PTH_FDMODE_BLOCK);
+        if (newmode == PTH_FDMODE_NONBLOCK)
+            pth_fdstate[fd] |= PTH_FDSTATE_NONBLOCK;
+        else if (newmode == PTH_FDMODE_BLOCK)
+            pth_fdstate[fd] &= ~(PTH_FDSTATE_NONBLOCK);
+        return oldmode;
+    }
+
     /* retrieve old mode (usually a very cheap operation) */
     if ((fdmode = fcntl(fd, F_GETFL, NULL)) == -1)
         oldmode = PTH_FDMODE_ERROR;
@@ -618,7 +795,8 @@ int pth_nap(pth_time_t naptime)
     pth_time_set(&until, PTH_TIME_NOW);
     pth_time_add(&until, &naptime);
     ev = pth_event(PTH_EVENT_TIME|PTH_MODE_STATIC, &ev_key, until);
-    pth_wait(ev);
+    if (pth_wait(ev) < 0)
+        return pth_error(FALSE, ETIMEDOUT);
     return TRUE;
 }
 
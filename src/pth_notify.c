@@ -0,0 +1,162 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  This file is part of GNU Pth, a non-preemptive thread scheduling
+**  library which can be found at http://www.gnu.org/software/pth/.
+**
+**  This library is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU Lesser General Public
+**  License as published by the Free Software Foundation; either
+**  version 2.1 of the License, or (at your option) any later version.
+**
+**  This library is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**  Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public
+**  License along with this library; if not, write to the Free Software
+**  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+**  USA, or contact Ralf S. Engelschall <rse@engelschall.com>.
+**
+**  pth_notify.c: Pth notification objects
+*/
+                             /* ``A ringing bell
+                                  is heard by everyone.''
+                                                 -- Unknown */
+#include "pth_p.h"
+
+#if cpp
+
+/* notification object structure */
+struct pth_notify_st {
+    int nt_rfd; /* read side (eventfd or pipe read end)   */
+    int nt_wfd; /* write side (eventfd or pipe write end) */
+};
+
+#endif /* cpp */
+
+/* create a new notification object */
+pth_notify_t pth_notify_create(void)
+{
+    pth_notify_t nt;
+
+    pth_implicit_init();
+
+    /* allocate notification structure */
+    if ((nt = (pth_notify_t)malloc(sizeof(struct pth_notify_st))) == NULL)
+        return pth_error((pth_notify_t)NULL, ENOMEM);
+
+    /* create the underlying kernel object */
+#ifdef HAVE_SYS_EVENTFD_H
+    if ((nt->nt_rfd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC)) == -1) {
+        pth_shield { free(nt); }
+        return NULL;
+    }
+    nt->nt_wfd = nt->nt_rfd;
+#else
+    {
+        int fds[2];
+        if (pipe(fds) == -1) {
+            pth_shield { free(nt); }
+            return NULL;
+        }
+        fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+        pth_fdmode(fds[0], PTH_FDMODE_NONBLOCK);
+        pth_fdmode(fds[1], PTH_FDMODE_NONBLOCK);
+        nt->nt_rfd = fds[0];
+        nt->nt_wfd = fds[1];
+    }
+#endif
+    return nt;
+}
+
+/* destroy a notification object */
+int pth_notify_destroy(pth_notify_t nt)
+{
+    if (nt == NULL)
+        return pth_error(FALSE, EINVAL);
+    close(nt->nt_rfd);
+    if (nt->nt_wfd != nt->nt_rfd)
+        close(nt->nt_wfd);
+    free(nt);
+    return TRUE;
+}
+
+/* raise a notification (safe from foreign OS threads and signal handlers) */
+int pth_notify_raise(pth_notify_t nt)
+{
+    int errno_saved;
+    ssize_t rc;
+
+    if (nt == NULL)
+        return pth_error(FALSE, EINVAL);
+
+    /* notice: only async-signal-safe operations are allowed here,
+       so we neither touch Pth internals nor leave errno modified */
+    errno_saved = errno;
+#ifdef HAVE_SYS_EVENTFD_H
+    {
+        uint64_t one = 1;
+        while ((rc = pth_sc(write)(nt->nt_wfd, &one, sizeof(one))) < 0
+               && errno == EINTR) ;
+    }
+#else
+    {
+        char c = 1;
+        while ((rc = pth_sc(write)(nt->nt_wfd, &c, sizeof(c))) < 0
+               && errno == EINTR) ;
+    }
+#endif
+    /* EAGAIN means the counter (or pipe) is already full of raises,
+       so the pending wakeup covers this raise, too */
+    if (rc < 0 && errno != EAGAIN) {
+        rc = errno;
+        errno = errno_saved;
+        return pth_error(FALSE, (int)rc);
+    }
+    errno = errno_saved;
+    return TRUE;
+}
+
+/* consume all pending raises (coalesced into a single result) */
+int pth_notify_drain(pth_notify_t nt)
+{
+    int raised = FALSE;
+#ifdef HAVE_SYS_EVENTFD_H
+    uint64_t cnt;
+    if (pth_sc(read)(nt->nt_rfd, &cnt, sizeof(cnt)) == sizeof(cnt))
+        raised = TRUE;
+#else
+    char buf[128];
+    while (pth_sc(read)(nt->nt_rfd, buf, sizeof(buf)) > 0)
+        raised = TRUE;
+#endif
+    return raised;
+}
+
+/* wait for a notification */
+int pth_notify_wait(pth_notify_t nt, pth_event_t ev_extra)
+{
+    static pth_key_t ev_key = PTH_KEY_INIT;
+    pth_event_t ev;
+    int err;
+
+    if (nt == NULL)
+        return pth_error(FALSE, EINVAL);
+
+    /* fast path: already raised */
+    if (pth_notify_drain(nt))
+        return TRUE;
+
+    /* else wait for the next raise */
+    if ((ev = pth_event(PTH_EVENT_NOTIFY|PTH_MODE_STATIC, &ev_key, nt)) == NULL)
+        return FALSE;
+    if (ev_extra != NULL)
+        pth_event_concat(ev, ev_extra, NULL);
+    if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0)
+        return pth_error(FALSE, err);
+    return TRUE;
+}
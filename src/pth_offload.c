@@ -0,0 +1,481 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  This file is part of GNU Pth, a non-preemptive thread scheduling
+**  library which can be found at http://www.gnu.org/software/pth/.
+**
+**  This library is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU Lesser General Public
+**  License as published by the Free Software Foundation; either
+**  version 2.1 of the License, or (at your option) any later version.
+**
+**  This library is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**  Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public
+**  License along with this library; if not, write to the Free Software
+**  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+**  USA, or contact Ralf S. Engelschall <rse@engelschall.com>.
+**
+**  pth_offload.c: Pth offloading of blocking calls to kernel threads
+*/
+                             /* ``If you can't beat them,
+                                  let somebody else wait for them.''
+                                                 -- Unknown */
+#include "pth_p.h"
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#if cpp
+
+/* internal event type: completion of an offloaded job */
+#define PTH_EVENT_OFFLOAD    _BIT(29)
+
+/* offloaded job */
+typedef struct pth_offload_job_st pth_offload_job_t;
+struct pth_offload_job_st {
+    pth_offload_job_t *oj_next;      /* queue or completion list link   */
+    void            *(*oj_func)(void *);
+    void              *oj_arg;
+    void              *oj_value;     /* return value of oj_func          */
+    pth_event_t        oj_ev;        /* event of the waiting thread      */
+    int                oj_done;      /* completion has been reaped       */
+    struct timespec    oj_submitted; /* submission time (for statistics) */
+};
+
+#endif /* cpp */
+
+#ifdef HAVE_PTHREAD_H
+
+/* bound of the job queue */
+#define PTH_OFFLOAD_QUEUE 1024
+
+/* idle kernel threads exit after this number of seconds */
+#define PTH_OFFLOAD_IDLE  10
+
+/* the pool of kernel threads */
+static struct {
+    int                initialized;
+    pthread_mutex_t    mutex;
+    pthread_cond_t     cond;      /* signals queued jobs to workers   */
+    pthread_cond_t     gone;      /* signals exiting workers          */
+    pth_offload_job_t *qhead;     /* queued jobs (FIFO)               */
+    pth_offload_job_t *qtail;
+    int                queued;
+    pth_offload_job_t *done;      /* completed but not yet reaped     */
+    int                workers;   /* running kernel threads           */
+    int                idle;      /* kernel threads waiting for jobs  */
+    int                maxworkers;
+    int                shutdown;
+    int                pending;   /* submitted but not yet reaped     */
+    pth_notify_t       nt;        /* completion signal to scheduler   */
+    unsigned long      jobs;      /* statistics: completed jobs       */
+    unsigned long      latency;   /* statistics: sum of latencies (us) */
+} pth_offload_pool;
+
+/* the body of a kernel thread of the pool */
+static void *pth_offload_worker(void *arg __attribute__((unused)))
+{
+    pth_offload_job_t *job;
+    struct timespec now, abstime;
+    long us;
+
+    pthread_mutex_lock(&pth_offload_pool.mutex);
+    for (;;) {
+        /* wait for a job, but give up when idle for too long */
+        while (pth_offload_pool.qhead == NULL && !pth_offload_pool.shutdown) {
+            clock_gettime(CLOCK_REALTIME, &abstime);
+            abstime.tv_sec += PTH_OFFLOAD_IDLE;
+            pth_offload_pool.idle++;
+            if (pthread_cond_timedwait(&pth_offload_pool.cond, &pth_offload_pool.mutex,
+                                       &abstime) == ETIMEDOUT
+                && pth_offload_pool.qhead == NULL) {
+                pth_offload_pool.idle--;
+                goto leave;
+            }
+            pth_offload_pool.idle--;
+        }
+        if (pth_offload_pool.qhead == NULL)
+            break;
+
+        /* dequeue and run the job */
+        job = pth_offload_pool.qhead;
+        pth_offload_pool.qhead = job->oj_next;
+        if (pth_offload_pool.qhead == NULL)
+            pth_offload_pool.qtail = NULL;
+        pth_offload_pool.queued--;
+        pthread_mutex_unlock(&pth_offload_pool.mutex);
+        job->oj_value = job->oj_func(job->oj_arg);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        us = (now.tv_sec  - job->oj_submitted.tv_sec) * 1000000L
+           + (now.tv_nsec - job->oj_submitted.tv_nsec) / 1000L;
+
+        /* hand it back to the scheduler */
+        pthread_mutex_lock(&pth_offload_pool.mutex);
+        job->oj_next = pth_offload_pool.done;
+        pth_offload_pool.done = job;
+        pth_offload_pool.jobs++;
+        pth_offload_pool.latency += (unsigned long)us;
+        pth_notify_raise(pth_offload_pool.nt);
+    }
+    leave:
+    pth_offload_pool.workers--;
+    pthread_cond_broadcast(&pth_offload_pool.gone);
+    pthread_mutex_unlock(&pth_offload_pool.mutex);
+    return NULL;
+}
+
+/* lazily initialize the pool */
+static int pth_offload_init(void)
+{
+    long ncpu;
+
+    if (pth_offload_pool.initialized)
+        return TRUE;
+    if ((pth_offload_pool.nt = pth_notify_create()) == NULL)
+        return FALSE;
+    pthread_mutex_init(&pth_offload_pool.mutex, NULL);
+    pthread_cond_init(&pth_offload_pool.cond, NULL);
+    pthread_cond_init(&pth_offload_pool.gone, NULL);
+    pth_offload_pool.qhead   = NULL;
+    pth_offload_pool.qtail   = NULL;
+    pth_offload_pool.queued  = 0;
+    pth_offload_pool.done    = NULL;
+    pth_offload_pool.workers = 0;
+    pth_offload_pool.idle    = 0;
+    pth_offload_pool.shutdown = FALSE;
+    pth_offload_pool.pending = 0;
+
+    /* the jobs mostly sleep in the kernel, so allow a few
+       more kernel threads than there are processors */
+    if ((ncpu = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+        ncpu = 1;
+    pth_offload_pool.maxworkers = (int)pth_util_min(ncpu * 2, 32);
+    if (pth_offload_pool.maxworkers < 4)
+        pth_offload_pool.maxworkers = 4;
+    pth_offload_pool.initialized = TRUE;
+    return TRUE;
+}
+
+/* the waiting thread was cancelled: the job result is discarded */
+static void pth_offload_orphan(void *arg)
+{
+    pth_offload_job_t *job = (pth_offload_job_t *)arg;
+    job->oj_ev = NULL;
+    return;
+}
+
+#endif /* HAVE_PTHREAD_H */
+
+/* run a blocking function on a kernel thread */
+int pth_offload(void *(*func)(void *), void *arg, void **value)
+{
+#ifdef HAVE_PTHREAD_H
+    static pth_key_t ev_key = PTH_KEY_INIT;
+    pth_offload_job_t *job;
+    pthread_attr_t attr;
+    pthread_t tid;
+    sigset_t ss, oss;
+    pth_event_t ev;
+    int rc;
+
+    pth_implicit_init();
+
+    if (func == NULL)
+        return pth_error(FALSE, EINVAL);
+    if (!pth_offload_init())
+        return FALSE;
+
+    /* create the job */
+    if ((job = (pth_offload_job_t *)malloc(sizeof(pth_offload_job_t))) == NULL)
+        return pth_error(FALSE, ENOMEM);
+    if ((ev = pth_event(PTH_EVENT_OFFLOAD|PTH_MODE_STATIC, &ev_key, job)) == NULL) {
+        pth_shield { free(job); }
+        return FALSE;
+    }
+    job->oj_next  = NULL;
+    job->oj_func  = func;
+    job->oj_arg   = arg;
+    job->oj_value = NULL;
+    job->oj_ev    = ev;
+    job->oj_done  = FALSE;
+    clock_gettime(CLOCK_MONOTONIC, &job->oj_submitted);
+
+    /* queue it and make sure a kernel thread picks it up */
+    pthread_mutex_lock(&pth_offload_pool.mutex);
+    if (pth_offload_pool.queued >= PTH_OFFLOAD_QUEUE) {
+        pthread_mutex_unlock(&pth_offload_pool.mutex);
+        free(job);
+        return pth_error(FALSE, EAGAIN);
+    }
+    if (pth_offload_pool.idle <= pth_offload_pool.queued
+        && pth_offload_pool.workers < pth_offload_pool.maxworkers) {
+        /* signals have to stay with the scheduler, so the
+           kernel thread starts with all of them blocked */
+        sigfillset(&ss);
+        pthread_sigmask(SIG_SETMASK, &ss, &oss);
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        rc = pthread_create(&tid, &attr, pth_offload_worker, NULL);
+        pthread_attr_destroy(&attr);
+        pthread_sigmask(SIG_SETMASK, &oss, NULL);
+        if (rc == 0)
+            pth_offload_pool.workers++;
+        else if (pth_offload_pool.workers == 0) {
+            pthread_mutex_unlock(&pth_offload_pool.mutex);
+            free(job);
+            return pth_error(FALSE, rc);
+        }
+    }
+    if (pth_offload_pool.qtail == NULL)
+        pth_offload_pool.qhead = job;
+    else
+        pth_offload_pool.qtail->oj_next = job;
+    pth_offload_pool.qtail = job;
+    pth_offload_pool.queued++;
+    pthread_cond_signal(&pth_offload_pool.cond);
+    pthread_mutex_unlock(&pth_offload_pool.mutex);
+    pth_offload_pool.pending++;
+
+    /* wait for the completion (on cancellation or when the deadline
+       of the thread passes the job keeps running, but its result is
+       discarded by the scheduler) */
+    pth_cleanup_push(pth_offload_orphan, job);
+    while (!job->oj_done) {
+        if (pth_wait(ev) < 0 && !job->oj_done) {
+            pth_cleanup_pop(TRUE);
+            return pth_error(FALSE, ETIMEDOUT);
+        }
+    }
+    pth_cleanup_pop(FALSE);
+
+    if (value != NULL)
+        *value = job->oj_value;
+    free(job);
+    return TRUE;
+#else
+    /* no kernel threads available, so block the process */
+    if (func == NULL)
+        return pth_error(FALSE, EINVAL);
+    if (value != NULL)
+        *value = func(arg);
+    else
+        func(arg);
+    return TRUE;
+#endif
+}
+
+/* a range of pages to fault in on a kernel thread */
+typedef struct {
+    const volatile char *mt_addr;
+    size_t               mt_len;
+    size_t               mt_page;
+} pth_mmap_touch_t;
+
+/* fault in the pages of a range (runs on a kernel thread
+   and owns its argument, as the caller might be gone already) */
+static void *pth_mmap_touch(void *arg)
+{
+    pth_mmap_touch_t *mt = (pth_mmap_touch_t *)arg;
+    size_t off;
+
+    for (off = 0; off < mt->mt_len; off += mt->mt_page)
+        (void)mt->mt_addr[off];
+    return NULL;
+}
+
+/* make sure the pages of a memory-mapped range are resident */
+int pth_mmap_prefetch(const void *addr, size_t len)
+{
+    pth_mmap_touch_t mt;
+    uintptr_t start, end, cold, last;
+    size_t page;
+    int cancelstate;
+    int deadlinecnt;
+    int rc;
+#ifdef HAVE_MINCORE
+    unsigned char vec[256];
+    uintptr_t chunk;
+    size_t n, i;
+#endif
+
+    pth_implicit_init();
+    if (addr == NULL)
+        return pth_error(FALSE, EINVAL);
+    if (len == 0)
+        return TRUE;
+
+    /* determine the pages covering the range */
+    page  = (size_t)sysconf(_SC_PAGESIZE);
+    start = (uintptr_t)addr & ~(uintptr_t)(page - 1);
+    end   = ((uintptr_t)addr + len + page - 1) & ~(uintptr_t)(page - 1);
+
+    /* find the first and last page which is not resident,
+       so hot ranges cost nothing more than the residency check */
+    cold = start;
+    last = end;
+#ifdef HAVE_MINCORE
+    cold = end;
+    last = start;
+    for (chunk = start; chunk < end; chunk += n * page) {
+        n = pth_util_min((end - chunk) / page, sizeof(vec));
+        if (mincore((void *)chunk, n * page, vec) < 0)
+            return pth_error(FALSE, errno);
+        for (i = 0; i < n; i++) {
+            if (vec[i] & 1)
+                continue;
+            if (cold == end)
+                cold = chunk + i * page;
+            last = chunk + (i + 1) * page;
+        }
+    }
+    if (cold == end)
+        return TRUE;
+#endif
+
+    /* let the kernel start reading ahead and fault
+       the pages in without stalling the other threads */
+#ifdef MADV_WILLNEED
+    madvise((void *)cold, last - cold, MADV_WILLNEED);
+#endif
+    mt.mt_addr = (const volatile char *)cold;
+    mt.mt_len  = last - cold;
+    mt.mt_page = page;
+
+    /* wait for the job regardless of cancellation requests and the
+       deadline of the thread, as the caller may unmap the range as
+       soon as we return while a kernel thread still touches it */
+    pth_cancel_state(PTH_CANCEL_DISABLE, &cancelstate);
+    deadlinecnt = pth_current->deadlinecnt;
+    pth_current->deadlinecnt = 0;
+    rc = pth_offload(pth_mmap_touch, &mt, NULL);
+    pth_shield {
+        pth_current->deadlinecnt = deadlinecnt;
+        pth_cancel_state(cancelstate, NULL);
+    }
+    return rc;
+}
+
+/* return the filedescriptor the scheduler has to watch
+   for completed jobs (or -1 if no job is outstanding) */
+int pth_offload_pollfd(void)
+{
+#ifdef HAVE_PTHREAD_H
+    if (!pth_offload_pool.initialized || pth_offload_pool.pending == 0)
+        return -1;
+    return pth_offload_pool.nt->nt_rfd;
+#else
+    return -1;
+#endif
+}
+
+/* take over all completed jobs and wake up their threads */
+int pth_offload_reap(void)
+{
+#ifdef HAVE_PTHREAD_H
+    pth_offload_job_t *job, *next;
+    int n;
+
+    if (!pth_offload_pool.initialized || pth_offload_pool.pending == 0)
+        return 0;
+    /* drain the notification together with the jobs it stands for, else
+       a notification raised just after draining would announce jobs which
+       are already taken over and later wake up the scheduler for nothing */
+    pthread_mutex_lock(&pth_offload_pool.mutex);
+    pth_notify_drain(pth_offload_pool.nt);
+    job = pth_offload_pool.done;
+    pth_offload_pool.done = NULL;
+    pthread_mutex_unlock(&pth_offload_pool.mutex);
+    for (n = 0; job != NULL; job = next, n++) {
+        next = job->oj_next;
+        pth_offload_pool.pending--;
+        if (job->oj_ev == NULL) {
+            /* waiting thread is gone */
+            free(job);
+            continue;
+        }
+        job->oj_done = TRUE;
+        job->oj_ev->ev_status = PTH_STATUS_OCCURRED;
+    }
+    return n;
+#else
+    return 0;
+#endif
+}
+
+/* query the pool statistics */
+long pth_offload_stat(int which)
+{
+#ifdef HAVE_PTHREAD_H
+    long rc = 0;
+
+    if (!pth_offload_pool.initialized)
+        return 0;
+    pthread_mutex_lock(&pth_offload_pool.mutex);
+    if (which == PTH_CTRL_GETOFFLOADQUEUE)
+        rc = (long)pth_offload_pool.queued;
+    else if (which == PTH_CTRL_GETOFFLOADJOBS)
+        rc = (long)pth_offload_pool.jobs;
+    else if (which == PTH_CTRL_GETOFFLOADLATENCY)
+        rc = (long)pth_offload_pool.latency;
+    pthread_mutex_unlock(&pth_offload_pool.mutex);
+    return rc;
+#else
+    (void)which;
+    return 0;
+#endif
+}
+
+/* shut down the pool (waiting for the running jobs) */
+void pth_offload_kill(void)
+{
+#ifdef HAVE_PTHREAD_H
+    pth_offload_job_t *job;
+
+    if (!pth_offload_pool.initialized)
+        return;
+    pthread_mutex_lock(&pth_offload_pool.mutex);
+    pth_offload_pool.shutdown = TRUE;
+    while ((job = pth_offload_pool.qhead) != NULL) {
+        pth_offload_pool.qhead = job->oj_next;
+        free(job);
+    }
+    pth_offload_pool.qtail = NULL;
+    pth_offload_pool.queued = 0;
+    pthread_cond_broadcast(&pth_offload_pool.cond);
+    while (pth_offload_pool.workers > 0)
+        pthread_cond_wait(&pth_offload_pool.gone, &pth_offload_pool.mutex);
+    while ((job = pth_offload_pool.done) != NULL) {
+        pth_offload_pool.done = job->oj_next;
+        free(job);
+    }
+    pthread_mutex_unlock(&pth_offload_pool.mutex);
+    pthread_cond_destroy(&pth_offload_pool.gone);
+    pthread_cond_destroy(&pth_offload_pool.cond);
+    pthread_mutex_destroy(&pth_offload_pool.mutex);
+    pth_notify_destroy(pth_offload_pool.nt);
+    pth_offload_pool.initialized = FALSE;
+#endif
+    return;
+}
+
+/* forget the pool after fork(2): its kernel threads
+   exist in the parent process only */
+void pth_offload_drop(void)
+{
+#ifdef HAVE_PTHREAD_H
+    if (!pth_offload_pool.initialized)
+        return;
+    pth_notify_destroy(pth_offload_pool.nt);
+    pth_offload_pool.initialized = FALSE;
+#endif
+    return;
+}
@@ -26,6 +26,11 @@
 #ifndef _PTH_P_H_
 #define _PTH_P_H_
 
+/* enable the Linux/BSD extensions (pidfd, splice, accept4, ...) */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -64,6 +69,15 @@
 #ifdef HAVE_DLFCN_H
 #include <dlfcn.h>
 #endif
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+#ifdef HAVE_NETINET_UDP_H
+#include <netinet/udp.h>
+#endif
 
 #ifdef PTH_DMALLOC
 #include <dmalloc.h>
@@ -104,6 +118,8 @@ struct pth_attr_st {
     unsigned int a_cancelstate;
     unsigned int a_stacksize;
     char        *a_stackaddr;
+    long         a_timerslack;
+    pth_time_t   a_deadline;
 };
 
 typedef struct pth_cleanup_st pth_cleanup_t;
@@ -121,16 +137,27 @@ struct pth_event_st {
     pth_status_t ev_status;
     int ev_type;
     int ev_goal;
+    int ev_pollidx;
     union {
         struct { int fd; }                                          FD;
         struct { int *n; int nfd; fd_set *rfds, *wfds, *efds; }     SELECT;
+        struct { int *n; struct pollfd *pfd; nfds_t nfd; }          POLL;
         struct { sigset_t *sigs; int *sig; }                        SIGS;
-        struct { pth_time_t tv; }                                   TIME;
+        struct { pth_time_t tv; struct timespec ts; }               TIME;
         struct { pth_msgport_t mp; }                                MSG;
         struct { pth_mutex_t *mutex; }                              MUTEX;
         struct { pth_cond_t *cond; }                                COND;
         struct { pth_t tid; }                                       TID;
         struct { pth_event_func_t func; void *arg; pth_time_t tv; } FUNC;
+        struct { pth_notify_t nt; }                                 NOTIFY;
+        struct { pid_t pid; int fd; }                               PID;
+        struct { pth_pipe_t p; }                                    PIPE;
+        struct { pth_sem_t *sem; unsigned int n; }                  SEM;
+        struct { pth_waitgroup_t *wg; }                             WAITGROUP;
+        struct { struct pth_offload_job_st *job; }                  OFFLOAD;
+        struct { struct pth_uring_op_st *op; }                      URING;
+        struct { int fd; unsigned int seq; }                        ZEROCOPY;
+        struct { int *granted; }                                    GRANT;
     } ev_args;
 };
 
@@ -149,12 +176,44 @@ struct pth_msgport_st {
     pth_ring_t     mp_queue;
 };
 
+struct pth_notify_st {
+    int nt_rfd;
+    int nt_wfd;
+};
+
+#define PTH_EVENT_OFFLOAD    _BIT(29)
+
+typedef struct pth_offload_job_st pth_offload_job_t;
+struct pth_offload_job_st {
+    pth_offload_job_t *oj_next;
+    void            *(*oj_func)(void *);
+    void              *oj_arg;
+    void              *oj_value;
+    pth_event_t        oj_ev;
+    int                oj_done;
+    struct timespec    oj_submitted;
+};
+
 struct pth_pqueue_st {
     pth_t q_head;
     int   q_num;
 };
 typedef struct pth_pqueue_st pth_pqueue_t;
 
+struct pth_stream_st {
+    int     st_fd;
+    char   *st_rbuf;
+    size_t  st_rsize;
+    size_t  st_rpos;
+    size_t  st_rlen;
+    size_t  st_rscan;
+    int     st_rdelim;
+    int     st_reof;
+    char   *st_wbuf;
+    size_t  st_wsize;
+    size_t  st_wlen;
+};
+
 struct pth_st {
     pth_t          q_next;
     pth_t          q_prev;
@@ -170,6 +229,11 @@ struct pth_st {
     pth_time_t     running;
 
     pth_event_t    events;
+    long           timerslack;
+    pth_event_t    deadline;
+    struct timespec *deadlines;
+    int            deadlinecnt;
+    int            deadlinemax;
 
     sigset_t       sigpending;
     int            sigpendcnt;
@@ -193,12 +257,55 @@ struct pth_st {
     pth_cleanup_t *cleanups;
 
     pth_ring_t     mutexring;
+    int            prioinherit;
+    struct pth_mutex_waiter_st *mutexwait;
 
 #ifdef PTH_EX
     ex_ctx_t       ex_ctx;
 #endif
 };
 
+#define pth_tcb_prio(t) \
+    ((t)->prioinherit > (t)->prio ? (t)->prioinherit : (t)->prio)
+
+#define PTH_URING_OP_READ    1
+#define PTH_URING_OP_WRITE   2
+#define PTH_URING_OP_READV   3
+#define PTH_URING_OP_WRITEV  4
+#define PTH_URING_OP_RECV    5
+#define PTH_URING_OP_SEND    6
+#define PTH_URING_OP_ACCEPT  7
+
+#define PTH_EVENT_URING      _BIT(30)
+
+typedef struct pth_uring_op_st pth_uring_op_t;
+struct pth_uring_op_st {
+    pth_event_t uo_ev;
+    int         uo_done;
+    int         uo_res;
+};
+
+#define PTH_EVENT_ZEROCOPY   _BIT(28)
+
+typedef struct pth_pipe_waiter_st pth_pipe_waiter_t;
+struct pth_pipe_waiter_st {
+    pth_pipe_waiter_t  *pw_next;
+    pth_pipe_waiter_t **pw_list;
+    pth_event_t         pw_ev;
+};
+
+struct pth_pipe_st {
+    char              *p_buf;
+    size_t             p_size;
+    size_t             p_head;
+    size_t             p_len;
+    int                p_closed;
+    pth_pipe_waiter_t *p_readers;
+    pth_pipe_waiter_t *p_writers;
+};
+
+#define PTH_EVENT_GRANT      _BIT(27)
+
 extern int pth_initialized;
 extern int pth_errno_storage;
 extern int pth_errno_flag;
@@ -213,7 +320,10 @@ extern pth_pqueue_t pth_SQ;
 extern pth_pqueue_t pth_DQ;
 extern int          pth_favournew;
 extern float        pth_loadval;
+extern unsigned long pth_timer_wakeups;
+extern unsigned long pth_timer_coalesced;
 extern pth_time_t   pth_time_zero;
+extern int          pth_cork_pending;
 
 #if PTH_SYSCALL_SOFT
 #define pth_sc(func) pth_sc_##func
@@ -227,8 +337,13 @@ extern pth_t pth_tcb_alloc(unsigned int stacksize, void *stackaddr);
 extern void pth_tcb_free(pth_t t);
 extern int pth_mctx_set(pth_mctx_t *mctx, void (*func)(void), char *sk_addr_lo, char *sk_addr_hi);
 extern int pth_time_cmp(pth_time_t *t1, pth_time_t *t2);
+extern int pth_timens_cmp(const struct timespec *t1, const struct timespec *t2);
+extern void pth_timens_add(struct timespec *t1, const struct timespec *t2);
+extern void pth_timens_sub(struct timespec *t1, const struct timespec *t2);
+extern void pth_timens_from_time(struct timespec *ts, const pth_time_t *tv);
 extern double pth_time_t2d(pth_time_t *t);
 extern void pth_mutex_releaseall(pth_t thread);
+extern long pth_mutex_stat(int which);
 extern int pth_util_sigdelete(int sig);
 extern int pth_attr_ctrl(int cmd, pth_attr_t a, int op, va_list ap);
 extern void pth_cleanup_popall(pth_t t, int execute);
@@ -236,12 +351,28 @@ extern void pth_key_destroydata(pth_t t);
 extern void pth_debug(const char *file, int line, int argc, const char *fmt, ...);
 extern void pth_dumpstate(FILE *fp);
 extern void pth_dumpqueue(FILE *fp, const char *qn, pth_pqueue_t *q);
+extern void pth_event_release(pth_event_t ev);
+extern void pth_event_timens(pth_event_t ev, const struct timespec *ts);
+extern int pth_wait_result(pth_event_t ev, pth_event_t ev_extra, int rc);
 extern ssize_t pth_readv_faked(int fd, const struct iovec *iov, int iovcnt);
 extern ssize_t pth_writev_iov_bytes(const struct iovec *iov, int iovcnt);
 extern void pth_writev_iov_advance(const struct iovec *riov, int riovcnt, size_t advance, struct iovec **wiov, int *wiovcnt, struct iovec *tiov, int tiovcnt);
 extern ssize_t pth_writev_faked(int fd, const struct iovec *iov, int iovcnt);
+extern ssize_t pth_preadv_faked(int fd, const struct iovec *iov, int iovcnt, off_t offset);
+extern ssize_t pth_pwritev_faked(int fd, const struct iovec *iov, int iovcnt, off_t offset);
 extern int pth_thread_exists(pth_t t);
 extern void pth_thread_cleanup(pth_t thread);
+extern int pth_fdstate_own(int fd, int fdmode);
+extern int pth_fdstate_owned(int fd);
+extern int pth_fdstate_stale(int fd);
+extern void pth_fdstate_release(int fd);
+extern void pth_fdstate_kill(void);
+extern int pth_notify_drain(pth_notify_t nt);
+extern int pth_offload_pollfd(void);
+extern int pth_offload_reap(void);
+extern long pth_offload_stat(int which);
+extern void pth_offload_kill(void);
+extern void pth_offload_drop(void);
 extern void pth_pqueue_init(pth_pqueue_t *q);
 extern void pth_pqueue_insert(pth_pqueue_t *q, int prio, pth_t t);
 extern pth_t pth_pqueue_delmax(pth_pqueue_t *q);
@@ -266,13 +397,38 @@ extern void pth_scheduler_drop(void);
 extern void pth_scheduler_kill(void);
 extern void *pth_scheduler(void *);
 extern void pth_sched_eventmanager(pth_time_t *now, int dopoll);
+extern int pth_uring_init(void);
+extern int pth_uring_kill(void);
+extern void pth_uring_drop(void);
+extern int pth_uring_active(void);
+extern int pth_uring_pollfd(void);
+extern int pth_uring_reap(void);
+extern int pth_uring_io(int op, int fd, const void *addr, size_t len, unsigned long long off, int flags, pth_event_t ev_extra, ssize_t *res);
 extern char *pth_util_cpystrn(char *dst, const char *src, size_t dst_size);
+extern int pth_util_pidfd_open(pid_t pid);
+extern int pth_util_pid_exited(pid_t pid);
 extern int pth_util_fd_valid(int fd);
-extern void pth_util_fds_merge(int nfd, fd_set *ifds1, fd_set *ofds1, fd_set *ifds2, fd_set *ofds2, fd_set *ifds3, fd_set *ofds3);
-extern int pth_util_fds_test(int nfd, fd_set *ifds1, fd_set *ofds1, fd_set *ifds2, fd_set *ofds2, fd_set *ifds3, fd_set *ofds3);
-extern int pth_util_fds_select(int nfd, fd_set *ifds1, fd_set *ofds1, fd_set *ifds2, fd_set *ofds2, fd_set *ifds3, fd_set *ofds3);
+extern int pth_util_ppoll(struct pollfd *pfd, nfds_t nfd, const struct timespec *ts);
+extern int pth_util_fd_poll(int fd, short events);
 extern void pth_syscall_init(void);
 extern void pth_syscall_kill(void);
+extern void pth_zerocopy_release(int fd);
+extern void pth_zerocopy_kill(void);
+extern int pth_zerocopy_done(int fd, unsigned int seq);
+extern int pth_zerocopy_reap(int fd);
+extern int pth_cork_writev(int fd, const struct iovec *iov, int iovcnt, pth_event_t ev_extra, ssize_t *rv);
+extern int pth_cork_sync(int fd, pth_event_t ev_extra);
+extern void pth_cork_flushall(pth_t t);
+extern int pth_cork_release(int fd);
+extern void pth_cork_kill(void);
+extern int pth_deadline_set(pth_t t, const struct timespec *until);
+extern void pth_deadline_clear(pth_t t);
+extern int pth_deadline_left(pth_t t, pth_time_t *left);
+extern void pth_pool_kill(void);
+extern void pth_fsync_release(int fd);
+extern void pth_fsync_kill(void);
+extern long pth_fsync_stat(int which);
+extern int pth_pipe_ready(pth_pipe_t p, int goal);
 
 extern void pth_mctx_switch_asm(pth_mctx_t *from_mctx, pth_mctx_t *to_mctx);
 
@@ -388,6 +544,9 @@ extern void pth_mctx_switch_asm(pth_mctx_t *from_mctx, pth_mctx_t *to_mctx);
         } \
     } while (0)
 
+#define pth_timens_now(t1) \
+    clock_gettime(CLOCK_REALTIME, (t1))
+
 #define pth_time_add(t1,t2) \
     (t1)->tv_sec  += (t2)->tv_sec; \
     (t1)->tv_usec += (t2)->tv_usec; \
@@ -0,0 +1,240 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  This file is part of GNU Pth, a non-preemptive thread scheduling
+**  library which can be found at http://www.gnu.org/software/pth/.
+**
+**  This library is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU Lesser General Public
+**  License as published by the Free Software Foundation; either
+**  version 2.1 of the License, or (at your option) any later version.
+**
+**  This library is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**  Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public
+**  License along with this library; if not, write to the Free Software
+**  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+**  USA, or contact Ralf S. Engelschall <rse@engelschall.com>.
+**
+**  pth_pipe.c: Pth in-process pipes
+*/
+                             /* ``The shortest way between
+                                  two threads is not through
+                                  the kernel.''
+                                                 -- Unknown */
+#include "pth_p.h"
+
+/*
+ * An in-process pipe is a ring buffer shared by the threads of the
+ * process. Threads blocked in pth_pipe_read(3) or pth_pipe_write(3)
+ * register themselves at the pipe, so the other side tags their
+ * events directly once there is data or room again, and the data never
+ * crosses the kernel. For everybody else PTH_EVENT_PIPE is checked by
+ * the scheduler like the other non-I/O events.
+ */
+
+#if cpp
+
+/* thread blocked on a pipe */
+typedef struct pth_pipe_waiter_st pth_pipe_waiter_t;
+struct pth_pipe_waiter_st {
+    pth_pipe_waiter_t  *pw_next;
+    pth_pipe_waiter_t **pw_list;  /* list the waiter is linked into */
+    pth_event_t         pw_ev;    /* event the thread waits for     */
+};
+
+/* in-process pipe structure */
+struct pth_pipe_st {
+    char              *p_buf;      /* ring buffer                         */
+    size_t             p_size;     /* size of ring buffer                 */
+    size_t             p_head;     /* start of data in ring buffer        */
+    size_t             p_len;      /* amount of data in ring buffer       */
+    int                p_closed;   /* no more data will be written        */
+    pth_pipe_waiter_t *p_readers;  /* threads waiting for data            */
+    pth_pipe_waiter_t *p_writers;  /* threads waiting for room            */
+};
+
+#endif /* cpp */
+
+/* create a new in-process pipe */
+pth_pipe_t pth_pipe_create(size_t size)
+{
+    pth_pipe_t p;
+
+    pth_implicit_init();
+    if (size == 0)
+        size = PTH_PIPE_BUFSIZE;
+
+    /* allocate structure and buffer in one chunk */
+    if ((p = (pth_pipe_t)malloc(sizeof(struct pth_pipe_st) + size)) == NULL)
+        return pth_error((pth_pipe_t)NULL, ENOMEM);
+    p->p_buf     = (char *)(p + 1);
+    p->p_size    = size;
+    p->p_head    = 0;
+    p->p_len     = 0;
+    p->p_closed  = FALSE;
+    p->p_readers = NULL;
+    p->p_writers = NULL;
+    return p;
+}
+
+/* destroy an in-process pipe */
+int pth_pipe_destroy(pth_pipe_t p)
+{
+    if (p == NULL)
+        return pth_error(FALSE, EINVAL);
+    if (p->p_readers != NULL || p->p_writers != NULL)
+        return pth_error(FALSE, EBUSY);
+    free(p);
+    return TRUE;
+}
+
+/* wake up all threads of a waiter list */
+static void pth_pipe_wakeup(pth_pipe_waiter_t **list)
+{
+    pth_pipe_waiter_t *pw;
+
+    for (pw = *list; pw != NULL; pw = pw->pw_next)
+        pw->pw_ev->ev_status = PTH_STATUS_OCCURRED;
+    *list = NULL;
+    return;
+}
+
+/* end the data stream of an in-process pipe */
+int pth_pipe_close(pth_pipe_t p)
+{
+    if (p == NULL)
+        return pth_error(FALSE, EINVAL);
+    p->p_closed = TRUE;
+    pth_pipe_wakeup(&p->p_readers);
+    pth_pipe_wakeup(&p->p_writers);
+    return TRUE;
+}
+
+/* check whether a pipe is ready for reading or writing (scheduler) */
+int pth_pipe_ready(pth_pipe_t p, int goal)
+{
+    if (p->p_closed)
+        return TRUE;
+    if ((goal & PTH_UNTIL_FD_READABLE) && p->p_len > 0)
+        return TRUE;
+    if ((goal & PTH_UNTIL_FD_WRITEABLE) && p->p_len < p->p_size)
+        return TRUE;
+    return FALSE;
+}
+
+/* remove a waiter from its waiter list (if still linked) */
+static void pth_pipe_unlink(void *arg)
+{
+    pth_pipe_waiter_t *pw = (pth_pipe_waiter_t *)arg;
+    pth_pipe_waiter_t **list;
+
+    for (list = pw->pw_list; *list != NULL; list = &(*list)->pw_next) {
+        if (*list == pw) {
+            *list = pw->pw_next;
+            break;
+        }
+    }
+    return;
+}
+
+/* let the current thread wait until a pipe gets ready */
+static int pth_pipe_wait(pth_pipe_t p, int goal, pth_event_t ev_extra)
+{
+    static pth_key_t ev_key = PTH_KEY_INIT;
+    pth_pipe_waiter_t pw;
+    pth_event_t ev;
+    int rc;
+
+    if ((ev = pth_event(PTH_EVENT_PIPE|goal|PTH_MODE_STATIC, &ev_key, p)) == NULL)
+        return errno;
+    if (ev_extra != NULL)
+        pth_event_concat(ev, ev_extra, NULL);
+
+    /* register for a direct wakeup by the other side */
+    pw.pw_list = (goal == PTH_UNTIL_FD_READABLE ? &p->p_readers : &p->p_writers);
+    pw.pw_ev   = ev;
+    pw.pw_next = *pw.pw_list;
+    *pw.pw_list = &pw;
+    pth_cleanup_push(pth_pipe_unlink, &pw);
+    rc = pth_wait(ev);
+    pth_cleanup_pop(TRUE);
+    return pth_wait_result(ev, ev_extra, rc);
+}
+
+/* read up to nbytes of data (waiting only until some is available) */
+ssize_t pth_pipe_read(pth_pipe_t p, void *buf, size_t nbytes, pth_event_t ev_extra)
+{
+    size_t n, chunk;
+    int err;
+
+    if (p == NULL || (buf == NULL && nbytes > 0))
+        return pth_error(-1, EINVAL);
+    if (nbytes == 0)
+        return 0;
+
+    /* wait for data or the end of the stream */
+    while (p->p_len == 0) {
+        if (p->p_closed)
+            return 0;
+        if ((err = pth_pipe_wait(p, PTH_UNTIL_FD_READABLE, ev_extra)) != 0)
+            return pth_error(-1, err);
+    }
+
+    /* copy the data out of the ring buffer (in at most two pieces) */
+    n = pth_util_min(nbytes, p->p_len);
+    chunk = pth_util_min(n, p->p_size - p->p_head);
+    memcpy(buf, p->p_buf + p->p_head, chunk);
+    if (chunk < n)
+        memcpy((char *)buf + chunk, p->p_buf, n - chunk);
+    p->p_head = (p->p_head + n) % p->p_size;
+    p->p_len -= n;
+    if (p->p_len == 0)
+        p->p_head = 0;
+
+    /* there is room again */
+    pth_pipe_wakeup(&p->p_writers);
+    return (ssize_t)n;
+}
+
+/* write nbytes of data (waiting for room as long as necessary) */
+ssize_t pth_pipe_write(pth_pipe_t p, const void *buf, size_t nbytes, pth_event_t ev_extra)
+{
+    size_t done, n, tail, chunk;
+    int err;
+
+    if (p == NULL || (buf == NULL && nbytes > 0))
+        return pth_error(-1, EINVAL);
+
+    done = 0;
+    while (done < nbytes) {
+        if (p->p_closed)
+            return (done > 0 ? (ssize_t)done : pth_error(-1, EPIPE));
+
+        /* wait for room (a partial write is reported
+           if the waiting was stopped by an extra event) */
+        if (p->p_len == p->p_size) {
+            if ((err = pth_pipe_wait(p, PTH_UNTIL_FD_WRITEABLE, ev_extra)) != 0)
+                return (done > 0 ? (ssize_t)done : pth_error(-1, err));
+            continue;
+        }
+
+        /* copy the data into the ring buffer (in at most two pieces) */
+        n = pth_util_min(nbytes - done, p->p_size - p->p_len);
+        tail = (p->p_head + p->p_len) % p->p_size;
+        chunk = pth_util_min(n, p->p_size - tail);
+        memcpy(p->p_buf + tail, (const char *)buf + done, chunk);
+        if (chunk < n)
+            memcpy(p->p_buf, (const char *)buf + done + chunk, n - chunk);
+        p->p_len += n;
+        done += n;
+
+        /* there is data now */
+        pth_pipe_wakeup(&p->p_readers);
+    }
+    return (ssize_t)done;
+}
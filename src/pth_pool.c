@@ -0,0 +1,206 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  This file is part of GNU Pth, a non-preemptive thread scheduling
+**  library which can be found at http://www.gnu.org/software/pth/.
+**
+**  This library is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU Lesser General Public
+**  License as published by the Free Software Foundation; either
+**  version 2.1 of the License, or (at your option) any later version.
+**
+**  This library is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**  Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public
+**  License along with this library; if not, write to the Free Software
+**  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+**  USA, or contact Ralf S. Engelschall <rse@engelschall.com>.
+**
+**  pth_pool.c: Pth pooled receive buffers
+*/
+                             /* ``Neither a borrower nor a lender be.''
+                                            -- William Shakespeare */
+#include "pth_p.h"
+
+#include <stddef.h>
+#include <sys/ioctl.h>
+
+/*
+ * A thread receiving with pth_recv_pooled(3) waits for readability
+ * without holding any buffer. Only once data arrived it borrows a
+ * buffer from a process-wide pool, whose size class is chosen from the
+ * amount of data the kernel has queued. Released buffers are kept for
+ * reuse, but only up to a small number per class, so the memory spent
+ * on receive buffers follows the number of connections which actually
+ * have data in flight and not the number of open connections.
+ */
+
+/* size classes: 256, 1K, 4K, 16K and 64K bytes */
+#define PTH_POOL_CLASSES  5
+#define PTH_POOL_MINSHIFT 8
+
+/* idle buffers kept per size class */
+#define PTH_POOL_KEEP     64
+
+/* header in front of every pooled buffer */
+typedef union pth_pool_hdr_un pth_pool_hdr_t;
+union pth_pool_hdr_un {
+    struct {
+        pth_pool_hdr_t *next;   /* next idle buffer of same size class */
+        int             cls;    /* size class of buffer                */
+    } h;
+    max_align_t align;          /* keeps the payload suitably aligned  */
+};
+
+static pth_pool_hdr_t *pth_pool_idle[PTH_POOL_CLASSES];
+static int             pth_pool_nidle[PTH_POOL_CLASSES];
+
+/* the payload size of a size class */
+static size_t pth_pool_size(int cls)
+{
+    return (size_t)1 << (PTH_POOL_MINSHIFT + 2 * cls);
+}
+
+/* borrow a buffer of a size class */
+static void *pth_pool_get(int cls)
+{
+    pth_pool_hdr_t *hdr;
+
+    if ((hdr = pth_pool_idle[cls]) != NULL) {
+        pth_pool_idle[cls] = hdr->h.next;
+        pth_pool_nidle[cls]--;
+    }
+    else {
+        if ((hdr = (pth_pool_hdr_t *)malloc(sizeof(pth_pool_hdr_t) + pth_pool_size(cls))) == NULL)
+            return pth_error((void *)NULL, ENOMEM);
+        hdr->h.cls = cls;
+    }
+    hdr->h.next = NULL;
+    return (void *)(hdr + 1);
+}
+
+/* return a borrowed buffer to the pool */
+void pth_recv_release(void *buf)
+{
+    pth_pool_hdr_t *hdr;
+    int cls;
+
+    if (buf == NULL)
+        return;
+    hdr = (pth_pool_hdr_t *)buf - 1;
+    cls = hdr->h.cls;
+    if (pth_pool_nidle[cls] >= PTH_POOL_KEEP) {
+        pth_shield { free(hdr); }
+        return;
+    }
+    hdr->h.next = pth_pool_idle[cls];
+    pth_pool_idle[cls] = hdr;
+    pth_pool_nidle[cls]++;
+    return;
+}
+
+/* free all idle buffers of the pool */
+void pth_pool_kill(void)
+{
+    pth_pool_hdr_t *hdr;
+    int cls;
+
+    for (cls = 0; cls < PTH_POOL_CLASSES; cls++) {
+        while ((hdr = pth_pool_idle[cls]) != NULL) {
+            pth_pool_idle[cls] = hdr->h.next;
+            free(hdr);
+        }
+        pth_pool_nidle[cls] = 0;
+    }
+    return;
+}
+
+/* Pth variant of recv(2) with a buffer lent by the library */
+ssize_t pth_recv_pooled(int fd, void **buf, size_t nbytes, int flags)
+{
+    return pth_recv_pooled_ev(fd, buf, nbytes, flags, NULL);
+}
+
+/* Pth variant of recv(2) with a buffer lent by the library and extra event(s) */
+ssize_t pth_recv_pooled_ev(int fd, void **buf, size_t nbytes, int flags, pth_event_t ev_extra)
+{
+    static pth_key_t ev_key = PTH_KEY_INIT;
+    struct timespec delay;
+    struct pollfd pfd;
+    pth_event_t ev;
+    void *b;
+    size_t want;
+    ssize_t n;
+    int avail;
+    int fdmode;
+    int cls;
+    int err;
+
+    pth_implicit_init();
+    pth_debug2("pth_recv_pooled_ev: enter from thread \"%s\"", pth_current->name);
+
+    /* argument sanity checks */
+    if (buf == NULL || nbytes == 0)
+        return pth_error(-1, EINVAL);
+    *buf = NULL;
+    if (!pth_util_fd_valid(fd))
+        return pth_error(-1, EBADF);
+    if ((fdmode = pth_fdmode(fd, PTH_FDMODE_POLL)) == PTH_FDMODE_ERROR)
+        return pth_error(-1, EBADF);
+
+    for (;;) {
+        /* wait for readability without holding a buffer */
+        if (fdmode == PTH_FDMODE_BLOCK) {
+            pfd.fd      = fd;
+            pfd.events  = POLLIN;
+            pfd.revents = 0;
+            delay.tv_sec  = 0;
+            delay.tv_nsec = 0;
+            while ((n = pth_util_ppoll(&pfd, 1, &delay)) < 0
+                   && errno == EINTR) ;
+            if (n < 0)
+                return pth_error(-1, errno);
+            if (n == 0) {
+                ev = pth_event(PTH_EVENT_FD|PTH_UNTIL_FD_READABLE|PTH_MODE_STATIC, &ev_key, fd);
+                if (ev_extra != NULL)
+                    pth_event_concat(ev, ev_extra, NULL);
+                if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0)
+                    return pth_error(-1, err);
+            }
+        }
+
+        /* choose the smallest buffer holding what the kernel has queued
+           (or the largest one if it cannot tell) */
+        want = nbytes;
+        if (ioctl(fd, FIONREAD, &avail) == 0 && avail >= 0 && (size_t)avail < want)
+            want = (avail > 0 ? (size_t)avail : 1);
+        for (cls = 0; cls < PTH_POOL_CLASSES-1; cls++)
+            if (pth_pool_size(cls) >= want)
+                break;
+        want = pth_util_min(nbytes, pth_pool_size(cls));
+
+        /* borrow the buffer and receive into it */
+        if ((b = pth_pool_get(cls)) == NULL)
+            return -1;
+        while ((n = pth_sc(recvfrom)(fd, b, want, flags, NULL, NULL)) < 0
+               && errno == EINTR) ;
+        if (n > 0) {
+            *buf = b;
+            break;
+        }
+        pth_shield { pth_recv_release(b); }
+
+        /* somebody else was faster: wait again */
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)
+            && fdmode == PTH_FDMODE_BLOCK)
+            continue;
+        break;
+    }
+
+    pth_debug2("pth_recv_pooled_ev: leave to thread \"%s\"", pth_current->name);
+    return n;
+}
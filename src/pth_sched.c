@@ -37,16 +37,23 @@ pth_pqueue_t pth_SQ;         /* queue of suspended threads            */
 pth_pqueue_t pth_DQ;         /* queue of terminated threads           */
 int          pth_favournew;  /* favour new threads on startup         */
 float        pth_loadval;    /* average scheduler load value          */
+unsigned long pth_timer_wakeups;   /* number of wakeups caused by timers */
+unsigned long pth_timer_coalesced; /* timers fired without own wakeup    */
 
 static int          pth_sigpipe[2]; /* internal signal occurrence pipe       */
 static sigset_t     pth_sigpending; /* mask of pending signals               */
 static sigset_t     pth_sigblock;   /* mask of signals we block in scheduler */
 static sigset_t     pth_sigcatch;   /* mask of signals we have to catch      */
 static sigset_t     pth_sigraised;  /* mask of raised signals                */
+static struct sigaction pth_sigchld_osa; /* application's SIGCHLD action to chain to */
 
 static pth_time_t   pth_loadticknext;
 static pth_time_t   pth_loadtickgap = PTH_TIME(1,0);
 
+static struct pollfd *pth_pfd;      /* filedescriptors the scheduler waits on */
+static nfds_t        pth_pfd_num;   /* number of used pollfd entries          */
+static nfds_t        pth_pfd_size;  /* number of allocated pollfd entries     */
+
 /* initialize the scheduler ingredients */
 int pth_scheduler_init(void)
 {
@@ -72,6 +79,10 @@ int pth_scheduler_init(void)
     /* initialize scheduling hints */
     pth_favournew = 1; /* the default is the original behaviour */
 
+    /* initialize timer statistics */
+    pth_timer_wakeups   = 0;
+    pth_timer_coalesced = 0;
+
     /* initialize load support */
     pth_loadval = 1.0;
     pth_time_set(&pth_loadticknext, PTH_TIME_NOW);
@@ -108,18 +119,33 @@ void pth_scheduler_drop(void)
     while ((t = pth_pqueue_delmax(&pth_DQ)) != NULL)
         pth_tcb_free(t);
     pth_pqueue_init(&pth_DQ);
+
+    /* the operations of the io_uring engine belonged to dropped
+       threads (and after fork(2) the ring is the parent's one) */
+    pth_uring_drop();
+    pth_offload_drop();
     return;
 }
 
 /* kill the scheduler ingredients */
 void pth_scheduler_kill(void)
 {
+    /* shut down the kernel threads of the offload pool */
+    pth_offload_kill();
+
     /* drop all threads */
     pth_scheduler_drop();
 
     /* remove the internal signal pipe */
     close(pth_sigpipe[0]);
     close(pth_sigpipe[1]);
+
+    /* release the pollfd array */
+    if (pth_pfd != NULL)
+        free(pth_pfd);
+    pth_pfd      = NULL;
+    pth_pfd_num  = 0;
+    pth_pfd_size = 0;
     return;
 }
 
@@ -351,7 +377,7 @@ void *pth_scheduler(void *dummy)
         if (pth_current != NULL && pth_current->state == PTH_STATE_WAITING) {
             pth_debug2("pth_scheduler: moving thread \"%s\" to waiting queue",
                        pth_current->name);
-            pth_pqueue_insert(&pth_WQ, pth_current->prio, pth_current);
+            pth_pqueue_insert(&pth_WQ, pth_tcb_prio(pth_current), pth_current);
             pth_current = NULL;
         }
 
@@ -362,7 +388,7 @@ void *pth_scheduler(void *dummy)
          */
         pth_pqueue_increase(&pth_RQ);
         if (pth_current != NULL)
-            pth_pqueue_insert(&pth_RQ, pth_current->prio, pth_current);
+            pth_pqueue_insert(&pth_RQ, pth_tcb_prio(pth_current), pth_current);
 
         /*
          * Manage the events in the waiting queue, i.e. decide whether their
@@ -384,6 +410,103 @@ void *pth_scheduler(void *dummy)
 
 /* forward declaration for signal handler */
 static void pth_sched_eventmanager_sighandler(int sig);
+static void pth_sched_eventmanager_sigchain(int sig, siginfo_t *si, void *uc);
+
+/* append a filedescriptor to the pollfd array the scheduler waits on
+   and return its index (or -1 if the array cannot be grown) */
+static int pth_sched_pfd_add(int fd, short events)
+{
+    struct pollfd *pfd;
+    nfds_t size;
+
+    if (pth_pfd_num == pth_pfd_size) {
+        size = (pth_pfd_size == 0 ? 64 : pth_pfd_size * 2);
+        if ((pfd = (struct pollfd *)realloc(pth_pfd, size * sizeof(struct pollfd))) == NULL)
+            return -1;
+        pth_pfd      = pfd;
+        pth_pfd_size = size;
+    }
+    pth_pfd[pth_pfd_num].fd      = fd;
+    pth_pfd[pth_pfd_num].events  = events;
+    pth_pfd[pth_pfd_num].revents = 0;
+    return (int)(pth_pfd_num++);
+}
+
+/* the poll(2) results which select(2) reports as readable, writeable
+   or exceptional (errors and hangups let reads and writes return) */
+#define PTH_POLL_RSET (POLLIN|POLLRDNORM|POLLRDBAND|POLLHUP|POLLERR)
+#define PTH_POLL_WSET (POLLOUT|POLLWRNORM|POLLWRBAND|POLLHUP|POLLERR)
+#define PTH_POLL_ESET (POLLPRI)
+
+/* append the filedescriptor sets of a select event to the pollfd array */
+static int pth_sched_pfd_addsets(pth_event_t ev)
+{
+    int first;
+    int idx;
+    short events;
+    int s;
+
+    first = -1;
+    for (s = 0; s < ev->ev_args.SELECT.nfd; s++) {
+        events = 0;
+        if (ev->ev_args.SELECT.rfds != NULL && FD_ISSET(s, ev->ev_args.SELECT.rfds))
+            events |= POLLIN;
+        if (ev->ev_args.SELECT.wfds != NULL && FD_ISSET(s, ev->ev_args.SELECT.wfds))
+            events |= POLLOUT;
+        if (ev->ev_args.SELECT.efds != NULL && FD_ISSET(s, ev->ev_args.SELECT.efds))
+            events |= POLLPRI;
+        if (events == 0)
+            continue;
+        if ((idx = pth_sched_pfd_add(s, events)) == -1)
+            return -2;
+        if (first == -1)
+            first = idx;
+    }
+    return first;
+}
+
+/* map the poll(2) results back onto the filedescriptor sets of a
+   select event: returns the number of ready filedescriptors (the sets
+   are only modified if there is at least one) or -1 for invalid ones */
+static int pth_sched_pfd_setsresult(pth_event_t ev)
+{
+    int pass;
+    int idx;
+    int n;
+    int s;
+    short revents;
+
+    n = 0;
+    for (pass = 0; pass < 2; pass++) {
+        idx = ev->ev_pollidx;
+        for (s = 0; s < ev->ev_args.SELECT.nfd; s++) {
+            int r = (ev->ev_args.SELECT.rfds != NULL && FD_ISSET(s, ev->ev_args.SELECT.rfds));
+            int w = (ev->ev_args.SELECT.wfds != NULL && FD_ISSET(s, ev->ev_args.SELECT.wfds));
+            int e = (ev->ev_args.SELECT.efds != NULL && FD_ISSET(s, ev->ev_args.SELECT.efds));
+            if (!r && !w && !e)
+                continue;
+            revents = pth_pfd[idx++].revents;
+            if (pass == 0) {
+                if (revents & POLLNVAL)
+                    return -1;
+                n += (r && (revents & PTH_POLL_RSET));
+                n += (w && (revents & PTH_POLL_WSET));
+                n += (e && (revents & PTH_POLL_ESET));
+            }
+            else {
+                if (r && !(revents & PTH_POLL_RSET))
+                    FD_CLR(s, ev->ev_args.SELECT.rfds);
+                if (w && !(revents & PTH_POLL_WSET))
+                    FD_CLR(s, ev->ev_args.SELECT.wfds);
+                if (e && !(revents & PTH_POLL_ESET))
+                    FD_CLR(s, ev->ev_args.SELECT.efds);
+            }
+        }
+        if (n == 0)
+            break;
+    }
+    return n;
+}
 
 /*
  * Look whether some events already occurred (or failed) and move
@@ -393,24 +516,33 @@ void pth_sched_eventmanager(pth_time_t *now, int dopoll)
 {
     pth_t nexttimer_thread;
     pth_event_t nexttimer_ev;
-    pth_time_t nexttimer_value;
+    struct timespec nexttimer_value;
+    struct timespec nowns;
+    struct timespec pollns;
     pth_event_t evh;
     pth_event_t ev;
     pth_t t;
     pth_t tlast;
     int this_occurred;
     int any_occurred;
-    fd_set rfds;
-    fd_set wfds;
-    fd_set efds;
-    struct timeval delay;
-    struct timeval *pdelay;
+    struct timespec delay;
+    struct timespec *pdelay;
     sigset_t oss;
     struct sigaction sa;
     struct sigaction osa[1+PTH_NSIG];
     char minibuf[128];
     int loop_repeat;
-    int fdmax;
+    int pidcatch;
+    int sigchain;
+    int sigpipeidx;
+    int uringidx;
+    int offloadidx;
+    int uringfd;
+    int offloadfd;
+    short events;
+    short revents;
+    int reaped;
+    nfds_t i;
     int rc;
     int sig;
     int n;
@@ -422,25 +554,32 @@ void pth_sched_eventmanager(pth_time_t *now, int dopoll)
     loop_entry:
     loop_repeat = FALSE;
 
-    /* initialize fd sets */
-    FD_ZERO(&rfds);
-    FD_ZERO(&wfds);
-    FD_ZERO(&efds);
-    fdmax = -1;
+    /* initialize the pollfd array */
+    pth_pfd_num = 0;
 
     /* initialize signal status */
     sigpending(&pth_sigpending);
     sigfillset(&pth_sigblock);
     sigemptyset(&pth_sigcatch);
     sigemptyset(&pth_sigraised);
+    pidcatch = FALSE;
 
     /* initialize next timer */
-    pth_time_set(&nexttimer_value, PTH_TIME_ZERO);
+    nexttimer_value.tv_sec  = 0;
+    nexttimer_value.tv_nsec = 0;
     nexttimer_thread = NULL;
     nexttimer_ev = NULL;
 
-    /* for all threads in the waiting queue... */
+    /* timers are checked against a fresh clock with nanosecond resolution */
+    pth_timens_now(&nowns);
+
+    /* take over the completions of the io_uring engine in one batch
+       (their events are tagged directly) */
     any_occurred = FALSE;
+    if (pth_uring_reap() > 0)
+        any_occurred = TRUE;
+
+    /* for all threads in the waiting queue... */
     for (t = pth_pqueue_head(&pth_WQ); t != NULL;
          t = pth_pqueue_walk(&pth_WQ, t, PTH_WALK_NEXT)) {
 
@@ -465,26 +604,82 @@ void pth_sched_eventmanager(pth_time_t *now, int dopoll)
                 /* Filedescriptor I/O */
                 if (ev->ev_type == PTH_EVENT_FD) {
                     /* filedescriptors are checked later all at once.
-                       Here we only assemble them in the fd sets */
+                       Here we only assemble them in the pollfd array */
+                    events = 0;
                     if (ev->ev_goal & PTH_UNTIL_FD_READABLE)
-                        FD_SET(ev->ev_args.FD.fd, &rfds);
+                        events |= POLLIN;
                     if (ev->ev_goal & PTH_UNTIL_FD_WRITEABLE)
-                        FD_SET(ev->ev_args.FD.fd, &wfds);
+                        events |= POLLOUT;
                     if (ev->ev_goal & PTH_UNTIL_FD_EXCEPTION)
-                        FD_SET(ev->ev_args.FD.fd, &efds);
-                    if (fdmax < ev->ev_args.FD.fd)
-                        fdmax = ev->ev_args.FD.fd;
+                        events |= POLLPRI;
+                    if ((ev->ev_pollidx = pth_sched_pfd_add(ev->ev_args.FD.fd, events)) == -1) {
+                        ev->ev_status = PTH_STATUS_FAILED;
+                        any_occurred = TRUE;
+                    }
                 }
                 /* Filedescriptor Set Select I/O */
                 else if (ev->ev_type == PTH_EVENT_SELECT) {
                     /* filedescriptors are checked later all at once.
-                       Here we only merge the fd sets. */
-                    pth_util_fds_merge(ev->ev_args.SELECT.nfd,
-                                       ev->ev_args.SELECT.rfds, &rfds,
-                                       ev->ev_args.SELECT.wfds, &wfds,
-                                       ev->ev_args.SELECT.efds, &efds);
-                    if (fdmax < ev->ev_args.SELECT.nfd-1)
-                        fdmax = ev->ev_args.SELECT.nfd-1;
+                       Here we only convert the fd sets. */
+                    if ((ev->ev_pollidx = pth_sched_pfd_addsets(ev)) == -2) {
+                        ev->ev_status = PTH_STATUS_FAILED;
+                        any_occurred = TRUE;
+                    }
+                }
+                /* Filedescriptor Array Poll I/O */
+                else if (ev->ev_type == PTH_EVENT_POLL) {
+                    /* filedescriptors are checked later all at once.
+                       Here we only append the array (negative
+                       filedescriptors are ignored by poll(2) itself) */
+                    ev->ev_pollidx = (int)pth_pfd_num;
+                    for (i = 0; i < ev->ev_args.POLL.nfd; i++) {
+                        if (pth_sched_pfd_add(ev->ev_args.POLL.pfd[i].fd,
+                                              ev->ev_args.POLL.pfd[i].events) == -1) {
+                            pth_pfd_num = (nfds_t)ev->ev_pollidx;
+                            ev->ev_status = PTH_STATUS_FAILED;
+                            any_occurred = TRUE;
+                            break;
+                        }
+                    }
+                }
+                /* Notification Object */
+                else if (ev->ev_type == PTH_EVENT_NOTIFY) {
+                    /* checked later together with the other
+                       filedescriptors, so raises cost no extra syscall */
+                    if ((ev->ev_pollidx = pth_sched_pfd_add(ev->ev_args.NOTIFY.nt->nt_rfd, POLLIN)) == -1) {
+                        ev->ev_status = PTH_STATUS_FAILED;
+                        any_occurred = TRUE;
+                    }
+                }
+                /* Child Process Termination */
+                else if (ev->ev_type == PTH_EVENT_PID) {
+                    if (ev->ev_args.PID.fd != -1) {
+                        /* the process descriptor becomes readable on exit */
+                        if ((ev->ev_pollidx = pth_sched_pfd_add(ev->ev_args.PID.fd, POLLIN)) == -1) {
+                            ev->ev_status = PTH_STATUS_FAILED;
+                            any_occurred = TRUE;
+                        }
+                    }
+                    else if (pth_util_pid_exited(ev->ev_args.PID.pid))
+                        this_occurred = TRUE;
+                    else {
+                        /* no process descriptor, so let SIGCHLD awake us */
+                        sigdelset(&pth_sigblock, SIGCHLD);
+                        pidcatch = TRUE;
+                    }
+                }
+                /* Zero-Copy Send Completion */
+                else if (ev->ev_type == PTH_EVENT_ZEROCOPY) {
+                    if (pth_zerocopy_done(ev->ev_args.ZEROCOPY.fd, ev->ev_args.ZEROCOPY.seq))
+                        this_occurred = TRUE;
+                    else {
+                        /* the completion notifications arrive on the error
+                           queue, which poll(2) always reports as POLLERR */
+                        if ((ev->ev_pollidx = pth_sched_pfd_add(ev->ev_args.ZEROCOPY.fd, 0)) == -1) {
+                            ev->ev_status = PTH_STATUS_FAILED;
+                            any_occurred = TRUE;
+                        }
+                    }
                 }
                 /* Signal Set */
                 else if (ev->ev_type == PTH_EVENT_SIGS) {
@@ -514,15 +709,25 @@ void pth_sched_eventmanager(pth_time_t *now, int dopoll)
                 }
                 /* Timer */
                 else if (ev->ev_type == PTH_EVENT_TIME) {
-                    if (pth_time_cmp(&(ev->ev_args.TIME.tv), now) < 0)
+                    if (pth_timens_cmp(&(ev->ev_args.TIME.ts), &nowns) <= 0)
                         this_occurred = TRUE;
                     else {
-                        /* remember the timer which will be elapsed next */
+                        /* remember the timer which has to be elapsed next,
+                           where each deadline can be deferred by the timer
+                           slack of its thread in order to let more timers
+                           expire within the same wakeup */
+                        struct timespec ts = ev->ev_args.TIME.ts;
+                        if (t->timerslack > 0) {
+                            struct timespec slack;
+                            slack.tv_sec  = t->timerslack / 1000000000L;
+                            slack.tv_nsec = t->timerslack % 1000000000L;
+                            pth_timens_add(&ts, &slack);
+                        }
                         if ((nexttimer_thread == NULL && nexttimer_ev == NULL) ||
-                            pth_time_cmp(&(ev->ev_args.TIME.tv), &nexttimer_value) < 0) {
+                            pth_timens_cmp(&ts, &nexttimer_value) < 0) {
                             nexttimer_thread = t;
                             nexttimer_ev = ev;
-                            pth_time_set(&nexttimer_value, &(ev->ev_args.TIME.tv));
+                            nexttimer_value = ts;
                         }
                     }
                 }
@@ -533,7 +738,8 @@ void pth_sched_eventmanager(pth_time_t *now, int dopoll)
                 }
                 /* Mutex Release */
                 else if (ev->ev_type == PTH_EVENT_MUTEX) {
-                    if (!(ev->ev_args.MUTEX.mutex->mx_state & PTH_MUTEX_LOCKED))
+                    if (   !(ev->ev_args.MUTEX.mutex->mx_state & PTH_MUTEX_LOCKED)
+                        || ev->ev_args.MUTEX.mutex->mx_owner == t)
                         this_occurred = TRUE;
                 }
                 /* Condition Variable Signal */
@@ -549,6 +755,26 @@ void pth_sched_eventmanager(pth_time_t *now, int dopoll)
                         }
                     }
                 }
+                /* Semaphore Units */
+                else if (ev->ev_type == PTH_EVENT_SEM) {
+                    if (ev->ev_args.SEM.sem->sm_value >= ev->ev_args.SEM.n)
+                        this_occurred = TRUE;
+                }
+                /* Wait Group Completion */
+                else if (ev->ev_type == PTH_EVENT_WAITGROUP) {
+                    if (ev->ev_args.WAITGROUP.wg->wg_count == 0)
+                        this_occurred = TRUE;
+                }
+                /* Direct Grant */
+                else if (ev->ev_type == PTH_EVENT_GRANT) {
+                    if (*(ev->ev_args.GRANT.granted))
+                        this_occurred = TRUE;
+                }
+                /* In-Process Pipe */
+                else if (ev->ev_type == PTH_EVENT_PIPE) {
+                    if (pth_pipe_ready(ev->ev_args.PIPE.p, ev->ev_goal))
+                        this_occurred = TRUE;
+                }
                 /* Thread Termination */
                 else if (ev->ev_type == PTH_EVENT_TID) {
                     if (   (   ev->ev_args.TID.tid == NULL
@@ -562,14 +788,14 @@ void pth_sched_eventmanager(pth_time_t *now, int dopoll)
                     if (ev->ev_args.FUNC.func(ev->ev_args.FUNC.arg))
                         this_occurred = TRUE;
                     else {
-                        pth_time_t tv;
-                        pth_time_set(&tv, now);
-                        pth_time_add(&tv, &(ev->ev_args.FUNC.tv));
+                        struct timespec ts;
+                        pth_timens_from_time(&ts, &(ev->ev_args.FUNC.tv));
+                        pth_timens_add(&ts, &nowns);
                         if ((nexttimer_thread == NULL && nexttimer_ev == NULL) ||
-                            pth_time_cmp(&tv, &nexttimer_value) < 0) {
+                            pth_timens_cmp(&ts, &nexttimer_value) < 0) {
                             nexttimer_thread = t;
                             nexttimer_ev = ev;
-                            pth_time_set(&nexttimer_value, &tv);
+                            nexttimer_value = ts;
                         }
                     }
                 }
@@ -581,6 +807,11 @@ void pth_sched_eventmanager(pth_time_t *now, int dopoll)
                     any_occurred = TRUE;
                 }
             }
+            else {
+                /* already tagged directly by another thread
+                   (e.g. the other side of an in-process pipe) */
+                any_occurred = TRUE;
+            }
         } while ((ev = ev->ev_next) != evh);
     }
     if (any_occurred)
@@ -590,14 +821,19 @@ void pth_sched_eventmanager(pth_time_t *now, int dopoll)
     if (dopoll) {
         /* do a polling with immediate timeout,
            i.e. check the fd sets only without blocking */
-        pth_time_set(&delay, PTH_TIME_ZERO);
+        delay.tv_sec  = 0;
+        delay.tv_nsec = 0;
         pdelay = &delay;
     }
     else if (nexttimer_ev != NULL) {
         /* do a polling with a timeout set to the next timer,
            i.e. wait for the fd sets or the next timer */
-        pth_time_set(&delay, &nexttimer_value);
-        pth_time_sub(&delay, now);
+        delay = nexttimer_value;
+        pth_timens_sub(&delay, &nowns);
+        if (delay.tv_sec < 0) {
+            delay.tv_sec  = 0;
+            delay.tv_nsec = 0;
+        }
         pdelay = &delay;
     }
     else {
@@ -606,18 +842,43 @@ void pth_sched_eventmanager(pth_time_t *now, int dopoll)
         pdelay = NULL;
     }
 
-    /* clear pipe and let select() wait for the read-part of the pipe */
+    /* clear pipe and let poll() wait for the read-part of the pipe */
     while (pth_sc(read)(pth_sigpipe[0], minibuf, sizeof(minibuf)) > 0) ;
-    FD_SET(pth_sigpipe[0], &rfds);
-    if (fdmax < pth_sigpipe[0])
-        fdmax = pth_sigpipe[0];
+    sigpipeidx = pth_sched_pfd_add(pth_sigpipe[0], POLLIN);
+
+    /* submit the queued io_uring operations and let poll()
+       wait for their completions, too */
+    uringidx = -1;
+    if ((uringfd = pth_uring_pollfd()) != -1)
+        uringidx = pth_sched_pfd_add(uringfd, POLLIN);
+
+    /* let poll() wait for jobs completed by the offload pool */
+    offloadidx = -1;
+    if ((offloadfd = pth_offload_pollfd()) != -1)
+        offloadidx = pth_sched_pfd_add(offloadfd, POLLIN);
+
+    /* a SIGCHLD caught just for child process events is not consumed
+       like the signals waited for by signal events, but still passed on
+       to the action of the application */
+    sigchain = (pidcatch && !sigismember(&pth_sigcatch, SIGCHLD));
+    if (pidcatch)
+        sigaddset(&pth_sigcatch, SIGCHLD);
+    if (sigchain)
+        sigaction(SIGCHLD, NULL, &pth_sigchld_osa);
 
     /* replace signal actions for signals we've to catch for events */
     for (sig = 1; sig < PTH_NSIG; sig++) {
         if (sigismember(&pth_sigcatch, sig)) {
-            sa.sa_handler = pth_sched_eventmanager_sighandler;
             sigfillset(&sa.sa_mask);
-            sa.sa_flags = 0;
+            if (sig == SIGCHLD && sigchain) {
+                sa.sa_sigaction = pth_sched_eventmanager_sigchain;
+                sa.sa_flags = SA_SIGINFO
+                              | (pth_sigchld_osa.sa_flags & (SA_NOCLDSTOP|SA_NOCLDWAIT));
+            }
+            else {
+                sa.sa_handler = pth_sched_eventmanager_sighandler;
+                sa.sa_flags = 0;
+            }
             sigaction(sig, &sa, &osa[sig]);
         }
     }
@@ -628,11 +889,12 @@ void pth_sched_eventmanager(pth_time_t *now, int dopoll)
     pth_sc(sigprocmask)(SIG_SETMASK, &pth_sigblock, &oss);
 
     /* now do the polling for filedescriptor I/O and timers
-       WHEN THE SCHEDULER SLEEPS AT ALL, THEN HERE!! */
-    rc = -1;
-    if (!(dopoll && fdmax == -1))
-        while ((rc = pth_sc(select)(fdmax+1, &rfds, &wfds, &efds, pdelay)) < 0
-               && errno == EINTR) ;
+       WHEN THE SCHEDULER SLEEPS AT ALL, THEN HERE!!
+       (ppoll(2) is used for its nanosecond timeout resolution and
+       because it takes time proportional to the number of waited-on
+       filedescriptors instead of their highest number) */
+    while ((rc = pth_util_ppoll(pth_pfd, pth_pfd_num, pdelay)) < 0
+           && errno == EINTR) ;
 
     /* restore signal mask and actions and handle signals */
     pth_sc(sigprocmask)(SIG_SETMASK, &oss, NULL);
@@ -652,22 +914,39 @@ void pth_sched_eventmanager(pth_time_t *now, int dopoll)
             pth_debug2("pth_sched_eventmanager: [timeout] event occurred for thread \"%s\"",
                        nexttimer_thread->name);
             nexttimer_ev->ev_status = PTH_STATUS_OCCURRED;
+            pth_timer_wakeups++;
         }
     }
 
-    /* if the internal signal pipe was used, adjust the select() results */
-    if (!dopoll && rc > 0 && FD_ISSET(pth_sigpipe[0], &rfds)) {
-        FD_CLR(pth_sigpipe[0], &rfds);
+    /* all other timers which elapsed meanwhile are handled below, too
+       (remember when the poll timeout was chosen, as only the timers
+       which were still ahead then were deferred into this wakeup) */
+    pollns = nowns;
+    if (!dopoll || rc > 0)
+        pth_timens_now(&nowns);
+
+    /* if the internal signal pipe was used, adjust the poll() results */
+    if (!dopoll && rc > 0 && sigpipeidx != -1 && pth_pfd[sigpipeidx].revents != 0)
         rc--;
+
+    /* if io_uring operations completed, reap them all at once */
+    if (uringfd != -1) {
+        if (rc > 0 && uringidx != -1 && pth_pfd[uringidx].revents != 0)
+            rc--;
+        pth_uring_reap();
     }
 
-    /* if an error occurred, avoid confusion in the cleanup loop */
-    if (rc <= 0) {
-        FD_ZERO(&rfds);
-        FD_ZERO(&wfds);
-        FD_ZERO(&efds);
+    /* if offloaded jobs completed, take them over all at once */
+    if (offloadfd != -1 && rc > 0 && offloadidx != -1 && pth_pfd[offloadidx].revents != 0) {
+        rc--;
+        pth_offload_reap();
     }
 
+    /* if an error occurred, avoid confusion in the cleanup loop */
+    if (rc <= 0)
+        for (i = 0; i < pth_pfd_num; i++)
+            pth_pfd[i].revents = 0;
+
     /* now comes the final cleanup loop where we've to
        do two jobs: first we've to do the late handling of the fd I/O events and
        additionally if a thread has one occurred event, we move it from the
@@ -689,90 +968,131 @@ void pth_sched_eventmanager(pth_time_t *now, int dopoll)
                 if (ev->ev_status == PTH_STATUS_PENDING) {
                     /* Filedescriptor I/O */
                     if (ev->ev_type == PTH_EVENT_FD) {
-                        if (   (   ev->ev_goal & PTH_UNTIL_FD_READABLE
-                                && FD_ISSET(ev->ev_args.FD.fd, &rfds))
-                            || (   ev->ev_goal & PTH_UNTIL_FD_WRITEABLE
-                                && FD_ISSET(ev->ev_args.FD.fd, &wfds))
-                            || (   ev->ev_goal & PTH_UNTIL_FD_EXCEPTION
-                                && FD_ISSET(ev->ev_args.FD.fd, &efds)) ) {
+                        revents = pth_pfd[ev->ev_pollidx].revents;
+                        if (revents & POLLNVAL) {
+                            ev->ev_status = PTH_STATUS_FAILED;
+                            pth_debug2("pth_sched_eventmanager: "
+                                       "[I/O] event failed for thread \"%s\"", t->name);
+                        }
+                        else if (   (   ev->ev_goal & PTH_UNTIL_FD_READABLE
+                                     && revents & PTH_POLL_RSET)
+                                 || (   ev->ev_goal & PTH_UNTIL_FD_WRITEABLE
+                                     && revents & PTH_POLL_WSET)
+                                 || (   ev->ev_goal & PTH_UNTIL_FD_EXCEPTION
+                                     && revents & PTH_POLL_ESET) ) {
                             pth_debug2("pth_sched_eventmanager: "
                                        "[I/O] event occurred for thread \"%s\"", t->name);
                             ev->ev_status = PTH_STATUS_OCCURRED;
                         }
-                        else if (rc < 0) {
-                            /* re-check particular filedescriptor */
-                            int rc2;
-                            if (ev->ev_goal & PTH_UNTIL_FD_READABLE)
-                                FD_SET(ev->ev_args.FD.fd, &rfds);
-                            if (ev->ev_goal & PTH_UNTIL_FD_WRITEABLE)
-                                FD_SET(ev->ev_args.FD.fd, &wfds);
-                            if (ev->ev_goal & PTH_UNTIL_FD_EXCEPTION)
-                                FD_SET(ev->ev_args.FD.fd, &efds);
-                            pth_time_set(&delay, PTH_TIME_ZERO);
-                            while ((rc2 = pth_sc(select)(ev->ev_args.FD.fd+1, &rfds, &wfds, &efds, &delay)) < 0
-                                   && errno == EINTR) ;
-                            if (rc2 > 0) {
-                                /* cleanup afterwards for next iteration */
-                                FD_CLR(ev->ev_args.FD.fd, &rfds);
-                                FD_CLR(ev->ev_args.FD.fd, &wfds);
-                                FD_CLR(ev->ev_args.FD.fd, &efds);
-                            } else if (rc2 < 0) {
-                                /* cleanup afterwards for next iteration */
-                                FD_ZERO(&rfds);
-                                FD_ZERO(&wfds);
-                                FD_ZERO(&efds);
+                    }
+                    /* Filedescriptor Set I/O */
+                    else if (ev->ev_type == PTH_EVENT_SELECT) {
+                        if (ev->ev_pollidx != -1 && (n = pth_sched_pfd_setsresult(ev)) != 0) {
+                            if (n < 0) {
                                 ev->ev_status = PTH_STATUS_FAILED;
                                 pth_debug2("pth_sched_eventmanager: "
                                            "[I/O] event failed for thread \"%s\"", t->name);
                             }
+                            else {
+                                if (ev->ev_args.SELECT.n != NULL)
+                                    *(ev->ev_args.SELECT.n) = n;
+                                ev->ev_status = PTH_STATUS_OCCURRED;
+                                pth_debug2("pth_sched_eventmanager: "
+                                           "[I/O] event occurred for thread \"%s\"", t->name);
+                            }
                         }
                     }
-                    /* Filedescriptor Set I/O */
-                    else if (ev->ev_type == PTH_EVENT_SELECT) {
-                        if (pth_util_fds_test(ev->ev_args.SELECT.nfd,
-                                              ev->ev_args.SELECT.rfds, &rfds,
-                                              ev->ev_args.SELECT.wfds, &wfds,
-                                              ev->ev_args.SELECT.efds, &efds)) {
-                            n = pth_util_fds_select(ev->ev_args.SELECT.nfd,
-                                                    ev->ev_args.SELECT.rfds, &rfds,
-                                                    ev->ev_args.SELECT.wfds, &wfds,
-                                                    ev->ev_args.SELECT.efds, &efds);
-                            if (ev->ev_args.SELECT.n != NULL)
-                                *(ev->ev_args.SELECT.n) = n;
+                    /* Filedescriptor Array Poll I/O */
+                    else if (ev->ev_type == PTH_EVENT_POLL) {
+                        n = 0;
+                        for (i = 0; i < ev->ev_args.POLL.nfd; i++)
+                            if (pth_pfd[(nfds_t)ev->ev_pollidx + i].revents != 0)
+                                n++;
+                        if (n > 0) {
+                            for (i = 0; i < ev->ev_args.POLL.nfd; i++)
+                                ev->ev_args.POLL.pfd[i].revents = pth_pfd[(nfds_t)ev->ev_pollidx + i].revents;
+                            if (ev->ev_args.POLL.n != NULL)
+                                *(ev->ev_args.POLL.n) = n;
                             ev->ev_status = PTH_STATUS_OCCURRED;
                             pth_debug2("pth_sched_eventmanager: "
                                        "[I/O] event occurred for thread \"%s\"", t->name);
                         }
-                        else if (rc < 0) {
-                            /* re-check particular filedescriptor set */
-                            int rc2;
-                            fd_set *prfds = NULL;
-                            fd_set *pwfds = NULL;
-                            fd_set *pefds = NULL;
-                            fd_set trfds;
-                            fd_set twfds;
-                            fd_set tefds;
-                            if (ev->ev_args.SELECT.rfds) {
-                                memcpy(&trfds, ev->ev_args.SELECT.rfds, sizeof(rfds));
-                                prfds = &trfds;
-                            }
-                            if (ev->ev_args.SELECT.wfds) {
-                                memcpy(&twfds, ev->ev_args.SELECT.wfds, sizeof(wfds));
-                                pwfds = &twfds;
-                            }
-                            if (ev->ev_args.SELECT.efds) {
-                                memcpy(&tefds, ev->ev_args.SELECT.efds, sizeof(efds));
-                                pefds = &tefds;
+                    }
+                    /* Notification Object */
+                    else if (ev->ev_type == PTH_EVENT_NOTIFY) {
+                        revents = pth_pfd[ev->ev_pollidx].revents;
+                        if (revents & POLLNVAL) {
+                            ev->ev_status = PTH_STATUS_FAILED;
+                            pth_debug2("pth_sched_eventmanager: "
+                                       "[notify] event failed for thread \"%s\"", t->name);
+                        }
+                        else if (revents & POLLIN) {
+                            /* consume all raises at once; other waiters on the
+                               same object still see their own revents and wake, too */
+                            pth_notify_drain(ev->ev_args.NOTIFY.nt);
+                            ev->ev_status = PTH_STATUS_OCCURRED;
+                            pth_debug2("pth_sched_eventmanager: "
+                                       "[notify] event occurred for thread \"%s\"", t->name);
+                        }
+                    }
+                    /* Timer */
+                    else if (ev->ev_type == PTH_EVENT_TIME) {
+                        if (pth_timens_cmp(&(ev->ev_args.TIME.ts), &nowns) <= 0) {
+                            pth_debug2("pth_sched_eventmanager: "
+                                       "[timeout] event occurred for thread \"%s\"", t->name);
+                            ev->ev_status = PTH_STATUS_OCCURRED;
+                            /* it shares the wakeup only thanks to the timer
+                               slack if it was still ahead when we started to
+                               sleep, but not beyond the deferred wakeup */
+                            if (   !dopoll && nexttimer_ev != NULL
+                                && nexttimer_ev->ev_type == PTH_EVENT_TIME
+                                && pth_timens_cmp(&(ev->ev_args.TIME.ts), &pollns) > 0
+                                && pth_timens_cmp(&(ev->ev_args.TIME.ts), &nexttimer_value) <= 0)
+                                pth_timer_coalesced++;
+                        }
+                    }
+                    /* Child Process Termination */
+                    else if (ev->ev_type == PTH_EVENT_PID) {
+                        if (ev->ev_args.PID.fd != -1) {
+                            revents = pth_pfd[ev->ev_pollidx].revents;
+                            if (revents & POLLIN) {
+                                ev->ev_status = PTH_STATUS_OCCURRED;
+                                pth_debug2("pth_sched_eventmanager: "
+                                           "[pid] event occurred for thread \"%s\"", t->name);
                             }
-                            pth_time_set(&delay, PTH_TIME_ZERO);
-                            while ((rc2 = pth_sc(select)(ev->ev_args.SELECT.nfd+1, prfds, pwfds, pefds, &delay)) < 0
-                                   && errno == EINTR) ;
-                            if (rc2 < 0) {
+                            else if (revents & POLLNVAL) {
                                 ev->ev_status = PTH_STATUS_FAILED;
                                 pth_debug2("pth_sched_eventmanager: "
-                                           "[I/O] event failed for thread \"%s\"", t->name);
+                                           "[pid] event failed for thread \"%s\"", t->name);
                             }
                         }
+                        else if (   sigismember(&pth_sigraised, SIGCHLD)
+                                 && pth_util_pid_exited(ev->ev_args.PID.pid)) {
+                            ev->ev_status = PTH_STATUS_OCCURRED;
+                            pth_debug2("pth_sched_eventmanager: "
+                                       "[pid] event occurred for thread \"%s\"", t->name);
+                        }
+                    }
+                    /* Zero-Copy Send Completion */
+                    else if (ev->ev_type == PTH_EVENT_ZEROCOPY) {
+                        revents = pth_pfd[ev->ev_pollidx].revents;
+                        reaped = FALSE;
+                        if (revents & POLLERR)
+                            reaped = pth_zerocopy_reap(ev->ev_args.ZEROCOPY.fd);
+                        if (pth_zerocopy_done(ev->ev_args.ZEROCOPY.fd, ev->ev_args.ZEROCOPY.seq)) {
+                            ev->ev_status = PTH_STATUS_OCCURRED;
+                            pth_debug2("pth_sched_eventmanager: "
+                                       "[zerocopy] event occurred for thread \"%s\"", t->name);
+                        }
+                        else if (   (revents & POLLNVAL) || reaped < 0
+                                 || ((revents & (POLLERR|POLLHUP)) == (POLLERR|POLLHUP) && !reaped)) {
+                            /* the connection broke or a socket error is pending
+                               (which poll(2) reports again and again): the
+                               buffers are never released */
+                            ev->ev_status = PTH_STATUS_FAILED;
+                            pth_debug2("pth_sched_eventmanager: "
+                                       "[zerocopy] event failed for thread \"%s\"", t->name);
+                        }
                     }
                     /* Signal Set */
                     else if (ev->ev_type == PTH_EVENT_SIGS) {
@@ -832,7 +1152,7 @@ void pth_sched_eventmanager(pth_time_t *now, int dopoll)
         if (any_occurred) {
             pth_pqueue_delete(&pth_WQ, tlast);
             tlast->state = PTH_STATE_READY;
-            pth_pqueue_insert(&pth_RQ, tlast->prio+1, tlast);
+            pth_pqueue_insert(&pth_RQ, pth_tcb_prio(tlast)+1, tlast);
             pth_debug2("pth_sched_eventmanager: thread \"%s\" moved from waiting "
                        "to ready queue", tlast->name);
         }
@@ -855,10 +1175,24 @@ static void pth_sched_eventmanager_sighandler(int sig)
     /* remember raised signal */
     sigaddset(&pth_sigraised, sig);
 
-    /* write signal to signal pipe in order to awake the select() */
+    /* write signal to signal pipe in order to awake the poll() */
     c = (int)sig;
     ssize_t written = pth_sc(write)(pth_sigpipe[1], &c, sizeof(char));
     (void)written;
     return;
 }
 
+static void pth_sched_eventmanager_sigchain(int sig, siginfo_t *si, void *uc)
+{
+    /* awake the poll() like for all other signals... */
+    pth_sched_eventmanager_sighandler(sig);
+
+    /* ...and pass the signal on to the replaced action */
+    if (pth_sigchld_osa.sa_flags & SA_SIGINFO)
+        pth_sigchld_osa.sa_sigaction(sig, si, uc);
+    else if (   pth_sigchld_osa.sa_handler != SIG_DFL
+             && pth_sigchld_osa.sa_handler != SIG_IGN)
+        pth_sigchld_osa.sa_handler(sig);
+    return;
+}
+
@@ -0,0 +1,322 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  This file is part of GNU Pth, a non-preemptive thread scheduling
+**  library which can be found at http://www.gnu.org/software/pth/.
+**
+**  This library is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU Lesser General Public
+**  License as published by the Free Software Foundation; either
+**  version 2.1 of the License, or (at your option) any later version.
+**
+**  This library is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**  Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public
+**  License along with this library; if not, write to the Free Software
+**  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+**  USA, or contact Ralf S. Engelschall <rse@engelschall.com>.
+**
+**  pth_stream.c: Pth buffered streams
+*/
+                             /* ``Buffering is the art of
+                                  doing things later.''
+                                                 -- Unknown */
+#include "pth_p.h"
+
+#if cpp
+
+/* buffered stream structure */
+struct pth_stream_st {
+    int     st_fd;     /* underlying filedescriptor                   */
+    char   *st_rbuf;   /* read buffer                                 */
+    size_t  st_rsize;  /* size of read buffer                         */
+    size_t  st_rpos;   /* start of unconsumed data in read buffer     */
+    size_t  st_rlen;   /* end of valid data in read buffer            */
+    size_t  st_rscan;  /* data behind st_rpos known to lack st_rdelim */
+    int     st_rdelim; /* delimiter st_rscan refers to                */
+    int     st_reof;   /* end of input reached                        */
+    char   *st_wbuf;   /* write buffer                                */
+    size_t  st_wsize;  /* size of write buffer                        */
+    size_t  st_wlen;   /* amount of pending data in write buffer      */
+};
+
+#endif /* cpp */
+
+/* create a new buffered stream on a filedescriptor */
+pth_stream_t pth_stream_create(int fd, size_t rsize, size_t wsize)
+{
+    pth_stream_t st;
+
+    if (!pth_util_fd_valid(fd))
+        return pth_error((pth_stream_t)NULL, EBADF);
+    if (rsize == 0)
+        rsize = PTH_STREAM_BUFSIZE;
+    if (wsize == 0)
+        wsize = PTH_STREAM_BUFSIZE;
+
+    /* allocate structure and both buffers in one chunk */
+    if ((st = (pth_stream_t)malloc(sizeof(struct pth_stream_st) + rsize + wsize)) == NULL)
+        return pth_error((pth_stream_t)NULL, ENOMEM);
+    st->st_fd     = fd;
+    st->st_rbuf   = (char *)(st + 1);
+    st->st_rsize  = rsize;
+    st->st_rpos   = 0;
+    st->st_rlen   = 0;
+    st->st_rscan  = 0;
+    st->st_rdelim = -1;
+    st->st_reof   = FALSE;
+    st->st_wbuf   = st->st_rbuf + rsize;
+    st->st_wsize  = wsize;
+    st->st_wlen   = 0;
+    return st;
+}
+
+/* flush and destroy a buffered stream (the filedescriptor stays open) */
+int pth_stream_destroy(pth_stream_t st)
+{
+    int rc;
+
+    if (st == NULL)
+        return pth_error(FALSE, EINVAL);
+    rc = pth_stream_flush(st, NULL);
+    pth_shield { free(st); }
+    return rc;
+}
+
+/* return the filedescriptor of a buffered stream */
+int pth_stream_fd(pth_stream_t st)
+{
+    if (st == NULL)
+        return pth_error(-1, EINVAL);
+    return st->st_fd;
+}
+
+/* read more data into the read buffer */
+static ssize_t pth_stream_fill(pth_stream_t st, pth_event_t ev_extra)
+{
+    ssize_t n;
+
+    /* move unconsumed data to the front to make room */
+    if (st->st_rpos > 0) {
+        if (st->st_rlen > st->st_rpos)
+            memmove(st->st_rbuf, st->st_rbuf + st->st_rpos, st->st_rlen - st->st_rpos);
+        st->st_rlen -= st->st_rpos;
+        st->st_rpos  = 0;
+    }
+    if (st->st_rlen == st->st_rsize)
+        return pth_error(-1, ENOBUFS);
+
+    n = pth_read_ev(st->st_fd, st->st_rbuf + st->st_rlen, st->st_rsize - st->st_rlen, ev_extra);
+    if (n > 0)
+        st->st_rlen += (size_t)n;
+    else if (n == 0)
+        st->st_reof = TRUE;
+    return n;
+}
+
+/* read up to nbytes of data (without waiting for more once some is available) */
+ssize_t pth_stream_read(pth_stream_t st, void *buf, size_t nbytes, pth_event_t ev_extra)
+{
+    ssize_t n;
+    size_t avail;
+
+    if (st == NULL || (buf == NULL && nbytes > 0))
+        return pth_error(-1, EINVAL);
+    if (nbytes == 0)
+        return 0;
+
+    /* large reads into an empty buffer bypass it */
+    if (st->st_rpos == st->st_rlen) {
+        if (st->st_reof)
+            return 0;
+        if (nbytes >= st->st_rsize) {
+            if ((n = pth_read_ev(st->st_fd, buf, nbytes, ev_extra)) == 0)
+                st->st_reof = TRUE;
+            return n;
+        }
+        if ((n = pth_stream_fill(st, ev_extra)) <= 0)
+            return n;
+    }
+
+    /* serve from the buffer */
+    avail = st->st_rlen - st->st_rpos;
+    if (nbytes > avail)
+        nbytes = avail;
+    memcpy(buf, st->st_rbuf + st->st_rpos, nbytes);
+    pth_stream_consume(st, nbytes);
+    return (ssize_t)nbytes;
+}
+
+/* read data up to and including a delimiter, but at most nbytes */
+ssize_t pth_stream_readuntil(pth_stream_t st, int delim, void *buf, size_t nbytes, pth_event_t ev_extra)
+{
+    size_t done, chunk;
+    char *cp;
+    ssize_t n;
+
+    if (st == NULL || (buf == NULL && nbytes > 0))
+        return pth_error(-1, EINVAL);
+
+    /* scan and copy each buffered byte exactly once,
+       letting memchr(3) do the scanning word- or vector-wise */
+    done = 0;
+    while (done < nbytes) {
+        chunk = st->st_rlen - st->st_rpos;
+        if (chunk > 0) {
+            if (chunk > nbytes - done)
+                chunk = nbytes - done;
+            cp = (char *)memchr(st->st_rbuf + st->st_rpos, delim, chunk);
+            if (cp != NULL)
+                chunk = (size_t)(cp - (st->st_rbuf + st->st_rpos)) + 1;
+            memcpy((char *)buf + done, st->st_rbuf + st->st_rpos, chunk);
+            pth_stream_consume(st, chunk);
+            done += chunk;
+            if (cp != NULL)
+                break;
+            continue;
+        }
+        if (st->st_reof)
+            break;
+        if ((n = pth_stream_fill(st, ev_extra)) < 0) {
+            /* do not lose already consumed data */
+            if (done == 0)
+                return -1;
+            break;
+        }
+    }
+    return (ssize_t)done;
+}
+
+/* make at least nbytes of data available in the read buffer without consuming it */
+ssize_t pth_stream_peek(pth_stream_t st, size_t nbytes, const void **data, pth_event_t ev_extra)
+{
+    ssize_t n;
+
+    if (st == NULL || data == NULL || nbytes > st->st_rsize)
+        return pth_error(-1, EINVAL);
+    if (nbytes == 0)
+        nbytes = 1;
+    while (st->st_rlen - st->st_rpos < nbytes && !st->st_reof)
+        if ((n = pth_stream_fill(st, ev_extra)) < 0)
+            return -1;
+    *data = st->st_rbuf + st->st_rpos;
+    return (ssize_t)(st->st_rlen - st->st_rpos);
+}
+
+/* make data up to and including a delimiter available in the read
+   buffer without consuming it (the data is scanned only once, even if
+   it has to be called again after an interruption) */
+ssize_t pth_stream_peekuntil(pth_stream_t st, int delim, const void **data, pth_event_t ev_extra)
+{
+    char *cp;
+    ssize_t n;
+
+    if (st == NULL || data == NULL)
+        return pth_error(-1, EINVAL);
+    if (st->st_rdelim != delim) {
+        st->st_rdelim = delim;
+        st->st_rscan  = 0;
+    }
+    for (;;) {
+        cp = (char *)memchr(st->st_rbuf + st->st_rpos + st->st_rscan, delim,
+                            st->st_rlen - st->st_rpos - st->st_rscan);
+        if (cp != NULL) {
+            *data = st->st_rbuf + st->st_rpos;
+            return (ssize_t)(cp - (st->st_rbuf + st->st_rpos)) + 1;
+        }
+        st->st_rscan = st->st_rlen - st->st_rpos;
+        if (st->st_reof) {
+            *data = st->st_rbuf + st->st_rpos;
+            return (ssize_t)st->st_rscan;
+        }
+        if ((n = pth_stream_fill(st, ev_extra)) < 0)
+            return -1;
+    }
+}
+
+/* consume data from the read buffer */
+int pth_stream_consume(pth_stream_t st, size_t nbytes)
+{
+    if (st == NULL || nbytes > st->st_rlen - st->st_rpos)
+        return pth_error(FALSE, EINVAL);
+    st->st_rpos += nbytes;
+    st->st_rscan = (st->st_rscan > nbytes ? st->st_rscan - nbytes : 0);
+    if (st->st_rpos == st->st_rlen)
+        st->st_rpos = st->st_rlen = 0;
+    return TRUE;
+}
+
+/* write data through the write buffer */
+ssize_t pth_stream_write(pth_stream_t st, const void *buf, size_t nbytes, pth_event_t ev_extra)
+{
+    struct iovec iov[2];
+    size_t taken;
+    ssize_t n;
+
+    if (st == NULL || (buf == NULL && nbytes > 0))
+        return pth_error(-1, EINVAL);
+
+    /* just buffer the data if it fits */
+    if (st->st_wlen + nbytes <= st->st_wsize) {
+        memcpy(st->st_wbuf + st->st_wlen, buf, nbytes);
+        st->st_wlen += nbytes;
+        return (ssize_t)nbytes;
+    }
+
+    /* else write out the pending and the new data with a single call */
+    iov[0].iov_base = st->st_wbuf;
+    iov[0].iov_len  = st->st_wlen;
+    iov[1].iov_base = (void *)buf;
+    iov[1].iov_len  = nbytes;
+    if ((n = pth_writev_ev(st->st_fd, iov, 2, ev_extra)) < 0)
+        return -1;
+    if ((size_t)n < st->st_wlen) {
+        memmove(st->st_wbuf, st->st_wbuf + n, st->st_wlen - (size_t)n);
+        st->st_wlen -= (size_t)n;
+        taken = 0;
+    }
+    else {
+        taken = (size_t)n - st->st_wlen;
+        st->st_wlen = 0;
+    }
+
+    /* on an interrupted write keep as much of the rest as fits */
+    if (taken < nbytes) {
+        n = (ssize_t)(nbytes - taken);
+        if ((size_t)n > st->st_wsize - st->st_wlen)
+            n = (ssize_t)(st->st_wsize - st->st_wlen);
+        memcpy(st->st_wbuf + st->st_wlen, (const char *)buf + taken, (size_t)n);
+        st->st_wlen += (size_t)n;
+        taken += (size_t)n;
+        if (taken == 0)
+            return pth_error(-1, ev_extra != NULL ? EINTR : EAGAIN);
+    }
+    return (ssize_t)taken;
+}
+
+/* write out all pending data of the write buffer */
+int pth_stream_flush(pth_stream_t st, pth_event_t ev_extra)
+{
+    ssize_t n;
+
+    if (st == NULL)
+        return pth_error(FALSE, EINVAL);
+    if (st->st_wlen == 0)
+        return TRUE;
+    if ((n = pth_write_ev(st->st_fd, st->st_wbuf, st->st_wlen, ev_extra)) < 0)
+        return FALSE;
+
+    /* keep the rest if the write was interrupted by the extra
+       event or the filedescriptor is in non-blocking mode */
+    if ((size_t)n < st->st_wlen) {
+        memmove(st->st_wbuf, st->st_wbuf + n, st->st_wlen - (size_t)n);
+        st->st_wlen -= (size_t)n;
+        return pth_error(FALSE, ev_extra != NULL ? EINTR : EAGAIN);
+    }
+    st->st_wlen = 0;
+    return TRUE;
+}
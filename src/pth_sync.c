@@ -27,11 +27,42 @@
                                   with the turkeys.''
                                           -- Unknown  */
 #include "pth_p.h"
+#include <limits.h>
 
 /*
 **  Mutual Exclusion Locks
 */
 
+/*
+ * A released mutex is normally just unlocked and all waiting threads
+ * compete for it again, so a thread which releases and immediately
+ * reacquires it can starve the others. In fair mode (PTH_MUTEX_FAIR) the
+ * waiting threads are queued instead and a release hands the ownership
+ * directly over to the oldest of them, so only this thread is readied.
+ * Before a thread starts waiting it can optionally yield a few times, in
+ * case the owner just needs a moment to finish a short critical section.
+ * With priority inheritance (PTH_MUTEX_INHERIT) the queue is ordered by
+ * priority instead and the owner is scheduled with the priority of its
+ * most urgent waiter, so a low priority thread holding the mutex is not
+ * kept from releasing it by threads of medium priority. The boost is
+ * passed on if the owner itself waits for such a mutex.
+ */
+
+/* thread queued on a fair or priority inheritance mutex */
+typedef struct pth_mutex_waiter_st pth_mutex_waiter_t;
+struct pth_mutex_waiter_st {
+    pth_mutex_waiter_t *mw_next;
+    pth_mutex_t        *mw_mutex;    /* mutex the thread waits for      */
+    pth_t               mw_tid;      /* waiting thread                  */
+    pth_event_t         mw_ev;       /* event the thread waits for      */
+    int                 mw_granted;  /* ownership was handed over       */
+    int                 mw_prio;     /* priority of the thread in queue */
+};
+
+static unsigned long pth_mutex_contended = 0;  /* statistics: acquisitions which had to wait */
+static unsigned long pth_mutex_handoffs  = 0;  /* statistics: ownership handoffs            */
+static unsigned long pth_mutex_waittime  = 0;  /* statistics: sum of waiting times (us)     */
+
 int pth_mutex_init(pth_mutex_t *mutex)
 {
     if (mutex == NULL)
@@ -39,13 +70,192 @@ int pth_mutex_init(pth_mutex_t *mutex)
     mutex->mx_state = PTH_MUTEX_INITIALIZED;
     mutex->mx_owner = NULL;
     mutex->mx_count = 0;
+    mutex->mx_spins = 0;
+    mutex->mx_whead = NULL;
+    mutex->mx_wtail = NULL;
+    return TRUE;
+}
+
+int pth_mutex_setmode(pth_mutex_t *mutex, int mode, int spins)
+{
+    /* consistency checks */
+    if (mutex == NULL || spins < 0 || (mode & ~(PTH_MUTEX_FAIR|PTH_MUTEX_INHERIT)) != 0)
+        return pth_error(FALSE, EINVAL);
+    if (!(mutex->mx_state & PTH_MUTEX_INITIALIZED))
+        return pth_error(FALSE, EDEADLK);
+    if (mutex->mx_whead != NULL)
+        return pth_error(FALSE, EBUSY);
+
+    /* switch mode */
+    mutex->mx_state = (mutex->mx_state & ~(PTH_MUTEX_FAIR|PTH_MUTEX_INHERIT)) | mode;
+    mutex->mx_spins = spins;
     return TRUE;
 }
 
+/* make a thread the owner of a mutex */
+static void pth_mutex_own(pth_mutex_t *mutex, pth_t t)
+{
+    mutex->mx_state |= PTH_MUTEX_LOCKED;
+    mutex->mx_owner = t;
+    mutex->mx_count = 1;
+    pth_ring_append(&(t->mutexring), &(mutex->mx_node));
+    return;
+}
+
+/* determine the priority a thread inherits from the waiters of its mutexes */
+static int pth_mutex_inherited(pth_t t)
+{
+    pth_ringnode_t *rn;
+    pth_mutex_t *mutex;
+    int prio;
+
+    prio = PTH_PRIO_MIN;
+    rn = pth_ring_first(&(t->mutexring));
+    while (rn != NULL) {
+        mutex = (pth_mutex_t *)rn;
+        /* the queue is ordered, so the head is the most urgent waiter */
+        if ((mutex->mx_state & PTH_MUTEX_INHERIT) && mutex->mx_whead != NULL)
+            if (mutex->mx_whead->mw_prio > prio)
+                prio = mutex->mx_whead->mw_prio;
+        rn = pth_ring_next(&(t->mutexring), rn);
+    }
+    return prio;
+}
+
+/* queue a thread on a mutex (in priority order for inheritance mutexes) */
+static void pth_mutex_enqueue(pth_mutex_t *mutex, pth_mutex_waiter_t *mw)
+{
+    pth_mutex_waiter_t **pmw;
+
+    if (   !(mutex->mx_state & PTH_MUTEX_INHERIT)
+        || mutex->mx_wtail == NULL
+        || mutex->mx_wtail->mw_prio >= mw->mw_prio) {
+        mw->mw_next = NULL;
+        if (mutex->mx_wtail != NULL)
+            mutex->mx_wtail->mw_next = mw;
+        else
+            mutex->mx_whead = mw;
+        mutex->mx_wtail = mw;
+        return;
+    }
+    /* behind all waiters of at least the same priority */
+    for (pmw = &(mutex->mx_whead); (*pmw)->mw_prio >= mw->mw_prio; pmw = &((*pmw)->mw_next))
+        ;
+    mw->mw_next = *pmw;
+    *pmw = mw;
+    return;
+}
+
+/* remove a thread from the queue of a mutex (if still queued) */
+static void pth_mutex_dequeue(void *arg)
+{
+    pth_mutex_waiter_t *mw = (pth_mutex_waiter_t *)arg;
+    pth_mutex_waiter_t **pmw;
+    pth_mutex_waiter_t *prev;
+
+    prev = NULL;
+    for (pmw = &(mw->mw_mutex->mx_whead); *pmw != NULL; pmw = &((*pmw)->mw_next)) {
+        if (*pmw == mw) {
+            *pmw = mw->mw_next;
+            if (mw->mw_mutex->mx_wtail == mw)
+                mw->mw_mutex->mx_wtail = prev;
+            break;
+        }
+        prev = *pmw;
+    }
+    return;
+}
+
+/* recalculate the inherited priority of a thread and pass a
+   change on along the chain of mutex owners it waits for */
+static void pth_mutex_reprioritize(pth_t t)
+{
+    pth_mutex_waiter_t *mw;
+    int prio;
+    int depth;
+
+    /* the depth limit protects against cycles of deadlocked threads */
+    for (depth = 0; t != NULL && depth < 64; depth++) {
+        prio = pth_tcb_prio(t);
+        t->prioinherit = pth_mutex_inherited(t);
+        if (pth_tcb_prio(t) == prio)
+            break;
+        pth_debug3("pth_mutex_reprioritize: thread \"%s\" runs with priority %d",
+                   t->name, pth_tcb_prio(t));
+
+        /* a ready thread has to be queued again to take effect */
+        if (t->state == PTH_STATE_READY && pth_pqueue_contains(&pth_RQ, t)) {
+            pth_pqueue_delete(&pth_RQ, t);
+            pth_pqueue_insert(&pth_RQ, pth_tcb_prio(t), t);
+        }
+
+        /* a waiting thread moves within its queue and passes
+           the change on to the owner of that mutex */
+        if ((mw = t->mutexwait) == NULL)
+            break;
+        pth_mutex_dequeue(mw);
+        mw->mw_prio = pth_tcb_prio(t);
+        pth_mutex_enqueue(mw->mw_mutex, mw);
+        t = mw->mw_mutex->mx_owner;
+    }
+    return;
+}
+
+/* take a mutex away from its owner and pass it on (if somebody is queued) */
+static void pth_mutex_disown(pth_mutex_t *mutex)
+{
+    pth_mutex_waiter_t *mw;
+    pth_t owner;
+
+    owner = mutex->mx_owner;
+    pth_ring_delete(&(owner->mutexring), &(mutex->mx_node));
+    if ((mw = mutex->mx_whead) != NULL) {
+        /* hand the mutex directly over to the first waiter */
+        if ((mutex->mx_whead = mw->mw_next) == NULL)
+            mutex->mx_wtail = NULL;
+        mw->mw_granted = TRUE;
+        mw->mw_ev->ev_status = PTH_STATUS_OCCURRED;
+        mw->mw_tid->mutexwait = NULL;
+        pth_mutex_own(mutex, mw->mw_tid);
+        pth_mutex_handoffs++;
+        pth_debug2("pth_mutex_release: mutex handed over to thread \"%s\"", mw->mw_tid->name);
+    }
+    else {
+        mutex->mx_state &= ~(PTH_MUTEX_LOCKED);
+        mutex->mx_owner = NULL;
+        mutex->mx_count = 0;
+    }
+
+    /* the boost moves together with the mutex */
+    if (mutex->mx_state & PTH_MUTEX_INHERIT) {
+        pth_mutex_reprioritize(owner);
+        if (mw != NULL)
+            pth_mutex_reprioritize(mw->mw_tid);
+    }
+    return;
+}
+
+/* give up waiting for a mutex (cleanup handler) */
+static void pth_mutex_abandon(void *arg)
+{
+    pth_mutex_waiter_t *mw = (pth_mutex_waiter_t *)arg;
+
+    pth_mutex_dequeue(mw);
+    mw->mw_tid->mutexwait = NULL;
+    if ((mw->mw_mutex->mx_state & PTH_MUTEX_INHERIT) && !mw->mw_granted)
+        pth_mutex_reprioritize(mw->mw_mutex->mx_owner);
+    return;
+}
+
 int pth_mutex_acquire(pth_mutex_t *mutex, int tryonly, pth_event_t ev_extra)
 {
     static pth_key_t ev_key = PTH_KEY_INIT;
+    pth_mutex_waiter_t mw;
+    struct timespec t0, t1;
     pth_event_t ev;
+    int spins;
+    int rc;
+    int err;
 
     pth_debug2("pth_mutex_acquire: called from thread \"%s\"", pth_current->name);
 
@@ -57,10 +267,7 @@ int pth_mutex_acquire(pth_mutex_t *mutex, int tryonly, pth_event_t ev_extra)
 
     /* still not locked, so simply acquire mutex? */
     if (!(mutex->mx_state & PTH_MUTEX_LOCKED)) {
-        mutex->mx_state |= PTH_MUTEX_LOCKED;
-        mutex->mx_owner = pth_current;
-        mutex->mx_count = 1;
-        pth_ring_append(&(pth_current->mutexring), &(mutex->mx_node));
+        pth_mutex_own(mutex, pth_current);
         pth_debug1("pth_mutex_acquire: immediately locking mutex");
         return TRUE;
     }
@@ -77,28 +284,78 @@ int pth_mutex_acquire(pth_mutex_t *mutex, int tryonly, pth_event_t ev_extra)
     if (tryonly)
         return pth_error(FALSE, EBUSY);
 
-    /* else wait for mutex to become unlocked.. */
-    pth_debug1("pth_mutex_acquire: wait until mutex is unlocked");
-    for (;;) {
-        ev = pth_event(PTH_EVENT_MUTEX|PTH_MODE_STATIC, &ev_key, mutex);
-        if (ev_extra != NULL)
-            pth_event_concat(ev, ev_extra, NULL);
-        pth_wait(ev);
-        if (ev_extra != NULL) {
-            pth_event_isolate(ev);
-            if (pth_event_status(ev) == PTH_STATUS_PENDING)
-                return pth_error(FALSE, EINTR);
-        }
+    /* the mutex is contended */
+    pth_mutex_contended++;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    /* give the owner a few chances to finish a short critical
+       section (if waiters are queued the mutex can only be unlocked
+       afterwards if nobody is queued) */
+    for (spins = mutex->mx_spins; spins > 0; spins--) {
+        pth_yield(NULL);
         if (!(mutex->mx_state & PTH_MUTEX_LOCKED))
             break;
     }
 
-    /* now it's again unlocked, so acquire mutex */
-    pth_debug1("pth_mutex_acquire: locking mutex");
-    mutex->mx_state |= PTH_MUTEX_LOCKED;
-    mutex->mx_owner = pth_current;
-    mutex->mx_count = 1;
-    pth_ring_append(&(pth_current->mutexring), &(mutex->mx_node));
+    err = 0;
+    if (!(mutex->mx_state & PTH_MUTEX_LOCKED)) {
+        /* got free while yielding, so acquire mutex */
+        pth_debug1("pth_mutex_acquire: locking mutex after yielding");
+        pth_mutex_own(mutex, pth_current);
+    }
+    else if (mutex->mx_state & (PTH_MUTEX_FAIR|PTH_MUTEX_INHERIT)) {
+        /* queue up and wait until the ownership is handed over */
+        pth_debug1("pth_mutex_acquire: wait until mutex is handed over");
+        ev = pth_event(PTH_EVENT_MUTEX|PTH_MODE_STATIC, &ev_key, mutex);
+        mw.mw_mutex   = mutex;
+        mw.mw_tid     = pth_current;
+        mw.mw_ev      = ev;
+        mw.mw_granted = FALSE;
+        mw.mw_prio    = pth_tcb_prio(pth_current);
+        pth_mutex_enqueue(mutex, &mw);
+        if (mutex->mx_state & PTH_MUTEX_INHERIT) {
+            /* lend the owner our priority */
+            pth_current->mutexwait = &mw;
+            pth_mutex_reprioritize(mutex->mx_owner);
+        }
+        pth_cleanup_push(pth_mutex_abandon, &mw);
+        while (!mw.mw_granted) {
+            ev = pth_event(PTH_EVENT_MUTEX|PTH_MODE_STATIC, &ev_key, mutex);
+            if (ev_extra != NULL)
+                pth_event_concat(ev, ev_extra, NULL);
+            rc = pth_wait(ev);
+            if (mw.mw_granted)
+                break;
+            if ((err = pth_wait_result(ev, ev_extra, rc)) != 0)
+                break;
+        }
+        pth_cleanup_pop(TRUE);
+    }
+    else {
+        /* else wait for mutex to become unlocked.. */
+        pth_debug1("pth_mutex_acquire: wait until mutex is unlocked");
+        for (;;) {
+            ev = pth_event(PTH_EVENT_MUTEX|PTH_MODE_STATIC, &ev_key, mutex);
+            if (ev_extra != NULL)
+                pth_event_concat(ev, ev_extra, NULL);
+            if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0)
+                break;
+            if (!(mutex->mx_state & PTH_MUTEX_LOCKED))
+                break;
+        }
+
+        /* now it's again unlocked, so acquire mutex */
+        if (err == 0) {
+            pth_debug1("pth_mutex_acquire: locking mutex");
+            pth_mutex_own(mutex, pth_current);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    pth_mutex_waittime += (unsigned long)((t1.tv_sec  - t0.tv_sec) * 1000000L
+                                        + (t1.tv_nsec - t0.tv_nsec) / 1000L);
+    if (err != 0)
+        return pth_error(FALSE, err);
     return TRUE;
 }
 
@@ -116,77 +373,323 @@ int pth_mutex_release(pth_mutex_t *mutex)
 
     /* decrement recursion counter and release mutex */
     mutex->mx_count--;
-    if (mutex->mx_count <= 0) {
-        mutex->mx_state &= ~(PTH_MUTEX_LOCKED);
-        mutex->mx_owner = NULL;
-        mutex->mx_count = 0;
-        pth_ring_delete(&(pth_current->mutexring), &(mutex->mx_node));
-    }
+    if (mutex->mx_count <= 0)
+        pth_mutex_disown(mutex);
     return TRUE;
 }
 
 void pth_mutex_releaseall(pth_t thread)
 {
-    pth_ringnode_t *rn, *rnf;
+    pth_ringnode_t *rn;
 
     if (thread == NULL)
         return;
-    /* iterate over all mutexes of thread */
-    rn = rnf = pth_ring_first(&(thread->mutexring));
-    while (rn != NULL) {
-        pth_mutex_release((pth_mutex_t *)rn);
-        rn = pth_ring_next(&(thread->mutexring), rn);
-        if (rn == rnf)
-            break;
-    }
+    /* release all mutexes still held by thread, regardless
+       of recursion, as a terminated thread cannot do it later */
+    while ((rn = pth_ring_first(&(thread->mutexring))) != NULL)
+        pth_mutex_disown((pth_mutex_t *)rn);
     return;
 }
 
+/* query the mutex contention statistics */
+long pth_mutex_stat(int which)
+{
+    if (which == PTH_CTRL_GETMUTEXCONTENDED)
+        return (long)pth_mutex_contended;
+    else if (which == PTH_CTRL_GETMUTEXHANDOFFS)
+        return (long)pth_mutex_handoffs;
+    else if (which == PTH_CTRL_GETMUTEXWAITTIME)
+        return (long)pth_mutex_waittime;
+    return 0;
+}
+
 /*
 **  Read-Write Locks
 */
 
+/*
+ * Readers are only counted and a writer is recorded as owner, so no
+ * operation needs a mutex and releasing never blocks. Waiting threads
+ * are kept in wait lists and the releasing thread grants the lock
+ * directly to the threads which can proceed: a waiting writer is
+ * preferred (new readers queue up behind it and it gets the lock once
+ * the last reader left), else all waiting readers are let in at once.
+ * A pending upgrade of a reader goes before everything else.
+ */
+
+#if cpp
+#define PTH_EVENT_GRANT      _BIT(27)
+#endif /* cpp */
+
+#define PTH_RWLOCK_UPGRADE 2
+
+/* thread waiting for a read-write lock */
+typedef struct pth_rwlock_waiter_st pth_rwlock_waiter_t;
+struct pth_rwlock_waiter_st {
+    pth_rwlock_waiter_t *ww_next;
+    pth_rwlock_t        *ww_rwlock;   /* lock the thread waits for             */
+    pth_t                ww_tid;      /* waiting thread                        */
+    int                  ww_op;       /* PTH_RWLOCK_{RD,RW,UPGRADE}            */
+    pth_event_t          ww_ev;       /* event the thread waits for            */
+    int                  ww_granted;  /* lock was granted                      */
+};
+
 int pth_rwlock_init(pth_rwlock_t *rwlock)
 {
     if (rwlock == NULL)
         return pth_error(FALSE, EINVAL);
-    rwlock->rw_state = PTH_RWLOCK_INITIALIZED;
-    rwlock->rw_readers = 0;
-    pth_mutex_init(&(rwlock->rw_mutex_rd));
-    pth_mutex_init(&(rwlock->rw_mutex_rw));
+    rwlock->rw_state    = PTH_RWLOCK_INITIALIZED;
+    rwlock->rw_mode     = PTH_RWLOCK_RD;
+    rwlock->rw_readers  = 0;
+    rwlock->rw_writer   = NULL;
+    rwlock->rw_count    = 0;
+    rwlock->rw_rwait    = NULL;
+    rwlock->rw_wwait    = NULL;
+    rwlock->rw_wlast    = NULL;
+    rwlock->rw_upgrader = NULL;
     return TRUE;
 }
 
+/* make a thread the writer of a read-write lock */
+static void pth_rwlock_own(pth_rwlock_t *rwlock, pth_t t)
+{
+    rwlock->rw_mode   = PTH_RWLOCK_RW;
+    rwlock->rw_writer = t;
+    rwlock->rw_count  = 1;
+    return;
+}
+
+/* grant the lock to a waiting thread */
+static void pth_rwlock_grant(pth_rwlock_waiter_t *ww)
+{
+    ww->ww_granted = TRUE;
+    ww->ww_ev->ev_status = PTH_STATUS_OCCURRED;
+    return;
+}
+
+/* grant the lock to the waiting threads which can proceed now */
+static void pth_rwlock_wakeup(pth_rwlock_t *rwlock)
+{
+    pth_rwlock_waiter_t *ww;
+
+    if (rwlock->rw_writer != NULL)
+        return;
+
+    /* a pending upgrade goes first, once its reader is the last one */
+    if ((ww = rwlock->rw_upgrader) != NULL) {
+        if (rwlock->rw_readers == 1) {
+            rwlock->rw_upgrader = NULL;
+            rwlock->rw_readers  = 0;
+            pth_rwlock_own(rwlock, ww->ww_tid);
+            pth_rwlock_grant(ww);
+        }
+        return;
+    }
+
+    /* then the oldest writer, once all readers left */
+    if ((ww = rwlock->rw_wwait) != NULL) {
+        if (rwlock->rw_readers == 0) {
+            if ((rwlock->rw_wwait = ww->ww_next) == NULL)
+                rwlock->rw_wlast = NULL;
+            pth_rwlock_own(rwlock, ww->ww_tid);
+            pth_rwlock_grant(ww);
+        }
+        return;
+    }
+
+    /* else let all waiting readers in at once */
+    while ((ww = rwlock->rw_rwait) != NULL) {
+        rwlock->rw_rwait = ww->ww_next;
+        rwlock->rw_mode = PTH_RWLOCK_RD;
+        rwlock->rw_readers++;
+        pth_rwlock_grant(ww);
+    }
+    return;
+}
+
+/* give up waiting for a read-write lock (or the lock
+   itself, if it was granted to a cancelled thread) */
+static void pth_rwlock_abandon(void *arg)
+{
+    pth_rwlock_waiter_t *ww = (pth_rwlock_waiter_t *)arg;
+    pth_rwlock_t *rwlock = ww->ww_rwlock;
+    pth_rwlock_waiter_t **pww;
+    pth_rwlock_waiter_t *prev;
+
+    if (ww->ww_granted) {
+        if (rwlock->rw_writer == ww->ww_tid) {
+            rwlock->rw_writer = NULL;
+            rwlock->rw_count  = 0;
+        }
+        else
+            rwlock->rw_readers--;
+    }
+    else if (ww->ww_op == PTH_RWLOCK_UPGRADE)
+        rwlock->rw_upgrader = NULL;
+    else {
+        prev = NULL;
+        pww = (ww->ww_op == PTH_RWLOCK_RD ? &(rwlock->rw_rwait) : &(rwlock->rw_wwait));
+        for (; *pww != NULL; pww = &((*pww)->ww_next)) {
+            if (*pww == ww) {
+                *pww = ww->ww_next;
+                if (ww->ww_op == PTH_RWLOCK_RW && rwlock->rw_wlast == ww)
+                    rwlock->rw_wlast = prev;
+                break;
+            }
+            prev = *pww;
+        }
+    }
+
+    /* others might have waited just for this thread */
+    pth_rwlock_wakeup(rwlock);
+    return;
+}
+
+/* queue up for a read-write lock and wait until it is granted */
+static int pth_rwlock_wait(pth_rwlock_t *rwlock, int op, pth_event_t ev_extra)
+{
+    static pth_key_t ev_key = PTH_KEY_INIT;
+    pth_rwlock_waiter_t ww;
+    pth_event_t ev;
+    int rc;
+    int err;
+
+    ww.ww_next    = NULL;
+    ww.ww_rwlock  = rwlock;
+    ww.ww_tid     = pth_current;
+    ww.ww_op      = op;
+    ww.ww_granted = FALSE;
+    if ((ww.ww_ev = pth_event(PTH_EVENT_GRANT|PTH_MODE_STATIC, &ev_key, &ww.ww_granted)) == NULL)
+        return errno;
+    if (op == PTH_RWLOCK_UPGRADE)
+        rwlock->rw_upgrader = &ww;
+    else if (op == PTH_RWLOCK_RW) {
+        if (rwlock->rw_wlast != NULL)
+            rwlock->rw_wlast->ww_next = &ww;
+        else
+            rwlock->rw_wwait = &ww;
+        rwlock->rw_wlast = &ww;
+    }
+    else {
+        ww.ww_next = rwlock->rw_rwait;
+        rwlock->rw_rwait = &ww;
+    }
+
+    err = 0;
+    pth_cleanup_push(pth_rwlock_abandon, &ww);
+    while (!ww.ww_granted) {
+        ev = pth_event(PTH_EVENT_GRANT|PTH_MODE_STATIC, &ev_key, &ww.ww_granted);
+        if (ev_extra != NULL)
+            pth_event_concat(ev, ev_extra, NULL);
+        rc = pth_wait(ev);
+        if (ww.ww_granted)
+            break;
+        if ((err = pth_wait_result(ev, ev_extra, rc)) != 0)
+            break;
+    }
+    pth_cleanup_pop(FALSE);
+    if (!ww.ww_granted)
+        pth_rwlock_abandon(&ww);
+    return err;
+}
+
 int pth_rwlock_acquire(pth_rwlock_t *rwlock, int op, int tryonly, pth_event_t ev_extra)
 {
+    int err;
+
     /* consistency checks */
-    if (rwlock == NULL)
+    if (rwlock == NULL || (op != PTH_RWLOCK_RD && op != PTH_RWLOCK_RW))
         return pth_error(FALSE, EINVAL);
     if (!(rwlock->rw_state & PTH_RWLOCK_INITIALIZED))
         return pth_error(FALSE, EDEADLK);
 
-    /* acquire lock */
     if (op == PTH_RWLOCK_RW) {
-        /* read-write lock is simple */
-        if (!pth_mutex_acquire(&(rwlock->rw_mutex_rw), tryonly, ev_extra))
-            return FALSE;
-        rwlock->rw_mode = PTH_RWLOCK_RW;
+        /* recursive read-write lock */
+        if (rwlock->rw_writer == pth_current) {
+            rwlock->rw_count++;
+            return TRUE;
+        }
+        /* read-write lock is free? */
+        if (   rwlock->rw_writer == NULL && rwlock->rw_readers == 0
+            && rwlock->rw_upgrader == NULL && rwlock->rw_wwait == NULL) {
+            pth_rwlock_own(rwlock, pth_current);
+            return TRUE;
+        }
     }
     else {
-        /* read-only lock is more complicated to get right */
-        if (!pth_mutex_acquire(&(rwlock->rw_mutex_rd), tryonly, ev_extra))
-            return FALSE;
-        rwlock->rw_readers++;
-        if (rwlock->rw_readers == 1) {
-            if (!pth_mutex_acquire(&(rwlock->rw_mutex_rw), tryonly, ev_extra)) {
-                rwlock->rw_readers--;
-                pth_shield { pth_mutex_release(&(rwlock->rw_mutex_rd)); }
-                return FALSE;
-            }
+        /* the writer itself would wait forever */
+        if (rwlock->rw_writer == pth_current)
+            return pth_error(FALSE, EDEADLK);
+        /* read-only lock is free unless writers hold or wait for it */
+        if (   rwlock->rw_writer == NULL
+            && rwlock->rw_upgrader == NULL && rwlock->rw_wwait == NULL) {
+            rwlock->rw_mode = PTH_RWLOCK_RD;
+            rwlock->rw_readers++;
+            return TRUE;
         }
-        rwlock->rw_mode = PTH_RWLOCK_RD;
-        pth_mutex_release(&(rwlock->rw_mutex_rd));
     }
+
+    /* should we just tryonly? */
+    if (tryonly)
+        return pth_error(FALSE, EBUSY);
+
+    /* else wait until the lock is granted */
+    if ((err = pth_rwlock_wait(rwlock, op, ev_extra)) != 0)
+        return pth_error(FALSE, err);
+    return TRUE;
+}
+
+int pth_rwlock_upgrade(pth_rwlock_t *rwlock, int tryonly, pth_event_t ev_extra)
+{
+    int err;
+
+    /* consistency checks */
+    if (rwlock == NULL)
+        return pth_error(FALSE, EINVAL);
+    if (!(rwlock->rw_state & PTH_RWLOCK_INITIALIZED))
+        return pth_error(FALSE, EDEADLK);
+    if (rwlock->rw_writer != NULL || rwlock->rw_readers == 0)
+        return pth_error(FALSE, EDEADLK);
+
+    /* the only reader can upgrade immediately */
+    if (rwlock->rw_readers == 1) {
+        rwlock->rw_readers = 0;
+        pth_rwlock_own(rwlock, pth_current);
+        return TRUE;
+    }
+
+    /* two readers waiting for each other would wait forever */
+    if (rwlock->rw_upgrader != NULL)
+        return pth_error(FALSE, EDEADLK);
+    if (tryonly)
+        return pth_error(FALSE, EBUSY);
+
+    /* else wait until the other readers left
+       (the read-only lock is kept on failure) */
+    if ((err = pth_rwlock_wait(rwlock, PTH_RWLOCK_UPGRADE, ev_extra)) != 0)
+        return pth_error(FALSE, err);
+    return TRUE;
+}
+
+int pth_rwlock_downgrade(pth_rwlock_t *rwlock)
+{
+    /* consistency checks */
+    if (rwlock == NULL)
+        return pth_error(FALSE, EINVAL);
+    if (!(rwlock->rw_state & PTH_RWLOCK_INITIALIZED))
+        return pth_error(FALSE, EDEADLK);
+    if (rwlock->rw_writer != pth_current)
+        return pth_error(FALSE, EACCES);
+    if (rwlock->rw_count > 1)
+        return pth_error(FALSE, EDEADLK);
+
+    /* become a reader and let the other readers in
+       (unless a writer is waiting) */
+    rwlock->rw_writer  = NULL;
+    rwlock->rw_count   = 0;
+    rwlock->rw_mode    = PTH_RWLOCK_RD;
+    rwlock->rw_readers = 1;
+    pth_rwlock_wakeup(rwlock);
     return TRUE;
 }
 
@@ -199,26 +702,20 @@ int pth_rwlock_release(pth_rwlock_t *rwlock)
         return pth_error(FALSE, EDEADLK);
 
     /* release lock */
-    if (rwlock->rw_mode == PTH_RWLOCK_RW) {
-        /* read-write unlock is simple */
-        if (!pth_mutex_release(&(rwlock->rw_mutex_rw)))
-            return FALSE;
+    if (rwlock->rw_writer != NULL) {
+        if (rwlock->rw_writer != pth_current)
+            return pth_error(FALSE, EACCES);
+        if (--rwlock->rw_count > 0)
+            return TRUE;
+        rwlock->rw_writer = NULL;
     }
-    else {
-        /* read-only unlock is more complicated to get right */
-        if (!pth_mutex_acquire(&(rwlock->rw_mutex_rd), FALSE, NULL))
-            return FALSE;
+    else if (rwlock->rw_readers > 0)
         rwlock->rw_readers--;
-        if (rwlock->rw_readers == 0) {
-            if (!pth_mutex_release(&(rwlock->rw_mutex_rw))) {
-                rwlock->rw_readers++;
-                pth_shield { pth_mutex_release(&(rwlock->rw_mutex_rd)); }
-                return FALSE;
-            }
-        }
-        rwlock->rw_mode = PTH_RWLOCK_RD;
-        pth_mutex_release(&(rwlock->rw_mutex_rd));
-    }
+    else
+        return pth_error(FALSE, EDEADLK);
+
+    /* grant the lock to the next thread(s) */
+    pth_rwlock_wakeup(rwlock);
     return TRUE;
 }
 
@@ -226,34 +723,91 @@ int pth_rwlock_release(pth_rwlock_t *rwlock)
 **  Condition Variables
 */
 
+/*
+ * Threads waiting in pth_cond_await(3) are queued at the condition
+ * variable, so a notification moves exactly one of them (or all of them
+ * for a broadcast) to the ready state and returns to the caller without
+ * a switch to the scheduler. Threads waiting through a PTH_EVENT_COND
+ * event are counted as waiters by pth_wait(3) and still woken through
+ * the signal flags checked by the scheduler, but only by notifications
+ * which were not taken by queued threads, as nobody would clear the
+ * flags again otherwise.
+ */
+
+/* thread waiting on a condition variable */
+typedef struct pth_cond_waiter_st pth_cond_waiter_t;
+struct pth_cond_waiter_st {
+    pth_cond_waiter_t *cw_next;
+    pth_cond_t        *cw_cond;     /* condition variable waited on  */
+    pth_mutex_t       *cw_mutex;    /* mutex to reacquire            */
+    pth_event_t        cw_ev;       /* event the thread waits for    */
+    int                cw_granted;  /* thread was notified           */
+};
+
 int pth_cond_init(pth_cond_t *cond)
 {
     if (cond == NULL)
         return pth_error(FALSE, EINVAL);
     cond->cn_state   = PTH_COND_INITIALIZED;
     cond->cn_waiters = 0;
+    cond->cn_whead   = NULL;
+    cond->cn_wtail   = NULL;
     return TRUE;
 }
 
-static void pth_cond_cleanup_handler(void *_cleanvec)
+/* re-acquire the mutex of a condition variable, even
+   if the deadline of the current thread already passed */
+static void pth_cond_reacquire(pth_mutex_t *mutex)
 {
-    pth_mutex_t *mutex = (pth_mutex_t *)(((void **)_cleanvec)[0]);
-    pth_cond_t  *cond  = (pth_cond_t  *)(((void **)_cleanvec)[1]);
+    int deadlinecnt;
 
-    /* re-acquire mutex when pth_cond_await() is cancelled
-       in order to restore the condition variable semantics */
+    deadlinecnt = pth_current->deadlinecnt;
+    pth_current->deadlinecnt = 0;
     pth_mutex_acquire(mutex, FALSE, NULL);
+    pth_current->deadlinecnt = deadlinecnt;
+    return;
+}
 
-    /* fix number of waiters */
-    cond->cn_waiters--;
+/* remove a thread from the queue of a condition variable (if still queued) */
+static void pth_cond_dequeue(pth_cond_waiter_t *cw)
+{
+    pth_cond_t *cond = cw->cw_cond;
+    pth_cond_waiter_t **pcw;
+    pth_cond_waiter_t *prev;
+
+    prev = NULL;
+    for (pcw = &(cond->cn_whead); *pcw != NULL; pcw = &((*pcw)->cw_next)) {
+        if (*pcw == cw) {
+            *pcw = cw->cw_next;
+            if (cond->cn_wtail == cw)
+                cond->cn_wtail = prev;
+            cond->cn_waiters--;
+            break;
+        }
+        prev = *pcw;
+    }
+    return;
+}
+
+static void pth_cond_cleanup_handler(void *arg)
+{
+    pth_cond_waiter_t *cw = (pth_cond_waiter_t *)arg;
+
+    /* leave the queue (if not already notified) */
+    pth_cond_dequeue(cw);
+
+    /* re-acquire mutex when pth_cond_await() is cancelled
+       in order to restore the condition variable semantics */
+    pth_cond_reacquire(cw->cw_mutex);
     return;
 }
 
 int pth_cond_await(pth_cond_t *cond, pth_mutex_t *mutex, pth_event_t ev_extra)
 {
     static pth_key_t ev_key = PTH_KEY_INIT;
-    void *cleanvec[2];
+    pth_cond_waiter_t cw;
     pth_event_t ev;
+    int rc;
 
     /* consistency checks */
     if (cond == NULL || mutex == NULL)
@@ -261,38 +815,41 @@ int pth_cond_await(pth_cond_t *cond, pth_mutex_t *mutex, pth_event_t ev_extra)
     if (!(cond->cn_state & PTH_COND_INITIALIZED))
         return pth_error(FALSE, EDEADLK);
 
-    /* check whether we can do a short-circuit wait */
-    if (    (cond->cn_state & PTH_COND_SIGNALED)
-        && !(cond->cn_state & PTH_COND_BROADCAST)) {
-        cond->cn_state &= ~(PTH_COND_SIGNALED);
-        cond->cn_state &= ~(PTH_COND_BROADCAST);
-        cond->cn_state &= ~(PTH_COND_HANDLED);
-        return TRUE;
-    }
-
-    /* add us to the number of waiters */
+    /* add us to the queue of waiters */
+    cw.cw_next    = NULL;
+    cw.cw_cond    = cond;
+    cw.cw_mutex   = mutex;
+    cw.cw_granted = FALSE;
+    if ((cw.cw_ev = ev = pth_event(PTH_EVENT_GRANT|PTH_MODE_STATIC, &ev_key, &cw.cw_granted)) == NULL)
+        return FALSE;
+    if (cond->cn_wtail != NULL)
+        cond->cn_wtail->cw_next = &cw;
+    else
+        cond->cn_whead = &cw;
+    cond->cn_wtail = &cw;
     cond->cn_waiters++;
 
     /* release mutex (caller had to acquire it first) */
     pth_mutex_release(mutex);
 
     /* wait until the condition is signaled */
-    ev = pth_event(PTH_EVENT_COND|PTH_MODE_STATIC, &ev_key, cond);
     if (ev_extra != NULL)
         pth_event_concat(ev, ev_extra, NULL);
-    cleanvec[0] = mutex;
-    cleanvec[1] = cond;
-    pth_cleanup_push(pth_cond_cleanup_handler, cleanvec);
-    pth_wait(ev);
+    pth_cleanup_push(pth_cond_cleanup_handler, &cw);
+    rc = pth_wait(ev);
     pth_cleanup_pop(FALSE);
     if (ev_extra != NULL)
         pth_event_isolate(ev);
 
+    /* remove us from the queue of waiters (if not notified) */
+    pth_cond_dequeue(&cw);
+
     /* reacquire mutex */
-    pth_mutex_acquire(mutex, FALSE, NULL);
+    pth_cond_reacquire(mutex);
 
-    /* remove us from the number of waiters */
-    cond->cn_waiters--;
+    /* the deadline of the thread passed while waiting */
+    if (rc < 0 && !cw.cw_granted)
+        return pth_error(FALSE, ETIMEDOUT);
 
     /* release mutex (caller had to acquire it first) */
     return TRUE;
@@ -300,24 +857,47 @@ int pth_cond_await(pth_cond_t *cond, pth_mutex_t *mutex, pth_event_t ev_extra)
 
 int pth_cond_notify(pth_cond_t *cond, int broadcast)
 {
+    pth_cond_waiter_t *cw;
+    int yield;
+    int taken;
+
     /* consistency checks */
     if (cond == NULL)
         return pth_error(FALSE, EINVAL);
     if (!(cond->cn_state & PTH_COND_INITIALIZED))
         return pth_error(FALSE, EDEADLK);
+    yield = (broadcast & PTH_COND_YIELD);
+    broadcast &= ~(PTH_COND_YIELD);
 
     /* do something only if there is at least one waiters (POSIX semantics) */
     if (cond->cn_waiters > 0) {
-        /* signal the condition */
-        cond->cn_state |= PTH_COND_SIGNALED;
-        if (broadcast)
-            cond->cn_state |= PTH_COND_BROADCAST;
-        else
-            cond->cn_state &= ~(PTH_COND_BROADCAST);
-        cond->cn_state &= ~(PTH_COND_HANDLED);
+        /* wake up the oldest queued thread (or all of them) */
+        taken = FALSE;
+        while ((cw = cond->cn_whead) != NULL) {
+            if ((cond->cn_whead = cw->cw_next) == NULL)
+                cond->cn_wtail = NULL;
+            cond->cn_waiters--;
+            cw->cw_granted = TRUE;
+            cw->cw_ev->ev_status = PTH_STATUS_OCCURRED;
+            taken = TRUE;
+            if (!broadcast)
+                break;
+        }
 
-        /* and give other threads a chance to awake */
-        pth_yield(NULL);
+        /* signal the condition for the remaining waiters, which wait
+           on PTH_EVENT_COND events (counted by pth_wait, but not queued) */
+        if (cond->cn_waiters > 0 && (broadcast || !taken)) {
+            cond->cn_state |= PTH_COND_SIGNALED;
+            if (broadcast)
+                cond->cn_state |= PTH_COND_BROADCAST;
+            else
+                cond->cn_state &= ~(PTH_COND_BROADCAST);
+            cond->cn_state &= ~(PTH_COND_HANDLED);
+        }
+
+        /* and give other threads a chance to awake (if requested) */
+        if (yield)
+            pth_yield(NULL);
     }
 
     /* return to caller */
@@ -380,3 +960,344 @@ int pth_barrier_reach(pth_barrier_t *barrier)
     return rv;
 }
 
+
+/*
+**  Counting Semaphores
+*/
+
+/*
+ * Waiting threads are queued in arrival order together with the number
+ * of units they need. A release grants the units directly to the queued
+ * threads from the front as long as they suffice, so exactly the
+ * threads which can proceed are readied and a large request is not
+ * starved by smaller ones arriving later.
+ */
+
+/* thread waiting for units of a semaphore */
+typedef struct pth_sem_waiter_st pth_sem_waiter_t;
+struct pth_sem_waiter_st {
+    pth_sem_waiter_t *sw_next;
+    pth_sem_t        *sw_sem;      /* semaphore the thread waits for  */
+    unsigned int      sw_n;        /* number of units needed          */
+    pth_event_t       sw_ev;       /* event the thread waits for      */
+    int               sw_granted;  /* units were granted              */
+};
+
+int pth_sem_init(pth_sem_t *sem, unsigned int value)
+{
+    if (sem == NULL)
+        return pth_error(FALSE, EINVAL);
+    sem->sm_state = PTH_SEM_INITIALIZED;
+    sem->sm_value = value;
+    sem->sm_whead = NULL;
+    sem->sm_wtail = NULL;
+    return TRUE;
+}
+
+/* grant units to the queued threads which can proceed now */
+static void pth_sem_wakeup(pth_sem_t *sem)
+{
+    pth_sem_waiter_t *sw;
+
+    while ((sw = sem->sm_whead) != NULL && sw->sw_n <= sem->sm_value) {
+        if ((sem->sm_whead = sw->sw_next) == NULL)
+            sem->sm_wtail = NULL;
+        sem->sm_value -= sw->sw_n;
+        sw->sw_granted = TRUE;
+        sw->sw_ev->ev_status = PTH_STATUS_OCCURRED;
+    }
+    return;
+}
+
+/* give up waiting for a semaphore (or return the
+   units, if they were granted to a cancelled thread) */
+static void pth_sem_abandon(void *arg)
+{
+    pth_sem_waiter_t *sw = (pth_sem_waiter_t *)arg;
+    pth_sem_t *sem = sw->sw_sem;
+    pth_sem_waiter_t **psw;
+    pth_sem_waiter_t *prev;
+
+    if (sw->sw_granted)
+        sem->sm_value += sw->sw_n;
+    else {
+        prev = NULL;
+        for (psw = &(sem->sm_whead); *psw != NULL; psw = &((*psw)->sw_next)) {
+            if (*psw == sw) {
+                *psw = sw->sw_next;
+                if (sem->sm_wtail == sw)
+                    sem->sm_wtail = prev;
+                break;
+            }
+            prev = *psw;
+        }
+    }
+
+    /* the threads behind might be able to proceed now */
+    pth_sem_wakeup(sem);
+    return;
+}
+
+int pth_sem_acquire_ev(pth_sem_t *sem, unsigned int n, pth_event_t ev_extra)
+{
+    static pth_key_t ev_key = PTH_KEY_INIT;
+    pth_sem_waiter_t sw;
+    pth_event_t ev;
+    int rc;
+    int err;
+
+    /* consistency checks */
+    if (sem == NULL || n == 0)
+        return pth_error(FALSE, EINVAL);
+    if (!(sem->sm_state & PTH_SEM_INITIALIZED))
+        return pth_error(FALSE, EDEADLK);
+
+    /* enough units and nobody queued before us? */
+    if (sem->sm_whead == NULL && n <= sem->sm_value) {
+        sem->sm_value -= n;
+        return TRUE;
+    }
+
+    /* else queue up and wait until the units are granted */
+    sw.sw_next    = NULL;
+    sw.sw_sem     = sem;
+    sw.sw_n       = n;
+    sw.sw_granted = FALSE;
+    if ((sw.sw_ev = pth_event(PTH_EVENT_GRANT|PTH_MODE_STATIC, &ev_key, &sw.sw_granted)) == NULL)
+        return FALSE;
+    if (sem->sm_wtail != NULL)
+        sem->sm_wtail->sw_next = &sw;
+    else
+        sem->sm_whead = &sw;
+    sem->sm_wtail = &sw;
+    err = 0;
+    pth_cleanup_push(pth_sem_abandon, &sw);
+    while (!sw.sw_granted) {
+        ev = pth_event(PTH_EVENT_GRANT|PTH_MODE_STATIC, &ev_key, &sw.sw_granted);
+        if (ev_extra != NULL)
+            pth_event_concat(ev, ev_extra, NULL);
+        rc = pth_wait(ev);
+        if (sw.sw_granted)
+            break;
+        if ((err = pth_wait_result(ev, ev_extra, rc)) != 0)
+            break;
+    }
+    pth_cleanup_pop(FALSE);
+    if (!sw.sw_granted) {
+        pth_sem_abandon(&sw);
+        return pth_error(FALSE, err);
+    }
+    return TRUE;
+}
+
+int pth_sem_acquire(pth_sem_t *sem, unsigned int n)
+{
+    return pth_sem_acquire_ev(sem, n, NULL);
+}
+
+int pth_sem_tryacquire(pth_sem_t *sem, unsigned int n)
+{
+    /* consistency checks */
+    if (sem == NULL || n == 0)
+        return pth_error(FALSE, EINVAL);
+    if (!(sem->sm_state & PTH_SEM_INITIALIZED))
+        return pth_error(FALSE, EDEADLK);
+
+    /* take the units only if nobody has to wait for them */
+    if (sem->sm_whead != NULL || n > sem->sm_value)
+        return pth_error(FALSE, EBUSY);
+    sem->sm_value -= n;
+    return TRUE;
+}
+
+int pth_sem_release(pth_sem_t *sem, unsigned int n)
+{
+    /* consistency checks */
+    if (sem == NULL)
+        return pth_error(FALSE, EINVAL);
+    if (!(sem->sm_state & PTH_SEM_INITIALIZED))
+        return pth_error(FALSE, EDEADLK);
+    if (n > UINT_MAX - sem->sm_value)
+        return pth_error(FALSE, EOVERFLOW);
+
+    /* return the units and hand them on to the queued threads */
+    sem->sm_value += n;
+    pth_sem_wakeup(sem);
+    return TRUE;
+}
+
+/*
+**  Wait Groups and Latches
+*/
+
+/*
+ * A wait group counts outstanding pieces of work, like the children of a
+ * scatter/gather request, and lets threads wait until all of them are
+ * done. A latch is a wait group which starts with a fixed count, can
+ * only count down and stays open once it reached zero. The waiting
+ * threads register themselves, so the thread which brings the count down
+ * to zero tags their events directly. For everybody else
+ * PTH_EVENT_WAITGROUP is checked by the scheduler.
+ */
+
+/* thread waiting for a wait group */
+typedef struct pth_waitgroup_waiter_st pth_waitgroup_waiter_t;
+struct pth_waitgroup_waiter_st {
+    pth_waitgroup_waiter_t *gw_next;
+    pth_waitgroup_t        *gw_wg;       /* wait group the thread waits for */
+    pth_event_t             gw_ev;       /* event the thread waits for      */
+    int                     gw_granted;  /* count reached zero              */
+};
+
+int pth_waitgroup_init(pth_waitgroup_t *wg)
+{
+    if (wg == NULL)
+        return pth_error(FALSE, EINVAL);
+    wg->wg_state   = PTH_WAITGROUP_INITIALIZED;
+    wg->wg_count   = 0;
+    wg->wg_waiters = NULL;
+    return TRUE;
+}
+
+/* wake up all threads waiting for a wait group */
+static void pth_waitgroup_wakeup(pth_waitgroup_t *wg)
+{
+    pth_waitgroup_waiter_t *gw;
+
+    for (gw = wg->wg_waiters; gw != NULL; gw = gw->gw_next) {
+        gw->gw_granted = TRUE;
+        gw->gw_ev->ev_status = PTH_STATUS_OCCURRED;
+    }
+    wg->wg_waiters = NULL;
+    return;
+}
+
+/* remove a waiter from its wait group (if still linked) */
+static void pth_waitgroup_unlink(void *arg)
+{
+    pth_waitgroup_waiter_t *gw = (pth_waitgroup_waiter_t *)arg;
+    pth_waitgroup_waiter_t **pgw;
+
+    for (pgw = &(gw->gw_wg->wg_waiters); *pgw != NULL; pgw = &((*pgw)->gw_next)) {
+        if (*pgw == gw) {
+            *pgw = gw->gw_next;
+            break;
+        }
+    }
+    return;
+}
+
+/* let the current thread wait until the count of a wait group is zero */
+static int pth_waitgroup_await(pth_waitgroup_t *wg, pth_event_t ev_extra)
+{
+    static pth_key_t ev_key = PTH_KEY_INIT;
+    pth_waitgroup_waiter_t gw;
+    pth_event_t ev;
+    int rc;
+    int err;
+
+    /* consistency checks */
+    if (wg == NULL)
+        return pth_error(FALSE, EINVAL);
+    if (!(wg->wg_state & PTH_WAITGROUP_INITIALIZED))
+        return pth_error(FALSE, EDEADLK);
+
+    /* nothing outstanding? */
+    if (wg->wg_count == 0)
+        return TRUE;
+
+    /* else register and wait for the last piece of work */
+    gw.gw_wg      = wg;
+    gw.gw_granted = FALSE;
+    if ((gw.gw_ev = pth_event(PTH_EVENT_GRANT|PTH_MODE_STATIC, &ev_key, &gw.gw_granted)) == NULL)
+        return FALSE;
+    gw.gw_next = wg->wg_waiters;
+    wg->wg_waiters = &gw;
+    err = 0;
+    pth_cleanup_push(pth_waitgroup_unlink, &gw);
+    while (!gw.gw_granted) {
+        ev = pth_event(PTH_EVENT_GRANT|PTH_MODE_STATIC, &ev_key, &gw.gw_granted);
+        if (ev_extra != NULL)
+            pth_event_concat(ev, ev_extra, NULL);
+        rc = pth_wait(ev);
+        if (gw.gw_granted)
+            break;
+        if ((err = pth_wait_result(ev, ev_extra, rc)) != 0)
+            break;
+    }
+    pth_cleanup_pop(TRUE);
+    if (!gw.gw_granted)
+        return pth_error(FALSE, err);
+    return TRUE;
+}
+
+int pth_waitgroup_add(pth_waitgroup_t *wg, int delta)
+{
+    unsigned int n;
+
+    /* consistency checks */
+    if (wg == NULL)
+        return pth_error(FALSE, EINVAL);
+    if (!(wg->wg_state & PTH_WAITGROUP_INITIALIZED))
+        return pth_error(FALSE, EDEADLK);
+    if (wg->wg_state & PTH_WAITGROUP_LATCH)
+        return pth_error(FALSE, EINVAL);
+
+    /* adjust the count and release the waiters once all is done */
+    if (delta >= 0) {
+        if ((unsigned int)delta > UINT_MAX - wg->wg_count)
+            return pth_error(FALSE, EOVERFLOW);
+        wg->wg_count += (unsigned int)delta;
+    }
+    else {
+        n = (unsigned int)(-(delta + 1)) + 1;
+        if (n > wg->wg_count)
+            return pth_error(FALSE, EINVAL);
+        wg->wg_count -= n;
+        if (wg->wg_count == 0)
+            pth_waitgroup_wakeup(wg);
+    }
+    return TRUE;
+}
+
+int pth_waitgroup_done(pth_waitgroup_t *wg)
+{
+    return pth_waitgroup_add(wg, -1);
+}
+
+int pth_waitgroup_wait(pth_waitgroup_t *wg, pth_event_t ev_extra)
+{
+    return pth_waitgroup_await(wg, ev_extra);
+}
+
+int pth_latch_init(pth_latch_t *latch, unsigned int count)
+{
+    if (latch == NULL)
+        return pth_error(FALSE, EINVAL);
+    latch->wg_state   = PTH_WAITGROUP_INITIALIZED|PTH_WAITGROUP_LATCH;
+    latch->wg_count   = count;
+    latch->wg_waiters = NULL;
+    return TRUE;
+}
+
+int pth_latch_countdown(pth_latch_t *latch, unsigned int n)
+{
+    /* consistency checks */
+    if (latch == NULL || n == 0)
+        return pth_error(FALSE, EINVAL);
+    if (!(latch->wg_state & PTH_WAITGROUP_INITIALIZED))
+        return pth_error(FALSE, EDEADLK);
+    if (!(latch->wg_state & PTH_WAITGROUP_LATCH) || n > latch->wg_count)
+        return pth_error(FALSE, EINVAL);
+
+    /* count down and open the latch for good at zero */
+    latch->wg_count -= n;
+    if (latch->wg_count == 0)
+        pth_waitgroup_wakeup(latch);
+    return TRUE;
+}
+
+int pth_latch_wait(pth_latch_t *latch, pth_event_t ev_extra)
+{
+    return pth_waitgroup_await(latch, ev_extra);
+}
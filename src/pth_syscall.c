@@ -57,6 +57,7 @@
 #define sendto        __pth_sys_sendto
 #define pread         __pth_sys_pread
 #define pwrite        __pth_sys_pwrite
+#define close         __pth_sys_close
 
 /* include the private header and this way system headers */
 #include "pth_p.h"
@@ -103,6 +104,7 @@ int pth_syscall_hard = PTH_SYSCALL_HARD;
 #undef sendto
 #undef pread
 #undef pwrite
+#undef close
 
 /* internal data structures */
 #if cpp
@@ -152,6 +154,7 @@ static pth_syscall_fct_tab_t pth_syscall_fct_tab[] = {
 #define PTH_SCF_sendto        19
 #define PTH_SCF_pread         20
 #define PTH_SCF_pwrite        21
+#define PTH_SCF_close         22
     { "fork",        NULL },
     { "waitpid",     NULL },
     { "system",      NULL },
@@ -174,6 +177,7 @@ static pth_syscall_fct_tab_t pth_syscall_fct_tab[] = {
     { "sendto",      NULL },
     { "pread",       NULL },
     { "pwrite",      NULL },
+    { "close",       NULL },
     { NULL,          NULL }
 };
 #endif
@@ -536,8 +540,15 @@ ssize_t pread(int fd, void *buf, size_t nbytes, off_t offset)
     pth_implicit_init();
     return pth_pread(fd, buf, nbytes, offset);
 }
-/* NOTICE: internally fully emulated, so still no
-   internal exit point pth_sc_pread necessary! */
+static ssize_t pth_sc_pread(int fd, void *buf, size_t nbytes, off_t offset)
+{
+    /* internal exit point for Pth */
+    if (pth_syscall_fct_tab[PTH_SCF_pread].addr != NULL)
+        return ((ssize_t (*)(int, void *, size_t, off_t))
+               pth_syscall_fct_tab[PTH_SCF_pread].addr)
+               (fd, buf, nbytes, offset);
+    else return (ssize_t)syscall(SYS_pread64, fd, buf, nbytes, offset);
+}
 
 /* ==== Pth hard syscall wrapper for pwrite(2) ==== */
 ssize_t pwrite(int, const void *, size_t, off_t);
@@ -547,8 +558,15 @@ ssize_t pwrite(int fd, const void *buf, size_t nbytes, off_t offset)
     pth_implicit_init();
     return pth_pwrite(fd, buf, nbytes, offset);
 }
-/* NOTICE: internally fully emulated, so still no
-   internal exit point pth_sc_pwrite necessary! */
+static ssize_t pth_sc_pwrite(int fd, const void *buf, size_t nbytes, off_t offset)
+{
+    /* internal exit point for Pth */
+    if (pth_syscall_fct_tab[PTH_SCF_pwrite].addr != NULL)
+        return ((ssize_t (*)(int, const void *, size_t, off_t))
+               pth_syscall_fct_tab[PTH_SCF_pwrite].addr)
+               (fd, buf, nbytes, offset);
+    else return (ssize_t)syscall(SYS_pwrite64, fd, buf, nbytes, offset);
+}
 
 /* ==== Pth hard syscall wrapper for recv(2) ==== */
 ssize_t recv(int, void *, size_t, int);
@@ -622,5 +640,23 @@ static ssize_t pth_sc_sendto(int fd, const void *buf, size_t nbytes, int flags,
     else return (ssize_t)syscall(SYS_sendto, fd, buf, nbytes, flags, to, tolen);
 }
 
+/* ==== Pth hard syscall wrapper for close(2) ==== */
+int close(int);
+int close(int fd)
+{
+    /* external entry point for application */
+    pth_implicit_init();
+    return pth_close(fd);
+}
+static int pth_sc_close(int fd)
+{
+    /* internal exit point for Pth */
+    if (pth_syscall_fct_tab[PTH_SCF_close].addr != NULL)
+        return ((int (*)(int))
+               pth_syscall_fct_tab[PTH_SCF_close].addr)
+               (fd);
+    else return (int)syscall(SYS_close, fd);
+}
+
 #endif /* PTH_SYSCALL_HARD */
 
@@ -50,6 +50,11 @@ struct pth_st {
 
     /* event handling */
     pth_event_t    events;               /* events the tread is waiting for             */
+    long           timerslack;           /* allowed deferral of its timers (ns)         */
+    pth_event_t    deadline;             /* timer event of the innermost deadline       */
+    struct timespec *deadlines;          /* stack of (effective) deadlines              */
+    int            deadlinecnt;          /* number of deadlines on the stack            */
+    int            deadlinemax;          /* allocated size of the deadline stack        */
 
     /* per-thread signal handling */
     sigset_t       sigpending;           /* set    of pending signals                   */
@@ -79,6 +84,8 @@ struct pth_st {
 
     /* mutex ring */
     pth_ring_t     mutexring;            /* ring of aquired mutex structures            */
+    int            prioinherit;          /* priority inherited from mutex waiters       */
+    struct pth_mutex_waiter_st *mutexwait; /* queue entry of mutex waited for (or NULL) */
 
 #ifdef PTH_EX
     /* per-thread exception handling */
@@ -86,6 +93,10 @@ struct pth_st {
 #endif
 };
 
+    /* effective priority of a thread (base or inherited one) */
+#define pth_tcb_prio(t) \
+    ((t)->prioinherit > (t)->prio ? (t)->prioinherit : (t)->prio)
+
 #endif /* cpp */
 
 __attribute__((unused)) static const char *pth_state_names[] = {
@@ -144,6 +155,7 @@ void pth_tcb_free(pth_t t)
         free(t->data_value);
     if (t->cleanups != NULL)
         pth_cleanup_popall(t, FALSE);
+    pth_deadline_clear(t);
     free(t);
     return;
 }
@@ -63,6 +63,12 @@ __attribute__((unused)) static void pth_time_usleep(unsigned long usec)
     } while (0)
 #endif /* cpp */
 
+/* calculate: t1 = now (nanosecond resolution) */
+#if cpp
+#define pth_timens_now(t1) \
+    clock_gettime(CLOCK_REALTIME, (t1))
+#endif /* cpp */
+
 /* time value constructor */
 pth_time_t pth_time(long sec, long usec)
 {
@@ -119,6 +125,52 @@ int pth_time_cmp(pth_time_t *t1, pth_time_t *t2)
     }
 #endif
 
+/* calculate: t1 <=> t2 (nanosecond resolution) */
+int pth_timens_cmp(const struct timespec *t1, const struct timespec *t2)
+{
+    if (t1->tv_sec != t2->tv_sec)
+        return (t1->tv_sec < t2->tv_sec ? -1 : 1);
+    if (t1->tv_nsec != t2->tv_nsec)
+        return (t1->tv_nsec < t2->tv_nsec ? -1 : 1);
+    return 0;
+}
+
+/* calculate: t1 = t1 + t2 (nanosecond resolution) */
+void pth_timens_add(struct timespec *t1, const struct timespec *t2)
+{
+    t1->tv_sec  += t2->tv_sec;
+    t1->tv_nsec += t2->tv_nsec;
+    while (t1->tv_nsec >= 1000000000L) {
+        t1->tv_sec  += 1;
+        t1->tv_nsec -= 1000000000L;
+    }
+    return;
+}
+
+/* calculate: t1 = t1 - t2 (nanosecond resolution) */
+void pth_timens_sub(struct timespec *t1, const struct timespec *t2)
+{
+    t1->tv_sec  -= t2->tv_sec;
+    t1->tv_nsec -= t2->tv_nsec;
+    while (t1->tv_nsec < 0) {
+        t1->tv_sec  -= 1;
+        t1->tv_nsec += 1000000000L;
+    }
+    return;
+}
+
+/* convert a (possibly non-normalized) time structure into nanosecond resolution */
+void pth_timens_from_time(struct timespec *ts, const pth_time_t *tv)
+{
+    ts->tv_sec  = tv->tv_sec + (tv->tv_usec / 1000000);
+    ts->tv_nsec = (tv->tv_usec % 1000000) * 1000;
+    if (ts->tv_nsec < 0) {
+        ts->tv_sec  -= 1;
+        ts->tv_nsec += 1000000000L;
+    }
+    return;
+}
+
 /* calculate: t1 = t1 / n */
 __attribute__((unused)) static void pth_time_div(pth_time_t *t1, int n)
 {
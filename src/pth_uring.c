@@ -0,0 +1,402 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  This file is part of GNU Pth, a non-preemptive thread scheduling
+**  library which can be found at http://www.gnu.org/software/pth/.
+**
+**  This library is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU Lesser General Public
+**  License as published by the Free Software Foundation; either
+**  version 2.1 of the License, or (at your option) any later version.
+**
+**  This library is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**  Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public
+**  License along with this library; if not, write to the Free Software
+**  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+**  USA, or contact Ralf S. Engelschall <rse@engelschall.com>.
+**
+**  pth_uring.c: Pth io_uring based I/O engine
+*/
+                             /* ``Don't call us, we'll call you.''
+                                                 -- Unknown */
+#include "pth_p.h"
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#if cpp
+
+/* operations the engine performs on behalf of the I/O functions */
+#define PTH_URING_OP_READ    1
+#define PTH_URING_OP_WRITE   2
+#define PTH_URING_OP_READV   3
+#define PTH_URING_OP_WRITEV  4
+#define PTH_URING_OP_RECV    5
+#define PTH_URING_OP_SEND    6
+#define PTH_URING_OP_ACCEPT  7
+
+/* internal event type: completion of a ring operation */
+#define PTH_EVENT_URING      _BIT(30)
+
+/* operation record (lives on the stack of the waiting thread) */
+typedef struct pth_uring_op_st pth_uring_op_t;
+struct pth_uring_op_st {
+    pth_event_t uo_ev;   /* event the thread is parked on */
+    int         uo_done; /* completion has been reaped    */
+    int         uo_res;  /* result or negated errno value */
+};
+
+#endif /* cpp */
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+/* number of submission queue entries requested from the kernel */
+#define PTH_URING_ENTRIES 256
+
+/* the ring state */
+static struct {
+    int                  fd;          /* ring filedescriptor or -1 if off */
+    unsigned int         sqentries;   /* submission queue size            */
+    unsigned int         cqentries;   /* completion queue size            */
+    unsigned int         inflight;    /* submitted but not yet reaped     */
+    unsigned int         unsubmitted; /* queued but not yet entered       */
+    void                *sqmap;
+    size_t               sqmaplen;
+    void                *cqmap;
+    size_t               cqmaplen;
+    struct io_uring_sqe *sqes;
+    size_t               sqeslen;
+    unsigned int        *sqhead;
+    unsigned int        *sqtail;
+    unsigned int        *sqmask;
+    unsigned int        *sqarray;
+    unsigned int        *cqhead;
+    unsigned int        *cqtail;
+    unsigned int        *cqmask;
+    struct io_uring_cqe *cqes;
+} pth_uring = { .fd = -1 };
+
+/* mapping of our operations onto the kernel opcodes */
+static const unsigned char pth_uring_opcode[] = {
+    0,
+    IORING_OP_READ,
+    IORING_OP_WRITE,
+    IORING_OP_READV,
+    IORING_OP_WRITEV,
+    IORING_OP_RECV,
+    IORING_OP_SEND,
+    IORING_OP_ACCEPT
+};
+
+#endif /* HAVE_LINUX_IO_URING_H */
+
+/* set up the ring (the engine is off until this is called) */
+int pth_uring_init(void)
+{
+#ifdef HAVE_LINUX_IO_URING_H
+    struct io_uring_params p;
+    char *sq, *cq;
+    int fd;
+
+    if (pth_uring.fd != -1)
+        return TRUE;
+
+    memset(&p, 0, sizeof(p));
+    if ((fd = (int)syscall(__NR_io_uring_setup, PTH_URING_ENTRIES, &p)) == -1)
+        return FALSE;
+
+    /* plain reads and writes have to honour the file position (Linux 5.6) */
+    if (!(p.features & IORING_FEAT_RW_CUR_POS)) {
+        pth_shield { close(fd); }
+        return pth_error(FALSE, ENOSYS);
+    }
+
+    /* map the rings and the submission queue entries */
+    pth_uring.sqmaplen = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    pth_uring.cqmaplen = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (pth_uring.cqmaplen > pth_uring.sqmaplen)
+            pth_uring.sqmaplen = pth_uring.cqmaplen;
+        pth_uring.cqmaplen = 0;
+    }
+    pth_uring.sqmap = mmap(NULL, pth_uring.sqmaplen, PROT_READ|PROT_WRITE,
+                           MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (pth_uring.sqmap == MAP_FAILED) {
+        pth_shield { close(fd); }
+        return FALSE;
+    }
+    pth_uring.cqmap = pth_uring.sqmap;
+    if (pth_uring.cqmaplen > 0) {
+        pth_uring.cqmap = mmap(NULL, pth_uring.cqmaplen, PROT_READ|PROT_WRITE,
+                               MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (pth_uring.cqmap == MAP_FAILED) {
+            pth_shield {
+                munmap(pth_uring.sqmap, pth_uring.sqmaplen);
+                close(fd);
+            }
+            return FALSE;
+        }
+    }
+    pth_uring.sqeslen = p.sq_entries * sizeof(struct io_uring_sqe);
+    pth_uring.sqes = mmap(NULL, pth_uring.sqeslen, PROT_READ|PROT_WRITE,
+                          MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (pth_uring.sqes == MAP_FAILED) {
+        pth_shield {
+            if (pth_uring.cqmaplen > 0)
+                munmap(pth_uring.cqmap, pth_uring.cqmaplen);
+            munmap(pth_uring.sqmap, pth_uring.sqmaplen);
+            close(fd);
+        }
+        return FALSE;
+    }
+
+    sq = (char *)pth_uring.sqmap;
+    cq = (char *)pth_uring.cqmap;
+    pth_uring.sqhead      = (unsigned int *)(sq + p.sq_off.head);
+    pth_uring.sqtail      = (unsigned int *)(sq + p.sq_off.tail);
+    pth_uring.sqmask      = (unsigned int *)(sq + p.sq_off.ring_mask);
+    pth_uring.sqarray     = (unsigned int *)(sq + p.sq_off.array);
+    pth_uring.cqhead      = (unsigned int *)(cq + p.cq_off.head);
+    pth_uring.cqtail      = (unsigned int *)(cq + p.cq_off.tail);
+    pth_uring.cqmask      = (unsigned int *)(cq + p.cq_off.ring_mask);
+    pth_uring.cqes        = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    pth_uring.sqentries   = p.sq_entries;
+    pth_uring.cqentries   = p.cq_entries;
+    pth_uring.inflight    = 0;
+    pth_uring.unsubmitted = 0;
+    pth_uring.fd          = fd;
+    return TRUE;
+#else
+    return pth_error(FALSE, ENOSYS);
+#endif
+}
+
+/* tear down the ring (refused while operations are still in flight) */
+int pth_uring_kill(void)
+{
+#ifdef HAVE_LINUX_IO_URING_H
+    if (pth_uring.fd == -1)
+        return TRUE;
+    if (pth_uring.inflight > 0)
+        return pth_error(FALSE, EBUSY);
+    munmap(pth_uring.sqes, pth_uring.sqeslen);
+    if (pth_uring.cqmaplen > 0)
+        munmap(pth_uring.cqmap, pth_uring.cqmaplen);
+    munmap(pth_uring.sqmap, pth_uring.sqmaplen);
+    close(pth_uring.fd);
+    pth_uring.fd = -1;
+#endif
+    return TRUE;
+}
+
+/* forget the ring without waiting for its operations
+   (the threads owning them are already gone) */
+void pth_uring_drop(void)
+{
+#ifdef HAVE_LINUX_IO_URING_H
+    pth_uring.inflight = 0;
+    pth_uring.unsubmitted = 0;
+    pth_uring_kill();
+#endif
+    return;
+}
+
+/* determine whether the engine is active */
+int pth_uring_active(void)
+{
+#ifdef HAVE_LINUX_IO_URING_H
+    return (pth_uring.fd != -1);
+#else
+    return FALSE;
+#endif
+}
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+/* hand all queued submission queue entries over to the kernel */
+static void pth_uring_submit(void)
+{
+    int rc;
+
+    while (pth_uring.unsubmitted > 0) {
+        rc = (int)syscall(__NR_io_uring_enter, pth_uring.fd,
+                          pth_uring.unsubmitted, 0, 0, NULL, 0);
+        if (rc == -1 && errno == EINTR)
+            continue;
+        if (rc <= 0)
+            break; /* retried on the next scheduler run */
+        pth_uring.unsubmitted -= (unsigned int)rc;
+    }
+    return;
+}
+
+/* queue a submission queue entry (NULL if the queue is full) */
+static struct io_uring_sqe *pth_uring_sqe(void)
+{
+    struct io_uring_sqe *sqe;
+    unsigned int tail, idx;
+
+    tail = *pth_uring.sqtail;
+    if (tail - __atomic_load_n(pth_uring.sqhead, __ATOMIC_ACQUIRE) >= pth_uring.sqentries) {
+        pth_uring_submit();
+        if (tail - __atomic_load_n(pth_uring.sqhead, __ATOMIC_ACQUIRE) >= pth_uring.sqentries)
+            return NULL;
+    }
+    idx = tail & *pth_uring.sqmask;
+    sqe = &pth_uring.sqes[idx];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    pth_uring.sqarray[idx] = idx;
+    return sqe;
+}
+
+/* publish the last queued submission queue entry */
+static void pth_uring_commit(void)
+{
+    __atomic_store_n(pth_uring.sqtail, *pth_uring.sqtail + 1, __ATOMIC_RELEASE);
+    pth_uring.unsubmitted++;
+    pth_uring.inflight++;
+    return;
+}
+
+#endif /* HAVE_LINUX_IO_URING_H */
+
+/* submit queued operations and return the ring filedescriptor
+   the scheduler has to watch (or -1 if nothing is in flight) */
+int pth_uring_pollfd(void)
+{
+#ifdef HAVE_LINUX_IO_URING_H
+    if (pth_uring.fd == -1 || pth_uring.inflight == 0)
+        return -1;
+    pth_uring_submit();
+    return pth_uring.fd;
+#else
+    return -1;
+#endif
+}
+
+/* reap all available completions at once and wake up their threads */
+int pth_uring_reap(void)
+{
+#ifdef HAVE_LINUX_IO_URING_H
+    struct io_uring_cqe *cqe;
+    pth_uring_op_t *uo;
+    unsigned int head, tail;
+    int n;
+
+    if (pth_uring.fd == -1 || pth_uring.inflight == 0)
+        return 0;
+    n = 0;
+    head = *pth_uring.cqhead;
+    tail = __atomic_load_n(pth_uring.cqtail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        cqe = &pth_uring.cqes[head & *pth_uring.cqmask];
+        uo = (pth_uring_op_t *)(uintptr_t)cqe->user_data;
+        if (uo != NULL) {
+            /* the event is tagged directly, so the thread is moved
+               to the ready queue by the next cleanup loop */
+            uo->uo_res  = cqe->res;
+            uo->uo_done = TRUE;
+            uo->uo_ev->ev_status = PTH_STATUS_OCCURRED;
+            n++;
+        }
+        pth_uring.inflight--;
+        head++;
+    }
+    __atomic_store_n(pth_uring.cqhead, head, __ATOMIC_RELEASE);
+    return n;
+#else
+    return 0;
+#endif
+}
+
+/* perform an I/O operation through the ring: returns FALSE if the
+   engine cannot take it (the caller then uses the readiness path) */
+int pth_uring_io(int op, int fd, const void *addr, size_t len,
+                 unsigned long long off, int flags, pth_event_t ev_extra, ssize_t *res)
+{
+#ifdef HAVE_LINUX_IO_URING_H
+    static pth_key_t ev_key = PTH_KEY_INIT;
+    struct io_uring_sqe *sqe;
+    pth_uring_op_t uo;
+    pth_event_t ev;
+    int deadlinecnt;
+    int expired;
+    int cancelstate;
+
+    /* non-blocking filedescriptors keep their immediate EAGAIN semantics,
+       (filedescriptors owned by Pth are physically non-blocking and
+       better served by a direct attempt) and room for a cancellation
+       is kept in the completion queue */
+    if (pth_uring.fd == -1 || pth_uring.inflight + 2 > pth_uring.cqentries)
+        return FALSE;
+    if (pth_fdstate_owned(fd) || pth_fdmode(fd, PTH_FDMODE_POLL) != PTH_FDMODE_BLOCK)
+        return FALSE;
+    if ((ev = pth_event(PTH_EVENT_URING|PTH_MODE_STATIC, &ev_key, &uo)) == NULL)
+        return FALSE;
+    uo.uo_ev   = ev;
+    uo.uo_done = FALSE;
+    uo.uo_res  = 0;
+
+    /* queue the operation (submitted in batch by the scheduler) */
+    if ((sqe = pth_uring_sqe()) == NULL)
+        return FALSE;
+    sqe->opcode    = pth_uring_opcode[op];
+    sqe->fd        = fd;
+    sqe->addr      = (unsigned long long)(uintptr_t)addr;
+    sqe->len       = (unsigned int)(len > 0x7ffff000 ? 0x7ffff000 : len);
+    sqe->off       = off;
+    sqe->rw_flags  = (unsigned int)flags;
+    sqe->user_data = (unsigned long long)(uintptr_t)&uo;
+    pth_uring_commit();
+
+    /* the kernel owns the buffer until the completion arrives,
+       so the thread must not vanish in between */
+    pth_cancel_state(PTH_CANCEL_DISABLE, &cancelstate);
+    if (ev_extra != NULL)
+        pth_event_concat(ev, ev_extra, NULL);
+    expired = (pth_wait(ev) < 0);
+    if (ev_extra != NULL)
+        pth_event_isolate(ev);
+    if (!uo.uo_done) {
+        /* extra event occurred, deadline passed or cancellation was
+           requested: abort the operation and wait for its final
+           completion (regardless of the deadline of the thread) */
+        if ((sqe = pth_uring_sqe()) != NULL) {
+            sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+            sqe->fd        = -1;
+            sqe->addr      = (unsigned long long)(uintptr_t)&uo;
+            sqe->user_data = 0;
+            pth_uring_commit();
+        }
+        deadlinecnt = pth_current->deadlinecnt;
+        pth_current->deadlinecnt = 0;
+        while (!uo.uo_done)
+            pth_wait(ev);
+        pth_current->deadlinecnt = deadlinecnt;
+    }
+    pth_cancel_state(cancelstate, NULL);
+
+    /* deliver the result */
+    if (uo.uo_res == -ECANCELED || uo.uo_res == -EINTR) {
+        pth_cancel_point();
+        *res = pth_error(-1, (expired ? ETIMEDOUT : EINTR));
+    }
+    else if (uo.uo_res < 0)
+        *res = pth_error(-1, -uo.uo_res);
+    else
+        *res = uo.uo_res;
+    return TRUE;
+#else
+    (void)op; (void)fd; (void)addr; (void)len;
+    (void)off; (void)flags; (void)ev_extra; (void)res;
+    return FALSE;
+#endif
+}
@@ -26,6 +26,11 @@
                                   the root of all evil.''
                                              -- D.E.Knuth */
 #include "pth_p.h"
+#include <limits.h>
+
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
 
 /* calculate numerical mimimum */
 #if cpp
@@ -92,94 +97,100 @@ char *pth_util_cpystrn(char *dst, const char *src, size_t dst_size)
     return d;
 }
 
+/* open a pollable process descriptor (or return -1 if not possible) */
+int pth_util_pidfd_open(pid_t pid)
+{
+    int fd = -1;
+#if defined(HAVE_SYS_SYSCALL_H) && defined(SYS_pidfd_open)
+    if (pid > 0) {
+        pth_shield { fd = (int)syscall(SYS_pidfd_open, pid, 0); }
+    }
+#else
+    (void)pid;
+#endif
+    return fd;
+}
+
+/* check whether a waitpid(2) style pid has a child which already exited */
+int pth_util_pid_exited(pid_t pid)
+{
+    siginfo_t si;
+    idtype_t idtype;
+    id_t id;
+    int rc;
+
+    if (pid < -1) {
+        idtype = P_PGID;
+        id = (id_t)(-pid);
+    }
+    else if (pid == -1) {
+        idtype = P_ALL;
+        id = 0;
+    }
+    else if (pid == 0) {
+        idtype = P_PGID;
+        id = (id_t)getpgrp();
+    }
+    else {
+        idtype = P_PID;
+        id = (id_t)pid;
+    }
+    memset(&si, 0, sizeof(si));
+    pth_shield {
+        while ((rc = waitid(idtype, id, &si, WEXITED|WNOHANG|WNOWAIT)) < 0
+               && errno == EINTR) ;
+    }
+    /* without any such child there is nothing to wait for, either */
+    if (rc == -1)
+        return TRUE;
+    return (si.si_pid != 0);
+}
+
 /* check whether a file-descriptor is valid */
 int pth_util_fd_valid(int fd)
 {
-    if (fd < 0 || fd >= FD_SETSIZE)
+    if (fd < 0)
         return FALSE;
+    if (pth_fdstate_owned(fd))
+        return TRUE;
     if (fcntl(fd, F_GETFL) == -1 && errno == EBADF)
         return FALSE;
     return TRUE;
 }
 
-/* merge input fd set into output fds */
-void pth_util_fds_merge(int nfd,
-                               fd_set *ifds1, fd_set *ofds1,
-                               fd_set *ifds2, fd_set *ofds2,
-                               fd_set *ifds3, fd_set *ofds3)
-{
-    register int s;
-
-    for (s = 0; s < nfd; s++) {
-        if (ifds1 != NULL)
-            if (FD_ISSET(s, ifds1))
-                FD_SET(s, ofds1);
-        if (ifds2 != NULL)
-            if (FD_ISSET(s, ifds2))
-                FD_SET(s, ofds2);
-        if (ifds3 != NULL)
-            if (FD_ISSET(s, ifds3))
-                FD_SET(s, ofds3);
-    }
-    return;
-}
-
-/* test whether fds in the input fd sets occurred in the output fds */
-int pth_util_fds_test(int nfd,
-                             fd_set *ifds1, fd_set *ofds1,
-                             fd_set *ifds2, fd_set *ofds2,
-                             fd_set *ifds3, fd_set *ofds3)
+/* wait for filedescriptor events with a nanosecond resolution timeout
+   (the timeout is rounded up to milliseconds if ppoll(2) is missing) */
+int pth_util_ppoll(struct pollfd *pfd, nfds_t nfd, const struct timespec *ts)
 {
-    register int s;
-
-    for (s = 0; s < nfd; s++) {
-        if (ifds1 != NULL)
-            if (FD_ISSET(s, ifds1) && FD_ISSET(s, ofds1))
-                return TRUE;
-        if (ifds2 != NULL)
-            if (FD_ISSET(s, ifds2) && FD_ISSET(s, ofds2))
-                return TRUE;
-        if (ifds3 != NULL)
-            if (FD_ISSET(s, ifds3) && FD_ISSET(s, ofds3))
-                return TRUE;
-    }
-    return FALSE;
+#if defined(HAVE_PPOLL)
+    return pth_sc(ppoll)(pfd, nfd, ts, NULL);
+#else
+    int ms;
+
+    if (ts == NULL)
+        ms = -1;
+    else if (ts->tv_sec >= (INT_MAX / 1000) - 1)
+        ms = INT_MAX;
+    else
+        ms = (int)(ts->tv_sec * 1000 + (ts->tv_nsec + 999999) / 1000000);
+    return pth_sc(poll)(pfd, nfd, ms);
+#endif
 }
 
-/*
- * clear fds in input fd sets if not occurred in output fd sets and return
- * number of remaining input fds. This number uses BSD select(2) semantics: a
- * fd in two set counts twice!
- */
-int pth_util_fds_select(int nfd,
-                               fd_set *ifds1, fd_set *ofds1,
-                               fd_set *ifds2, fd_set *ofds2,
-                               fd_set *ifds3, fd_set *ofds3)
+/* directly poll a single filedescriptor without waiting */
+int pth_util_fd_poll(int fd, short events)
 {
-    register int s;
-    register int n;
-
-    n = 0;
-    for (s = 0; s < nfd; s++) {
-        if (ifds1 != NULL && FD_ISSET(s, ifds1)) {
-            if (!FD_ISSET(s, ofds1))
-               FD_CLR(s, ifds1);
-            else
-               n++;
-        }
-        if (ifds2 != NULL && FD_ISSET(s, ifds2)) {
-            if (!FD_ISSET(s, ofds2))
-                FD_CLR(s, ifds2);
-            else
-                n++;
-        }
-        if (ifds3 != NULL && FD_ISSET(s, ifds3)) {
-            if (!FD_ISSET(s, ofds3))
-                FD_CLR(s, ifds3);
-            else
-                n++;
-        }
-    }
+    struct timespec delay;
+    struct pollfd pfd;
+    int n;
+
+    pfd.fd      = fd;
+    pfd.events  = events;
+    pfd.revents = 0;
+    delay.tv_sec  = 0;
+    delay.tv_nsec = 0;
+    while ((n = pth_util_ppoll(&pfd, 1, &delay)) < 0
+           && errno == EINTR) ;
     return n;
 }
 
@@ -0,0 +1,351 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  This file is part of GNU Pth, a non-preemptive thread scheduling
+**  library which can be found at http://www.gnu.org/software/pth/.
+**
+**  This library is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU Lesser General Public
+**  License as published by the Free Software Foundation; either
+**  version 2.1 of the License, or (at your option) any later version.
+**
+**  This library is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**  Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public
+**  License along with this library; if not, write to the Free Software
+**  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+**  USA, or contact Ralf S. Engelschall <rse@engelschall.com>.
+**
+**  pth_zerocopy.c: Pth zero-copy sends
+*/
+                             /* ``The fastest copy is
+                                  the one you never make.''
+                                                 -- Unknown */
+#include "pth_p.h"
+
+#ifdef HAVE_LINUX_ERRQUEUE_H
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#endif
+
+#if defined(HAVE_LINUX_ERRQUEUE_H) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define PTH_ZEROCOPY 1
+#endif
+
+#if cpp
+
+/* internal event type: release of the buffers of zero-copy sends */
+#define PTH_EVENT_ZEROCOPY   _BIT(28)
+
+#endif /* cpp */
+
+/* zero-copy state of a socket */
+#define PTH_ZEROCOPY_UNKNOWN 0 /* not used for zero-copy sends yet      */
+#define PTH_ZEROCOPY_ON      1 /* SO_ZEROCOPY enabled                   */
+#define PTH_ZEROCOPY_OFF     2 /* not supported or not worth it: copy   */
+typedef struct {
+    int          zc_mode;   /* one of the PTH_ZEROCOPY_XXX modes above     */
+    unsigned int zc_next;   /* kernel sequence number of the next send     */
+    unsigned int zc_done;   /* all sends before this number were released  */
+    int          zc_users;  /* threads inside pth_send_zc_ev()             */
+    int          zc_closed; /* socket was closed while in use              */
+    int          zc_error;  /* socket error taken over by the scheduler    */
+} pth_zerocopy_t;
+
+/* the states are allocated one by one, so a thread waiting in
+   pth_send_zc_ev() keeps its state while the table grows */
+static pth_zerocopy_t **pth_zerocopy_tab  = NULL;
+static int              pth_zerocopy_size = 0;
+
+/* find (and optionally create) the zero-copy state of a socket */
+static pth_zerocopy_t *pth_zerocopy_lookup(int fd, int create)
+{
+    pth_zerocopy_t **tab;
+    pth_zerocopy_t *zc;
+    int size;
+
+    if (fd < 0)
+        return NULL;
+    if (fd >= pth_zerocopy_size) {
+        if (!create)
+            return NULL;
+        size = (pth_zerocopy_size == 0 ? 64 : pth_zerocopy_size);
+        while (size <= fd)
+            size *= 2;
+        if ((tab = (pth_zerocopy_t **)realloc(pth_zerocopy_tab, (size_t)size * sizeof(pth_zerocopy_t *))) == NULL)
+            return NULL;
+        memset(tab + pth_zerocopy_size, 0, (size_t)(size - pth_zerocopy_size) * sizeof(pth_zerocopy_t *));
+        pth_zerocopy_tab  = tab;
+        pth_zerocopy_size = size;
+    }
+    if ((zc = pth_zerocopy_tab[fd]) == NULL) {
+        if (!create)
+            return NULL;
+        if ((zc = (pth_zerocopy_t *)calloc(1, sizeof(pth_zerocopy_t))) == NULL)
+            return NULL;
+        pth_zerocopy_tab[fd] = zc;
+    }
+    if (!create && zc->zc_mode == PTH_ZEROCOPY_UNKNOWN)
+        return NULL;
+    return zc;
+}
+
+/* a thread no longer uses the zero-copy state (or was cancelled while doing so) */
+static void pth_zerocopy_unuse(void *arg)
+{
+    pth_zerocopy_t *zc = (pth_zerocopy_t *)arg;
+
+    zc->zc_users--;
+    if (zc->zc_closed && zc->zc_users == 0)
+        free(zc);
+    return;
+}
+
+/* forget the zero-copy state of a socket (freed by the
+   last thread still sending on it, if there is one) */
+void pth_zerocopy_release(int fd)
+{
+    pth_zerocopy_t *zc;
+
+    if (fd < 0 || fd >= pth_zerocopy_size || (zc = pth_zerocopy_tab[fd]) == NULL)
+        return;
+    pth_zerocopy_tab[fd] = NULL;
+    if (zc->zc_users > 0)
+        zc->zc_closed = TRUE;
+    else
+        free(zc);
+    return;
+}
+
+/* forget the zero-copy state of all sockets */
+void pth_zerocopy_kill(void)
+{
+    int fd;
+
+    for (fd = 0; fd < pth_zerocopy_size; fd++)
+        if (pth_zerocopy_tab[fd] != NULL)
+            free(pth_zerocopy_tab[fd]);
+    if (pth_zerocopy_tab != NULL)
+        free(pth_zerocopy_tab);
+    pth_zerocopy_tab  = NULL;
+    pth_zerocopy_size = 0;
+    return;
+}
+
+/* check whether all zero-copy sends before sequence number seq were released */
+int pth_zerocopy_done(int fd, unsigned int seq)
+{
+    pth_zerocopy_t *zc;
+
+    if ((zc = pth_zerocopy_lookup(fd, FALSE)) == NULL)
+        return TRUE;
+    return ((int)(zc->zc_done - seq) >= 0);
+}
+
+/* take over the completion notifications queued on the error queue of a
+   socket (called by the scheduler when poll(2) reports POLLERR for it);
+   returns TRUE if some sends were released and -1 if the error queue was
+   empty, i.e. the POLLERR stands for a socket error which never goes away
+   by itself and hence has to fail the waiting threads */
+int pth_zerocopy_reap(int fd)
+{
+#ifdef PTH_ZEROCOPY
+    pth_zerocopy_t *zc;
+    struct msghdr msg;
+    struct cmsghdr *cm;
+    struct sock_extended_err *ee;
+    char control[128];
+    socklen_t len;
+    int reaped;
+    int queued;
+    int err;
+    ssize_t n;
+
+    if ((zc = pth_zerocopy_lookup(fd, FALSE)) == NULL)
+        return FALSE;
+    reaped = FALSE;
+    queued = FALSE;
+    for (;;) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control    = control;
+        msg.msg_controllen = sizeof(control);
+        while ((n = recvmsg(fd, &msg, MSG_ERRQUEUE|MSG_DONTWAIT)) == -1
+               && errno == EINTR) ;
+        if (n == -1)
+            break;
+        queued = TRUE;
+        for (cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!(   (cm->cmsg_level == IPPROTO_IP   && cm->cmsg_type == IP_RECVERR)
+                  || (cm->cmsg_level == IPPROTO_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+                continue;
+            ee = (struct sock_extended_err *)CMSG_DATA(cm);
+            if (ee->ee_errno != 0 || ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                continue;
+            /* the sends [ee_info, ee_data] were released, and
+               stream sockets release their sends in order */
+            if ((int)(ee->ee_data + 1 - zc->zc_done) > 0)
+                zc->zc_done = ee->ee_data + 1;
+            /* if the kernel had to copy the data anyway (e.g. on the
+               loopback device), zero-copy only adds overhead */
+            if (ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                zc->zc_mode = PTH_ZEROCOPY_OFF;
+            reaped = TRUE;
+        }
+    }
+    if (!queued) {
+        /* take over the socket error (which clears it) and keep it
+           for the next pth_send_zc(3) on the socket (further waiters
+           on the same socket then find it already taken over) */
+        err = 0;
+        len = sizeof(err);
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1)
+            err = errno;
+        if (err != 0)
+            zc->zc_error = err;
+        else if (zc->zc_error == 0)
+            zc->zc_error = EIO;
+        return -1;
+    }
+    return reaped;
+#else
+    (void)fd;
+    return FALSE;
+#endif
+}
+
+/* Pth variant of send(2) without copying the data */
+ssize_t pth_send_zc(int fd, const void *buf, size_t nbytes, int flags, pth_event_t *done)
+{
+    return pth_send_zc_ev(fd, buf, nbytes, flags, done, NULL);
+}
+
+/* Pth variant of send(2) without copying the data, with extra event(s) */
+ssize_t pth_send_zc_ev(int fd, const void *buf, size_t nbytes, int flags, pth_event_t *done, pth_event_t ev_extra)
+{
+    pth_zerocopy_t *zc;
+    pth_event_t ev;
+    static pth_key_t ev_key = PTH_KEY_INIT;
+    unsigned int first;
+    int zcflags;
+    int fdmode;
+    ssize_t rv;
+    ssize_t s;
+    int err;
+
+    pth_implicit_init();
+    pth_debug2("pth_send_zc_ev: enter from thread \"%s\"", pth_current->name);
+
+    /* argument sanity checks */
+    if (done == NULL || (buf == NULL && nbytes > 0))
+        return pth_error(-1, EINVAL);
+    *done = NULL;
+    if (!pth_util_fd_valid(fd))
+        return pth_error(-1, EBADF);
+
+    /* keep the order with data collected on a corked filedescriptor */
+    if (pth_cork_pending > 0 && !pth_cork_sync(fd, ev_extra))
+        return -1;
+
+    /* enable zero-copy sends on the first use of the socket */
+    if ((zc = pth_zerocopy_lookup(fd, TRUE)) == NULL)
+        return pth_error(-1, ENOMEM);
+
+    /* report a socket error the scheduler took over while waiting */
+    if (zc->zc_error != 0) {
+        err = zc->zc_error;
+        zc->zc_error = 0;
+        return pth_error(-1, err);
+    }
+    if (zc->zc_mode == PTH_ZEROCOPY_UNKNOWN) {
+        zc->zc_mode = PTH_ZEROCOPY_OFF;
+#ifdef PTH_ZEROCOPY
+        {
+            int on = 1;
+            if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == 0)
+                zc->zc_mode = PTH_ZEROCOPY_ON;
+        }
+#endif
+    }
+    first   = zc->zc_next;
+    zcflags = 0;
+#ifdef PTH_ZEROCOPY
+    if (zc->zc_mode == PTH_ZEROCOPY_ON)
+        zcflags = MSG_ZEROCOPY;
+#endif
+
+    /* force filedescriptor into non-blocking mode */
+    if ((fdmode = pth_fdmode(fd, PTH_FDMODE_NONBLOCK)) == PTH_FDMODE_ERROR)
+        return pth_error(-1, EBADF);
+
+    /* keep the state while waiting, even if the socket is closed meanwhile */
+    zc->zc_users++;
+    pth_cleanup_push(pth_zerocopy_unuse, zc);
+
+    /* send the data, mimicing the blocking send(2) behaviour */
+    rv = 0;
+    ev = NULL;
+    while (nbytes > 0) {
+        while ((s = pth_sc(send)(fd, buf, nbytes, flags|zcflags)) < 0
+               && errno == EINTR) ;
+        /* if no more pages can be pinned, copy instead */
+        if (s < 0 && errno == ENOBUFS && zcflags != 0) {
+            zcflags = 0;
+            continue;
+        }
+        if (s > 0) {
+            /* every successful zero-copy send consumes a sequence number */
+            if (zcflags != 0)
+                zc->zc_next++;
+            rv += s;
+            nbytes -= (size_t)s;
+            buf = (const char *)buf + s;
+            continue;
+        }
+        if (   s < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)
+            && fdmode != PTH_FDMODE_NONBLOCK) {
+            /* wait until the socket is writeable again */
+            if (ev == NULL)
+                if ((ev = pth_event(PTH_EVENT_FD|PTH_UNTIL_FD_WRITEABLE|PTH_MODE_STATIC, &ev_key, fd)) == NULL)
+                    break;
+            if (ev_extra != NULL)
+                pth_event_concat(ev, ev_extra, NULL);
+            if ((err = pth_wait_result(ev, ev_extra, pth_wait(ev))) != 0) {
+                errno = err;
+                break;
+            }
+            /* the filedescriptor number might already be reused */
+            if (zc->zc_closed) {
+                errno = EBADF;
+                break;
+            }
+            continue;
+        }
+        break;
+    }
+
+    /* restore filedescriptor mode */
+    if (!zc->zc_closed)
+        pth_shield { pth_fdmode(fd, fdmode); }
+
+    /* pass error to caller, but not for partial sends (rv > 0), else
+       create the event which occurs once the kernel released the buffer
+       (immediately if the data was just copied or the socket is gone) */
+    if (rv == 0 && nbytes > 0)
+        rv = -1;
+    else {
+        pth_shield { *done = pth_event(PTH_EVENT_ZEROCOPY, fd, zc->zc_next); }
+        if (*done == NULL)
+            rv = pth_error(-1, ENOMEM);
+        else if (zc->zc_next == first || zc->zc_closed)
+            (*done)->ev_status = PTH_STATUS_OCCURRED;
+    }
+    pth_shield { pth_cleanup_pop(TRUE); }
+
+    pth_debug2("pth_send_zc_ev: leave to thread \"%s\"", pth_current->name);
+    return rv;
+}
+
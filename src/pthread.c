@@ -598,7 +598,8 @@ int pthread_mutexattr_init(pthread_mutexattr_t *attr)
     pthread_initialize();
     if (attr == NULL)
         return pth_error(EINVAL, EINVAL);
-    /* nothing to do for us */
+    /* the attribute holds the protocol only */
+    *attr = PTHREAD_PRIO_NONE;
     return OK;
 }
 
@@ -630,16 +631,21 @@ int pthread_mutexattr_setprotocol(pthread_mutexattr_t *attr, int protocol)
 {
     if (attr == NULL)
         return pth_error(EINVAL, EINVAL);
-    /* not supported */
-    return pth_error(ENOSYS, ENOSYS);
+    /* priority ceilings are not supported */
+    if (protocol == PTHREAD_PRIO_PROTECT)
+        return pth_error(ENOSYS, ENOSYS);
+    if (protocol != PTHREAD_PRIO_INHERIT && protocol != PTHREAD_PRIO_NONE)
+        return pth_error(EINVAL, EINVAL);
+    *attr = protocol;
+    return OK;
 }
 
 int pthread_mutexattr_getprotocol(pthread_mutexattr_t *attr, int *protocol)
 {
-    if (attr == NULL)
+    if (attr == NULL || protocol == NULL)
         return pth_error(EINVAL, EINVAL);
-    /* not supported */
-    return pth_error(ENOSYS, ENOSYS);
+    *protocol = *attr;
+    return OK;
 }
 
 int pthread_mutexattr_setpshared(pthread_mutexattr_t *attr, int pshared)
@@ -689,6 +695,8 @@ int pthread_mutex_init(pthread_mutex_t *mutex, const pthread_mutexattr_t *attr)
         return errno;
     if (!pth_mutex_init(m))
         return errno;
+    if (attr != NULL && *attr == PTHREAD_PRIO_INHERIT)
+        pth_mutex_setmode(m, PTH_MUTEX_INHERIT, 0);
     (*mutex) = (pthread_mutex_t)m;
     return OK;
 }
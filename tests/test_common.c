@@ -37,22 +37,17 @@
 /*
  * implementation of a convinient greedy tread-safe line reading function to
  * avoid slow byte-wise reading from filedescriptors - which is important for
- * high-performance situations.
+ * high-performance situations. It is a thin wrapper around a per-thread
+ * Pth buffered stream.
  */
 
 #define READLINE_MAXLEN 1024
 static pth_key_t  readline_key;
 static pth_once_t readline_once_ctrl = PTH_ONCE_INIT;
 
-typedef struct {
-    int   rl_cnt;
-    char *rl_bufptr;
-    char  rl_buf[READLINE_MAXLEN];
-} readline_buf;
-
 static void readline_buf_destroy(void *vp)
 {
-    free(vp);
+    pth_stream_destroy((pth_stream_t)vp);
     return;
 }
 
@@ -70,56 +65,30 @@ ssize_t pth_readline(int fd, void *buf, size_t buflen)
 
 ssize_t pth_readline_ev(int fd, void *buf, size_t buflen, pth_event_t ev_extra)
 {
-    size_t n;
-    ssize_t rc;
-    char c = '\0', *cp;
-    readline_buf *rl;
+    pth_stream_t st;
+    ssize_t n, i, j;
+    char *cp;
 
+    if (buflen == 0)
+        return 0;
     pth_once(&readline_once_ctrl, readline_init, NULL);
-    if ((rl = (readline_buf *)pth_key_getdata(readline_key)) == NULL) {
-        rl = (readline_buf *)malloc(sizeof(readline_buf));
-        rl->rl_cnt = 0;
-        rl->rl_bufptr = NULL;
-        pth_key_setdata(readline_key, rl);
-    }
-    cp = (char *)buf;
-    for (n = 1; n < buflen; n++) {
-
-        /* fetch one character (but read more) */
-        rc = 1;
-        if (rl->rl_cnt <= 0) {
-            if ((rl->rl_cnt = pth_read_ev(fd, rl->rl_buf, READLINE_MAXLEN, ev_extra)) < 0)
-                rc = -1;
-            else if (rl->rl_cnt == 0)
-                rc = 0;
-            else
-                rl->rl_bufptr = rl->rl_buf;
-        }
-        if (rc == 1) {
-            rl->rl_cnt--;
-            c = *rl->rl_bufptr++;
-        }
-
-        /* act on fetched character */
-        if (rc == 1) {
-            if (c == '\r') {
-                n--;
-                continue;
-            }
-            *cp++ = c;
-            if (c == '\n')
-                break;
-        }
-        else if (rc == 0) {
-            if (n == 1)
-                return 0;
-            else
-                break;
-        }
-        else
+    if ((st = (pth_stream_t)pth_key_getdata(readline_key)) == NULL
+        || pth_stream_fd(st) != fd) {
+        if (st != NULL)
+            pth_stream_destroy(st);
+        if ((st = pth_stream_create(fd, READLINE_MAXLEN, 0)) == NULL)
             return -1;
+        pth_key_setdata(readline_key, st);
     }
-    *cp = NUL;
-    return n;
+
+    /* read the line and strip all carriage returns */
+    if ((n = pth_stream_readuntil(st, '\n', buf, buflen - 1, ev_extra)) <= 0)
+        return n;
+    cp = (char *)buf;
+    for (i = j = 0; i < n; i++)
+        if (cp[i] != '\r')
+            cp[j++] = cp[i];
+    cp[j] = NUL;
+    return j;
 }
 
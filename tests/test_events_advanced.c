@@ -10,9 +10,11 @@
 #include <string.h>
 #include <signal.h>
 #include <unistd.h>
+#include <time.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <pthread.h>
 #include "pth.h"
 
 static int test_count = 0;
@@ -354,6 +356,88 @@ static void test_event_cond(void)
     PASS();
 }
 
+static pth_cond_t stale_cond = PTH_COND_INIT;
+static pth_mutex_t stale_mutex = PTH_MUTEX_INIT;
+
+static void *stale_cond_thread(void *arg __attribute__((unused)))
+{
+    pth_mutex_acquire(&stale_mutex, FALSE, NULL);
+    pth_cond_await(&stale_cond, &stale_mutex, NULL);
+    pth_mutex_release(&stale_mutex);
+    return NULL;
+}
+
+static void test_event_cond_after_notify(void)
+{
+    pth_event_t ev, ev_to;
+    pth_t tid;
+
+    TEST("pth_event: COND event after a taken notification");
+
+    /* a notification taken by a queued waiter leaves no signal behind */
+    tid = pth_spawn(PTH_ATTR_DEFAULT, stale_cond_thread, NULL);
+    ASSERT(tid != NULL, "thread spawn failed");
+    pth_yield(NULL);
+    ASSERT(stale_cond.cn_waiters == 1, "waiter not queued");
+    pth_mutex_acquire(&stale_mutex, FALSE, NULL);
+    pth_cond_notify(&stale_cond, FALSE);
+    pth_mutex_release(&stale_mutex);
+    pth_join(tid, NULL);
+
+    ev = pth_event(PTH_EVENT_COND, &stale_cond);
+    ev_to = pth_event(PTH_EVENT_TIME, pth_timeout(0, 20000));
+    ASSERT(ev != NULL && ev_to != NULL, "event creation failed");
+    pth_event_concat(ev, ev_to, NULL);
+    pth_wait(ev);
+    ASSERT(pth_event_status(ev) == PTH_STATUS_PENDING, "stale condition signal");
+    ASSERT(pth_event_status(ev_to) == PTH_STATUS_OCCURRED, "timeout did not occur");
+
+    pth_event_free(ev, PTH_FREE_ALL);
+    PASS();
+}
+
+static pth_cond_t event_cond = PTH_COND_INIT;
+
+static void *event_cond_thread(void *arg __attribute__((unused)))
+{
+    pth_event_t ev, ev_to;
+    pth_status_t status;
+
+    ev = pth_event(PTH_EVENT_COND, &event_cond);
+    ev_to = pth_event(PTH_EVENT_TIME, pth_timeout(2, 0));
+    if (ev == NULL || ev_to == NULL)
+        return (void *)1;
+    pth_event_concat(ev, ev_to, NULL);
+    pth_wait(ev);
+    status = pth_event_status(ev);
+    pth_event_free(ev, PTH_FREE_ALL);
+    return (status == PTH_STATUS_OCCURRED ? NULL : (void *)1);
+}
+
+static void test_event_cond_notify(void)
+{
+    void *result;
+    pth_t tid;
+    int i;
+
+    TEST("pth_event: COND event woken by pth_cond_notify");
+
+    /* both a signal and a broadcast wake a thread waiting on the event */
+    for (i = 0; i < 2; i++) {
+        tid = pth_spawn(PTH_ATTR_DEFAULT, event_cond_thread, NULL);
+        ASSERT(tid != NULL, "thread spawn failed");
+        pth_yield(NULL);
+        ASSERT(event_cond.cn_waiters == 1, "event waiter not counted");
+        pth_cond_notify(&event_cond, i == 1);
+        result = (void *)1;
+        pth_join(tid, &result);
+        ASSERT(result == NULL, "event waiter not woken");
+        ASSERT(event_cond.cn_waiters == 0, "event waiter still counted");
+        ASSERT(!(event_cond.cn_state & PTH_COND_SIGNALED), "signal not consumed");
+    }
+    PASS();
+}
+
 static void *tid_test_thread(void *arg __attribute__((unused)))
 {
     pth_sleep(1);
@@ -531,6 +615,117 @@ static void test_event_reuse_mode(void)
     PASS();
 }
 
+static void test_event_notify(void)
+{
+    pth_notify_t nt;
+    pth_notify_t nt2;
+    pth_event_t ev;
+
+    TEST("pth_event: NOTIFY event typeof/extract");
+    nt = pth_notify_create();
+    ASSERT(nt != NULL, "notify creation failed");
+
+    ev = pth_event(PTH_EVENT_NOTIFY, nt);
+    ASSERT(ev != NULL, "event creation failed");
+    ASSERT(pth_event_typeof(ev) == PTH_EVENT_NOTIFY, "event type mismatch");
+    nt2 = NULL;
+    ASSERT(pth_event_extract(ev, &nt2) == TRUE, "extract failed");
+    ASSERT(nt2 == nt, "extracted notify mismatch");
+
+    pth_event_free(ev, PTH_FREE_ALL);
+    pth_notify_destroy(nt);
+    PASS();
+}
+
+static void test_event_notify_coalesce(void)
+{
+    pth_notify_t nt;
+    pth_event_t ev;
+    pth_event_t evt;
+
+    TEST("pth_event: NOTIFY coalesces multiple raises");
+    nt = pth_notify_create();
+    ASSERT(nt != NULL, "notify creation failed");
+
+    pth_notify_raise(nt);
+    pth_notify_raise(nt);
+    pth_notify_raise(nt);
+
+    ev = pth_event(PTH_EVENT_NOTIFY, nt);
+    pth_wait(ev);
+    ASSERT(pth_event_status(ev) == PTH_STATUS_OCCURRED, "raise not seen");
+
+    /* all three raises were consumed by the single wakeup */
+    evt = pth_event(PTH_EVENT_TIME, pth_timeout(0, 50000));
+    ASSERT(pth_notify_wait(nt, evt) == FALSE, "raises not coalesced");
+    ASSERT(pth_event_status(evt) == PTH_STATUS_OCCURRED, "timeout not occurred");
+
+    pth_event_free(evt, PTH_FREE_ALL);
+    pth_event_free(ev, PTH_FREE_ALL);
+    pth_notify_destroy(nt);
+    PASS();
+}
+
+static void *notify_native_thread(void *arg)
+{
+    struct timespec ts = { 0, 50000000 };
+    nanosleep(&ts, NULL);
+    pth_notify_raise((pth_notify_t)arg);
+    return NULL;
+}
+
+static void test_event_notify_foreign(void)
+{
+    pth_notify_t nt;
+    pthread_t thr;
+    pth_event_t evt;
+
+    TEST("pth_notify_raise: from a native OS thread");
+    nt = pth_notify_create();
+    ASSERT(nt != NULL, "notify creation failed");
+    ASSERT(pthread_create(&thr, NULL, notify_native_thread, nt) == 0,
+           "pthread_create failed");
+
+    evt = pth_event(PTH_EVENT_TIME, pth_timeout(5, 0));
+    ASSERT(pth_notify_wait(nt, evt) == TRUE, "notification not received");
+
+    pthread_join(thr, NULL);
+    pth_event_free(evt, PTH_FREE_ALL);
+    pth_notify_destroy(nt);
+    PASS();
+}
+
+static pth_notify_t notify_sig_nt;
+
+static void notify_sig_handler(int sig __attribute__((unused)))
+{
+    pth_notify_raise(notify_sig_nt);
+}
+
+static void test_event_notify_signal(void)
+{
+    struct sigaction sa, osa;
+    pth_event_t evt;
+
+    TEST("pth_notify_raise: from a signal handler");
+    notify_sig_nt = pth_notify_create();
+    ASSERT(notify_sig_nt != NULL, "notify creation failed");
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = notify_sig_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR2, &sa, &osa);
+    kill(getpid(), SIGUSR2);
+
+    evt = pth_event(PTH_EVENT_TIME, pth_timeout(5, 0));
+    ASSERT(pth_notify_wait(notify_sig_nt, evt) == TRUE, "notification not received");
+
+    sigaction(SIGUSR2, &osa, NULL);
+    pth_event_free(evt, PTH_FREE_ALL);
+    pth_notify_destroy(notify_sig_nt);
+    PASS();
+}
+
 int main(int argc __attribute__((unused)), char *argv[] __attribute__((unused)))
 {
     printf("========================================\n");
@@ -557,6 +752,8 @@ int main(int argc __attribute__((unused)), char *argv[] __attribute__((unused)))
     test_event_fd_writable();
     test_event_mutex();
     test_event_cond();
+    test_event_cond_after_notify();
+    test_event_cond_notify();
     test_event_tid();
     test_event_func();
     test_event_select();
@@ -565,6 +762,10 @@ int main(int argc __attribute__((unused)), char *argv[] __attribute__((unused)))
     test_event_sigs();
     test_event_chain_mode();
     test_event_reuse_mode();
+    test_event_notify();
+    test_event_notify_coalesce();
+    test_event_notify_foreign();
+    test_event_notify_signal();
 
     printf("\n========================================\n");
     printf("Test Results:\n");
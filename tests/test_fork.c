@@ -8,7 +8,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <signal.h>
 #include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include "pth.h"
@@ -282,6 +285,170 @@ static void test_atfork_null_handlers(void)
     PASS();
 }
 
+static double elapsed_since(struct timeval *tv0)
+{
+    struct timeval tv1;
+    gettimeofday(&tv1, NULL);
+    return (tv1.tv_sec - tv0->tv_sec) + (tv1.tv_usec - tv0->tv_usec) / 1000000.0;
+}
+
+static void child_sleep_exit(long ms, int code)
+{
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+    nanosleep(&ts, NULL);
+    _exit(code);
+}
+
+static volatile int ticker_count = 0;
+
+static void *ticker_thread(void *arg __attribute__((unused)))
+{
+    for (;;) {
+        ticker_count++;
+        pth_usleep(5000);
+    }
+    return NULL;
+}
+
+static void test_pth_waitpid_wakeup(void)
+{
+    struct timeval tv0;
+    pth_t ticker;
+    pid_t pid;
+    pid_t rpid;
+    int status;
+
+    TEST("pth_waitpid: wakes on child exit and does not block others");
+
+    ticker_count = 0;
+    ticker = pth_spawn(PTH_ATTR_DEFAULT, ticker_thread, NULL);
+    ASSERT(ticker != NULL, "spawn failed");
+
+    pid = pth_fork();
+    ASSERT(pid >= 0, "fork failed");
+    if (pid == 0)
+        child_sleep_exit(50, 7);
+
+    gettimeofday(&tv0, NULL);
+    rpid = pth_waitpid(pid, &status, 0);
+    pth_cancel(ticker);
+    pth_join(ticker, NULL);
+
+    ASSERT(rpid == pid, "wrong pid reaped");
+    ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 7, "wrong exit status");
+    ASSERT(elapsed_since(&tv0) < 0.2, "child exit noticed too late");
+    ASSERT(ticker_count > 1, "other threads were blocked");
+
+    PASS();
+}
+
+static void test_pth_waitpid_any(void)
+{
+    pid_t pid;
+    pid_t rpid;
+    int status;
+
+    TEST("pth_waitpid: any child (-1)");
+
+    pid = pth_fork();
+    ASSERT(pid >= 0, "fork failed");
+    if (pid == 0)
+        child_sleep_exit(20, 3);
+
+    rpid = pth_waitpid(-1, &status, 0);
+    ASSERT(rpid == pid, "wrong pid reaped");
+    ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 3, "wrong exit status");
+
+    PASS();
+}
+
+static volatile sig_atomic_t sigchld_count = 0;
+
+static void sigchld_handler(int sig __attribute__((unused)))
+{
+    sigchld_count++;
+}
+
+static void test_pth_waitpid_any_sigchld_handler(void)
+{
+    struct sigaction sa, osa;
+    pid_t pid;
+    pid_t rpid;
+    int status;
+
+    TEST("pth_waitpid: any child keeps the SIGCHLD handler of the application");
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigchld_handler;
+    sigemptyset(&sa.sa_mask);
+    ASSERT(sigaction(SIGCHLD, &sa, &osa) == 0, "sigaction failed");
+    sigchld_count = 0;
+
+    pid = pth_fork();
+    ASSERT(pid >= 0, "fork failed");
+    if (pid == 0)
+        child_sleep_exit(20, 4);
+
+    rpid = pth_waitpid(-1, &status, 0);
+    sigaction(SIGCHLD, &osa, NULL);
+    ASSERT(rpid == pid, "wrong pid reaped");
+    ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 4, "wrong exit status");
+    ASSERT(sigchld_count == 1, "SIGCHLD handler of the application not called");
+
+    PASS();
+}
+
+static void test_event_pid(void)
+{
+    pth_event_t ev;
+    pth_event_t evt;
+    pid_t pid;
+    pid_t epid;
+    int status;
+
+    TEST("pth_event: PID event in an event ring");
+
+    pid = pth_fork();
+    ASSERT(pid >= 0, "fork failed");
+    if (pid == 0)
+        child_sleep_exit(20, 0);
+
+    ev = pth_event(PTH_EVENT_PID, pid);
+    ASSERT(ev != NULL, "event creation failed");
+    ASSERT(pth_event_typeof(ev) == PTH_EVENT_PID, "event type mismatch");
+    epid = 0;
+    pth_event_extract(ev, &epid);
+    ASSERT(epid == pid, "extracted pid mismatch");
+
+    evt = pth_event(PTH_EVENT_TIME, pth_timeout(5, 0));
+    pth_event_concat(ev, evt, NULL);
+    pth_wait(ev);
+    pth_event_isolate(ev);
+    ASSERT(pth_event_status(ev) == PTH_STATUS_OCCURRED, "PID event not occurred");
+
+    /* the event does not reap the child */
+    ASSERT(waitpid(pid, &status, WNOHANG) == pid, "child already reaped");
+
+    pth_event_free(evt, PTH_FREE_ALL);
+    pth_event_free(ev, PTH_FREE_ALL);
+    PASS();
+}
+
+static void test_pth_system(void)
+{
+    struct timeval tv0;
+
+    TEST("pth_system: returns promptly");
+
+    gettimeofday(&tv0, NULL);
+    ASSERT(pth_system("exit 5") != -1, "pth_system failed");
+    ASSERT(elapsed_since(&tv0) < 0.2, "child exit noticed too late");
+
+    PASS();
+}
+
 int main(int argc __attribute__((unused)), char *argv[] __attribute__((unused)))
 {
     printf("========================================\n");
@@ -303,6 +470,11 @@ int main(int argc __attribute__((unused)), char *argv[] __attribute__((unused)))
     test_pth_fork_child_can_spawn();
     test_pth_fork_with_running_threads();
     test_atfork_null_handlers();
+    test_pth_waitpid_wakeup();
+    test_pth_waitpid_any();
+    test_pth_waitpid_any_sigchld_handler();
+    test_event_pid();
+    test_pth_system();
 
     printf("\n========================================\n");
     printf("Test Results:\n");
@@ -9,6 +9,7 @@
 **  Tests I/O functions not covered by existing tests
 */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,6 +22,7 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <sys/resource.h>
 
 #include "pth.h"
 
@@ -185,6 +187,301 @@ static void test_pth_pread_pwrite(void)
     fprintf(stderr, "  PASSED: pth_pread and pth_pwrite work correctly\n");
 }
 
+static void test_pth_preadv_pwritev(void)
+{
+    char filename[] = "/tmp/pth_test_XXXXXX";
+    int fd;
+    char part1[] = "log-";
+    char part2[] = "structured";
+    char rbuf1[8], rbuf2[8];
+    struct iovec iov[2];
+    struct iovec many[64];
+    ssize_t n;
+    int i;
+
+    fprintf(stderr, "\nTesting pth_preadv and pth_pwritev...\n");
+
+    fd = mkstemp(filename);
+    TEST_ASSERT(fd >= 0, "mkstemp failed");
+
+    iov[0].iov_base = part1;
+    iov[0].iov_len  = strlen(part1);
+    iov[1].iov_base = part2;
+    iov[1].iov_len  = strlen(part2);
+    n = pth_pwritev(fd, iov, 2, 100);
+    TEST_ASSERT(n == 14, "pth_pwritev failed");
+    fprintf(stderr, "  wrote %zd bytes at offset 100\n", n);
+
+    memset(rbuf1, 0, sizeof(rbuf1));
+    memset(rbuf2, 0, sizeof(rbuf2));
+    iov[0].iov_base = rbuf1;
+    iov[0].iov_len  = 4;
+    iov[1].iov_base = rbuf2;
+    iov[1].iov_len  = 6;
+    n = pth_preadv(fd, iov, 2, 104);
+    TEST_ASSERT(n == 10, "pth_preadv failed");
+    TEST_ASSERT(memcmp(rbuf1, "stru", 4) == 0 && memcmp(rbuf2, "ctured", 6) == 0,
+                "preadv data mismatch");
+    fprintf(stderr, "  read %zd bytes at offset 104: '%s%s'\n", n, rbuf1, rbuf2);
+
+    /* positional I/O never moves the file offset */
+    TEST_ASSERT(lseek(fd, 0, SEEK_CUR) == 0, "file offset was changed");
+
+    TEST_ASSERT(pth_preadv(fd, iov, 0, 0) == -1 && errno == EINVAL,
+                "empty iovec accepted");
+
+    /* more vectors than fit into the temporary stack copy */
+    for (i = 0; i < 64; i++) {
+        many[i].iov_base = (char *)"0123456789abcdefghijklmnopqrstuvwxyz" + (i % 36);
+        many[i].iov_len  = 1;
+    }
+    n = pth_pwritev(fd, many, 64, 200);
+    TEST_ASSERT(n == 64, "pth_pwritev with many vectors failed");
+    TEST_ASSERT(pth_pread(fd, rbuf1, 8, 234) == 8 && memcmp(rbuf1, "yz012345", 8) == 0,
+                "pwritev data mismatch");
+
+    close(fd);
+    unlink(filename);
+
+    fprintf(stderr, "  PASSED: pth_preadv and pth_pwritev work correctly\n");
+}
+
+#define XFER_SIZE (256 * 1024)
+
+static void *xfer_drain(void *arg)
+{
+    int fd = *(int *)arg;
+    char buf[4096];
+    long total = 0;
+    ssize_t n;
+
+    while ((n = pth_read(fd, buf, sizeof(buf))) > 0)
+        total += n;
+    return (void *)total;
+}
+
+static void test_pth_sendfile_splice_tee(void)
+{
+    char filename[] = "/tmp/pth_test_XXXXXX";
+    char buf[XFER_SIZE / 64];
+    int fd, sv[2], pa[2], pb[2];
+    pth_attr_t attr;
+    pth_event_t ev;
+    pth_t tid;
+    void *total;
+    off_t off;
+    ssize_t n;
+    int i;
+
+    fprintf(stderr, "\nTesting pth_sendfile, pth_splice and pth_tee...\n");
+
+    fd = mkstemp(filename);
+    TEST_ASSERT(fd >= 0, "mkstemp failed");
+    memset(buf, 'z', sizeof(buf));
+    for (i = 0; i < 64; i++)
+        TEST_ASSERT(write(fd, buf, sizeof(buf)) == (ssize_t)sizeof(buf), "write failed");
+
+    attr = pth_attr_new();
+    pth_attr_set(attr, PTH_ATTR_JOINABLE, TRUE);
+
+    /* more data than fits into the socket buffer: the sender has to park */
+    TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0, "socketpair failed");
+    tid = pth_spawn(attr, xfer_drain, &sv[1]);
+    TEST_ASSERT(tid != NULL, "spawn failed");
+    off = 0;
+    n = pth_sendfile(sv[0], fd, &off, XFER_SIZE);
+    TEST_ASSERT(n == XFER_SIZE, "pth_sendfile transferred too few bytes");
+    TEST_ASSERT(off == XFER_SIZE, "pth_sendfile did not advance the offset");
+    close(sv[0]);
+    pth_join(tid, &total);
+    TEST_ASSERT((long)total == XFER_SIZE, "receiver got wrong amount of data");
+    close(sv[1]);
+    fprintf(stderr, "  sendfile moved %zd bytes\n", n);
+
+    /* the same from a file through a pipe with explicit offset */
+    TEST_ASSERT(pipe(pa) == 0, "pipe failed");
+    tid = pth_spawn(attr, xfer_drain, &pa[0]);
+    TEST_ASSERT(tid != NULL, "spawn failed");
+    off = 1024;
+    n = pth_splice(fd, &off, pa[1], NULL, XFER_SIZE - 1024, 0);
+    TEST_ASSERT(n == XFER_SIZE - 1024, "pth_splice transferred too few bytes");
+    TEST_ASSERT(off == XFER_SIZE, "pth_splice did not advance the offset");
+    close(pa[1]);
+    pth_join(tid, &total);
+    TEST_ASSERT((long)total == XFER_SIZE - 1024, "reader got wrong amount of data");
+    close(pa[0]);
+    fprintf(stderr, "  splice moved %zd bytes\n", n);
+
+    /* duplicate pipe content without consuming it */
+    TEST_ASSERT(pipe(pa) == 0 && pipe(pb) == 0, "pipe failed");
+    TEST_ASSERT(write(pa[1], "tee!", 4) == 4, "write failed");
+    n = pth_tee(pa[0], pb[1], 64, 0);
+    TEST_ASSERT(n == 4, "pth_tee failed");
+    TEST_ASSERT(pth_read(pb[0], buf, sizeof(buf)) == 4 && memcmp(buf, "tee!", 4) == 0,
+                "tee data mismatch");
+    TEST_ASSERT(pth_read(pa[0], buf, sizeof(buf)) == 4, "tee consumed its input");
+
+    /* an empty input pipe parks the thread until the extra event */
+    ev = pth_event(PTH_EVENT_TIME, pth_timeout(0, 100000));
+    n = pth_splice_ev(pa[0], NULL, pb[1], NULL, 64, 0, ev);
+    TEST_ASSERT(n == -1 && errno == EINTR, "pth_splice_ev did not time out");
+    pth_event_free(ev, PTH_FREE_THIS);
+    close(pa[0]); close(pa[1]);
+    close(pb[0]); close(pb[1]);
+
+    pth_attr_destroy(attr);
+    close(fd);
+    unlink(filename);
+
+    fprintf(stderr, "  PASSED: pth_sendfile, pth_splice and pth_tee work correctly\n");
+}
+
+#define MMSG_BATCH 32
+
+static int mmsg_socket(struct sockaddr_in *addr)
+{
+    socklen_t len = sizeof(*addr);
+    int fd;
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    TEST_ASSERT(fd >= 0, "socket failed");
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST_ASSERT(bind(fd, (struct sockaddr *)addr, sizeof(*addr)) == 0, "bind failed");
+    TEST_ASSERT(getsockname(fd, (struct sockaddr *)addr, &len) == 0, "getsockname failed");
+    return fd;
+}
+
+static void *mmsg_receiver(void *arg)
+{
+    static char bufs[MMSG_BATCH][16];
+    struct mmsghdr vec[MMSG_BATCH];
+    struct iovec iov[MMSG_BATCH];
+    int fd = *(int *)arg;
+    int i;
+
+    memset(vec, 0, sizeof(vec));
+    for (i = 0; i < MMSG_BATCH; i++) {
+        iov[i].iov_base = bufs[i];
+        iov[i].iov_len  = sizeof(bufs[i]);
+        vec[i].msg_hdr.msg_iov    = &iov[i];
+        vec[i].msg_hdr.msg_iovlen = 1;
+    }
+    return (void *)(long)pth_recvmmsg(fd, vec, MMSG_BATCH, 0);
+}
+
+static void test_pth_recvmmsg_sendmmsg(void)
+{
+    struct sockaddr_in rxaddr, txaddr;
+    struct mmsghdr vec[MMSG_BATCH];
+    struct iovec iov[MMSG_BATCH];
+    char bufs[MMSG_BATCH][16];
+    char big[400];
+    char cbuf[64];
+    struct msghdr msg;
+    pth_attr_t attr;
+    pth_event_t ev;
+    pth_t tid;
+    void *rc;
+    int rx, tx;
+    int i, n, got;
+
+    fprintf(stderr, "\nTesting pth_recvmmsg and pth_sendmmsg...\n");
+
+    rx = mmsg_socket(&rxaddr);
+    tx = mmsg_socket(&txaddr);
+    TEST_ASSERT(connect(tx, (struct sockaddr *)&rxaddr, sizeof(rxaddr)) == 0, "connect failed");
+
+    /* a whole batch of datagrams per call */
+    memset(vec, 0, sizeof(vec));
+    for (i = 0; i < MMSG_BATCH; i++) {
+        snprintf(bufs[i], sizeof(bufs[i]), "msg-%02d", i);
+        iov[i].iov_base = bufs[i];
+        iov[i].iov_len  = strlen(bufs[i]);
+        vec[i].msg_hdr.msg_iov    = &iov[i];
+        vec[i].msg_hdr.msg_iovlen = 1;
+    }
+    n = pth_sendmmsg(tx, vec, MMSG_BATCH, 0);
+    TEST_ASSERT(n == MMSG_BATCH, "pth_sendmmsg failed");
+    fprintf(stderr, "  sent %d datagrams in one call\n", n);
+
+    memset(bufs, 0, sizeof(bufs));
+    for (i = 0; i < MMSG_BATCH; i++)
+        iov[i].iov_len = sizeof(bufs[i]);
+    for (got = 0; got < MMSG_BATCH; got += n) {
+        n = pth_recvmmsg(rx, vec + got, MMSG_BATCH - got, 0);
+        TEST_ASSERT(n > 0, "pth_recvmmsg failed");
+    }
+    for (i = 0; i < MMSG_BATCH; i++) {
+        char expect[16];
+        snprintf(expect, sizeof(expect), "msg-%02d", i);
+        TEST_ASSERT(vec[i].msg_len == strlen(expect) && strcmp(bufs[i], expect) == 0,
+                    "datagram mismatch");
+    }
+    fprintf(stderr, "  received %d datagrams\n", got);
+
+    /* an empty socket parks the thread until data or the extra event */
+    ev = pth_event(PTH_EVENT_TIME, pth_timeout(0, 100000));
+    n = pth_recvmmsg_ev(rx, vec, MMSG_BATCH, 0, ev);
+    TEST_ASSERT(n == -1 && errno == EINTR, "pth_recvmmsg_ev did not time out");
+    pth_event_free(ev, PTH_FREE_THIS);
+
+    attr = pth_attr_new();
+    pth_attr_set(attr, PTH_ATTR_JOINABLE, TRUE);
+    tid = pth_spawn(attr, mmsg_receiver, &rx);
+    TEST_ASSERT(tid != NULL, "spawn failed");
+    pth_yield(NULL);
+    n = pth_sendmmsg(tx, vec, 4, 0);
+    TEST_ASSERT(n == 4, "pth_sendmmsg failed");
+    pth_join(tid, &rc);
+    TEST_ASSERT((long)rc >= 1, "parked pth_recvmmsg got nothing");
+    while ((long)rc < 4) {
+        n = pth_recvmmsg(rx, vec, MMSG_BATCH, 0);
+        TEST_ASSERT(n > 0, "pth_recvmmsg failed");
+        rc = (void *)((long)rc + n);
+    }
+    pth_attr_destroy(attr);
+
+    /* one large buffer leaves the process as several segments */
+    if (pth_udp_segment(tx, 100)) {
+        memset(big, 'g', sizeof(big));
+        iov[0].iov_base = big;
+        iov[0].iov_len  = sizeof(big);
+        n = pth_sendmmsg(tx, vec, 1, 0);
+        TEST_ASSERT(n == 1, "segmented pth_sendmmsg failed");
+        for (got = 0; got < 4; got++) {
+            n = pth_recvmmsg(rx, vec, 1, 0);
+            TEST_ASSERT(n == 1 && vec[0].msg_len == 100, "segment size mismatch");
+        }
+        fprintf(stderr, "  GSO split one buffer into %d datagrams\n", got);
+
+        /* ...and may be received again as one coalesced buffer */
+        if (pth_udp_gro(rx, TRUE)) {
+            n = pth_sendmmsg(tx, vec, 1, 0);
+            TEST_ASSERT(n == 1, "segmented pth_sendmmsg failed");
+            for (got = 0; got < (int)sizeof(big); got += (int)vec[0].msg_len) {
+                vec[0].msg_hdr.msg_control    = cbuf;
+                vec[0].msg_hdr.msg_controllen = sizeof(cbuf);
+                n = pth_recvmmsg(rx, vec, 1, 0);
+                TEST_ASSERT(n == 1, "pth_recvmmsg failed");
+                if (vec[0].msg_len > 100)
+                    TEST_ASSERT(pth_udp_gro_size(&vec[0].msg_hdr) == 100, "GRO size mismatch");
+            }
+            memset(&msg, 0, sizeof(msg));
+            TEST_ASSERT(pth_udp_gro_size(&msg) == 0, "GRO size on empty message");
+            fprintf(stderr, "  GRO received %d bytes\n", got);
+        }
+    }
+    else
+        fprintf(stderr, "  SKIPPED: UDP segmentation offload not available\n");
+
+    close(rx);
+    close(tx);
+
+    fprintf(stderr, "  PASSED: pth_recvmmsg and pth_sendmmsg work correctly\n");
+}
+
 static void test_pth_poll(void)
 {
     int fds[2];
@@ -223,6 +520,117 @@ static void test_pth_poll(void)
     fprintf(stderr, "  PASSED: pth_poll works correctly\n");
 }
 
+static void *poll_writer_thread(void *arg)
+{
+    int fd = *(int *)arg;
+
+    pth_usleep(20000);
+    if (pth_write(fd, "P", 1) != 1)
+        return (void *)1;
+    return NULL;
+}
+
+static void test_pth_poll_native(void)
+{
+    enum { NPIPES = 64 };
+    int fds[NPIPES][2];
+    struct pollfd pfd[NPIPES];
+    struct rlimit rl;
+    pth_t tid;
+    int hifd;
+    int rc;
+    int i;
+    char byte;
+
+    fprintf(stderr, "\nTesting pth_poll without select(2) conversion...\n");
+
+    /* hangups are reported by the kernel instead of being synthesized */
+    if (pipe(fds[0]) != 0)
+        TEST_FAILED("pipe creation failed");
+    close(fds[0][1]);
+    pfd[0].fd = fds[0][0];
+    pfd[0].events = POLLIN;
+    rc = pth_poll(pfd, 1, 1000);
+    TEST_ASSERT(rc == 1, "pth_poll should report the closed writer");
+    TEST_ASSERT(pfd[0].revents & POLLHUP, "POLLHUP should be set");
+    close(fds[0][0]);
+    fprintf(stderr, "  POLLHUP reported for pipe without writer\n");
+
+    /* closed filedescriptors yield POLLNVAL, negative ones are ignored */
+    if (pipe(fds[0]) != 0)
+        TEST_FAILED("pipe creation failed");
+    close(fds[0][0]);
+    close(fds[0][1]);
+    pfd[0].fd = fds[0][0];
+    pfd[0].events = POLLIN;
+    pfd[1].fd = -1;
+    pfd[1].events = POLLIN;
+    rc = pth_poll(pfd, 2, 0);
+    TEST_ASSERT(rc == 1, "pth_poll should count the invalid filedescriptor");
+    TEST_ASSERT(pfd[0].revents == POLLNVAL, "POLLNVAL should be set");
+    TEST_ASSERT(pfd[1].revents == 0, "negative filedescriptor should be ignored");
+
+    /* many filedescriptors with only the last one becoming ready
+       while the caller is suspended in the scheduler */
+    for (i = 0; i < NPIPES; i++) {
+        if (pipe(fds[i]) != 0)
+            TEST_FAILED("pipe creation failed");
+        pfd[i].fd = fds[i][0];
+        pfd[i].events = POLLIN;
+    }
+    tid = pth_spawn(PTH_ATTR_DEFAULT, poll_writer_thread, &fds[NPIPES-1][1]);
+    TEST_ASSERT(tid != NULL, "pth_spawn failed");
+    rc = pth_poll(pfd, NPIPES, 5000);
+    TEST_ASSERT(rc == 1, "pth_poll should report exactly one ready filedescriptor");
+    for (i = 0; i < NPIPES-1; i++)
+        TEST_ASSERT(pfd[i].revents == 0, "idle filedescriptor reported as ready");
+    TEST_ASSERT(pfd[NPIPES-1].revents & POLLIN, "POLLIN should be set");
+    pth_join(tid, NULL);
+    if (read(fds[NPIPES-1][0], &byte, 1) != 1)
+        TEST_FAILED("read failed");
+    fprintf(stderr, "  waited on %d filedescriptors through the scheduler\n", NPIPES);
+
+    /* filedescriptors beyond FD_SETSIZE work, too */
+    hifd = FD_SETSIZE + 16;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur <= (rlim_t)hifd + 1
+        && rl.rlim_max > (rlim_t)hifd + 1) {
+        rl.rlim_cur = (rlim_t)hifd + 2;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    if (dup2(fds[0][0], hifd) == hifd && dup2(fds[0][1], hifd + 1) == hifd + 1) {
+        pfd[0].fd = hifd;
+        pfd[0].events = POLLIN;
+        tid = pth_spawn(PTH_ATTR_DEFAULT, poll_writer_thread, &fds[0][1]);
+        TEST_ASSERT(tid != NULL, "pth_spawn failed");
+        rc = pth_poll(pfd, 1, 5000);
+        TEST_ASSERT(rc == 1, "pth_poll should accept filedescriptors >= FD_SETSIZE");
+        TEST_ASSERT(pfd[0].revents & POLLIN, "POLLIN should be set");
+        pth_join(tid, NULL);
+        TEST_ASSERT(pth_read(hifd, &byte, 1) == 1, "pth_read beyond FD_SETSIZE failed");
+
+        /* and so do the I/O functions waiting for them in the scheduler */
+        tid = pth_spawn(PTH_ATTR_DEFAULT, poll_writer_thread, &fds[0][1]);
+        TEST_ASSERT(tid != NULL, "pth_spawn failed");
+        TEST_ASSERT(pth_read(hifd, &byte, 1) == 1 && byte == 'P',
+                    "waiting pth_read beyond FD_SETSIZE failed");
+        pth_join(tid, NULL);
+        TEST_ASSERT(pth_write(hifd + 1, "H", 1) == 1, "pth_write beyond FD_SETSIZE failed");
+        TEST_ASSERT(pth_read(hifd, &byte, 1) == 1 && byte == 'H', "data mismatch");
+        close(hifd);
+        close(hifd + 1);
+        fprintf(stderr, "  filedescriptor %d beyond FD_SETSIZE polled, read and written\n", hifd);
+    }
+    else
+        fprintf(stderr, "  SKIPPED: cannot create filedescriptor beyond FD_SETSIZE\n");
+
+    for (i = 0; i < NPIPES; i++) {
+        close(fds[i][0]);
+        close(fds[i][1]);
+    }
+
+    fprintf(stderr, "  PASSED: pth_poll works natively\n");
+}
+
 static void test_pth_select(void)
 {
     int fds[2];
@@ -382,6 +790,619 @@ static void test_pth_accept_connect(void)
     fprintf(stderr, "  PASSED: pth_accept and pth_connect work correctly\n");
 }
 
+static void *accept_many_client_thread(void *arg)
+{
+    struct sockaddr_in *addr = (struct sockaddr_in *)arg;
+    int fds[5];
+    int i;
+
+    /* connect all clients before the first byte is sent */
+    for (i = 0; i < 5; i++) {
+        fds[i] = socket(AF_INET, SOCK_STREAM, 0);
+        if (fds[i] < 0 || pth_connect(fds[i], (struct sockaddr *)addr, sizeof(*addr)) != 0)
+            return (void *)1;
+    }
+    pth_usleep(20000);
+    for (i = 0; i < 5; i++) {
+        if (pth_write(fds[i], "x", 1) != 1)
+            return (void *)1;
+        close(fds[i]);
+    }
+    return NULL;
+}
+
+static void *accept_many_reader_thread(void *arg)
+{
+    int fd = *(int *)arg;
+    char byte;
+
+    if (pth_read(fd, &byte, 1) != 1)
+        return (void *)1;
+    return NULL;
+}
+
+static void test_pth_accept_many(void)
+{
+    struct sockaddr_in addr;
+    socklen_t addrlen;
+    pth_t tid;
+    void *result;
+    pth_event_t ev;
+    pth_t readers[2];
+    int fds[8];
+    int pipefd[2];
+    int client;
+    int s;
+    int n, i, total;
+    char byte;
+
+    fprintf(stderr, "\nTesting pth_accept_many...\n");
+
+    s = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT(s >= 0, "socket creation failed");
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    addrlen = sizeof(addr);
+    TEST_ASSERT(bind(s, (struct sockaddr *)&addr, sizeof(addr)) == 0, "bind failed");
+    TEST_ASSERT(listen(s, 16) == 0, "listen failed");
+    TEST_ASSERT(getsockname(s, (struct sockaddr *)&addr, &addrlen) == 0, "getsockname failed");
+
+    TEST_ASSERT(pth_accept_many(s, NULL, 8, NULL) == -1 && errno == EINVAL,
+                "missing array not rejected");
+
+    tid = pth_spawn(PTH_ATTR_DEFAULT, accept_many_client_thread, &addr);
+    TEST_ASSERT(tid != NULL, "pth_spawn failed");
+
+    /* the first call waits, later ones drain the backlog */
+    total = 0;
+    while (total < 5) {
+        n = pth_accept_many(s, fds + total, 8 - total, NULL);
+        TEST_ASSERT(n > 0, "pth_accept_many failed");
+        total += n;
+    }
+    TEST_ASSERT(total == 5, "wrong number of connections accepted");
+    fprintf(stderr, "  accepted %d connections\n", total);
+
+    for (i = 0; i < total; i++) {
+        /* physically non-blocking and close-on-exec, but logically blocking */
+        TEST_ASSERT(fcntl(fds[i], F_GETFL) & O_NONBLOCK, "connection not non-blocking");
+        TEST_ASSERT(fcntl(fds[i], F_GETFD) & FD_CLOEXEC, "connection not close-on-exec");
+        TEST_ASSERT(pth_fdmode(fds[i], PTH_FDMODE_POLL) == PTH_FDMODE_BLOCK,
+                    "connection not in logical blocking mode");
+        n = (int)pth_read(fds[i], &byte, 1);
+        TEST_ASSERT(n == 1 && byte == 'x', "pth_read did not wait for data");
+        if (i < total - 1)
+            TEST_ASSERT(pth_close(fds[i]) == 0, "pth_close failed");
+    }
+    pth_join(tid, &result);
+    TEST_ASSERT(result == NULL, "client thread failed");
+
+    /* a connection closed behind the back of Pth and its number reused
+       for a blocking pipe does not make pth_read block the process */
+    TEST_ASSERT(close(fds[total - 1]) == 0, "close failed");
+    TEST_ASSERT(pipe(pipefd) == 0, "pipe failed");
+    TEST_ASSERT(dup2(pipefd[0], fds[total - 1]) == fds[total - 1], "dup2 failed");
+    close(pipefd[0]);
+    ev = pth_event(PTH_EVENT_TIME, pth_timeout(0, 50000));
+    n = (int)pth_read_ev(fds[total - 1], &byte, 1, ev);
+    TEST_ASSERT(n == -1 && errno == EINTR, "pth_read on reused filedescriptor did not wait");
+    TEST_ASSERT(pth_event_status(ev) == PTH_STATUS_OCCURRED, "timeout did not occur");
+    pth_event_free(ev, PTH_FREE_THIS);
+    TEST_ASSERT(pth_write(pipefd[1], "y", 1) == 1, "pth_write failed");
+    n = (int)pth_read(fds[total - 1], &byte, 1);
+    TEST_ASSERT(n == 1 && byte == 'y', "pth_read on reused filedescriptor failed");
+    close(pipefd[1]);
+    TEST_ASSERT(pth_close(fds[total - 1]) == 0, "pth_close failed");
+
+    /* two readers woken by the same byte: the slower one waits again */
+    client = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT(client >= 0, "socket creation failed");
+    TEST_ASSERT(pth_connect(client, (struct sockaddr *)&addr, sizeof(addr)) == 0,
+                "pth_connect failed");
+    TEST_ASSERT(pth_accept_many(s, fds, 1, NULL) == 1, "pth_accept_many failed");
+    readers[0] = pth_spawn(PTH_ATTR_DEFAULT, accept_many_reader_thread, &fds[0]);
+    readers[1] = pth_spawn(PTH_ATTR_DEFAULT, accept_many_reader_thread, &fds[0]);
+    TEST_ASSERT(readers[0] != NULL && readers[1] != NULL, "pth_spawn failed");
+    pth_yield(NULL);
+    TEST_ASSERT(pth_write(client, "1", 1) == 1, "pth_write failed");
+    pth_nap(pth_time(0, 20000));
+    TEST_ASSERT(pth_write(client, "2", 1) == 1, "pth_write failed");
+    for (i = 0; i < 2; i++) {
+        pth_join(readers[i], &result);
+        TEST_ASSERT(result == NULL, "blocking pth_read failed after a raced wakeup");
+    }
+    TEST_ASSERT(pth_close(fds[0]) == 0, "pth_close failed");
+    close(client);
+
+    /* a non-blocking listener does not wait */
+    pth_fdmode(s, PTH_FDMODE_NONBLOCK);
+    n = pth_accept_many(s, fds, 8, NULL);
+    TEST_ASSERT(n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK),
+                "non-blocking listener should not wait");
+    close(s);
+
+    fprintf(stderr, "  PASSED: pth_accept_many works correctly\n");
+}
+
+#define ZC_SIZE (4 * 1024 * 1024)
+
+static void *send_zc_reader_thread(void *arg)
+{
+    struct sockaddr_in *addr = (struct sockaddr_in *)arg;
+    char buf[8192];
+    size_t total, i;
+    ssize_t n;
+    int s;
+
+    s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s < 0)
+        return (void *)1;
+    if (pth_connect(s, (struct sockaddr *)addr, sizeof(*addr)) != 0)
+        return (void *)1;
+    total = 0;
+    while ((n = pth_read(s, buf, sizeof(buf))) > 0) {
+        for (i = 0; i < (size_t)n; i++)
+            if (buf[i] != (char)(((total + i) % ZC_SIZE) % 251))
+                return (void *)1;
+        total += (size_t)n;
+    }
+    close(s);
+    return (total == 2 * ZC_SIZE ? NULL : (void *)1);
+}
+
+static char send_zc_blocked_data[1024 * 1024];
+
+static void *send_zc_blocked_thread(void *arg)
+{
+    int fd = *(int *)arg;
+    pth_event_t done;
+    ssize_t n;
+
+    /* nobody reads yet, so this blocks once the socket buffer is full */
+    n = pth_send_zc(fd, send_zc_blocked_data, sizeof(send_zc_blocked_data), 0, &done);
+    if (n != (ssize_t)sizeof(send_zc_blocked_data))
+        return (void *)1;
+    pth_event_free(done, PTH_FREE_THIS);
+    return NULL;
+}
+
+static void test_pth_send_zc(void)
+{
+    struct sockaddr_in addr;
+    socklen_t addrlen;
+    pth_event_t done;
+    pth_t tid;
+    void *result;
+    char *buf;
+    ssize_t n;
+    size_t i, total;
+    int fds[2], fds2[2];
+    int s, c, hi;
+
+    fprintf(stderr, "\nTesting pth_send_zc...\n");
+
+    buf = malloc(ZC_SIZE);
+    TEST_ASSERT(buf != NULL, "malloc failed");
+    for (i = 0; i < ZC_SIZE; i++)
+        buf[i] = (char)(i % 251);
+
+    s = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT(s >= 0, "socket creation failed");
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    addrlen = sizeof(addr);
+    TEST_ASSERT(bind(s, (struct sockaddr *)&addr, sizeof(addr)) == 0, "bind failed");
+    TEST_ASSERT(listen(s, 1) == 0, "listen failed");
+    TEST_ASSERT(getsockname(s, (struct sockaddr *)&addr, &addrlen) == 0, "getsockname failed");
+
+    tid = pth_spawn(PTH_ATTR_DEFAULT, send_zc_reader_thread, &addr);
+    TEST_ASSERT(tid != NULL, "pth_spawn failed");
+    c = pth_accept(s, NULL, NULL);
+    TEST_ASSERT(c >= 0, "pth_accept failed");
+
+    /* the buffer may only be reused once the completion event occurred */
+    n = pth_send_zc(c, buf, ZC_SIZE, 0, &done);
+    TEST_ASSERT(n == ZC_SIZE, "pth_send_zc failed");
+    TEST_ASSERT(done != NULL, "no completion event");
+    pth_wait(done);
+    TEST_ASSERT(pth_event_status(done) == PTH_STATUS_OCCURRED, "buffer not released");
+    pth_event_free(done, PTH_FREE_THIS);
+
+    /* loopback reports copied data, so the second send falls back to copying */
+    n = pth_send_zc(c, buf, ZC_SIZE, 0, &done);
+    TEST_ASSERT(n == ZC_SIZE, "second pth_send_zc failed");
+    pth_wait(done);
+    TEST_ASSERT(pth_event_status(done) == PTH_STATUS_OCCURRED, "buffer not released");
+    pth_event_free(done, PTH_FREE_THIS);
+
+    TEST_ASSERT(pth_close(c) == 0, "pth_close failed");
+    pth_join(tid, &result);
+    TEST_ASSERT(result == NULL, "reader did not receive the data");
+    close(s);
+
+    /* sockets without zero-copy support just copy */
+    TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0, "socketpair failed");
+    n = pth_send_zc(fds[0], "hello", 5, 0, &done);
+    TEST_ASSERT(n == 5, "pth_send_zc on unix socket failed");
+    TEST_ASSERT(pth_event_status(done) == PTH_STATUS_OCCURRED, "copied data not released at once");
+    pth_event_free(done, PTH_FREE_THIS);
+    TEST_ASSERT(pth_read(fds[1], buf, 5) == 5 && memcmp(buf, "hello", 5) == 0, "data mismatch");
+    TEST_ASSERT(pth_send_zc(fds[0], "x", 1, 0, NULL) == -1 && errno == EINVAL,
+                "missing event pointer not rejected");
+    pth_close(fds[0]);
+    close(fds[1]);
+
+    /* a sender blocked on a full socket keeps its state while
+       a sender on a high filedescriptor grows the state table */
+    TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0, "socketpair failed");
+    TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds2) == 0, "socketpair failed");
+    hi = dup2(fds2[0], 200);
+    TEST_ASSERT(hi == 200, "dup2 failed");
+    close(fds2[0]);
+    tid = pth_spawn(PTH_ATTR_DEFAULT, send_zc_blocked_thread, &fds[0]);
+    TEST_ASSERT(tid != NULL, "pth_spawn failed");
+    pth_yield(NULL);
+    n = pth_send_zc(hi, "x", 1, 0, &done);
+    TEST_ASSERT(n == 1, "pth_send_zc on high filedescriptor failed");
+    pth_event_free(done, PTH_FREE_THIS);
+    for (total = 0; total < sizeof(send_zc_blocked_data); total += (size_t)n) {
+        n = pth_read(fds[1], buf, ZC_SIZE);
+        TEST_ASSERT(n > 0, "pth_read failed");
+    }
+    pth_join(tid, &result);
+    TEST_ASSERT(result == NULL, "blocked sender failed");
+    pth_close(fds[0]);
+    pth_close(hi);
+    close(fds[1]);
+    close(fds2[1]);
+    free(buf);
+
+    fprintf(stderr, "  PASSED: pth_send_zc works correctly\n");
+}
+
+static void *cork_echo_thread(void *arg)
+{
+    int fd = *(int *)arg;
+    char buf[64];
+    ssize_t n;
+
+    /* the request arrives as one piece once the writer waits */
+    n = pth_read(fd, buf, sizeof(buf));
+    if (n != 8 || memcmp(buf, "req:ping", 8) != 0)
+        return (void *)1;
+    if (pth_write(fd, "pong", 4) != 4)
+        return (void *)1;
+    return NULL;
+}
+
+static void *cork_drain_thread(void *arg)
+{
+    int fd = *(int *)arg;
+    char buf[4096];
+    ssize_t n;
+
+    /* make room after the writer started to wait, then expect the
+       pending byte of its buffer after the data filling the socket */
+    pth_nap(pth_time(0, 50000));
+    for (;;) {
+        if ((n = pth_read(fd, buf, sizeof(buf))) <= 0)
+            return (void *)1;
+        if (buf[n-1] == 'z')
+            return NULL;
+    }
+}
+
+static char cork_blocked_data[1024*1024];
+
+static void *cork_blocked_thread(void *arg)
+{
+    int fd = *(int *)arg;
+
+    /* does not fit, so it is written out together with the buffer */
+    memset(cork_blocked_data, 'c', sizeof(cork_blocked_data));
+    if (pth_write(fd, cork_blocked_data, sizeof(cork_blocked_data)) != -1)
+        return (void *)1;
+    return NULL;
+}
+
+static void test_pth_cork(void)
+{
+    struct pollfd pfd;
+    char big[100];
+    char buf[256];
+    pth_t tid;
+    void *result;
+    pth_event_t ev;
+    ssize_t n;
+    int fds[2];
+    int full[2];
+
+    fprintf(stderr, "\nTesting pth_cork and pth_flush...\n");
+
+    TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0, "socketpair failed");
+    TEST_ASSERT(pth_cork(fds[0], 64), "pth_cork failed");
+    pfd.fd = fds[1];
+    pfd.events = POLLIN;
+
+    /* small writes are collected until the thread yields */
+    TEST_ASSERT(pth_write(fds[0], "a", 1) == 1, "pth_write failed");
+    TEST_ASSERT(pth_write(fds[0], "bc", 2) == 2, "pth_write failed");
+    TEST_ASSERT(poll(&pfd, 1, 0) == 0, "data not collected");
+    pth_yield(NULL);
+    n = read(fds[1], buf, sizeof(buf));
+    TEST_ASSERT(n == 3 && memcmp(buf, "abc", 3) == 0, "data not written on yield");
+
+    /* an explicit flush and output bypassing the buffer */
+    TEST_ASSERT(pth_write(fds[0], "d", 1) == 1, "pth_write failed");
+    TEST_ASSERT(pth_flush(fds[0]), "pth_flush failed");
+    TEST_ASSERT(pth_write(fds[0], "e", 1) == 1, "pth_write failed");
+    TEST_ASSERT(pth_send(fds[0], "f", 1, 0) == 1, "pth_send failed");
+    n = read(fds[1], buf, sizeof(buf));
+    TEST_ASSERT(n == 3 && memcmp(buf, "def", 3) == 0, "order not preserved");
+
+    /* data not fitting goes out together with the pending data */
+    TEST_ASSERT(pth_write(fds[0], "head:", 5) == 5, "pth_write failed");
+    memset(big, 'b', sizeof(big));
+    TEST_ASSERT(pth_write(fds[0], big, sizeof(big)) == (ssize_t)sizeof(big), "large pth_write failed");
+    n = read(fds[1], buf, sizeof(buf));
+    TEST_ASSERT(n == 5 + (ssize_t)sizeof(big) && memcmp(buf, "head:", 5) == 0
+                && buf[n-1] == 'b', "write-through wrong");
+
+    /* waiting for the reply writes out the request */
+    tid = pth_spawn(PTH_ATTR_DEFAULT, cork_echo_thread, &fds[1]);
+    TEST_ASSERT(tid != NULL, "pth_spawn failed");
+    TEST_ASSERT(pth_write(fds[0], "req:", 4) == 4, "pth_write failed");
+    TEST_ASSERT(pth_write(fds[0], "ping", 4) == 4, "pth_write failed");
+    n = pth_read(fds[0], buf, sizeof(buf));
+    TEST_ASSERT(n == 4 && memcmp(buf, "pong", 4) == 0, "no reply");
+    pth_join(tid, &result);
+    TEST_ASSERT(result == NULL, "request not written in one piece");
+
+    /* closing writes out what is left */
+    TEST_ASSERT(pth_write(fds[0], "bye", 3) == 3, "pth_write failed");
+    TEST_ASSERT(pth_close(fds[0]) == 0, "pth_close failed");
+    n = read(fds[1], buf, sizeof(buf));
+    TEST_ASSERT(n == 3 && memcmp(buf, "bye", 3) == 0, "pth_close did not flush");
+    close(fds[1]);
+
+    /* a timed wait on another filedescriptor writes out the buffer
+       (which itself has to wait) but still honours its timeout */
+    TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0, "socketpair failed");
+    TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, full) == 0, "socketpair failed");
+    while (send(full[0], big, sizeof(big), MSG_DONTWAIT) > 0)
+        ;
+    while (send(fds[0], big, sizeof(big), MSG_DONTWAIT) > 0)
+        ;
+    TEST_ASSERT(pth_cork(fds[0], 64), "pth_cork failed");
+    TEST_ASSERT(pth_write(fds[0], "z", 1) == 1, "pth_write failed");
+    tid = pth_spawn(PTH_ATTR_DEFAULT, cork_drain_thread, &fds[1]);
+    TEST_ASSERT(tid != NULL, "pth_spawn failed");
+    ev = pth_event(PTH_EVENT_TIME, pth_timeout(0, 200000));
+    n = pth_write_ev(full[0], "x", 1, ev);
+    TEST_ASSERT(n == -1 && errno == EINTR, "timeout of write ignored");
+    TEST_ASSERT(pth_event_status(ev) == PTH_STATUS_OCCURRED, "timeout did not occur");
+    pth_event_free(ev, PTH_FREE_THIS);
+    pth_join(tid, &result);
+    TEST_ASSERT(result == NULL, "buffer not written out on wait");
+    TEST_ASSERT(pth_close(fds[0]) == 0, "pth_close failed");
+    close(fds[1]);
+    close(full[0]);
+    close(full[1]);
+
+    /* closing while another thread writes the buffer out */
+    TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0, "socketpair failed");
+    TEST_ASSERT(pth_cork(fds[0], 64), "pth_cork failed");
+    tid = pth_spawn(PTH_ATTR_DEFAULT, cork_blocked_thread, &fds[0]);
+    TEST_ASSERT(tid != NULL, "pth_spawn failed");
+    pth_yield(NULL);
+    TEST_ASSERT(pth_close(fds[0]) == 0, "pth_close failed");
+    pth_join(tid, &result);
+    TEST_ASSERT(result == NULL, "write on closed filedescriptor succeeded");
+    close(fds[1]);
+
+    fprintf(stderr, "  PASSED: pth_cork and pth_flush work correctly\n");
+}
+
+static void *deadline_thread(void *arg)
+{
+    char c;
+    int fd = *(int *)arg;
+
+    /* the time budget given at spawn time covers the whole thread */
+    if (pth_read(fd, &c, 1) != -1 || errno != ETIMEDOUT)
+        return (void *)1;
+    return NULL;
+}
+
+static void test_pth_deadline(void)
+{
+    pth_attr_t attr;
+    pth_time_t left;
+    pth_t tid;
+    void *result;
+    char c;
+    int fds[2];
+
+    fprintf(stderr, "\nTesting pth_deadline_push and pth_deadline_pop...\n");
+
+    TEST_ASSERT(pipe(fds) == 0, "pipe failed");
+    TEST_ASSERT(!pth_deadline_remaining(&left) && errno == ENOENT, "unexpected deadline");
+    TEST_ASSERT(!pth_deadline_pop() && errno == ENOENT, "pop without deadline succeeded");
+
+    /* a blocking read fails once the budget is used up */
+    TEST_ASSERT(pth_deadline_push(pth_time(0, 50000)), "pth_deadline_push failed");
+    TEST_ASSERT(pth_deadline_remaining(&left), "pth_deadline_remaining failed");
+    TEST_ASSERT(left.tv_sec == 0 && left.tv_usec <= 50000, "remaining budget wrong");
+    TEST_ASSERT(pth_read(fds[0], &c, 1) == -1 && errno == ETIMEDOUT, "read not cut short");
+    TEST_ASSERT(pth_deadline_remaining(&left) && left.tv_sec == 0 && left.tv_usec == 0,
+                "budget not used up");
+    TEST_ASSERT(pth_nap(pth_time(1, 0)) == FALSE && errno == ETIMEDOUT, "nap not cut short");
+    TEST_ASSERT(pth_deadline_pop(), "pth_deadline_pop failed");
+
+    /* an inner deadline can only shorten the outer one */
+    TEST_ASSERT(pth_deadline_push(pth_time(0, 30000)), "pth_deadline_push failed");
+    TEST_ASSERT(pth_deadline_push(pth_time(10, 0)), "pth_deadline_push failed");
+    TEST_ASSERT(pth_deadline_remaining(&left) && left.tv_sec == 0, "inner deadline extended");
+    TEST_ASSERT(pth_deadline_pop(), "pth_deadline_pop failed");
+    TEST_ASSERT(pth_deadline_pop(), "pth_deadline_pop failed");
+
+    /* without a deadline the thread waits as long as needed */
+    TEST_ASSERT(pth_usleep(40000) == 0, "pth_usleep failed");
+    TEST_ASSERT(write(fds[1], "x", 1) == 1, "write failed");
+    TEST_ASSERT(pth_read(fds[0], &c, 1) == 1, "read failed without deadline");
+
+    /* a time budget as thread attribute */
+    attr = pth_attr_new();
+    TEST_ASSERT(pth_attr_set(attr, PTH_ATTR_DEADLINE, pth_time(0, 20000)), "attribute not set");
+    tid = pth_spawn(attr, deadline_thread, &fds[0]);
+    TEST_ASSERT(tid != NULL, "pth_spawn failed");
+    pth_attr_destroy(attr);
+    TEST_ASSERT(pth_join(tid, &result), "pth_join failed");
+    TEST_ASSERT(result == NULL, "thread deadline not honoured");
+
+    close(fds[0]);
+    close(fds[1]);
+
+    fprintf(stderr, "  PASSED: pth_deadline_push and pth_deadline_pop work correctly\n");
+}
+
+static void *pooled_writer_thread(void *arg)
+{
+    int fd = *(int *)arg;
+
+    pth_nap(pth_time(0, 20000));
+    if (pth_write(fd, "hello", 5) != 5)
+        return (void *)1;
+    return NULL;
+}
+
+static void test_pth_recv_pooled(void)
+{
+    char msg[10000];
+    void *buf, *prev;
+    pth_t tid;
+    void *result;
+    ssize_t n;
+    int fds[2];
+
+    fprintf(stderr, "\nTesting pth_recv_pooled...\n");
+
+    TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0, "socketpair failed");
+
+    /* the thread waits without a buffer and gets one lent on arrival */
+    tid = pth_spawn(PTH_ATTR_DEFAULT, pooled_writer_thread, &fds[1]);
+    TEST_ASSERT(tid != NULL, "pth_spawn failed");
+    n = pth_recv_pooled(fds[0], &buf, 65536, 0);
+    TEST_ASSERT(n == 5 && buf != NULL && memcmp(buf, "hello", 5) == 0, "pooled receive failed");
+    pth_join(tid, &result);
+    TEST_ASSERT(result == NULL, "writer failed");
+    prev = buf;
+    pth_recv_release(buf);
+
+    /* released buffers are reused */
+    TEST_ASSERT(write(fds[1], "again", 5) == 5, "write failed");
+    n = pth_recv_pooled(fds[0], &buf, 65536, 0);
+    TEST_ASSERT(n == 5 && buf == prev, "buffer not reused");
+    pth_recv_release(buf);
+
+    /* larger data gets a larger buffer, but never more than requested */
+    memset(msg, 'm', sizeof(msg));
+    TEST_ASSERT(write(fds[1], msg, sizeof(msg)) == (ssize_t)sizeof(msg), "write failed");
+    n = pth_recv_pooled(fds[0], &buf, 65536, 0);
+    TEST_ASSERT(n == (ssize_t)sizeof(msg) && memcmp(buf, msg, sizeof(msg)) == 0, "large receive failed");
+    pth_recv_release(buf);
+    TEST_ASSERT(write(fds[1], msg, 100) == 100, "write failed");
+    n = pth_recv_pooled(fds[0], &buf, 60, 0);
+    TEST_ASSERT(n == 60, "receive not limited");
+    pth_recv_release(buf);
+    n = pth_recv_pooled(fds[0], &buf, 65536, 0);
+    TEST_ASSERT(n == 40, "rest not received");
+    pth_recv_release(buf);
+
+    /* end of file lends no buffer */
+    close(fds[1]);
+    n = pth_recv_pooled(fds[0], &buf, 65536, 0);
+    TEST_ASSERT(n == 0 && buf == NULL, "end of file not reported");
+    close(fds[0]);
+
+    fprintf(stderr, "  PASSED: pth_recv_pooled works correctly\n");
+}
+
+static void *pipe_producer_thread(void *arg)
+{
+    pth_pipe_t p = (pth_pipe_t)arg;
+    char chunk[100];
+    int i;
+
+    /* more than fits into the pipe, so the producer has to wait */
+    for (i = 0; i < 50; i++) {
+        memset(chunk, 'a' + (i % 26), sizeof(chunk));
+        if (pth_pipe_write(p, chunk, sizeof(chunk), NULL) != (ssize_t)sizeof(chunk))
+            return (void *)1;
+    }
+    pth_pipe_close(p);
+    return NULL;
+}
+
+static void test_pth_pipe(void)
+{
+    pth_pipe_t p;
+    pth_event_t ev;
+    pth_t tid;
+    void *result;
+    char buf[256];
+    size_t total;
+    ssize_t n, i;
+    int ok;
+
+    fprintf(stderr, "\nTesting pth_pipe_read and pth_pipe_write...\n");
+
+    /* a producer and a consumer hand over the data directly */
+    p = pth_pipe_create(1024);
+    TEST_ASSERT(p != NULL, "pth_pipe_create failed");
+    tid = pth_spawn(PTH_ATTR_DEFAULT, pipe_producer_thread, p);
+    TEST_ASSERT(tid != NULL, "pth_spawn failed");
+    total = 0;
+    ok = TRUE;
+    while ((n = pth_pipe_read(p, buf, sizeof(buf), NULL)) > 0) {
+        for (i = 0; i < n; i++)
+            if (buf[i] != 'a' + (int)(((total + (size_t)i) / 100) % 26))
+                ok = FALSE;
+        total += (size_t)n;
+    }
+    TEST_ASSERT(n == 0, "end of data not reported");
+    TEST_ASSERT(total == 5000 && ok, "data corrupted");
+    pth_join(tid, &result);
+    TEST_ASSERT(result == NULL, "producer failed");
+    TEST_ASSERT(pth_pipe_write(p, "x", 1, NULL) == -1 && errno == EPIPE, "write after close");
+    TEST_ASSERT(pth_pipe_destroy(p), "pth_pipe_destroy failed");
+
+    /* waiting is limited by extra events */
+    p = pth_pipe_create(4);
+    TEST_ASSERT(p != NULL, "pth_pipe_create failed");
+    ev = pth_event(PTH_EVENT_TIME, pth_timeout(0, 20000));
+    TEST_ASSERT(pth_pipe_read(p, buf, 1, ev) == -1 && errno == EINTR, "read not interrupted");
+    pth_event_free(ev, PTH_FREE_THIS);
+    ev = pth_event(PTH_EVENT_TIME, pth_timeout(0, 20000));
+    n = pth_pipe_write(p, "abcdef", 6, ev);
+    TEST_ASSERT(n == 4, "partial write not reported");
+    pth_event_free(ev, PTH_FREE_THIS);
+
+    /* the pipe is an event source for everybody else */
+    ev = pth_event(PTH_EVENT_PIPE|PTH_UNTIL_FD_WRITEABLE, p);
+    TEST_ASSERT(ev != NULL, "pth_event failed");
+    TEST_ASSERT(pth_pipe_read(p, buf, sizeof(buf), NULL) == 4, "read failed");
+    TEST_ASSERT(pth_wait(ev) == 1, "pipe not writeable");
+    pth_event_free(ev, PTH_FREE_THIS);
+    TEST_ASSERT(pth_pipe_destroy(p), "pth_pipe_destroy failed");
+
+    fprintf(stderr, "  PASSED: pth_pipe_read and pth_pipe_write work correctly\n");
+}
+
 static void test_pth_recv_send(void)
 {
     int fds[2];
@@ -410,6 +1431,56 @@ static void test_pth_recv_send(void)
     fprintf(stderr, "  PASSED: pth_recv and pth_send work correctly\n");
 }
 
+static void test_pth_uring_timeout(void)
+{
+    int fds[2];
+    char buf[16];
+    pth_event_t ev;
+    ssize_t n;
+
+    if (pipe(fds) != 0)
+        TEST_FAILED("pipe creation failed");
+
+    /* the pending read has to be cancelled in the kernel */
+    ev = pth_event(PTH_EVENT_TIME, pth_timeout(0, 100000));
+    n = pth_read_ev(fds[0], buf, sizeof(buf), ev);
+    TEST_ASSERT(n == -1 && errno == EINTR, "pth_read_ev did not time out");
+    pth_event_free(ev, PTH_FREE_THIS);
+
+    /* ...and must not have swallowed later data */
+    TEST_ASSERT(write(fds[1], "x", 1) == 1, "write failed");
+    n = pth_read(fds[0], buf, sizeof(buf));
+    TEST_ASSERT(n == 1 && buf[0] == 'x', "data lost after cancelled read");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void test_pth_uring(void)
+{
+    fprintf(stderr, "\nTesting the io_uring engine...\n");
+
+    if (pth_ctrl(PTH_CTRL_IOURING, TRUE) != 1) {
+        fprintf(stderr, "  SKIPPED: io_uring not available\n");
+        return;
+    }
+
+    /* the same API, now completion based */
+    test_pth_read_write();
+    test_pth_readv_writev();
+    test_pth_pread_pwrite();
+    test_pth_preadv_pwritev();
+    test_pth_accept_connect();
+    test_pth_accept_many();
+    test_pth_recv_send();
+    test_pth_recv_pooled();
+    test_pth_uring_timeout();
+
+    TEST_ASSERT(pth_ctrl(PTH_CTRL_IOURING, FALSE) == 0, "engine not switched off");
+
+    fprintf(stderr, "  PASSED: io_uring engine works correctly\n");
+}
+
 int main(int argc, char *argv[])
 {
     (void)argc;
@@ -425,10 +1496,21 @@ int main(int argc, char *argv[])
     test_pth_read_write();
     test_pth_readv_writev();
     test_pth_pread_pwrite();
+    test_pth_preadv_pwritev();
+    test_pth_sendfile_splice_tee();
     test_pth_poll();
+    test_pth_poll_native();
     test_pth_select();
     test_pth_accept_connect();
+    test_pth_accept_many();
+    test_pth_send_zc();
+    test_pth_cork();
+    test_pth_deadline();
+    test_pth_pipe();
     test_pth_recv_send();
+    test_pth_recv_pooled();
+    test_pth_recvmmsg_sendmmsg();
+    test_pth_uring();
 
     pth_kill();
 
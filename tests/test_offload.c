@@ -0,0 +1,279 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  Test: Offloading of blocking calls to kernel threads
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include "pth.h"
+
+static int test_count = 0;
+static int test_passed = 0;
+static int test_failed = 0;
+
+#define TEST(name) do { \
+    test_count++; \
+    printf("Test %d: %s ... ", test_count, name); \
+    fflush(stdout); \
+} while (0)
+
+#define PASS() do { \
+    test_passed++; \
+    printf("OK\n"); \
+} while (0)
+
+#define FAIL(msg) do { \
+    test_failed++; \
+    printf("FAILED: %s\n", msg); \
+} while (0)
+
+#define ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        FAIL(msg); \
+        return; \
+    } \
+} while (0)
+
+static double now_msec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+/* a call which blocks in the kernel without any pollable fd */
+static void *blocking_sleep(void *arg)
+{
+    struct timespec ts;
+
+    ts.tv_sec  = 0;
+    ts.tv_nsec = (long)arg * 1000000L;
+    nanosleep(&ts, NULL);
+    return arg;
+}
+
+static void *double_it(void *arg)
+{
+    return (void *)((long)arg * 2);
+}
+
+static volatile int spinner_count = 0;
+
+static void *spinner_thread(void *arg __attribute__((unused)))
+{
+    for (;;) {
+        spinner_count++;
+        pth_yield(NULL);
+        pth_cancel_point();
+    }
+    return NULL;
+}
+
+static void test_offload_result(void)
+{
+    void *value = NULL;
+
+    TEST("pth_offload: function result is returned");
+    ASSERT(pth_offload(double_it, (void *)21L, &value) == TRUE, "pth_offload failed");
+    ASSERT((long)value == 42, "wrong result");
+    ASSERT(pth_offload(double_it, (void *)1L, NULL) == TRUE, "pth_offload without value failed");
+    PASS();
+}
+
+static void test_offload_invalid(void)
+{
+    TEST("pth_offload: NULL function rejected");
+    ASSERT(pth_offload(NULL, NULL, NULL) == FALSE, "NULL function accepted");
+    ASSERT(errno == EINVAL, "wrong errno");
+    PASS();
+}
+
+static void test_offload_does_not_block(void)
+{
+    pth_t spinner;
+
+    TEST("pth_offload: other threads run while the call blocks");
+    spinner_count = 0;
+    spinner = pth_spawn(PTH_ATTR_DEFAULT, spinner_thread, NULL);
+    ASSERT(spinner != NULL, "spawn failed");
+    ASSERT(pth_offload(blocking_sleep, (void *)100L, NULL) == TRUE, "pth_offload failed");
+    pth_cancel(spinner);
+    pth_join(spinner, NULL);
+    ASSERT(spinner_count > 10, "the blocking call froze the other threads");
+    PASS();
+}
+
+#define PARALLEL_JOBS 4
+
+static void *offloader(void *arg)
+{
+    void *value = NULL;
+
+    if (!pth_offload(blocking_sleep, arg, &value))
+        return NULL;
+    return value;
+}
+
+static void test_offload_parallel(void)
+{
+    pth_t tids[PARALLEL_JOBS];
+    void *value;
+    long jobs, latency;
+    double t0, dt;
+    int i;
+
+    TEST("pth_offload: jobs of several threads run in parallel");
+    jobs    = pth_ctrl(PTH_CTRL_GETOFFLOADJOBS);
+    latency = pth_ctrl(PTH_CTRL_GETOFFLOADLATENCY);
+    t0 = now_msec();
+    for (i = 0; i < PARALLEL_JOBS; i++) {
+        tids[i] = pth_spawn(PTH_ATTR_DEFAULT, offloader, (void *)100L);
+        ASSERT(tids[i] != NULL, "spawn failed");
+    }
+    for (i = 0; i < PARALLEL_JOBS; i++) {
+        value = NULL;
+        pth_join(tids[i], &value);
+        ASSERT((long)value == 100, "job result lost");
+    }
+    dt = now_msec() - t0;
+    ASSERT(dt < 100.0 * PARALLEL_JOBS - 50.0, "jobs were serialized");
+
+    jobs    = pth_ctrl(PTH_CTRL_GETOFFLOADJOBS) - jobs;
+    latency = pth_ctrl(PTH_CTRL_GETOFFLOADLATENCY) - latency;
+    ASSERT(jobs == PARALLEL_JOBS, "completed jobs not counted");
+    ASSERT(latency >= 100000L * PARALLEL_JOBS, "latency not accounted");
+    ASSERT(pth_ctrl(PTH_CTRL_GETOFFLOADQUEUE) == 0, "queue not drained");
+    PASS();
+}
+
+static void test_mmap_prefetch(void)
+{
+    unsigned char vec[64];
+    size_t page, len;
+    long jobs;
+    char *map;
+    int i;
+
+    TEST("pth_mmap_prefetch: cold pages are faulted in off the scheduler");
+    page = (size_t)sysconf(_SC_PAGESIZE);
+    len  = 64 * page;
+    map  = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    ASSERT(map != MAP_FAILED, "mmap failed");
+    ASSERT(mincore(map, len, vec) == 0 && !(vec[0] & 1), "fresh mapping already resident");
+
+    /* the cold range is touched by a kernel thread */
+    jobs = pth_ctrl(PTH_CTRL_GETOFFLOADJOBS);
+    ASSERT(pth_mmap_prefetch(map + 10, len - 20) == TRUE, "prefetch failed");
+    ASSERT(pth_ctrl(PTH_CTRL_GETOFFLOADJOBS) == jobs + 1, "cold range not offloaded");
+    ASSERT(mincore(map, len, vec) == 0, "mincore failed");
+    for (i = 0; i < 64; i++)
+        ASSERT(vec[i] & 1, "page not resident");
+
+    /* a hot range costs no offloading */
+    ASSERT(pth_mmap_prefetch(map, len) == TRUE, "prefetch failed");
+    ASSERT(pth_ctrl(PTH_CTRL_GETOFFLOADJOBS) == jobs + 1, "hot range offloaded");
+    munmap(map, len);
+
+    /* a passed deadline does not leave the range touched behind our back,
+       so it can be unmapped right away */
+    len = 4096 * page;
+    map = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    ASSERT(map != MAP_FAILED, "mmap failed");
+    ASSERT(pth_deadline_push(pth_time(0, 1)), "pth_deadline_push failed");
+    ASSERT(pth_mmap_prefetch(map, len) == TRUE, "prefetch aborted by deadline");
+    ASSERT(pth_deadline_pop(), "pth_deadline_pop failed");
+    ASSERT(mincore(map, 64 * page, vec) == 0 && (vec[63] & 1), "range not touched");
+
+    /* unmapped memory is reported */
+    munmap(map, len);
+    ASSERT(pth_mmap_prefetch(map, len) == FALSE && errno == ENOMEM, "unmapped range accepted");
+    PASS();
+}
+
+#define FSYNC_THREADS 8
+
+static void *fsync_writer(void *arg)
+{
+    int fd = (int)(long)arg;
+
+    if (pth_write(fd, "record\n", 7) != 7)
+        return (void *)1;
+    if (!pth_fsync_group(fd))
+        return (void *)1;
+    return NULL;
+}
+
+static void test_fsync_group(void)
+{
+    char path[] = "/tmp/test_offload_XXXXXX";
+    pth_t tids[FSYNC_THREADS];
+    void *value;
+    long syncs, requests, latency;
+    int fd, i;
+
+    TEST("pth_fsync_group: concurrent syncs are coalesced");
+    fd = mkstemp(path);
+    ASSERT(fd >= 0, "mkstemp failed");
+    unlink(path);
+    syncs    = pth_ctrl(PTH_CTRL_GETFSYNCS);
+    requests = pth_ctrl(PTH_CTRL_GETFSYNCREQUESTS);
+    latency  = pth_ctrl(PTH_CTRL_GETFSYNCLATENCY);
+    for (i = 0; i < FSYNC_THREADS; i++) {
+        tids[i] = pth_spawn(PTH_ATTR_DEFAULT, fsync_writer, (void *)(long)fd);
+        ASSERT(tids[i] != NULL, "spawn failed");
+    }
+    for (i = 0; i < FSYNC_THREADS; i++) {
+        value = (void *)1;
+        pth_join(tids[i], &value);
+        ASSERT(value == NULL, "write or sync failed");
+    }
+    syncs    = pth_ctrl(PTH_CTRL_GETFSYNCS) - syncs;
+    requests = pth_ctrl(PTH_CTRL_GETFSYNCREQUESTS) - requests;
+    latency  = pth_ctrl(PTH_CTRL_GETFSYNCLATENCY) - latency;
+    ASSERT(requests == FSYNC_THREADS, "requests not counted");
+    ASSERT(syncs >= 1 && syncs <= 2, "syncs not coalesced");
+    ASSERT(latency >= 0, "latency not accounted");
+    ASSERT(pth_close(fd) == 0, "pth_close failed");
+
+    ASSERT(pth_fsync_group(-1) == FALSE && errno == EBADF, "bad filedescriptor accepted");
+    PASS();
+}
+
+int main(int argc __attribute__((unused)), char *argv[] __attribute__((unused)))
+{
+    printf("========================================\n");
+    printf("Offload Test Suite\n");
+    printf("========================================\n\n");
+
+    if (!pth_init()) {
+        fprintf(stderr, "ERROR: pth_init() failed\n");
+        return 1;
+    }
+
+    test_offload_result();
+    test_offload_invalid();
+    test_offload_does_not_block();
+    test_offload_parallel();
+    test_mmap_prefetch();
+    test_fsync_group();
+
+    printf("\n========================================\n");
+    printf("Test Results:\n");
+    printf("  Total:  %d\n", test_count);
+    printf("  Passed: %d\n", test_passed);
+    printf("  Failed: %d\n", test_failed);
+    printf("========================================\n");
+
+    pth_kill();
+
+    return (test_failed == 0) ? 0 : 1;
+}
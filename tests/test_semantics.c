@@ -401,6 +401,434 @@ static void test_mutex_with_event(void)
     fprintf(stderr, "  PASSED: mutex with event parameter works\n");
 }
 
+static pth_mutex_t fair_mutex = PTH_MUTEX_INIT;
+static int fair_order[4];
+static int fair_count = 0;
+
+static void *mutex_fair_thread(void *arg)
+{
+    int id = (int)(long)arg;
+    pth_event_t ev;
+    int rc;
+
+    /* a negative id gives up after a short time */
+    if (id < 0) {
+        ev = pth_event(PTH_EVENT_TIME, pth_timeout(0, 20000));
+        rc = pth_mutex_acquire(&fair_mutex, FALSE, ev);
+        pth_event_free(ev, PTH_FREE_THIS);
+        return (void *)(long)(rc == FALSE && errno == EINTR);
+    }
+    pth_mutex_acquire(&fair_mutex, FALSE, NULL);
+    fair_order[fair_count++] = id;
+    pth_mutex_release(&fair_mutex);
+    return NULL;
+}
+
+static void test_mutex_fair(void)
+{
+    pth_t tid[3];
+    void *result;
+    long handoffs, contended;
+    int i;
+
+    fprintf(stderr, "\nTesting fair mutex with ownership handoff...\n");
+
+    TEST_ASSERT(pth_mutex_setmode(&fair_mutex, PTH_MUTEX_FAIR, 0), "pth_mutex_setmode failed");
+    TEST_ASSERT(!pth_mutex_setmode(&fair_mutex, 42, 0) && errno == EINVAL, "bad mode accepted");
+    handoffs  = pth_ctrl(PTH_CTRL_GETMUTEXHANDOFFS);
+    contended = pth_ctrl(PTH_CTRL_GETMUTEXCONTENDED);
+
+    /* queue three threads behind the owner */
+    pth_mutex_acquire(&fair_mutex, FALSE, NULL);
+    for (i = 0; i < 3; i++) {
+        tid[i] = pth_spawn(PTH_ATTR_DEFAULT, mutex_fair_thread, (void *)(long)(i + 1));
+        TEST_ASSERT(tid[i] != NULL, "pth_spawn failed");
+    }
+    pth_yield(NULL);
+    TEST_ASSERT(!pth_mutex_setmode(&fair_mutex, 0, 0) && errno == EBUSY, "mode switched with waiters");
+
+    /* releasing and reacquiring immediately queues the
+       releaser behind the threads which waited before */
+    pth_mutex_release(&fair_mutex);
+    TEST_ASSERT(!pth_mutex_acquire(&fair_mutex, TRUE, NULL) && errno == EBUSY,
+                "mutex not handed over");
+    pth_mutex_acquire(&fair_mutex, FALSE, NULL);
+    fair_order[fair_count++] = 0;
+    for (i = 0; i < 3; i++)
+        pth_join(tid[i], NULL);
+    TEST_ASSERT(fair_count == 4 && fair_order[0] == 1 && fair_order[1] == 2
+                && fair_order[2] == 3 && fair_order[3] == 0, "waiters not served in order");
+    TEST_ASSERT(pth_ctrl(PTH_CTRL_GETMUTEXHANDOFFS) - handoffs == 4, "handoffs not counted");
+    TEST_ASSERT(pth_ctrl(PTH_CTRL_GETMUTEXCONTENDED) - contended == 4, "contention not counted");
+
+    /* a waiter which gives up leaves the queue */
+    tid[0] = pth_spawn(PTH_ATTR_DEFAULT, mutex_fair_thread, (void *)(long)-1);
+    TEST_ASSERT(tid[0] != NULL, "pth_spawn failed");
+    pth_join(tid[0], &result);
+    TEST_ASSERT(result == (void *)1, "waiting not stopped by event");
+    TEST_ASSERT(pth_mutex_setmode(&fair_mutex, 0, 3), "waiter not dequeued");
+    pth_mutex_release(&fair_mutex);
+
+    /* in the default mode the releaser can reacquire at once */
+    pth_mutex_acquire(&fair_mutex, FALSE, NULL);
+    TEST_ASSERT(pth_mutex_release(&fair_mutex), "pth_mutex_release failed");
+    TEST_ASSERT(pth_mutex_acquire(&fair_mutex, TRUE, NULL), "mutex not free after release");
+    pth_mutex_release(&fair_mutex);
+
+    fprintf(stderr, "  PASSED: fair mutex hands ownership over in order\n");
+}
+
+static pth_mutex_t inherit_mutex = PTH_MUTEX_INIT;
+static int inherit_held = FALSE;
+static int inherit_waiting = FALSE;
+static int inherit_preempted = 0;
+
+static void *inherit_low_thread(void *arg)
+{
+    int i;
+
+    (void)arg;
+    pth_mutex_acquire(&inherit_mutex, FALSE, NULL);
+    inherit_held = TRUE;
+    while (!inherit_waiting)
+        pth_yield(NULL);
+    for (i = 0; i < 5; i++)
+        pth_yield(NULL);
+    inherit_held = FALSE;
+    pth_mutex_release(&inherit_mutex);
+    return NULL;
+}
+
+static void *inherit_medium_thread(void *arg)
+{
+    (void)arg;
+    while (inherit_held) {
+        if (inherit_waiting)
+            inherit_preempted++;
+        pth_yield(NULL);
+    }
+    return NULL;
+}
+
+static void *inherit_high_thread(void *arg)
+{
+    (void)arg;
+    inherit_waiting = TRUE;
+    pth_mutex_acquire(&inherit_mutex, FALSE, NULL);
+    inherit_waiting = FALSE;
+    pth_mutex_release(&inherit_mutex);
+    return NULL;
+}
+
+/* count how often a medium priority thread runs while a high
+   priority thread waits for a mutex held by a low priority one */
+static int mutex_inversion(int mode)
+{
+    pth_attr_t attr;
+    pth_t tid[3];
+    int i;
+
+    TEST_ASSERT(pth_mutex_setmode(&inherit_mutex, mode, 0), "pth_mutex_setmode failed");
+    inherit_preempted = 0;
+    attr = pth_attr_new();
+    pth_attr_set(attr, PTH_ATTR_PRIO, PTH_PRIO_MIN);
+    tid[0] = pth_spawn(attr, inherit_low_thread, NULL);
+    while (!inherit_held)
+        pth_yield(NULL);
+    pth_attr_set(attr, PTH_ATTR_PRIO, PTH_PRIO_STD);
+    tid[1] = pth_spawn(attr, inherit_medium_thread, NULL);
+    pth_attr_set(attr, PTH_ATTR_PRIO, PTH_PRIO_MAX);
+    tid[2] = pth_spawn(attr, inherit_high_thread, NULL);
+    pth_attr_destroy(attr);
+    for (i = 0; i < 3; i++) {
+        TEST_ASSERT(tid[i] != NULL, "pth_spawn failed");
+        pth_join(tid[i], NULL);
+    }
+    return inherit_preempted;
+}
+
+static void test_mutex_inherit(void)
+{
+    int plain, inherit;
+
+    fprintf(stderr, "\nTesting mutex priority inheritance...\n");
+
+    plain   = mutex_inversion(PTH_MUTEX_FAIR);
+    inherit = mutex_inversion(PTH_MUTEX_INHERIT);
+    fprintf(stderr, "  medium thread ran %d times without and %d times with inheritance\n",
+            plain, inherit);
+    TEST_ASSERT(inherit < plain, "owner not boosted while a more urgent thread waits");
+
+    /* the boost ends with the release: the low priority
+       thread no longer wins against the medium one */
+    TEST_ASSERT(pth_mutex_acquire(&inherit_mutex, TRUE, NULL), "mutex not released");
+    pth_mutex_release(&inherit_mutex);
+    TEST_ASSERT(mutex_inversion(PTH_MUTEX_INHERIT) == inherit, "boost not reset after release");
+
+    fprintf(stderr, "  PASSED: mutex owner inherits the priority of its waiters\n");
+}
+
+static pth_rwlock_t pref_rwlock = PTH_RWLOCK_INIT;
+static char pref_order[4];
+static int pref_count = 0;
+
+static void *rwlock_pref_thread(void *arg)
+{
+    int op = (int)(long)arg;
+
+    if (!pth_rwlock_acquire(&pref_rwlock, op, FALSE, NULL))
+        return (void *)1;
+    pref_order[pref_count++] = (op == PTH_RWLOCK_RW ? 'W' : 'R');
+    /* readers stay a moment */
+    if (op == PTH_RWLOCK_RD)
+        pth_nap(pth_time(0, 20000));
+    pth_rwlock_release(&pref_rwlock);
+    return NULL;
+}
+
+static void test_rwlock_writer_preference(void)
+{
+    pth_t writer, reader;
+    void *result;
+
+    fprintf(stderr, "\nTesting rwlock writer preference, upgrade and downgrade...\n");
+
+    /* a waiting writer keeps new readers out */
+    TEST_ASSERT(pth_rwlock_acquire(&pref_rwlock, PTH_RWLOCK_RD, FALSE, NULL), "read lock failed");
+    writer = pth_spawn(PTH_ATTR_DEFAULT, rwlock_pref_thread, (void *)(long)PTH_RWLOCK_RW);
+    TEST_ASSERT(writer != NULL, "pth_spawn failed");
+    pth_yield(NULL);
+    TEST_ASSERT(!pth_rwlock_acquire(&pref_rwlock, PTH_RWLOCK_RD, TRUE, NULL) && errno == EBUSY,
+                "reader overtook waiting writer");
+    reader = pth_spawn(PTH_ATTR_DEFAULT, rwlock_pref_thread, (void *)(long)PTH_RWLOCK_RD);
+    TEST_ASSERT(reader != NULL, "pth_spawn failed");
+    pth_yield(NULL);
+    TEST_ASSERT(pth_rwlock_release(&pref_rwlock), "read unlock failed");
+    pth_join(writer, &result);
+    TEST_ASSERT(result == NULL, "writer failed");
+    pth_join(reader, &result);
+    TEST_ASSERT(result == NULL, "reader failed");
+    TEST_ASSERT(pref_count == 2 && pref_order[0] == 'W' && pref_order[1] == 'R',
+                "writer not preferred");
+
+    /* an upgrade waits until the other readers left */
+    TEST_ASSERT(pth_rwlock_acquire(&pref_rwlock, PTH_RWLOCK_RD, FALSE, NULL), "read lock failed");
+    reader = pth_spawn(PTH_ATTR_DEFAULT, rwlock_pref_thread, (void *)(long)PTH_RWLOCK_RD);
+    TEST_ASSERT(reader != NULL, "pth_spawn failed");
+    pth_yield(NULL);
+    TEST_ASSERT(!pth_rwlock_upgrade(&pref_rwlock, TRUE, NULL) && errno == EBUSY,
+                "upgrade with other readers");
+    TEST_ASSERT(pth_rwlock_upgrade(&pref_rwlock, FALSE, NULL), "upgrade failed");
+    TEST_ASSERT(pref_rwlock.rw_writer == pth_self() && pref_rwlock.rw_readers == 0,
+                "not upgraded to writer");
+    pth_join(reader, NULL);
+
+    /* a downgrade lets the readers in again */
+    TEST_ASSERT(pth_rwlock_downgrade(&pref_rwlock), "downgrade failed");
+    TEST_ASSERT(pth_rwlock_acquire(&pref_rwlock, PTH_RWLOCK_RD, TRUE, NULL), "reader kept out");
+    TEST_ASSERT(pth_rwlock_release(&pref_rwlock), "read unlock failed");
+    TEST_ASSERT(pth_rwlock_release(&pref_rwlock), "read unlock failed");
+    TEST_ASSERT(!pth_rwlock_release(&pref_rwlock) && errno == EDEADLK, "unlocked lock released");
+
+    fprintf(stderr, "  PASSED: rwlock prefers writers and upgrades correctly\n");
+}
+
+static pth_sem_t limit_sem = PTH_SEM_INIT(2);
+static int limit_active = 0;
+static int limit_max = 0;
+
+static void *sem_worker_thread(void *arg)
+{
+    (void)arg;
+    if (!pth_sem_acquire(&limit_sem, 1))
+        return (void *)1;
+    if (++limit_active > limit_max)
+        limit_max = limit_active;
+    pth_nap(pth_time(0, 5000));
+    limit_active--;
+    pth_sem_release(&limit_sem, 1);
+    return NULL;
+}
+
+static void *sem_units_thread(void *arg)
+{
+    unsigned int n = (unsigned int)(long)arg;
+
+    if (!pth_sem_acquire(&limit_sem, n))
+        return (void *)1;
+    return NULL;
+}
+
+static void test_sem(void)
+{
+    pth_t tid[5];
+    pth_event_t ev;
+    void *result;
+    int i;
+
+    fprintf(stderr, "\nTesting pth_sem_acquire and pth_sem_release...\n");
+
+    /* a semaphore limits the number of concurrent workers */
+    for (i = 0; i < 5; i++) {
+        tid[i] = pth_spawn(PTH_ATTR_DEFAULT, sem_worker_thread, NULL);
+        TEST_ASSERT(tid[i] != NULL, "pth_spawn failed");
+    }
+    for (i = 0; i < 5; i++) {
+        pth_join(tid[i], &result);
+        TEST_ASSERT(result == NULL, "worker failed");
+    }
+    TEST_ASSERT(limit_max == 2 && limit_sem.sm_value == 2, "limit not enforced");
+
+    /* units are granted in arrival order */
+    TEST_ASSERT(pth_sem_acquire(&limit_sem, 2), "pth_sem_acquire failed");
+    tid[0] = pth_spawn(PTH_ATTR_DEFAULT, sem_units_thread, (void *)3L);
+    tid[1] = pth_spawn(PTH_ATTR_DEFAULT, sem_units_thread, (void *)1L);
+    TEST_ASSERT(tid[0] != NULL && tid[1] != NULL, "pth_spawn failed");
+    pth_yield(NULL);
+    TEST_ASSERT(pth_sem_release(&limit_sem, 1), "pth_sem_release failed");
+    pth_yield(NULL);
+    TEST_ASSERT(limit_sem.sm_value == 1, "small request overtook large one");
+    TEST_ASSERT(!pth_sem_tryacquire(&limit_sem, 1) && errno == EBUSY,
+                "try variant overtook waiters");
+    TEST_ASSERT(pth_sem_release(&limit_sem, 3), "pth_sem_release failed");
+    pth_join(tid[0], &result);
+    TEST_ASSERT(result == NULL, "large request failed");
+    pth_join(tid[1], &result);
+    TEST_ASSERT(result == NULL, "small request failed");
+    TEST_ASSERT(limit_sem.sm_value == 0, "units miscounted");
+
+    /* waiting is limited by extra events */
+    ev = pth_event(PTH_EVENT_TIME, pth_timeout(0, 20000));
+    TEST_ASSERT(!pth_sem_acquire_ev(&limit_sem, 1, ev) && errno == EINTR, "waiting not stopped");
+    pth_event_free(ev, PTH_FREE_THIS);
+    TEST_ASSERT(limit_sem.sm_whead == NULL, "waiter not dequeued");
+
+    /* the semaphore is an event source */
+    TEST_ASSERT(pth_sem_release(&limit_sem, 2), "pth_sem_release failed");
+    ev = pth_event(PTH_EVENT_SEM, &limit_sem, 2U);
+    TEST_ASSERT(ev != NULL && pth_wait(ev) == 1, "semaphore event failed");
+    pth_event_free(ev, PTH_FREE_THIS);
+    TEST_ASSERT(pth_sem_tryacquire(&limit_sem, 2), "pth_sem_tryacquire failed");
+
+    fprintf(stderr, "  PASSED: pth_sem_acquire and pth_sem_release work correctly\n");
+}
+
+static pth_waitgroup_t fanout_wg = PTH_WAITGROUP_INIT;
+static pth_latch_t start_latch = PTH_LATCH_INIT(1);
+static int fanout_done = 0;
+
+static void *waitgroup_child_thread(void *arg)
+{
+    (void)arg;
+    if (!pth_latch_wait(&start_latch, NULL))
+        return (void *)1;
+    pth_nap(pth_time(0, 5000));
+    fanout_done++;
+    pth_waitgroup_done(&fanout_wg);
+    return NULL;
+}
+
+static void test_waitgroup(void)
+{
+    pth_t tid[3];
+    pth_event_t ev;
+    void *result;
+    int i;
+
+    fprintf(stderr, "\nTesting wait groups and latches...\n");
+
+    /* the children are held back by the latch */
+    TEST_ASSERT(pth_waitgroup_add(&fanout_wg, 3), "pth_waitgroup_add failed");
+    for (i = 0; i < 3; i++) {
+        tid[i] = pth_spawn(PTH_ATTR_DEFAULT, waitgroup_child_thread, NULL);
+        TEST_ASSERT(tid[i] != NULL, "pth_spawn failed");
+    }
+    pth_yield(NULL);
+    TEST_ASSERT(fanout_done == 0, "children passed the closed latch");
+
+    /* waiting is limited by extra events */
+    ev = pth_event(PTH_EVENT_TIME, pth_timeout(0, 20000));
+    TEST_ASSERT(!pth_waitgroup_wait(&fanout_wg, ev) && errno == EINTR, "waiting not stopped");
+    pth_event_free(ev, PTH_FREE_THIS);
+    TEST_ASSERT(fanout_wg.wg_waiters == NULL, "waiter not unlinked");
+
+    /* opening the latch lets all children run to completion */
+    TEST_ASSERT(pth_latch_countdown(&start_latch, 1), "pth_latch_countdown failed");
+    TEST_ASSERT(!pth_latch_countdown(&start_latch, 1) && errno == EINVAL, "open latch counted down");
+    TEST_ASSERT(pth_waitgroup_wait(&fanout_wg, NULL), "pth_waitgroup_wait failed");
+    TEST_ASSERT(fanout_done == 3, "returned before all children were done");
+    for (i = 0; i < 3; i++) {
+        pth_join(tid[i], &result);
+        TEST_ASSERT(result == NULL, "child failed");
+    }
+    TEST_ASSERT(pth_latch_wait(&start_latch, NULL), "open latch blocked");
+
+    /* the count cannot drop below zero and a latch cannot be raised */
+    TEST_ASSERT(!pth_waitgroup_done(&fanout_wg) && errno == EINVAL, "negative count accepted");
+    TEST_ASSERT(!pth_waitgroup_add(&start_latch, 1) && errno == EINVAL, "latch raised");
+
+    /* the wait group is an event source */
+    TEST_ASSERT(pth_waitgroup_add(&fanout_wg, 1), "pth_waitgroup_add failed");
+    ev = pth_event(PTH_EVENT_WAITGROUP, &fanout_wg);
+    TEST_ASSERT(ev != NULL && pth_event_status(ev) == PTH_STATUS_PENDING, "pth_event failed");
+    tid[0] = pth_spawn(PTH_ATTR_DEFAULT, waitgroup_child_thread, NULL);
+    TEST_ASSERT(tid[0] != NULL, "pth_spawn failed");
+    TEST_ASSERT(pth_wait(ev) == 1, "wait group event failed");
+    pth_event_free(ev, PTH_FREE_THIS);
+    TEST_ASSERT(fanout_done == 4, "event occurred too early");
+    pth_join(tid[0], NULL);
+
+    fprintf(stderr, "  PASSED: wait groups and latches work correctly\n");
+}
+
+static pth_mutex_t notify_mutex = PTH_MUTEX_INIT;
+static pth_cond_t notify_cond = PTH_COND_INIT;
+static int notify_ready = 0;
+static int notify_woken = 0;
+
+static void *cond_notify_thread(void *arg)
+{
+    (void)arg;
+    pth_mutex_acquire(&notify_mutex, FALSE, NULL);
+    while (!notify_ready)
+        pth_cond_await(&notify_cond, &notify_mutex, NULL);
+    notify_woken++;
+    pth_mutex_release(&notify_mutex);
+    return NULL;
+}
+
+static void test_cond_notify_noyield(void)
+{
+    pth_t tid[2];
+    int i;
+
+    fprintf(stderr, "\nTesting pth_cond_notify without yielding...\n");
+
+    for (i = 0; i < 2; i++) {
+        tid[i] = pth_spawn(PTH_ATTR_DEFAULT, cond_notify_thread, NULL);
+        TEST_ASSERT(tid[i] != NULL, "pth_spawn failed");
+    }
+    pth_yield(NULL);
+    TEST_ASSERT(notify_cond.cn_waiters == 2, "threads not queued");
+
+    /* a notification wakes exactly one thread and does not switch */
+    pth_mutex_acquire(&notify_mutex, FALSE, NULL);
+    notify_ready = 1;
+    TEST_ASSERT(pth_cond_notify(&notify_cond, FALSE), "pth_cond_notify failed");
+    TEST_ASSERT(notify_woken == 0 && notify_cond.cn_waiters == 1, "notify switched or woke all");
+    pth_mutex_release(&notify_mutex);
+    pth_yield(NULL);
+    TEST_ASSERT(notify_woken == 1, "notified thread not woken");
+
+    /* the old behaviour on request */
+    TEST_ASSERT(pth_cond_notify(&notify_cond, FALSE|PTH_COND_YIELD), "pth_cond_notify failed");
+    TEST_ASSERT(notify_woken == 2 && notify_cond.cn_waiters == 0, "notify did not yield");
+    for (i = 0; i < 2; i++)
+        pth_join(tid[i], NULL);
+
+    fprintf(stderr, "  PASSED: pth_cond_notify wakes one thread without yielding\n");
+}
+
 static void test_msgport_pending(void)
 {
     pth_msgport_t mp;
@@ -575,10 +1003,16 @@ int main(int argc, char *argv[])
     test_read_only_attributes();
     test_pth_attr_init();
     test_cond_broadcast();
+    test_cond_notify_noyield();
     test_barrier_headlight_taillight();
     test_mutex_recursive();
     test_mutex_trylock();
     test_mutex_with_event();
+    test_mutex_fair();
+    test_mutex_inherit();
+    test_rwlock_writer_preference();
+    test_sem();
+    test_waitgroup();
     test_msgport_pending();
     test_pth_cancel_point();
     test_pth_abort();
@@ -0,0 +1,250 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  Test: Buffered streams
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include "pth.h"
+
+static int test_count = 0;
+static int test_passed = 0;
+static int test_failed = 0;
+
+#define TEST(name) do { \
+    test_count++; \
+    printf("Test %d: %s ... ", test_count, name); \
+    fflush(stdout); \
+} while (0)
+
+#define PASS() do { \
+    test_passed++; \
+    printf("OK\n"); \
+} while (0)
+
+#define FAIL(msg) do { \
+    test_failed++; \
+    printf("FAILED: %s\n", msg); \
+} while (0)
+
+#define ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        FAIL(msg); \
+        return; \
+    } \
+} while (0)
+
+static const char *lines[] = {
+    "GET / HTTP/1.0\r\n",
+    "Host: localhost\r\n",
+    "X-A-Rather-Long-Header-Line: which does not fit into the small buffer\r\n",
+    "\r\n"
+};
+
+static void *line_writer(void *arg)
+{
+    int fd = *(int *)arg;
+    size_t i, j, len;
+
+    /* trickle the lines in small pieces to force partial fills */
+    for (i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+        len = strlen(lines[i]);
+        for (j = 0; j < len; j += 5) {
+            pth_write(fd, lines[i] + j, (len - j < 5 ? len - j : 5));
+            pth_yield(NULL);
+        }
+    }
+    close(fd);
+    return NULL;
+}
+
+static void test_readuntil(void)
+{
+    pth_stream_t st;
+    pth_t tid;
+    char buf[128];
+    ssize_t n;
+    size_t i;
+    int fds[2];
+
+    TEST("pth_stream_readuntil: lines across partial reads");
+    ASSERT(pipe(fds) == 0, "pipe failed");
+    st = pth_stream_create(fds[0], 16, 0);
+    ASSERT(st != NULL, "create failed");
+    ASSERT(pth_stream_fd(st) == fds[0], "wrong filedescriptor");
+    tid = pth_spawn(PTH_ATTR_DEFAULT, line_writer, &fds[1]);
+    ASSERT(tid != NULL, "spawn failed");
+    for (i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+        n = pth_stream_readuntil(st, '\n', buf, sizeof(buf), NULL);
+        ASSERT(n == (ssize_t)strlen(lines[i]), "wrong line length");
+        ASSERT(memcmp(buf, lines[i], (size_t)n) == 0, "wrong line content");
+    }
+    n = pth_stream_readuntil(st, '\n', buf, sizeof(buf), NULL);
+    ASSERT(n == 0, "no end of input");
+    pth_join(tid, NULL);
+    pth_stream_destroy(st);
+    close(fds[0]);
+    PASS();
+}
+
+static void test_readuntil_limit(void)
+{
+    pth_stream_t st;
+    char buf[8];
+    ssize_t n;
+    int fds[2];
+
+    TEST("pth_stream_readuntil: length limit and final line");
+    ASSERT(pipe(fds) == 0, "pipe failed");
+    ASSERT(write(fds[1], "0123456789\nend", 14) == 14, "write failed");
+    close(fds[1]);
+    st = pth_stream_create(fds[0], 0, 0);
+    ASSERT(st != NULL, "create failed");
+    n = pth_stream_readuntil(st, '\n', buf, sizeof(buf), NULL);
+    ASSERT(n == 8 && memcmp(buf, "01234567", 8) == 0, "limit not honoured");
+    n = pth_stream_readuntil(st, '\n', buf, sizeof(buf), NULL);
+    ASSERT(n == 3 && memcmp(buf, "89\n", 3) == 0, "rest of line wrong");
+    n = pth_stream_readuntil(st, '\n', buf, sizeof(buf), NULL);
+    ASSERT(n == 3 && memcmp(buf, "end", 3) == 0, "unterminated line wrong");
+    pth_stream_destroy(st);
+    close(fds[0]);
+    PASS();
+}
+
+static void test_peek_consume(void)
+{
+    pth_stream_t st;
+    const void *data;
+    ssize_t n;
+    int fds[2];
+
+    TEST("pth_stream_peek/peekuntil: zero-copy access");
+    ASSERT(pipe(fds) == 0, "pipe failed");
+    ASSERT(write(fds[1], "key=value;rest", 14) == 14, "write failed");
+    st = pth_stream_create(fds[0], 8, 0);
+    ASSERT(st != NULL, "create failed");
+
+    n = pth_stream_peekuntil(st, '=', &data, NULL);
+    ASSERT(n == 4 && memcmp(data, "key=", 4) == 0, "peekuntil wrong");
+    ASSERT(pth_stream_consume(st, (size_t)n), "consume failed");
+    n = pth_stream_peek(st, 3, &data, NULL);
+    ASSERT(n >= 3 && memcmp(data, "val", 3) == 0, "peek wrong");
+
+    /* a delimiter beyond the buffer capacity cannot be peeked */
+    n = pth_stream_peekuntil(st, '#', &data, NULL);
+    ASSERT(n == -1 && errno == ENOBUFS, "buffer overflow not reported");
+    n = pth_stream_peekuntil(st, ';', &data, NULL);
+    ASSERT(n == 6 && memcmp(data, "value;", 6) == 0, "peekuntil after overflow wrong");
+    ASSERT(pth_stream_consume(st, (size_t)n), "consume failed");
+    ASSERT(!pth_stream_consume(st, 100), "over-consume accepted");
+    pth_stream_destroy(st);
+    close(fds[0]);
+    close(fds[1]);
+    PASS();
+}
+
+static void test_write_flush(void)
+{
+    pth_stream_t st;
+    struct pollfd pfd;
+    char big[256];
+    char buf[512];
+    ssize_t n;
+    int fds[2];
+
+    TEST("pth_stream_write/flush: buffering and write-through");
+    ASSERT(pipe(fds) == 0, "pipe failed");
+    st = pth_stream_create(fds[1], 0, 64);
+    ASSERT(st != NULL, "create failed");
+
+    /* small writes stay in the buffer until flushed */
+    ASSERT(pth_stream_write(st, "hello ", 6, NULL) == 6, "write failed");
+    ASSERT(pth_stream_write(st, "world", 5, NULL) == 5, "write failed");
+    pfd.fd = fds[0];
+    pfd.events = POLLIN;
+    ASSERT(pth_poll(&pfd, 1, 0) == 0, "data not buffered");
+    ASSERT(pth_stream_flush(st, NULL), "flush failed");
+    n = pth_read(fds[0], buf, sizeof(buf));
+    ASSERT(n == 11 && memcmp(buf, "hello world", 11) == 0, "flushed data wrong");
+
+    /* data exceeding the buffer goes out together with the pending data */
+    ASSERT(pth_stream_write(st, "head:", 5, NULL) == 5, "write failed");
+    memset(big, 'b', sizeof(big));
+    ASSERT(pth_stream_write(st, big, sizeof(big), NULL) == (ssize_t)sizeof(big), "large write failed");
+    n = pth_read(fds[0], buf, sizeof(buf));
+    ASSERT(n == 5 + (ssize_t)sizeof(big), "write-through incomplete");
+    ASSERT(memcmp(buf, "head:", 5) == 0 && buf[5] == 'b' && buf[n-1] == 'b', "write-through wrong");
+
+    /* destroying flushes */
+    ASSERT(pth_stream_write(st, "bye", 3, NULL) == 3, "write failed");
+    ASSERT(pth_stream_destroy(st), "destroy failed");
+    n = pth_read(fds[0], buf, sizeof(buf));
+    ASSERT(n == 3 && memcmp(buf, "bye", 3) == 0, "destroy did not flush");
+    close(fds[0]);
+    close(fds[1]);
+    PASS();
+}
+
+static void test_read_timeout(void)
+{
+    pth_stream_t st;
+    pth_event_t ev;
+    char buf[64];
+    ssize_t n;
+    int fds[2];
+
+    TEST("pth_stream_read: buffered reads and extra event");
+    ASSERT(pipe(fds) == 0, "pipe failed");
+    st = pth_stream_create(fds[0], 0, 0);
+    ASSERT(st != NULL, "create failed");
+    ASSERT(write(fds[1], "abcdef", 6) == 6, "write failed");
+    n = pth_stream_read(st, buf, 2, NULL);
+    ASSERT(n == 2 && memcmp(buf, "ab", 2) == 0, "first read wrong");
+    n = pth_stream_read(st, buf, sizeof(buf), NULL);
+    ASSERT(n == 4 && memcmp(buf, "cdef", 4) == 0, "second read wrong");
+
+    ev = pth_event(PTH_EVENT_TIME, pth_timeout(0, 100000));
+    n = pth_stream_readuntil(st, '\n', buf, sizeof(buf), ev);
+    ASSERT(n == -1 && errno == EINTR, "extra event not honoured");
+    pth_event_free(ev, PTH_FREE_THIS);
+    pth_stream_destroy(st);
+    close(fds[0]);
+    close(fds[1]);
+    PASS();
+}
+
+int main(int argc __attribute__((unused)), char *argv[] __attribute__((unused)))
+{
+    printf("========================================\n");
+    printf("Stream Test Suite\n");
+    printf("========================================\n\n");
+
+    if (!pth_init()) {
+        fprintf(stderr, "ERROR: pth_init() failed\n");
+        return 1;
+    }
+
+    test_readuntil();
+    test_readuntil_limit();
+    test_peek_consume();
+    test_write_flush();
+    test_read_timeout();
+
+    printf("\n========================================\n");
+    printf("Test Results:\n");
+    printf("  Total:  %d\n", test_count);
+    printf("  Passed: %d\n", test_passed);
+    printf("  Failed: %d\n", test_failed);
+    printf("========================================\n");
+
+    pth_kill();
+
+    return (test_failed == 0) ? 0 : 1;
+}
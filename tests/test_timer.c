@@ -0,0 +1,252 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  Test: Timer precision and short sleeps
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include "pth.h"
+
+static int test_count = 0;
+static int test_passed = 0;
+static int test_failed = 0;
+
+#define TEST(name) do { \
+    test_count++; \
+    printf("Test %d: %s ... ", test_count, name); \
+    fflush(stdout); \
+} while (0)
+
+#define PASS() do { \
+    test_passed++; \
+    printf("OK\n"); \
+} while (0)
+
+#define FAIL(msg) do { \
+    test_failed++; \
+    printf("FAILED: %s\n", msg); \
+} while (0)
+
+#define ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        FAIL(msg); \
+        return; \
+    } \
+} while (0)
+
+static double now_usec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (double)ts.tv_sec * 1000000.0 + (double)ts.tv_nsec / 1000.0;
+}
+
+static volatile int spinner_count = 0;
+
+static void *spinner_thread(void *arg __attribute__((unused)))
+{
+    for (;;) {
+        spinner_count++;
+        pth_yield(NULL);
+        pth_cancel_point();
+    }
+    return NULL;
+}
+
+static void test_nanosleep_short(void)
+{
+    struct timespec ts;
+    double t0, dt;
+
+    TEST("pth_nanosleep: 200us sleep is neither skipped nor much too long");
+    ts.tv_sec  = 0;
+    ts.tv_nsec = 200000;
+    t0 = now_usec();
+    ASSERT(pth_nanosleep(&ts, NULL) == 0, "pth_nanosleep failed");
+    dt = now_usec() - t0;
+    ASSERT(dt >= 200.0, "woke up too early");
+    ASSERT(dt < 20000.0, "woke up much too late");
+    PASS();
+}
+
+static void test_nanosleep_invalid(void)
+{
+    struct timespec ts;
+
+    TEST("pth_nanosleep: invalid nanoseconds rejected");
+    ts.tv_sec  = 0;
+    ts.tv_nsec = 1000000000L;
+    ASSERT(pth_nanosleep(&ts, NULL) == -1, "invalid value accepted");
+    PASS();
+}
+
+static void test_short_sleep_does_not_block(void)
+{
+    pth_t spinner;
+    struct timeval tv;
+    int i;
+
+    TEST("pth_select/pth_usleep: short delays let other threads run");
+    spinner_count = 0;
+    spinner = pth_spawn(PTH_ATTR_DEFAULT, spinner_thread, NULL);
+    ASSERT(spinner != NULL, "spawn failed");
+
+    /* delays below 10ms were formerly performed by blocking the process */
+    for (i = 0; i < 5; i++) {
+        tv.tv_sec  = 0;
+        tv.tv_usec = 2000;
+        pth_select(0, NULL, NULL, NULL, &tv);
+    }
+    ASSERT(spinner_count > 5, "pth_select blocked the other threads");
+
+    spinner_count = 0;
+    for (i = 0; i < 5; i++)
+        pth_usleep(500);
+    ASSERT(spinner_count > 5, "pth_usleep blocked the other threads");
+
+    pth_cancel(spinner);
+    pth_join(spinner, NULL);
+    PASS();
+}
+
+static void test_pselect_nsec(void)
+{
+    struct timespec ts;
+    double t0, dt;
+
+    TEST("pth_pselect: nanosecond timeout honoured");
+    ts.tv_sec  = 0;
+    ts.tv_nsec = 300000;
+    t0 = now_usec();
+    ASSERT(pth_pselect(0, NULL, NULL, NULL, &ts, NULL) == 0, "pth_pselect failed");
+    dt = now_usec() - t0;
+    ASSERT(dt >= 300.0, "woke up too early");
+    ASSERT(dt < 20000.0, "woke up much too late");
+    PASS();
+}
+
+static void test_timer_slack_attr(void)
+{
+    pth_attr_t attr;
+    long slack;
+
+    TEST("pth_attr: PTH_ATTR_TIMER_SLACK set/get");
+    attr = pth_attr_new();
+    ASSERT(attr != NULL, "pth_attr_new failed");
+    slack = -1;
+    ASSERT(pth_attr_get(attr, PTH_ATTR_TIMER_SLACK, &slack) == TRUE, "get failed");
+    ASSERT(slack == 0, "default slack not zero");
+    ASSERT(pth_attr_set(attr, PTH_ATTR_TIMER_SLACK, 5000000L) == TRUE, "set failed");
+    ASSERT(pth_attr_get(attr, PTH_ATTR_TIMER_SLACK, &slack) == TRUE, "get failed");
+    ASSERT(slack == 5000000L, "slack mismatch");
+    ASSERT(pth_attr_set(attr, PTH_ATTR_TIMER_SLACK, -1L) == FALSE, "negative slack accepted");
+    pth_attr_destroy(attr);
+    PASS();
+}
+
+#define SLACK_THREADS 20
+
+static void *slack_sleeper(void *arg)
+{
+    struct timespec ts;
+    long i = (long)arg;
+
+    /* deadlines 0.5ms apart from each other */
+    ts.tv_sec  = 0;
+    ts.tv_nsec = 10000000L + i * 500000L;
+    pth_nanosleep(&ts, NULL);
+    return NULL;
+}
+
+static void test_timer_slack_coalescing(void)
+{
+    pth_attr_t attr;
+    pth_t tids[SLACK_THREADS];
+    long wakeups, coalesced;
+    long i;
+
+    TEST("timer slack: nearby deadlines share wakeups");
+    attr = pth_attr_new();
+    pth_attr_set(attr, PTH_ATTR_JOINABLE, TRUE);
+    pth_attr_set(attr, PTH_ATTR_TIMER_SLACK, 20000000L);
+
+    wakeups   = pth_ctrl(PTH_CTRL_GETTIMERWAKEUPS);
+    coalesced = pth_ctrl(PTH_CTRL_GETTIMERCOALESCED);
+    for (i = 0; i < SLACK_THREADS; i++) {
+        tids[i] = pth_spawn(attr, slack_sleeper, (void *)i);
+        ASSERT(tids[i] != NULL, "spawn failed");
+    }
+    for (i = 0; i < SLACK_THREADS; i++)
+        pth_join(tids[i], NULL);
+    wakeups   = pth_ctrl(PTH_CTRL_GETTIMERWAKEUPS) - wakeups;
+    coalesced = pth_ctrl(PTH_CTRL_GETTIMERCOALESCED) - coalesced;
+    pth_attr_destroy(attr);
+
+    ASSERT(wakeups >= 1, "no timer wakeup counted");
+    ASSERT(wakeups <= SLACK_THREADS / 4, "timers were not coalesced");
+    ASSERT(coalesced >= SLACK_THREADS / 2, "coalesced timers not counted");
+    PASS();
+}
+
+static void test_timer_no_slack_not_coalesced(void)
+{
+    pth_attr_t attr;
+    pth_t tids[SLACK_THREADS];
+    long coalesced;
+    long i;
+
+    TEST("timer slack: timers without slack are not counted as coalesced");
+    attr = pth_attr_new();
+    pth_attr_set(attr, PTH_ATTR_JOINABLE, TRUE);
+
+    coalesced = pth_ctrl(PTH_CTRL_GETTIMERCOALESCED);
+    for (i = 0; i < SLACK_THREADS; i++) {
+        tids[i] = pth_spawn(attr, slack_sleeper, (void *)(i / 4));
+        ASSERT(tids[i] != NULL, "spawn failed");
+    }
+    for (i = 0; i < SLACK_THREADS; i++)
+        pth_join(tids[i], NULL);
+    coalesced = pth_ctrl(PTH_CTRL_GETTIMERCOALESCED) - coalesced;
+    pth_attr_destroy(attr);
+
+    ASSERT(coalesced == 0, "timers expiring late were counted as coalesced");
+    PASS();
+}
+
+int main(int argc __attribute__((unused)), char *argv[] __attribute__((unused)))
+{
+    printf("========================================\n");
+    printf("Timer Test Suite\n");
+    printf("========================================\n\n");
+
+    if (!pth_init()) {
+        fprintf(stderr, "ERROR: pth_init() failed\n");
+        return 1;
+    }
+
+    test_nanosleep_short();
+    test_nanosleep_invalid();
+    test_short_sleep_does_not_block();
+    test_pselect_nsec();
+    test_timer_slack_attr();
+    test_timer_slack_coalescing();
+    test_timer_no_slack_not_coalesced();
+
+    printf("\n========================================\n");
+    printf("Test Results:\n");
+    printf("  Total:  %d\n", test_count);
+    printf("  Passed: %d\n", test_passed);
+    printf("  Failed: %d\n", test_failed);
+    printf("========================================\n");
+
+    pth_kill();
+
+    return (test_failed == 0) ? 0 : 1;
+}